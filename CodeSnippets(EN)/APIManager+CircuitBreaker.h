@@ -0,0 +1,94 @@
+#import "APIManager.h"
+#import "APIMethods.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+/*--------------------------------------------------------------------------------------------------------------
+ States of the circuit of one host.
+ 'Closed'   - requests are sent as usual, their outcomes are counted.
+ 'Open'     - requests are not sent, they fail immediately (or receive the cached answer).
+ 'HalfOpen' - the open interval has passed. Only one probe request is sent, its outcome closes or opens the circuit.
+ --------------------------------------------------------------------------------------------------------------*/
+typedef NS_ENUM(NSInteger, APICircuitState) {
+    APICircuitState_Closed = 0,
+    APICircuitState_Open,
+    APICircuitState_HalfOpen
+};
+
+// The code of the error which is returned instead of sending the request to the host with the open circuit
+static const NSInteger APICircuitOpenErrorCode = 503;
+
+
+/*--------------------------------------------------------------------------------------------------------------
+ 🌐🔌 'APIManager(CircuitBreaker)' - stops sending requests to a host that does not respond.
+ ---------------
+ When 'api.vk.com' or the photo upload server degrades, each screen keeps sending requests which wait for the
+ timeout of 5 seconds. The operations pile up in the queues, and the server receives even more load.
+ The circuit breaker counts the outcomes of the last requests of each host and, if too many of them failed,
+ "opens the circuit": new requests fail immediately without going to the network.
+ ---------------
+ [⚖️] Duties:
+ - Keep a sliding window of the last 'circuitWindowSize' outcomes for each host.
+ - Open the circuit when the share of failures reaches 'circuitFailureRateThreshold'.
+ - After 'circuitOpenInterval' seconds let one probe request through and close the circuit if it succeeds.
+ - Keep the last successful answer of idempotent requests and return it while the circuit is open.
+ ---------------
+ Additionally:
+ (⚠️) Failures are timeouts, refused connections and VK errors 1 and 10. Cancelled requests and the absence of
+      the Internet on the device are not counted: they say nothing about the state of the server.
+ (⚠️) The rejected request is not sent. The methods of 'APIManager' still return the operation, it already
+      contains the error with the code 'APICircuitOpenErrorCode' or the cached answer. When it is started, the
+      operation performs the local request built by '+requestInPlaceOfRejectedRequest:' and finishes as usual.
+ --------------------------------------------------------------------------------------------------------------*/
+@interface APIManager (CircuitBreaker)
+
+@property (class, nonatomic, assign) double         circuitFailureRateThreshold; // default 0.5
+@property (class, nonatomic, assign) NSUInteger     circuitWindowSize;           // default 20
+@property (class, nonatomic, assign) NSUInteger     circuitMinimumRequests;      // default 10. Fewer outcomes never open the circuit
+@property (class, nonatomic, assign) NSTimeInterval circuitOpenInterval;         // default 30 sec.
+
+
+#pragma mark - Admission
+
+/*--------------------------------------------------------------------------------------------------------------
+ Returns 'nil' if the request may be sent, otherwise the error which is returned to the user instead of the answer.
+ In the 'HalfOpen' state the first call lets the probe through, all the next ones are rejected until its outcome.
+ --------------------------------------------------------------------------------------------------------------*/
++ (nullable NSError*) admitRequest:(NSURLRequest*)request;
+
+/*--------------------------------------------------------------------------------------------------------------
+ Returns 'YES' if '+admitRequest:' would reject the request now. Unlike it, changes nothing:
+ the probe of the half-open circuit is not taken.
+ --------------------------------------------------------------------------------------------------------------*/
++ (BOOL) isCircuitOpenForRequest:(NSURLRequest*)request;
+
+/*--------------------------------------------------------------------------------------------------------------
+ Returns the request which the operation of the rejected request performs instead of it. 'NSURLSession' answers
+ the 'data:' URL itself without the network, so the operation starts and finishes as usual: '-syncStart' returns,
+ the queue releases the operation, the 'completion' is called.
+ --------------------------------------------------------------------------------------------------------------*/
++ (NSURLRequest*) requestInPlaceOfRejectedRequest:(NSURLRequest*)request;
+
+/*--------------------------------------------------------------------------------------------------------------
+ Counts the outcome of the finished operation in the window of the host to which the request was sent.
+ --------------------------------------------------------------------------------------------------------------*/
++ (void) recordOutcomeOfOperation:(BO*)op forRequest:(NSURLRequest*)request;
+
++ (APICircuitState) circuitStateForHost:(NSString*)host;
+
+
+#pragma mark - Cache
+
+/*--------------------------------------------------------------------------------------------------------------
+ Saves the successful answer of the API method whose 'cacheTTL' is above zero. Other answers are ignored.
+ --------------------------------------------------------------------------------------------------------------*/
++ (void) cacheResponseOfOperation:(BO*)op forRequest:(NSURLRequest*)request APIMethod:(APIMethod)method;
+
+/*--------------------------------------------------------------------------------------------------------------
+ Returns the last successful answer to the same request if it is not older than 'cacheTTL', or 'nil'.
+ --------------------------------------------------------------------------------------------------------------*/
++ (nullable id) cachedResponseForRequest:(NSURLRequest*)request APIMethod:(APIMethod)method;
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,397 @@
+#import "APIManager+CircuitBreaker.h"
+#import "APIManager+RetryPolicy.h"
+#import "APIMethodRegistry.h"
+#import "NetworkRequestConstructor+RequestBody.h"
+#import "NSError+ShortStyle.h"
+#import <RXNetworkOperation/RXNetworkOperation.h>
+
+
+// VK API errors which mean that the server itself is in trouble
+#define unknownErrorCode        1   // "Unknown error occurred"
+#define internalServerErrorCode 10  // "Internal server error"
+// How many last successful answers are kept for the fallback
+#define responseCacheCountLimit 64
+
+
+typedef NS_ENUM(NSInteger, APICircuitOutcome) {
+    APICircuitOutcome_Neutral = 0,
+    APICircuitOutcome_Success,
+    APICircuitOutcome_Failure
+};
+
+
+/*--------------------------------------------------------------------------------------------------------------
+ 'APICircuit' - the state of the circuit of one host.
+ 'outcomes' is a ring buffer of the last outcomes ('YES' - failure).
+ --------------------------------------------------------------------------------------------------------------*/
+@interface APICircuit : NSObject
+@property (nonatomic, assign) APICircuitState state;
+@property (nonatomic, strong) NSMutableArray<NSNumber*>* outcomes;
+@property (nonatomic, assign) NSUInteger     nextOutcomeIndex;
+@property (nonatomic, assign) CFAbsoluteTime openedAt;
+@property (nonatomic, assign) CFAbsoluteTime probeSentAt; // '0' - there is no probe in flight
+
+- (void) addOutcome:(BOOL)isFailure windowSize:(NSUInteger)windowSize;
+- (double) failureRate;
+- (void) open;
+- (void) close;
+@end
+
+
+@implementation APICircuit
+
+- (instancetype) init
+{
+    self = [super init];
+    if (self) {
+        _outcomes = [NSMutableArray new];
+    }
+    return self;
+}
+
+- (void) addOutcome:(BOOL)isFailure windowSize:(NSUInteger)windowSize
+{
+    if (self.outcomes.count < windowSize){
+        [self.outcomes addObject:@(isFailure)];
+        return;
+    }
+    // The window became smaller through the setter
+    while (self.outcomes.count > windowSize) [self.outcomes removeObjectAtIndex:0];
+
+    NSUInteger index = self.nextOutcomeIndex % windowSize;
+    self.outcomes[index]  = @(isFailure);
+    self.nextOutcomeIndex = (index + 1) % windowSize;
+}
+
+- (double) failureRate
+{
+    if (self.outcomes.count < 1) return 0;
+
+    NSUInteger failures = 0;
+    for (NSNumber* isFailure in self.outcomes){
+        if (isFailure.boolValue) failures += 1;
+    }
+    return (double)failures / self.outcomes.count;
+}
+
+- (void) open
+{
+    self.state       = APICircuitState_Open;
+    self.openedAt    = CFAbsoluteTimeGetCurrent();
+    self.probeSentAt = 0;
+}
+
+- (void) close
+{
+    self.state       = APICircuitState_Closed;
+    self.probeSentAt = 0;
+    self.nextOutcomeIndex = 0;
+    [self.outcomes removeAllObjects];
+}
+
+@end
+
+
+
+static double         _circuitFailureRateThreshold = 0.5;
+static NSUInteger     _circuitWindowSize           = 20;
+static NSUInteger     _circuitMinimumRequests      = 10;
+static NSTimeInterval _circuitOpenInterval         = 30;
+static NSMutableDictionary<NSString*,APICircuit*>* _circuits = nil;
+static NSCache<NSString*,id>* _responseCache = nil;
+
+
+
+@implementation APIManager (CircuitBreaker)
+
+#pragma mark - Admission
+
+/*--------------------------------------------------------------------------------------------------------------
+ Returns 'nil' if the request may be sent, otherwise the error which is returned to the user instead of the answer.
+ --------------------------------------------------------------------------------------------------------------*/
++ (nullable NSError*) admitRequest:(NSURLRequest*)request
+{
+    NSString* host = [APIManager circuitKeyForRequest:request];
+
+    @synchronized ([NSNotificationCenter defaultCenter])
+    {
+        APICircuit* circuit = [APIManager circuitForHost:host];
+        CFAbsoluteTime now  = CFAbsoluteTimeGetCurrent();
+
+        if ((circuit.state == APICircuitState_Open) && (now - circuit.openedAt >= _circuitOpenInterval)){
+            circuit.state = APICircuitState_HalfOpen;
+        }
+
+        switch (circuit.state) {
+            case APICircuitState_Closed:
+                return nil;
+
+            case APICircuitState_HalfOpen:
+                // The probe which has not returned within the open interval is considered lost
+                if ((circuit.probeSentAt > 0) && (now - circuit.probeSentAt < _circuitOpenInterval)) break;
+                circuit.probeSentAt = now;
+                APILog(@"The circuit of '%@' is half-open. The probe request is sent",host);
+                return nil;
+
+            case APICircuitState_Open:
+                break;
+        }
+    }
+    return [NSError initWithMsg:str(@"'%@' is temporarily unavailable",host) code:APICircuitOpenErrorCode];
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ Returns 'YES' if '+admitRequest:' would reject the request now. Unlike it, changes nothing.
+ --------------------------------------------------------------------------------------------------------------*/
++ (BOOL) isCircuitOpenForRequest:(NSURLRequest*)request
+{
+    NSString* host = [APIManager circuitKeyForRequest:request];
+
+    @synchronized ([NSNotificationCenter defaultCenter])
+    {
+        APICircuit* circuit = _circuits[host];
+        CFAbsoluteTime now  = CFAbsoluteTimeGetCurrent();
+
+        switch (circuit.state) {
+            case APICircuitState_Closed:
+                return NO;
+
+            // The open interval has passed: '+admitRequest:' will let the probe through
+            case APICircuitState_Open:
+                return (now - circuit.openedAt < _circuitOpenInterval);
+
+            // The probe is in flight
+            case APICircuitState_HalfOpen:
+                return ((circuit.probeSentAt > 0) && (now - circuit.probeSentAt < _circuitOpenInterval));
+        }
+    }
+    return NO;
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ Returns the request which the operation of the rejected request performs instead of it. 'NSURLSession' answers
+ the 'data:' URL itself without the network, so the operation starts and finishes as usual: '-syncStart' returns,
+ the queue releases the operation, the 'completion' is called.
+ --------------------------------------------------------------------------------------------------------------*/
++ (NSURLRequest*) requestInPlaceOfRejectedRequest:(NSURLRequest*)request
+{
+    NSMutableURLRequest* localRequest = [NSMutableURLRequest requestWithURL:[NSURL URLWithString:@"data:application/json,%7B%7D"]];
+    localRequest.HTTPMethod = request.HTTPMethod;
+    // The empty body: the upload operation sends it as the file
+    localRequest.HTTPBody   = [NSData data];
+    return localRequest;
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ Counts the outcome of the finished operation in the window of the host to which the request was sent.
+ --------------------------------------------------------------------------------------------------------------*/
++ (void) recordOutcomeOfOperation:(BO*)op forRequest:(NSURLRequest*)request
+{
+    NSString* host = [APIManager circuitKeyForRequest:request];
+    APICircuitOutcome outcome = [APIManager circuitOutcomeOfOperation:op];
+
+    @synchronized ([NSNotificationCenter defaultCenter])
+    {
+        APICircuit* circuit = [APIManager circuitForHost:host];
+        switch (circuit.state)
+        {
+            case APICircuitState_Closed:
+                if (outcome == APICircuitOutcome_Neutral) return;
+                [circuit addOutcome:(outcome == APICircuitOutcome_Failure) windowSize:_circuitWindowSize];
+
+                if ((circuit.outcomes.count >= _circuitMinimumRequests) &&
+                    ([circuit failureRate] >= _circuitFailureRateThreshold)){
+                    APILog(@"The circuit of '%@' is opened. Failure rate: %.2f",host,[circuit failureRate]);
+                    [circuit open];
+                }
+                break;
+
+            case APICircuitState_HalfOpen:
+                // The probe did not say anything about the server. The next request will be the probe
+                if (outcome == APICircuitOutcome_Neutral){
+                    circuit.probeSentAt = 0;
+                } else if (outcome == APICircuitOutcome_Success){
+                    APILog(@"The circuit of '%@' is closed",host);
+                    [circuit close];
+                } else {
+                    [circuit open];
+                }
+                break;
+
+            case APICircuitState_Open:
+                // Late answers to the requests sent before the circuit opened
+                break;
+        }
+    }
+}
+
++ (APICircuitState) circuitStateForHost:(NSString*)host
+{
+    @synchronized ([NSNotificationCenter defaultCenter]){
+        return _circuits[host].state;
+    }
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ The server answered - success, even if the answer contains an error of the request itself (For example 401).
+ --------------------------------------------------------------------------------------------------------------*/
++ (APICircuitOutcome) circuitOutcomeOfOperation:(BO*)op
+{
+    if (([op.json isKindOfClass:[NSDictionary class]]) && ([op.json[@"error"] isKindOfClass:[NSDictionary class]]))
+    {
+        NSInteger code = [op.json[@"error"][@"error_code"] integerValue];
+        BOOL isServerFailure = (code == unknownErrorCode) || (code == internalServerErrorCode);
+        return (isServerFailure) ? APICircuitOutcome_Failure : APICircuitOutcome_Success;
+    }
+    if (!op.error){
+        return (op.json) ? APICircuitOutcome_Success : APICircuitOutcome_Failure;
+    }
+
+    if (([op.error.domain isEqualToString:NSURLErrorDomain]) &&
+        ((op.error.code == NSURLErrorCancelled) || (op.error.code == NSURLErrorNotConnectedToInternet))){
+        return APICircuitOutcome_Neutral;
+    }
+    return APICircuitOutcome_Failure;
+}
+
+
+#pragma mark - Cache
+
+/*--------------------------------------------------------------------------------------------------------------
+ Saves the successful answer of the API method whose 'cacheTTL' is above zero. Other answers are ignored.
+ --------------------------------------------------------------------------------------------------------------*/
++ (void) cacheResponseOfOperation:(BO*)op forRequest:(NSURLRequest*)request APIMethod:(APIMethod)method
+{
+    if (APIMethodInfoFor(method)->cacheTTL <= 0) return;
+    if ((op.error) || (![op.json isKindOfClass:[NSDictionary class]]) || (!op.json[@"response"])) return;
+
+    @synchronized ([NSNotificationCenter defaultCenter])
+    {
+        if (!_responseCache){
+             _responseCache = [NSCache new];
+             _responseCache.countLimit = responseCacheCountLimit;
+        }
+    }
+    [_responseCache setObject:@[op.json, @(CFAbsoluteTimeGetCurrent())] forKey:[APIManager cacheKeyForRequest:request APIMethod:method]];
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ Returns the last successful answer to the same request if it is not older than 'cacheTTL', or 'nil'.
+ --------------------------------------------------------------------------------------------------------------*/
++ (nullable id) cachedResponseForRequest:(NSURLRequest*)request APIMethod:(APIMethod)method
+{
+    NSTimeInterval cacheTTL = APIMethodInfoFor(method)->cacheTTL;
+    if (cacheTTL <= 0) return nil;
+
+    NSCache* cache = nil;
+    @synchronized ([NSNotificationCenter defaultCenter]){
+        cache = _responseCache;
+    }
+    // [json, time of saving]
+    NSArray* entry = [cache objectForKey:[APIManager cacheKeyForRequest:request APIMethod:method]];
+    if ((!entry) || (CFAbsoluteTimeGetCurrent() - [entry.lastObject doubleValue] > cacheTTL)) return nil;
+    return entry.firstObject;
+}
+
+
+#pragma mark - Helpers
+
++ (NSString*) circuitKeyForRequest:(NSURLRequest*)request
+{
+    NSString* host = request.URL.host;
+    return (host) ? host.lowercaseString : @"";
+}
+
++ (NSString*) cacheKeyForRequest:(NSURLRequest*)request APIMethod:(APIMethod)method
+{
+    return str(@"%ld|%@",(long)method,[NRC canonicalKeyForRequest:request]);
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ [Internal method] Must be called inside '@synchronized ([NSNotificationCenter defaultCenter])'.
+ --------------------------------------------------------------------------------------------------------------*/
++ (APICircuit*) circuitForHost:(NSString*)host
+{
+    if (!_circuits){
+         _circuits = [NSMutableDictionary new];
+    }
+    APICircuit* circuit = _circuits[host];
+    if (!circuit){
+        circuit = [APICircuit new];
+        _circuits[host] = circuit;
+    }
+    return circuit;
+}
+
+
+#pragma mark - Setters & Getters
+
+/*--------------------------------------------------------------------------------------------------------------
+ @property (class, nonatomic, assign) double circuitFailureRateThreshold;
+ --------------------------------------------------------------------------------------------------------------*/
++ (void)setCircuitFailureRateThreshold:(double)circuitFailureRateThreshold
+{
+    @synchronized ([NSNotificationCenter defaultCenter]){
+        _circuitFailureRateThreshold = MIN(1, MAX(0, circuitFailureRateThreshold));
+    }
+}
+
++ (double)circuitFailureRateThreshold
+{
+    @synchronized ([NSNotificationCenter defaultCenter]){
+        return _circuitFailureRateThreshold;
+    }
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ @property (class, nonatomic, assign) NSUInteger circuitWindowSize;
+ --------------------------------------------------------------------------------------------------------------*/
++ (void)setCircuitWindowSize:(NSUInteger)circuitWindowSize
+{
+    @synchronized ([NSNotificationCenter defaultCenter]){
+        _circuitWindowSize = MAX(1, circuitWindowSize);
+    }
+}
+
++ (NSUInteger)circuitWindowSize
+{
+    @synchronized ([NSNotificationCenter defaultCenter]){
+        return _circuitWindowSize;
+    }
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ @property (class, nonatomic, assign) NSUInteger circuitMinimumRequests;
+ --------------------------------------------------------------------------------------------------------------*/
++ (void)setCircuitMinimumRequests:(NSUInteger)circuitMinimumRequests
+{
+    @synchronized ([NSNotificationCenter defaultCenter]){
+        _circuitMinimumRequests = MAX(1, circuitMinimumRequests);
+    }
+}
+
++ (NSUInteger)circuitMinimumRequests
+{
+    @synchronized ([NSNotificationCenter defaultCenter]){
+        return _circuitMinimumRequests;
+    }
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ @property (class, nonatomic, assign) NSTimeInterval circuitOpenInterval;
+ --------------------------------------------------------------------------------------------------------------*/
++ (void)setCircuitOpenInterval:(NSTimeInterval)circuitOpenInterval
+{
+    @synchronized ([NSNotificationCenter defaultCenter]){
+        _circuitOpenInterval = MAX(0, circuitOpenInterval);
+    }
+}
+
++ (NSTimeInterval)circuitOpenInterval
+{
+    @synchronized ([NSNotificationCenter defaultCenter]){
+        return _circuitOpenInterval;
+    }
+}
+
+@end
@@ -0,0 +1,54 @@
+#import "APIManager.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+/*--------------------------------------------------------------------------------------------------------------
+ Posted on the main thread when 'APIManager.isReachable' changes its value.
+ --------------------------------------------------------------------------------------------------------------*/
+extern NSNotificationName const APIReachabilityDidChangeNotification;
+
+
+/*--------------------------------------------------------------------------------------------------------------
+ 🌐📶 'APIManager(Connectivity)' - prepares connections in advance and tracks whether the network is available.
+ ---------------
+ The first request after the launch pays for DNS, TCP and TLS to 'api.vk.com' before it receives the first byte.
+ The category opens these connections in the background while the application is still starting, so the first
+ real request goes through an already established connection.
+ ---------------
+ [⚖️] Duties:
+ - Send lightweight 'HEAD' requests to the host of 'baseURL' and to the photo upload host through
+   'APIManager.defaultSession', so that the connections stay in its pool.
+ - Infer the availability of the network from the outcomes of real requests, without active pings.
+ ---------------
+ Additionally:
+ (⚠️) The connection is reused only by operations performed through 'APIManager.defaultSession'.
+ (⚠️) 'isReachable' is 'YES' until the first request says otherwise. The value is optimistic:
+      it changes only when a real request has finished.
+ --------------------------------------------------------------------------------------------------------------*/
+@interface APIManager (Connectivity)
+
+/*--------------------------------------------------------------------------------------------------------------
+ The host to which photos are uploaded. The concrete upload address is issued by 'photos.getWallUploadServer',
+ but it is always located on this host. Default 'https://pu.vk.com/'.
+ --------------------------------------------------------------------------------------------------------------*/
+@property (class, nonatomic, strong) NSString* uploadHostURL;
+
+@property (class, nonatomic, readonly, assign) BOOL isReachable;
+
+
+/*--------------------------------------------------------------------------------------------------------------
+ Opens connections to the host of 'baseURL' and to 'uploadHostURL' in the background.
+ Called from 'prepareAPIManagerBeforeUsing:'.
+ --------------------------------------------------------------------------------------------------------------*/
++ (void) prewarmConnections;
+
+/*--------------------------------------------------------------------------------------------------------------
+ Updates 'isReachable' according to the outcome of the finished operation.
+ Any answer of the server means that the network is available. Only errors which definitely mean the absence
+ of the network make it unavailable.
+ --------------------------------------------------------------------------------------------------------------*/
++ (void) updateReachabilityWithOperation:(BO*)op;
+
+@end
+
+NS_ASSUME_NONNULL_END
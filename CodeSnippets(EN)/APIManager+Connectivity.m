@@ -0,0 +1,126 @@
+#import "APIManager+Connectivity.h"
+#import "MultiThreads.h"
+#import <RXNetworkOperation/RXNetworkOperation.h>
+
+
+#define defaultUploadHostURL @"https://pu.vk.com/"
+// The prewarm is useless if it did not manage to finish before the first requests
+#define prewarmTimeout       10
+
+
+NSNotificationName const APIReachabilityDidChangeNotification = @"APIReachabilityDidChangeNotification";
+
+static NSString* _uploadHostURL = nil;
+static BOOL      _isReachable   = YES;
+
+
+
+@implementation APIManager (Connectivity)
+
+/*--------------------------------------------------------------------------------------------------------------
+ Opens connections to the host of 'baseURL' and to 'uploadHostURL' in the background.
+ --------------------------------------------------------------------------------------------------------------*/
++ (void) prewarmConnections
+{
+    NSMutableOrderedSet<NSURL*>* origins = [NSMutableOrderedSet new];
+    for (NSString* address in @[API.baseURL ?: @"", APIManager.uploadHostURL])
+    {
+        NSURLComponents* components = [NSURLComponents componentsWithString:address];
+        if (!components.host) continue;
+
+        // Only the origin matters, the connection is established to the host and not to the path
+        components.path  = @"/";
+        components.query = nil;
+        if (components.URL) [origins addObject:components.URL];
+    }
+
+    dispatch_async(dispatch_get_global_queue(QOS_CLASS_UTILITY, 0), ^{
+        for (NSURL* origin in origins)
+        {
+            NSMutableURLRequest* request = [NSMutableURLRequest requestWithURL:origin];
+            request.HTTPMethod      = @"HEAD";
+            request.timeoutInterval = prewarmTimeout;
+
+            DTO* netOp =
+            [DTO request:request uploadProgress:nil downloadProgress:nil completion:^(DTO * _Nonnull op, NSError * _Nullable error) {
+                // The answer itself does not matter. What matters is the connection that stays in the pool of the session
+                [APIManager updateReachabilityWithOperation:op];
+            }];
+            netOp.privateSession = APIManager.defaultSession;
+            [netOp start];
+        }
+    });
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ Updates 'isReachable' according to the outcome of the finished operation.
+ --------------------------------------------------------------------------------------------------------------*/
++ (void) updateReachabilityWithOperation:(BO*)op
+{
+    BOOL isReachable = YES;
+
+    if ((op.error) && (!op.json))
+    {
+        if (![op.error.domain isEqualToString:NSURLErrorDomain]) return;
+
+        switch (op.error.code) {
+            case NSURLErrorNotConnectedToInternet:
+            case NSURLErrorDataNotAllowed:
+            case NSURLErrorInternationalRoamingOff:
+            case NSURLErrorCallIsActive:
+                isReachable = NO;
+                break;
+
+            // Other errors (timeout, cancel, etc.) say nothing about the network of the device
+            default:
+                return;
+        }
+    }
+
+    @synchronized ([NSNotificationCenter defaultCenter])
+    {
+        if (_isReachable == isReachable) return;
+        _isReachable = isReachable;
+    }
+
+    APILog(@"Reachability changed: %@",(isReachable) ? @"reachable" : @"not reachable");
+    MainQueue(^{
+        [[NSNotificationCenter defaultCenter] postNotificationName:APIReachabilityDidChangeNotification object:nil];
+    });
+}
+
+
+#pragma mark - Setters & Getters
+
+/*--------------------------------------------------------------------------------------------------------------
+ @property (class, nonatomic, strong) NSString* uploadHostURL;
+ --------------------------------------------------------------------------------------------------------------*/
++ (void)setUploadHostURL:(NSString *)uploadHostURL
+{
+    @synchronized ([NSNotificationCenter defaultCenter]){
+        _uploadHostURL = uploadHostURL;
+    }
+}
+
++ (NSString *)uploadHostURL
+{
+    @synchronized ([NSNotificationCenter defaultCenter])
+    {
+        if (!_uploadHostURL){
+             _uploadHostURL = defaultUploadHostURL;
+        }
+        return _uploadHostURL;
+    }
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ @property (class, nonatomic, readonly, assign) BOOL isReachable;
+ --------------------------------------------------------------------------------------------------------------*/
++ (BOOL)isReachable
+{
+    @synchronized ([NSNotificationCenter defaultCenter]){
+        return _isReachable;
+    }
+}
+
+@end
@@ -0,0 +1,100 @@
+#import "APIManager.h"
+#import "APIMethods.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+/*--------------------------------------------------------------------------------------------------------------
+ 🏁 'APIHedgeRace' - a race between the original request and its duplicate ('hedge').
+ ---------------
+ The race observes the moment when the original operation starts. If the operation has not received an answer
+ within the adaptive threshold, the race sends the duplicate through 'APIManager.hedgeSession' (a separate pool of
+ connections). The first successful answer wins. The losing duplicate is cancelled. The losing original is not:
+ the user holds it, only its session task is cancelled.
+ --------------------------------------------------------------------------------------------------------------*/
+@interface APIHedgeRace : NSObject
+
+/*--------------------------------------------------------------------------------------------------------------
+ 'attemptCompletion' is called when the duplicate has finished.
+ (⚠️) Do not capture 'op' strongly inside the block, the race is stored until the end of the operation.
+ --------------------------------------------------------------------------------------------------------------*/
++ (instancetype) raceForOperation:(DTO*)op
+                        APIMethod:(APIMethod)method
+                          request:(NSURLRequest*)request
+                attemptCompletion:(void(^)(DTO* finishedOp))attemptCompletion;
+
+/*--------------------------------------------------------------------------------------------------------------
+ Called when the original operation or its duplicate has finished.
+ Returns 'YES' if the answer must be delivered to the user. Returns 'NO' for the loser and for the first failed
+ answer while the second request is still in flight.
+ --------------------------------------------------------------------------------------------------------------*/
+- (BOOL) shouldDeliverAttempt:(DTO*)attemptOp;
+
+@end
+
+
+
+/*--------------------------------------------------------------------------------------------------------------
+ 🌐🏁 'APIManager(Hedging)' - reduces the tail latency of idempotent reading requests.
+ ---------------
+ Most of the slow answers are caused not by the server, but by a "stuck" connection. Such a request waits for
+ the timeout, although the duplicate sent through another connection would have been answered in a normal time.
+ ---------------
+ [⚖️] Duties:
+ - Collect the latency of the last requests for each API method.
+ - Calculate the threshold (percentile 'hedgingPercentile' of the latency) after which the duplicate is sent.
+ - Limit the number of duplicates ('hedging budget'), so that they add no more than 'hedgingBudgetRatio' of the load.
+ ---------------
+ Additionally:
+ (⚠️) Hedging is disabled by default. Enable it with 'APIManager.isHedgingEnabled = YES'.
+ (⚠️) Only 'users.get', 'wall.get', 'friends.get' and 'photos.getAll' are hedged. Synchronous operations are never hedged.
+ --------------------------------------------------------------------------------------------------------------*/
+@interface APIManager (Hedging)
+
+@property (class, nonatomic, assign) BOOL   isHedgingEnabled;    // default 'NO'
+@property (class, nonatomic, assign) double hedgingPercentile;   // default 0.95
+@property (class, nonatomic, assign) double hedgingBudgetRatio;  // default 0.05 (no more than 5% of extra requests)
+
+/*--------------------------------------------------------------------------------------------------------------
+ The session through which duplicates are sent. It has the same configuration as 'APIManager.defaultSession',
+ but its own pool of connections, so the duplicate never waits for the "stuck" connection of the original.
+ --------------------------------------------------------------------------------------------------------------*/
+@property (class, nonatomic, readonly, strong) NSURLSession* hedgeSession;
+
+
+/*--------------------------------------------------------------------------------------------------------------
+ Returns 'YES' if the requests of the API method may be duplicated.
+ --------------------------------------------------------------------------------------------------------------*/
++ (BOOL) isHedgeableAPIMethod:(APIMethod)method;
+
+/*--------------------------------------------------------------------------------------------------------------
+ Returns the time after which the duplicate of the request is sent.
+ While fewer than 20 answers are collected, returns 1 second.
+ --------------------------------------------------------------------------------------------------------------*/
++ (NSTimeInterval) hedgeDelayForAPIMethod:(APIMethod)method;
+
+/*--------------------------------------------------------------------------------------------------------------
+ Saves the latency of the successful answer. The last 128 values are stored for each API method.
+ --------------------------------------------------------------------------------------------------------------*/
++ (void) recordLatency:(NSTimeInterval)latency forAPIMethod:(APIMethod)method;
+
+/*--------------------------------------------------------------------------------------------------------------
+ Called for every hedgeable request. Replenishes the hedging budget.
+ 'tryWithdrawHedgingBudget' returns 'NO' if the budget is exhausted.
+ --------------------------------------------------------------------------------------------------------------*/
++ (void) depositHedgingBudget;
++ (BOOL) tryWithdrawHedgingBudget;
+
+
+#pragma mark - Self-check
+
+#if DEBUG
+/*--------------------------------------------------------------------------------------------------------------
+ The duplicate wins the race: it is delivered, the original is not cancelled, and the late answer of the
+ original neither is delivered nor overwrites the delivered result. Returns 'YES' if the check has passed.
+ --------------------------------------------------------------------------------------------------------------*/
++ (BOOL) checkRaceWonByHedge;
+#endif
+
+@end
+
+NS_ASSUME_NONNULL_END
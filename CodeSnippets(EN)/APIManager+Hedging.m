@@ -0,0 +1,400 @@
+#import "APIManager+Hedging.h"
+#import "APIMethodRegistry.h"
+#import "APIManager+RateGovernor.h"
+#import <RXNetworkOperation/RXNetworkOperation.h>
+
+
+// How many last latencies are stored for each API method
+#define latencySamplesCapacity 128
+// Until so many answers are collected, the percentile is not trusted
+#define latencySamplesMinimum  20
+#define defaultHedgeDelay      1.0
+#define minimumHedgeDelay      0.05
+#define hedgingBudgetCapacity  5.0
+
+
+static BOOL          _isHedgingEnabled   = NO;
+static double        _hedgingPercentile  = 0.95;
+static double        _hedgingBudgetRatio = 0.05;
+static double        _hedgingBudget      = hedgingBudgetCapacity;
+static NSURLSession* _hedgeSession       = nil;
+static NSMutableDictionary<NSNumber*,NSMutableArray<NSNumber*>*>* _latencySamples = nil;
+static NSMutableDictionary<NSNumber*,NSNumber*>* _latencySampleIndexes = nil;
+
+
+
+@interface APIHedgeRace ()
+@property (nonatomic, weak)   DTO*           op;
+@property (nonatomic, assign) APIMethod      method;
+@property (nonatomic, strong) NSURLRequest*  request;
+@property (nonatomic, copy, nullable)   void(^attemptCompletion)(DTO* finishedOp);
+@property (nonatomic, strong, nullable) DTO* hedgeOp;
+@property (nonatomic, weak,   nullable) DTO* loser;
+// The answer of the duplicate, delivered in the original. Restored if the late answer of the original overwrites it
+@property (nonatomic, strong, nullable) id       winnerJSON;
+@property (nonatomic, strong, nullable) NSError* winnerError;
+@property (nonatomic, assign) CFAbsoluteTime startedAt;
+@property (nonatomic, assign) BOOL isResolved;
+@property (nonatomic, assign) BOOL isObserving;
+@property (nonatomic, assign) BOOL hasFailedContender;
+@end
+
+
+@implementation APIHedgeRace
+
++ (instancetype) raceForOperation:(DTO*)op
+                        APIMethod:(APIMethod)method
+                          request:(NSURLRequest*)request
+                attemptCompletion:(void(^)(DTO* finishedOp))attemptCompletion
+{
+    APIHedgeRace* race = [APIHedgeRace new];
+    race.op      = op;
+    race.method  = method;
+    race.request = request;
+    race.attemptCompletion = attemptCompletion;
+
+    // The timer starts when the operation really starts, and not when it was put in the queue
+    race.isObserving = YES;
+    [op addObserver:race forKeyPath:@"isExecuting" options:NSKeyValueObservingOptionNew context:nil];
+    return race;
+}
+
+- (void) observeValueForKeyPath:(NSString*)keyPath ofObject:(id)object change:(NSDictionary*)change context:(void*)context
+{
+    if (![change[NSKeyValueChangeNewKey] boolValue]) return;
+
+    @synchronized (self)
+    {
+        if ((self.startedAt > 0) || (self.isResolved)) return;
+        self.startedAt = CFAbsoluteTimeGetCurrent();
+    }
+
+    NSTimeInterval delay = [APIManager hedgeDelayForAPIMethod:self.method];
+    __weak APIHedgeRace* weakSelf = self;
+    dispatch_after(dispatch_time(DISPATCH_TIME_NOW, (int64_t)(delay * NSEC_PER_SEC)),
+                   dispatch_get_global_queue(QOS_CLASS_USER_INITIATED, 0), ^{
+        [weakSelf sendHedge];
+    });
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ The original has not answered within the threshold. We send the duplicate if the budget and the rate limit allow it.
+ --------------------------------------------------------------------------------------------------------------*/
+- (void) sendHedge
+{
+    DTO* op = self.op;
+    DTO* hedgeOp = nil;
+
+    @synchronized (self)
+    {
+        if ((!op) || (self.isResolved) || (op.isSync) || (op.isFinished) || (op.isCancelled)) return;
+
+        // The duplicate is a request too. It is better not to send it at all than to hold it in the queue
+        if (![APIManager tryReserveRequestSlotForAPIMethod:self.method]) return;
+        if (![APIManager tryWithdrawHedgingBudget]) return;
+
+        __weak APIHedgeRace* weakSelf = self;
+        hedgeOp =
+        [DTO request:self.request uploadProgress:nil downloadProgress:nil completion:^(DTO * _Nonnull finishedOp, NSError * _Nullable error) {
+            void(^attemptCompletion)(DTO* finishedOp) = weakSelf.attemptCompletion;
+            if (attemptCompletion) attemptCompletion(finishedOp);
+        }];
+        hedgeOp.privateSession = APIManager.hedgeSession;
+        self.hedgeOp = hedgeOp;
+    }
+    [hedgeOp start];
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ Returns 'YES' if the answer must be delivered to the user.
+ --------------------------------------------------------------------------------------------------------------*/
+- (BOOL) shouldDeliverAttempt:(DTO*)attemptOp
+{
+    DTO* loser = nil;
+
+    @synchronized (self)
+    {
+        // Repeats made after the race has finished are not related to it
+        if ((attemptOp != self.op) && (attemptOp != self.hedgeOp)){
+            return YES;
+        }
+        if (self.isResolved){
+            // The late answer of the original which lost. RX has already written it into the operation that the user holds
+            if ((attemptOp == self.loser) && (attemptOp == self.op)){
+                attemptOp.json  = self.winnerJSON;
+                attemptOp.error = self.winnerError;
+            }
+            return (attemptOp != self.loser);
+        }
+
+        // While the rival is in flight, the failed answer is not delivered. Perhaps the rival will be luckier.
+        BOOL isSucceeded     = [APIHedgeRace isSucceededOperation:attemptOp];
+        BOOL isRivalInFlight = (self.hedgeOp) && (!self.hasFailedContender);
+        if ((!isSucceeded) && (isRivalInFlight)){
+            self.hasFailedContender = YES;
+            return NO;
+        }
+
+        self.isResolved = YES;
+        self.attemptCompletion = nil;
+        if ((self.hedgeOp) && (!self.hasFailedContender)){
+            loser = (attemptOp == self.op) ? self.hedgeOp : self.op;
+            self.loser = loser;
+        }
+        if ((loser) && (loser == self.op)){
+            self.winnerJSON  = attemptOp.json;
+            self.winnerError = attemptOp.error;
+        }
+        if ((isSucceeded) && (self.startedAt > 0)){
+            [APIManager recordLatency:CFAbsoluteTimeGetCurrent() - self.startedAt forAPIMethod:self.method];
+        }
+    }
+
+    [self stopObserving];
+
+    // The original is the operation of the user, it is never cancelled. Only its session task is cancelled
+    if ((loser) && (loser == self.op)){
+        [self cancelTaskOfOperation:loser];
+    } else {
+        [loser cancel];
+    }
+    return YES;
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ The original has lost the race. The user holds the original and has already received the answer of the duplicate
+ in it, so the operation itself is not cancelled (otherwise 'isCancelled' is 'YES' on the successful result).
+ Only its 'NSURLSessionTask' is cancelled, so that the connection is released.
+ --------------------------------------------------------------------------------------------------------------*/
+- (void) cancelTaskOfOperation:(DTO*)op
+{
+    NSURLRequest* request = self.request;
+    NSURLSession* session = (op.privateSession) ? op.privateSession : APIManager.defaultSession;
+
+    [session getAllTasksWithCompletionHandler:^(NSArray<__kindof NSURLSessionTask*>* tasks) {
+        NSURLSessionTask* originalTask = nil;
+        for (NSURLSessionTask* task in tasks)
+        {
+            if ((task.state != NSURLSessionTaskStateRunning) || (![task.originalRequest isEqual:request])) continue;
+
+            // An identical request of another operation may be in flight. Then nothing is cancelled
+            if (originalTask) return;
+            originalTask = task;
+        }
+        [originalTask cancel];
+    }];
+}
+
+- (void) stopObserving
+{
+    DTO* op = self.op;
+    @synchronized (self)
+    {
+        if (!self.isObserving) return;
+        self.isObserving = NO;
+    }
+    [op removeObserver:self forKeyPath:@"isExecuting"];
+}
+
++ (BOOL) isSucceededOperation:(DTO*)op
+{
+    if ((op.error) || (!op.json)) return NO;
+    if (([op.json isKindOfClass:[NSDictionary class]]) && (op.json[@"error"])) return NO;
+    return YES;
+}
+
+@end
+
+
+
+@implementation APIManager (Hedging)
+
+/*--------------------------------------------------------------------------------------------------------------
+ Returns 'YES' if the requests of the API method may be duplicated.
+ --------------------------------------------------------------------------------------------------------------*/
++ (BOOL) isHedgeableAPIMethod:(APIMethod)method
+{
+    return APIMethodInfoFor(method)->isHedgeable;
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ Returns the time after which the duplicate of the request is sent.
+ --------------------------------------------------------------------------------------------------------------*/
++ (NSTimeInterval) hedgeDelayForAPIMethod:(APIMethod)method
+{
+    NSArray<NSNumber*>* samples = nil;
+    double percentile = 0;
+
+    @synchronized ([NSNotificationCenter defaultCenter])
+    {
+        samples    = [_latencySamples[@(method)] copy];
+        percentile = _hedgingPercentile;
+    }
+    if (samples.count < latencySamplesMinimum){
+        return defaultHedgeDelay;
+    }
+
+    NSArray<NSNumber*>* sorted = [samples sortedArrayUsingSelector:@selector(compare:)];
+    NSUInteger index = MIN(sorted.count - 1, (NSUInteger)(percentile * sorted.count));
+    return MAX(minimumHedgeDelay, [sorted[index] doubleValue]);
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ Saves the latency of the successful answer into the ring buffer of the API method.
+ --------------------------------------------------------------------------------------------------------------*/
++ (void) recordLatency:(NSTimeInterval)latency forAPIMethod:(APIMethod)method
+{
+    @synchronized ([NSNotificationCenter defaultCenter])
+    {
+        if (!_latencySamples){
+             _latencySamples       = [NSMutableDictionary new];
+             _latencySampleIndexes = [NSMutableDictionary new];
+        }
+        NSMutableArray<NSNumber*>* samples = _latencySamples[@(method)];
+        if (!samples){
+            samples = [NSMutableArray arrayWithCapacity:latencySamplesCapacity];
+            _latencySamples[@(method)] = samples;
+        }
+
+        if (samples.count < latencySamplesCapacity){
+            [samples addObject:@(latency)];
+        } else {
+            NSUInteger index = [_latencySampleIndexes[@(method)] unsignedIntegerValue];
+            samples[index] = @(latency);
+            _latencySampleIndexes[@(method)] = @((index + 1) % latencySamplesCapacity);
+        }
+    }
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ Called for every hedgeable request. Replenishes the hedging budget.
+ --------------------------------------------------------------------------------------------------------------*/
++ (void) depositHedgingBudget
+{
+    @synchronized ([NSNotificationCenter defaultCenter]){
+        _hedgingBudget = MIN(hedgingBudgetCapacity, _hedgingBudget + _hedgingBudgetRatio);
+    }
+}
+
++ (BOOL) tryWithdrawHedgingBudget
+{
+    @synchronized ([NSNotificationCenter defaultCenter])
+    {
+        if (_hedgingBudget < 1) return NO;
+        _hedgingBudget -= 1;
+        return YES;
+    }
+}
+
+
+#pragma mark - Setters & Getters
+
+/*--------------------------------------------------------------------------------------------------------------
+ @property (class, nonatomic, assign) BOOL isHedgingEnabled;
+ --------------------------------------------------------------------------------------------------------------*/
++ (void)setIsHedgingEnabled:(BOOL)isHedgingEnabled
+{
+    @synchronized ([NSNotificationCenter defaultCenter]){
+        _isHedgingEnabled = isHedgingEnabled;
+    }
+}
+
++ (BOOL)isHedgingEnabled
+{
+    @synchronized ([NSNotificationCenter defaultCenter]){
+        return _isHedgingEnabled;
+    }
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ @property (class, nonatomic, assign) double hedgingPercentile;
+ --------------------------------------------------------------------------------------------------------------*/
++ (void)setHedgingPercentile:(double)hedgingPercentile
+{
+    @synchronized ([NSNotificationCenter defaultCenter]){
+        _hedgingPercentile = MIN(1, MAX(0, hedgingPercentile));
+    }
+}
+
++ (double)hedgingPercentile
+{
+    @synchronized ([NSNotificationCenter defaultCenter]){
+        return _hedgingPercentile;
+    }
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ @property (class, nonatomic, assign) double hedgingBudgetRatio;
+ --------------------------------------------------------------------------------------------------------------*/
++ (void)setHedgingBudgetRatio:(double)hedgingBudgetRatio
+{
+    @synchronized ([NSNotificationCenter defaultCenter]){
+        _hedgingBudgetRatio = MAX(0, hedgingBudgetRatio);
+    }
+}
+
++ (double)hedgingBudgetRatio
+{
+    @synchronized ([NSNotificationCenter defaultCenter]){
+        return _hedgingBudgetRatio;
+    }
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ @property (class, nonatomic, readonly, strong) NSURLSession* hedgeSession;
+ --------------------------------------------------------------------------------------------------------------*/
++ (NSURLSession*) hedgeSession
+{
+    @synchronized ([NSNotificationCenter defaultCenter])
+    {
+        if (!_hedgeSession){
+             // Same configuration, but a separate pool of connections
+             NSURLSessionConfiguration* configuration = APIManager.defaultSession.configuration;
+             _hedgeSession = [NSURLSession sessionWithConfiguration:configuration
+                                                           delegate:RXNO_BaseOperation.internal_delegate
+                                                      delegateQueue:nil];
+             _hedgeSession.sessionDescription = @"APIManager.hedgeSession";
+        }
+        return _hedgeSession;
+    }
+}
+
+
+#pragma mark - Self-check
+
+#if DEBUG
+/*--------------------------------------------------------------------------------------------------------------
+ The duplicate wins the race: it is delivered, the original is not cancelled, and the late answer of the
+ original neither is delivered nor overwrites the delivered result. Returns 'YES' if the check has passed.
+ --------------------------------------------------------------------------------------------------------------*/
++ (BOOL) checkRaceWonByHedge
+{
+    NSURLRequest* request = [NSURLRequest requestWithURL:[NSURL URLWithString:@"https://api.vk.com/method/users.get"]];
+    DTO* op      = [DTO new];
+    DTO* hedgeOp = [DTO new];
+
+    APIHedgeRace* race =
+    [APIHedgeRace raceForOperation:op APIMethod:APIMethod_UserGet request:request attemptCompletion:^(DTO * _Nonnull finishedOp) {}];
+    race.hedgeOp = hedgeOp;
+
+    // The duplicate answers first
+    hedgeOp.json = @{ @"response" : @[ @{ @"id" : @(1) } ] };
+    BOOL isHedgeDelivered = [race shouldDeliverAttempt:hedgeOp];
+
+    // 'finishAttempt' copies the answer of the winner into the operation of the user
+    op.json  = hedgeOp.json;
+    op.error = hedgeOp.error;
+
+    // The cancelled task of the original: RX writes the cancellation error into the operation
+    op.json  = nil;
+    op.error = [NSError errorWithDomain:NSURLErrorDomain code:NSURLErrorCancelled userInfo:nil];
+    BOOL isOriginalDelivered = [race shouldDeliverAttempt:op];
+
+    BOOL isPassed = (isHedgeDelivered) && (!isOriginalDelivered) && (!op.isCancelled) &&
+                    (!op.error) && ([op.json isEqual:hedgeOp.json]);
+    if (!isPassed) APILog(@"+[checkRaceWonByHedge] failed");
+    return isPassed;
+}
+#endif
+
+@end
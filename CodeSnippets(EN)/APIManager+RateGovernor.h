@@ -0,0 +1,106 @@
+#import "APIManager.h"
+#import "APIMethods.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+/*--------------------------------------------------------------------------------------------------------------
+ 🌐🚥 'APIManager(RateGovernor)' - keeps the rate of outgoing requests within the limits of the VK API.
+ ---------------
+ VK allows a user token to perform about 3 requests per second. Everything above that is rejected with
+ error 6 "Too many requests per second". Instead of sending such requests and receiving an error,
+ the category holds excess operations in the queue until the 'token bucket' has a free slot.
+ ---------------
+ [⚖️] Duties:
+ - Keep one token bucket per access token and one bucket per method group.
+ - Calculate how long an operation must wait before it can be sent.
+ - Hold the operation, when it is started, until that moment comes.
+ - Recognize the throttling error and calculate the delay before the request is sent again.
+ ---------------
+ Additionally:
+ (⚠️) The slot is reserved when the operation is started, not when it is created: by an 'NSOperationQueue',
+      by '-start' or by '-syncStart'. If the slot is not free yet, '-start' sends the request when it is,
+      and '-syncStart' blocks the thread until then.
+ (⚠️) Repeats of a request are held in 'APIManager.aSyncQueue' through a dependency on a 'permit' operation.
+ --------------------------------------------------------------------------------------------------------------*/
+@interface APIManager (RateGovernor)
+
+/*--------------------------------------------------------------------------------------------------------------
+ How many times the request is sent again after the server answered with error 6 "Too many requests per second".
+ The default is 3. Each repeat is sent only when the bucket has a free slot, so it does not waste a round trip.
+ --------------------------------------------------------------------------------------------------------------*/
+@property (class, nonatomic, assign) NSUInteger maxRateLimitRetries;
+
+
+#pragma mark - Configuration
+
+/*--------------------------------------------------------------------------------------------------------------
+ Sets the limit for all requests performed with the given access token.
+ If you pass 'nil' to 'accessToken', the limit becomes the default one for all tokens (3 requests per second).
+ Pass '0' to 'requestsPerSecond' to disable the limit.
+ --------------------------------------------------------------------------------------------------------------*/
++ (void) setRequestsPerSecond:(double)requestsPerSecond
+                        burst:(NSUInteger)burst
+               forAccessToken:(nullable NSString*)accessToken;
+
+/*--------------------------------------------------------------------------------------------------------------
+ Sets an additional limit for the group of methods (For example, 1 'wall.post' per second).
+ By default the groups have no limit of their own. Pass '0' to 'requestsPerSecond' to disable the limit.
+ --------------------------------------------------------------------------------------------------------------*/
++ (void) setRequestsPerSecond:(double)requestsPerSecond
+                        burst:(NSUInteger)burst
+               forMethodGroup:(APIMethodGroup)group;
+
+/*--------------------------------------------------------------------------------------------------------------
+ Returns the group to which the API method belongs.
+ --------------------------------------------------------------------------------------------------------------*/
++ (APIMethodGroup) methodGroupForAPIMethod:(APIMethod)method;
+
+
+#pragma mark - Dispatch
+
+/*--------------------------------------------------------------------------------------------------------------
+ Takes a slot for the request from the buckets of the current token and of the method group.
+ Returns the number of seconds the request must wait before it is sent ('0' - can be sent right now).
+ --------------------------------------------------------------------------------------------------------------*/
++ (NSTimeInterval) reserveRequestSlotForAPIMethod:(APIMethod)method;
+
+/*--------------------------------------------------------------------------------------------------------------
+ Takes a slot only if it is free right now in both buckets. Returns 'NO' and takes nothing otherwise.
+ Used for optional requests (For example duplicates of hedged requests), which are better not sent at all than held.
+ --------------------------------------------------------------------------------------------------------------*/
++ (BOOL) tryReserveRequestSlotForAPIMethod:(APIMethod)method;
+
+/*--------------------------------------------------------------------------------------------------------------
+ Marks the operation as governed. When it is started (by a queue, '-start' or '-syncStart'), it reserves a slot
+ and is sent only when the slot is free. Called by 'APIManager' for every data task operation it creates.
+ --------------------------------------------------------------------------------------------------------------*/
++ (void) governOperation:(NSOperation*)op forAPIMethod:(APIMethod)method;
+
+/*--------------------------------------------------------------------------------------------------------------
+ Returns the time at which the governed operation was sent after its slot, or '0' if it was not started.
+ The time spent waiting for the slot is not included.
+ --------------------------------------------------------------------------------------------------------------*/
++ (CFAbsoluteTime) sendTimeOfOperation:(NSOperation*)op;
+
+/*--------------------------------------------------------------------------------------------------------------
+ Does not allow the queue to start the operation earlier than 'delay' seconds later.
+ --------------------------------------------------------------------------------------------------------------*/
++ (void) holdOperation:(NSOperation*)op forTimeInterval:(NSTimeInterval)delay;
+
+
+#pragma mark - Throttling errors
+
+/*--------------------------------------------------------------------------------------------------------------
+ Returns 'YES' if the server rejected the request with error 6 "Too many requests per second".
+ --------------------------------------------------------------------------------------------------------------*/
++ (BOOL) isRateLimitErrorInOperation:(BO*)op;
+
+/*--------------------------------------------------------------------------------------------------------------
+ The server has counted more requests than the bucket did (For example, the same token is used on another device).
+ The method empties the bucket of the token and returns the delay after which the request can be sent again.
+ --------------------------------------------------------------------------------------------------------------*/
++ (NSTimeInterval) delayAfterRateLimitErrorForAPIMethod:(APIMethod)method;
+
+@end
+
+NS_ASSUME_NONNULL_END
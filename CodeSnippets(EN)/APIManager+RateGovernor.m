@@ -0,0 +1,421 @@
+#import "APIManager+RateGovernor.h"
+#import "APIMethodRegistry.h"
+#import "Token.h"
+#import <RXNetworkOperation/RXNetworkOperation.h>
+#import <objc/runtime.h>
+
+
+// The limit of the VK API for a user token
+#define defaultRequestsPerSecond 3.0
+#define defaultBurst             3
+// Error "Too many requests per second"
+#define rateLimitErrorCode       6
+// The key under which the default limit for all tokens is stored
+#define anyAccessTokenKey        @"*"
+
+
+/*--------------------------------------------------------------------------------------------------------------
+ 'APIRateBucket' - classic 'token bucket'.
+ Every request takes one token. Tokens are restored at the 'rate' speed, but no more than 'capacity'.
+ The number of tokens may become negative, this is how the bucket keeps the queue of already reserved slots.
+ --------------------------------------------------------------------------------------------------------------*/
+@interface APIRateBucket : NSObject
+@property (nonatomic, assign) double rate;
+@property (nonatomic, assign) double capacity;
+@property (nonatomic, assign) double tokens;
+@property (nonatomic, assign) CFAbsoluteTime timestamp;
+
++ (instancetype) bucketWithRate:(double)rate capacity:(double)capacity;
+- (NSTimeInterval) reserve;
+- (BOOL) hasFreeToken;
+- (void) drain;
+@end
+
+
+@implementation APIRateBucket
+
++ (instancetype) bucketWithRate:(double)rate capacity:(double)capacity
+{
+    APIRateBucket* bucket = [APIRateBucket new];
+    bucket.rate      = rate;
+    bucket.capacity  = MAX(1, capacity);
+    bucket.tokens    = bucket.capacity;
+    bucket.timestamp = CFAbsoluteTimeGetCurrent();
+    return bucket;
+}
+
+- (void) refill
+{
+    CFAbsoluteTime now = CFAbsoluteTimeGetCurrent();
+    self.tokens    = MIN(self.capacity, self.tokens + (now - self.timestamp) * self.rate);
+    self.timestamp = now;
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ Takes one token and returns the number of seconds until this token is actually available.
+ --------------------------------------------------------------------------------------------------------------*/
+- (NSTimeInterval) reserve
+{
+    if (self.rate <= 0) return 0;
+
+    [self refill];
+    NSTimeInterval wait = (self.tokens >= 1) ? 0 : (1 - self.tokens) / self.rate;
+    self.tokens -= 1;
+    return wait;
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ Takes away all free tokens. Slots which were reserved earlier stay in the queue.
+ --------------------------------------------------------------------------------------------------------------*/
+- (void) drain
+{
+    [self refill];
+    if (self.tokens > 0) self.tokens = 0;
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ Returns 'YES' if one token is available right now.
+ --------------------------------------------------------------------------------------------------------------*/
+- (BOOL) hasFreeToken
+{
+    if (self.rate <= 0) return YES;
+
+    [self refill];
+    return (self.tokens >= 1);
+}
+
+@end
+
+
+
+static NSUInteger           _maxRateLimitRetries = 3;
+static NSMutableDictionary<NSString*,APIRateBucket*>* _rateBuckets = nil;
+static NSMutableDictionary<NSString*,NSArray<NSNumber*>*>* _tokenLimits = nil;
+static NSMutableDictionary<NSNumber*,NSArray<NSNumber*>*>* _groupLimits = nil;
+// API method of a governed operation whose slot is not reserved yet
+static char governedAPIMethodKey;
+// Time at which the slot of a governed operation lets its request be sent
+static char sendTimeKey;
+
+
+
+@implementation APIManager (RateGovernor)
+
+#pragma mark - Configuration
+
+/*--------------------------------------------------------------------------------------------------------------
+ Sets the limit for all requests performed with the given access token.
+ --------------------------------------------------------------------------------------------------------------*/
++ (void) setRequestsPerSecond:(double)requestsPerSecond
+                        burst:(NSUInteger)burst
+               forAccessToken:(nullable NSString*)accessToken
+{
+    NSString* key = (accessToken) ? [APIManager keyForAccessToken:accessToken] : anyAccessTokenKey;
+
+    @synchronized ([APIManager rateBuckets]) {
+        [APIManager tokenLimits][key] = @[@(MAX(0, requestsPerSecond)), @(burst)];
+        // Buckets will be recreated with new values on the next request
+        [[APIManager rateBuckets] removeAllObjects];
+    }
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ Sets an additional limit for the group of methods.
+ --------------------------------------------------------------------------------------------------------------*/
++ (void) setRequestsPerSecond:(double)requestsPerSecond
+                        burst:(NSUInteger)burst
+               forMethodGroup:(APIMethodGroup)group
+{
+    @synchronized ([APIManager rateBuckets]) {
+        [APIManager groupLimits][@(group)] = @[@(MAX(0, requestsPerSecond)), @(burst)];
+        [[APIManager rateBuckets] removeAllObjects];
+    }
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ Returns the group to which the API method belongs.
+ --------------------------------------------------------------------------------------------------------------*/
++ (APIMethodGroup) methodGroupForAPIMethod:(APIMethod)method
+{
+    return APIMethodInfoFor(method)->group;
+}
+
+
+#pragma mark - Dispatch
+
+/*--------------------------------------------------------------------------------------------------------------
+ Takes a slot for the request from the buckets of the current token and of the method group.
+ --------------------------------------------------------------------------------------------------------------*/
++ (NSTimeInterval) reserveRequestSlotForAPIMethod:(APIMethod)method
+{
+    APIMethodGroup group = [APIManager methodGroupForAPIMethod:method];
+    NSString* tokenKey   = [APIManager keyForAccessToken:APIManager.token.access_token];
+
+    @synchronized ([APIManager rateBuckets])
+    {
+        NSTimeInterval delay = 0;
+        if (group != APIMethodGroup_Service){
+            delay = [[APIManager bucketForAccessTokenKey:tokenKey] reserve];
+        }
+        APIRateBucket* groupBucket = [APIManager bucketForMethodGroup:group accessTokenKey:tokenKey];
+        if (groupBucket){
+            delay = MAX(delay, [groupBucket reserve]);
+        }
+        return delay;
+    }
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ Takes a slot only if it is free right now in both buckets. Returns 'NO' and takes nothing otherwise.
+ --------------------------------------------------------------------------------------------------------------*/
++ (BOOL) tryReserveRequestSlotForAPIMethod:(APIMethod)method
+{
+    APIMethodGroup group = [APIManager methodGroupForAPIMethod:method];
+    NSString* tokenKey   = [APIManager keyForAccessToken:APIManager.token.access_token];
+
+    @synchronized ([APIManager rateBuckets])
+    {
+        APIRateBucket* tokenBucket = (group != APIMethodGroup_Service) ? [APIManager bucketForAccessTokenKey:tokenKey] : nil;
+        APIRateBucket* groupBucket = [APIManager bucketForMethodGroup:group accessTokenKey:tokenKey];
+
+        if (((tokenBucket) && (![tokenBucket hasFreeToken])) || ((groupBucket) && (![groupBucket hasFreeToken]))){
+            return NO;
+        }
+        [tokenBucket reserve];
+        [groupBucket reserve];
+        return YES;
+    }
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ Marks the operation as governed. The slot is reserved by the hooks of '-start' and '-syncStart'.
+ --------------------------------------------------------------------------------------------------------------*/
++ (void) governOperation:(NSOperation*)op forAPIMethod:(APIMethod)method
+{
+    [APIManager installStartHooks];
+    objc_setAssociatedObject(op, &governedAPIMethodKey, @(method), OBJC_ASSOCIATION_RETAIN_NONATOMIC);
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ Takes the API method of a governed operation, so the slot is reserved only once,
+ even if '-syncStart' calls '-start' inside. Returns the delay before the request may be sent.
+ The moment of sending is remembered for '+sendTimeOfOperation:'.
+ --------------------------------------------------------------------------------------------------------------*/
++ (NSTimeInterval) reserveSlotOfGovernedOperation:(NSOperation*)op
+{
+    NSNumber* method = nil;
+    @synchronized (op) {
+        method = objc_getAssociatedObject(op, &governedAPIMethodKey);
+        objc_setAssociatedObject(op, &governedAPIMethodKey, nil, OBJC_ASSOCIATION_RETAIN_NONATOMIC);
+    }
+    if ((!method) || (op.isCancelled)) return 0;
+
+    NSTimeInterval delay = [APIManager reserveRequestSlotForAPIMethod:(APIMethod)method.integerValue];
+    objc_setAssociatedObject(op, &sendTimeKey, @(CFAbsoluteTimeGetCurrent() + MAX(0, delay)), OBJC_ASSOCIATION_RETAIN_NONATOMIC);
+    return delay;
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ Returns the time at which the governed operation was sent after its slot, or '0' if it was not started.
+ --------------------------------------------------------------------------------------------------------------*/
++ (CFAbsoluteTime) sendTimeOfOperation:(NSOperation*)op
+{
+    return [objc_getAssociatedObject(op, &sendTimeKey) doubleValue];
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ 'start' and 'syncStart' of 'DTO' are replaced once by implementations which reserve the slot of a governed
+ operation first. The framework is closed, so the hooks call the original implementations instead of
+ overriding them in a subclass. Operations that are not governed are started as before.
+ --------------------------------------------------------------------------------------------------------------*/
++ (void) installStartHooks
+{
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        Class operationClass = [DTO class];
+
+        SEL    startSelector = @selector(start);
+        Method startMethod   = class_getInstanceMethod(operationClass, startSelector);
+        void (*originalStart)(id, SEL) = (void (*)(id, SEL))method_getImplementation(startMethod);
+
+        IMP governedStart = imp_implementationWithBlock(^(NSOperation* op){
+            NSTimeInterval delay = [APIManager reserveSlotOfGovernedOperation:op];
+            if (delay <= 0){
+                originalStart(op, startSelector);
+                return;
+            }
+            // A queue or '-start': the thread is not blocked, the request is sent when the slot is free
+            dispatch_after(dispatch_time(DISPATCH_TIME_NOW, (int64_t)(delay * NSEC_PER_SEC)),
+                           dispatch_get_global_queue(QOS_CLASS_UTILITY, 0), ^{
+                originalStart(op, startSelector);
+            });
+        });
+        // 'class_replaceMethod' adds the method to 'DTO' itself if it is inherited, the superclass is not changed
+        class_replaceMethod(operationClass, startSelector, governedStart, method_getTypeEncoding(startMethod));
+
+        SEL    syncStartSelector = @selector(syncStart);
+        Method syncStartMethod   = class_getInstanceMethod(operationClass, syncStartSelector);
+        id (*originalSyncStart)(id, SEL) = (id (*)(id, SEL))method_getImplementation(syncStartMethod);
+
+        IMP governedSyncStart = imp_implementationWithBlock(^id(NSOperation* op){
+            // '-syncStart' blocks the thread anyway, so it waits for the slot here
+            NSTimeInterval delay = [APIManager reserveSlotOfGovernedOperation:op];
+            if (delay > 0) [NSThread sleepForTimeInterval:delay];
+
+            return originalSyncStart(op, syncStartSelector);
+        });
+        class_replaceMethod(operationClass, syncStartSelector, governedSyncStart, method_getTypeEncoding(syncStartMethod));
+    });
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ The operation gets a dependency on an empty 'permit' operation, which is completed after 'delay' seconds.
+ Until then the queue considers the operation not ready and starts the other ones.
+ --------------------------------------------------------------------------------------------------------------*/
++ (void) holdOperation:(NSOperation*)op forTimeInterval:(NSTimeInterval)delay
+{
+    if (delay <= 0) return;
+
+    NSBlockOperation* permit = [NSBlockOperation blockOperationWithBlock:^{}];
+    permit.name = @"APIManager.RateGovernor.permit";
+    [op addDependency:permit];
+
+    dispatch_after(dispatch_time(DISPATCH_TIME_NOW, (int64_t)(delay * NSEC_PER_SEC)),
+                   dispatch_get_global_queue(QOS_CLASS_UTILITY, 0), ^{
+        [permit start];
+    });
+}
+
+
+#pragma mark - Throttling errors
+
+/*--------------------------------------------------------------------------------------------------------------
+ Returns 'YES' if the server rejected the request with error 6 "Too many requests per second".
+ --------------------------------------------------------------------------------------------------------------*/
++ (BOOL) isRateLimitErrorInOperation:(BO*)op
+{
+    if (![op.json isKindOfClass:[NSDictionary class]]) return NO;
+
+    id error = op.json[@"error"];
+    if (![error isKindOfClass:[NSDictionary class]]) return NO;
+
+    return ([error[@"error_code"] integerValue] == rateLimitErrorCode);
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ Empties the bucket of the current token and returns the delay after which the request can be sent again.
+ --------------------------------------------------------------------------------------------------------------*/
++ (NSTimeInterval) delayAfterRateLimitErrorForAPIMethod:(APIMethod)method
+{
+    NSString* tokenKey = [APIManager keyForAccessToken:APIManager.token.access_token];
+
+    @synchronized ([APIManager rateBuckets]) {
+        [[APIManager bucketForAccessTokenKey:tokenKey] drain];
+    }
+    // Requests which are already waiting in the queue keep their slots, the repeat gets the next free one.
+    return [APIManager reserveRequestSlotForAPIMethod:method];
+}
+
+
+#pragma mark - Helpers
+
+/*--------------------------------------------------------------------------------------------------------------
+ The token itself is not stored in memory as a key, only its hash.
+ --------------------------------------------------------------------------------------------------------------*/
++ (NSString*) keyForAccessToken:(nullable NSString*)accessToken
+{
+    return str(@"%lu",(unsigned long)accessToken.hash);
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ (!) Must be called inside '@synchronized ([APIManager rateBuckets])'
+ --------------------------------------------------------------------------------------------------------------*/
++ (APIRateBucket*) bucketForAccessTokenKey:(NSString*)tokenKey
+{
+    APIRateBucket* bucket = [APIManager rateBuckets][tokenKey];
+    if (!bucket){
+        NSArray<NSNumber*>* limit = [APIManager tokenLimits][tokenKey];
+        if (!limit) limit = [APIManager tokenLimits][anyAccessTokenKey];
+
+        bucket = [APIRateBucket bucketWithRate:[limit[0] doubleValue] capacity:[limit[1] doubleValue]];
+        [APIManager rateBuckets][tokenKey] = bucket;
+    }
+    return bucket;
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ Returns 'nil' if the group has no limit of its own.
+ (!) Must be called inside '@synchronized ([APIManager rateBuckets])'
+ --------------------------------------------------------------------------------------------------------------*/
++ (nullable APIRateBucket*) bucketForMethodGroup:(APIMethodGroup)group accessTokenKey:(NSString*)tokenKey
+{
+    NSArray<NSNumber*>* limit = [APIManager groupLimits][@(group)];
+    if ([limit[0] doubleValue] <= 0) return nil;
+
+    NSString* key = str(@"%@|%ld",tokenKey,(long)group);
+    APIRateBucket* bucket = [APIManager rateBuckets][key];
+    if (!bucket){
+        bucket = [APIRateBucket bucketWithRate:[limit[0] doubleValue] capacity:[limit[1] doubleValue]];
+        [APIManager rateBuckets][key] = bucket;
+    }
+    return bucket;
+}
+
+
+#pragma mark - Setters & Getters
+
+/*--------------------------------------------------------------------------------------------------------------
+ @property (class, nonatomic, assign) NSUInteger maxRateLimitRetries;
+ --------------------------------------------------------------------------------------------------------------*/
++ (void)setMaxRateLimitRetries:(NSUInteger)maxRateLimitRetries
+{
+    @synchronized ([NSNotificationCenter defaultCenter]){
+        _maxRateLimitRetries = maxRateLimitRetries;
+    }
+}
+
++ (NSUInteger)maxRateLimitRetries
+{
+    @synchronized ([NSNotificationCenter defaultCenter]){
+        return _maxRateLimitRetries;
+    }
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ Private storages
+ --------------------------------------------------------------------------------------------------------------*/
++ (NSMutableDictionary<NSString*,APIRateBucket*>*) rateBuckets
+{
+    @synchronized ([NSNotificationCenter defaultCenter])
+    {
+        if (!_rateBuckets){
+             _rateBuckets = [NSMutableDictionary new];
+        }
+        return _rateBuckets;
+    }
+}
+
++ (NSMutableDictionary<NSString*,NSArray<NSNumber*>*>*) tokenLimits
+{
+    @synchronized ([NSNotificationCenter defaultCenter])
+    {
+        if (!_tokenLimits){
+             _tokenLimits = [NSMutableDictionary new];
+             _tokenLimits[anyAccessTokenKey] = @[@(defaultRequestsPerSecond), @(defaultBurst)];
+        }
+        return _tokenLimits;
+    }
+}
+
++ (NSMutableDictionary<NSNumber*,NSArray<NSNumber*>*>*) groupLimits
+{
+    @synchronized ([NSNotificationCenter defaultCenter])
+    {
+        if (!_groupLimits){
+             _groupLimits = [NSMutableDictionary new];
+        }
+        return _groupLimits;
+    }
+}
+
+@end
@@ -0,0 +1,98 @@
+#import "APIManager.h"
+#import "APIMethods.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+/*--------------------------------------------------------------------------------------------------------------
+ 📝 'APIRetryPolicy' - describes how a failed request of a certain API method is repeated.
+ ---------------
+ The delay before the repeat grows exponentially: 'baseDelay * multiplier^retry', but not more than 'maxDelay'.
+ The real delay is chosen randomly from zero to this value ('full jitter'), so that many clients that failed at
+ the same moment do not return to the server at the same moment.
+ --------------------------------------------------------------------------------------------------------------*/
+@interface APIRetryPolicy : NSObject <NSCopying>
+
+@property (nonatomic, assign) NSUInteger     maxRetries; // The number of repeats after the first attempt (default 2)
+@property (nonatomic, assign) NSTimeInterval baseDelay;  // default 0.25 sec.
+@property (nonatomic, assign) NSTimeInterval maxDelay;   // default 4 sec.
+@property (nonatomic, assign) double         multiplier; // default 2
+@property (nonatomic, assign) NSTimeInterval deadline;   // The total time for all attempts, counted from the first sending of the request (default 15 sec.)
+
++ (instancetype) defaultPolicy;
++ (instancetype) noRetryPolicy;
+
+/*--------------------------------------------------------------------------------------------------------------
+ Returns the delay before the repeat with the number 'retry' (counting from zero).
+ --------------------------------------------------------------------------------------------------------------*/
+- (NSTimeInterval) delayBeforeRetry:(NSUInteger)retry;
+
+@end
+
+
+
+/*--------------------------------------------------------------------------------------------------------------
+ 🌐🔁 'APIManager(RetryPolicy)' - repeats requests which failed because of transient problems.
+ ---------------
+ [⚖️] Duties:
+ - Know which API methods are idempotent (can be repeated without side effects).
+ - Distinguish transient failures (timeout, lost connection, VK errors 1 and 10) from final ones.
+ - Calculate the delay before the repeat according to the policy of the API method.
+ - Limit the share of repeats in the total number of requests ('retry budget'), so that a failing server
+   does not receive a "storm" of repeats from the application.
+ ---------------
+ Additionally:
+ (⚠️) A non-idempotent request (For example 'wall.post') is repeated only if it is known for sure that it has not
+      reached the server (the host was not found or the connection was not established). Otherwise the repeat
+      could publish the post twice.
+ --------------------------------------------------------------------------------------------------------------*/
+@interface APIManager (RetryPolicy)
+
+/*--------------------------------------------------------------------------------------------------------------
+ Each request adds 'retryBudgetRatio' (default 0.1) to the budget, each repeat takes 1 from it.
+ So in the long run there are no more than 10% of repeats. The budget does not grow above 'retryBudgetCapacity' (default 10).
+ --------------------------------------------------------------------------------------------------------------*/
+@property (class, nonatomic, assign) double retryBudgetRatio;
+@property (class, nonatomic, assign) double retryBudgetCapacity;
+
+
+#pragma mark - Policies
+
+/*--------------------------------------------------------------------------------------------------------------
+ Sets the policy for the API method. Pass 'nil' to return the default policy.
+ --------------------------------------------------------------------------------------------------------------*/
++ (void) setRetryPolicy:(nullable APIRetryPolicy*)policy forAPIMethod:(APIMethod)method;
+
++ (APIRetryPolicy*) retryPolicyForAPIMethod:(APIMethod)method;
+
+/*--------------------------------------------------------------------------------------------------------------
+ Returns 'YES' if repeating the API method does not change the state on the server.
+ --------------------------------------------------------------------------------------------------------------*/
++ (BOOL) isIdempotentAPIMethod:(APIMethod)method;
+
+
+#pragma mark - Decision
+
+/*--------------------------------------------------------------------------------------------------------------
+ Called for every new request. Replenishes the retry budget.
+ --------------------------------------------------------------------------------------------------------------*/
++ (void) depositRetryBudget;
+
+/*--------------------------------------------------------------------------------------------------------------
+ Decides whether the failed operation should be repeated.
+ Returns the delay before the repeat, or a negative value if the operation should not be repeated.
+ 'retries' - how many repeats have already been made, 'elapsed' - how many seconds have passed since the request was first sent.
+ --------------------------------------------------------------------------------------------------------------*/
++ (NSTimeInterval) retryDelayForOperation:(BO*)op
+                                APIMethod:(APIMethod)method
+                                  retries:(NSUInteger)retries
+                                  elapsed:(NSTimeInterval)elapsed;
+
+/*--------------------------------------------------------------------------------------------------------------
+ Returns 'YES' if the error is transient and the request may succeed if it is repeated.
+ 'isIdempotent' - for 'NO' only errors after which the request definitely did not reach the server are considered.
+ --------------------------------------------------------------------------------------------------------------*/
++ (BOOL) isTransientErrorInOperation:(BO*)op isIdempotent:(BOOL)isIdempotent;
+
+@end
+
+NS_ASSUME_NONNULL_END
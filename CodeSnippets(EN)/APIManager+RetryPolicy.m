@@ -0,0 +1,218 @@
+#import "APIManager+RetryPolicy.h"
+#import "APIMethodRegistry.h"
+#import <RXNetworkOperation/RXNetworkOperation.h>
+
+
+// VK API errors after which a repeat makes sense
+#define unknownErrorCode        1   // "Unknown error occurred"
+#define internalServerErrorCode 10  // "Internal server error"
+
+
+@implementation APIRetryPolicy
+
++ (instancetype) defaultPolicy
+{
+    APIRetryPolicy* policy = [APIRetryPolicy new];
+    policy.maxRetries = 2;
+    policy.baseDelay  = 0.25;
+    policy.maxDelay   = 4;
+    policy.multiplier = 2;
+    policy.deadline   = 15;
+    return policy;
+}
+
++ (instancetype) noRetryPolicy
+{
+    APIRetryPolicy* policy = [APIRetryPolicy defaultPolicy];
+    policy.maxRetries = 0;
+    return policy;
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ 'Full jitter': a random value from zero to the exponentially growing limit.
+ --------------------------------------------------------------------------------------------------------------*/
+- (NSTimeInterval) delayBeforeRetry:(NSUInteger)retry
+{
+    NSTimeInterval limit = MIN(self.maxDelay, self.baseDelay * pow(self.multiplier, retry));
+    return limit * ((double)arc4random() / UINT32_MAX);
+}
+
+- (id) copyWithZone:(NSZone*)zone
+{
+    APIRetryPolicy* copy = [[APIRetryPolicy allocWithZone:zone] init];
+    copy.maxRetries = self.maxRetries;
+    copy.baseDelay  = self.baseDelay;
+    copy.maxDelay   = self.maxDelay;
+    copy.multiplier = self.multiplier;
+    copy.deadline   = self.deadline;
+    return copy;
+}
+
+@end
+
+
+
+static double _retryBudget         = 10;
+static double _retryBudgetRatio    = 0.1;
+static double _retryBudgetCapacity = 10;
+static NSMutableDictionary<NSNumber*,APIRetryPolicy*>* _retryPolicies = nil;
+
+
+
+@implementation APIManager (RetryPolicy)
+
+#pragma mark - Policies
+
+/*--------------------------------------------------------------------------------------------------------------
+ Sets the policy for the API method. Pass 'nil' to return the default policy.
+ --------------------------------------------------------------------------------------------------------------*/
++ (void) setRetryPolicy:(nullable APIRetryPolicy*)policy forAPIMethod:(APIMethod)method
+{
+    @synchronized ([NSNotificationCenter defaultCenter])
+    {
+        if (!_retryPolicies){
+             _retryPolicies = [NSMutableDictionary new];
+        }
+        _retryPolicies[@(method)] = [policy copy];
+    }
+}
+
++ (APIRetryPolicy*) retryPolicyForAPIMethod:(APIMethod)method
+{
+    @synchronized ([NSNotificationCenter defaultCenter])
+    {
+        APIRetryPolicy* policy = _retryPolicies[@(method)];
+        return (policy) ? policy : [APIRetryPolicy defaultPolicy];
+    }
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ Returns 'YES' if repeating the API method does not change the state on the server.
+ --------------------------------------------------------------------------------------------------------------*/
++ (BOOL) isIdempotentAPIMethod:(APIMethod)method
+{
+    return APIMethodInfoFor(method)->isIdempotent;
+}
+
+
+#pragma mark - Decision
+
+/*--------------------------------------------------------------------------------------------------------------
+ Called for every new request. Replenishes the retry budget.
+ --------------------------------------------------------------------------------------------------------------*/
++ (void) depositRetryBudget
+{
+    @synchronized ([NSNotificationCenter defaultCenter]){
+        _retryBudget = MIN(_retryBudgetCapacity, _retryBudget + _retryBudgetRatio);
+    }
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ Decides whether the failed operation should be repeated.
+ Returns the delay before the repeat, or a negative value if the operation should not be repeated.
+ --------------------------------------------------------------------------------------------------------------*/
++ (NSTimeInterval) retryDelayForOperation:(BO*)op
+                                APIMethod:(APIMethod)method
+                                  retries:(NSUInteger)retries
+                                  elapsed:(NSTimeInterval)elapsed
+{
+    BOOL isIdempotent = [APIManager isIdempotentAPIMethod:method];
+    if (![APIManager isTransientErrorInOperation:op isIdempotent:isIdempotent]){
+        return -1;
+    }
+
+    APIRetryPolicy* policy = [APIManager retryPolicyForAPIMethod:method];
+    if (retries >= policy.maxRetries){
+        return -1;
+    }
+
+    // There is no point in a repeat which will not have time to finish before the deadline
+    NSTimeInterval delay = [policy delayBeforeRetry:retries];
+    if (elapsed + delay >= policy.deadline){
+        return -1;
+    }
+
+    @synchronized ([NSNotificationCenter defaultCenter])
+    {
+        if (_retryBudget < 1){
+            APILog(@"Retry budget is exhausted. The error is returned without repeat: %@",op.error);
+            return -1;
+        }
+        _retryBudget -= 1;
+    }
+    return delay;
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ Returns 'YES' if the error is transient and the request may succeed if it is repeated.
+ --------------------------------------------------------------------------------------------------------------*/
++ (BOOL) isTransientErrorInOperation:(BO*)op isIdempotent:(BOOL)isIdempotent
+{
+    // The request reached the server, but the server failed to process it
+    if (([op.json isKindOfClass:[NSDictionary class]]) && ([op.json[@"error"] isKindOfClass:[NSDictionary class]]))
+    {
+        NSInteger code = [op.json[@"error"][@"error_code"] integerValue];
+        return ((isIdempotent) && ((code == unknownErrorCode) || (code == internalServerErrorCode)));
+    }
+
+    if (![op.error.domain isEqualToString:NSURLErrorDomain]){
+        return NO;
+    }
+
+    switch (op.error.code) {
+        // The request definitely did not reach the server
+        case NSURLErrorCannotFindHost:
+        case NSURLErrorCannotConnectToHost:
+        case NSURLErrorDNSLookupFailed:
+        case NSURLErrorNotConnectedToInternet:
+            return YES;
+
+        // It is unknown whether the server managed to process the request
+        case NSURLErrorTimedOut:
+        case NSURLErrorNetworkConnectionLost:
+            return isIdempotent;
+
+        default:
+            return NO;
+    }
+}
+
+
+#pragma mark - Setters & Getters
+
+/*--------------------------------------------------------------------------------------------------------------
+ @property (class, nonatomic, assign) double retryBudgetRatio;
+ --------------------------------------------------------------------------------------------------------------*/
++ (void)setRetryBudgetRatio:(double)retryBudgetRatio
+{
+    @synchronized ([NSNotificationCenter defaultCenter]){
+        _retryBudgetRatio = MAX(0, retryBudgetRatio);
+    }
+}
+
++ (double)retryBudgetRatio
+{
+    @synchronized ([NSNotificationCenter defaultCenter]){
+        return _retryBudgetRatio;
+    }
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ @property (class, nonatomic, assign) double retryBudgetCapacity;
+ --------------------------------------------------------------------------------------------------------------*/
++ (void)setRetryBudgetCapacity:(double)retryBudgetCapacity
+{
+    @synchronized ([NSNotificationCenter defaultCenter]){
+        _retryBudgetCapacity = MAX(0, retryBudgetCapacity);
+        _retryBudget = MIN(_retryBudget, _retryBudgetCapacity);
+    }
+}
+
++ (double)retryBudgetCapacity
+{
+    @synchronized ([NSNotificationCenter defaultCenter]){
+        return _retryBudgetCapacity;
+    }
+}
+
+@end
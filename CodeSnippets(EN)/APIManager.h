@@ -88,6 +88,7 @@ NS_ASSUME_NONNULL_BEGIN
  The method was created to allow additional configuration of 'APIManager' before use.
  For example, you want to set some additional custom parameters.
  You can do this by calling this method inside 'didFinishLaunchingWithOptions:..'.
+ The method also opens connections to the API hosts in advance (see 'APIManager(Connectivity)').
  --------------------------------------------------------------------------------------------------------------*/
 + (void) prepareAPIManagerBeforeUsing:(nullable void(^)(void))completion;
 
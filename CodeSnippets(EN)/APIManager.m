@@ -9,9 +9,16 @@
 #import "APIManager.h"
 // Own Categories
 #import "APIManager+Utilites.h"
+#import "APIManager+RateGovernor.h"
+#import "APIManager+RetryPolicy.h"
+#import "APIManager+Hedging.h"
+#import "APIManager+CircuitBreaker.h"
+#import "APIManager+Connectivity.h"
 
 // Other Network layer components
+#import "APIMethodRegistry.h"
 #import "NetworkRequestConstructor.h"
+#import "NetworkRequestConstructor+FieldProjection.h"
 #import "Validator.h"
 #import "Parser.h"
 #import "Mapper.h"
@@ -38,7 +45,6 @@
 #import "KFKeychain.h"
 #import <RXNetworkOperation/RXNetworkOperation.h>
 #import "FEMDeserializer.h"
-#import "RealReachability.h"
 
 // WKWebView
 #import <WebKit/WebKit.h>
@@ -63,6 +69,25 @@ static AuthenticationCompletion  _authenticationCompletion = nil;
 
 
 
+typedef void(^APIDispatchCompletion)(DTO* op, NSError* _Nullable error);
+
+/*--------------------------------------------------------------------------------------------------------------
+ 'APIDispatchContext' - the state of one request of 'APIManager', shared by all attempts to perform it.
+ --------------------------------------------------------------------------------------------------------------*/
+@interface APIDispatchContext : NSObject
+@property (nonatomic, assign) APIMethod      method;
+@property (nonatomic, strong) NSURLRequest*  request;
+@property (nonatomic, copy)   APIDispatchCompletion completion;
+@property (nonatomic, assign) CFAbsoluteTime createdAt;
+@property (nonatomic, assign) NSUInteger     retries;          // Repeats after transient failures
+@property (nonatomic, assign) NSUInteger     rateLimitRetries; // Repeats after "Too many requests per second"
+@property (nonatomic, strong, nullable) APIHedgeRace* hedgeRace; // Race with the duplicate, if the request is hedged
+@end
+
+@implementation APIDispatchContext
+@end
+
+
 @interface APIManager ()
 
 @property (class, nonatomic, readwrite, strong) NSURLSession* defaultSession;
@@ -117,8 +142,19 @@ static AuthenticationCompletion  _authenticationCompletion = nil;
 {
     [API setBaseURL:@"https://api.vk.com/method/"];
     
-    GLobalRealReachability.hostForPing  = @"www.google.com";
-    GLobalRealReachability.hostForCheck = @"www.goolge.com";
+    // Connections to the API hosts are opened in advance. Availability of the network is inferred from real requests
+    [APIManager prewarmConnections];
+    
+    // Templates are parsed in the background, so the first responses do not read them from disk
+    [Templater warmUpTemplates:^(TemplaterWarmUpReport* report) {
+#if DEBUG
+        // Debug builds read templates edited on disk again without restarting the application.
+        // The first snapshot of the folder is taken after the warm-up and off the main thread
+        dispatch_async(dispatch_get_global_queue(QOS_CLASS_UTILITY, 0), ^{
+            Templater.watchesTemplateDirectory = YES;
+        });
+#endif
+    }];
     
     if (completion) completion();
 }
@@ -157,7 +193,7 @@ static AuthenticationCompletion  _authenticationCompletion = nil;
                                                                              nameCase:nil];
     // NetworkOpeation
      DTO* netOp =
-    [DTO request:request uploadProgress:nil downloadProgress:nil completion:^(DTO * _Nonnull op, NSError * _Nullable error) {
+    [APIManager dataTaskForAPIMethod:APIMethod_UserGet request:request completion:^(DTO * _Nonnull op, NSError * _Nullable error) {
        
         // Check on 401 and other server's error
         if ([APIManager checkOnServerAndOtherError:op apiMethodCompletion:completion]){
@@ -169,8 +205,9 @@ static AuthenticationCompletion  _authenticationCompletion = nil;
             return;
         }
         
-        // Mapper
-        NSArray<UserProfile*>* userProfiles = [Mapper usersGetFromJSON:op.json error:&error];
+        // Mapper. In the tracking mode the fields which the mapping did not read are printed to the console
+        NSDictionary* json = [NRC trackFieldUsageInJSON:op.json request:request];
+        NSArray<UserProfile*>* userProfiles = [Mapper usersGetFromJSON:json error:&error];
         if ([API callCompletionIfOccuredErrorInOp:op result:userProfiles error:error block:completion]){
             return;
         }
@@ -178,7 +215,7 @@ static AuthenticationCompletion  _authenticationCompletion = nil;
         // Call completion
         if (completion) completion(userProfiles,op);
     }];
-    //netOp.privateSession = self.defaultSession;
+    netOp.privateSession = self.defaultSession;
     return netOp;
 }
 
@@ -196,7 +233,7 @@ static AuthenticationCompletion  _authenticationCompletion = nil;
     
     // NetworkOpeation
      DTO* netOp =
-    [DTO request:request uploadProgress:nil downloadProgress:nil completion:^(DTO * _Nonnull op, NSError * _Nullable error) {
+    [APIManager dataTaskForAPIMethod:APIMethod_PhotosGetAll request:request completion:^(DTO * _Nonnull op, NSError * _Nullable error) {
         
         // Check server error. For example 401 - failed authentication
         if ([APIManager checkOnServerAndOtherError:op apiMethodCompletion:completion]){
@@ -218,7 +255,7 @@ static AuthenticationCompletion  _authenticationCompletion = nil;
         // Call completion
         if (completion) completion(collection,op);
     }];
-    //netOp.privateSession = self.defaultSession;
+    netOp.privateSession = self.defaultSession;
     return netOp;
 }
 
@@ -241,7 +278,7 @@ static AuthenticationCompletion  _authenticationCompletion = nil;
                                                                                  offset:offset];
     // NetworkOpeation
     DTO* netOp =
-    [DTO request:request uploadProgress:nil downloadProgress:nil completion:^(DTO * _Nonnull op, NSError * _Nullable error) {
+    [APIManager dataTaskForAPIMethod:APIMethod_FriendsGet request:request completion:^(DTO * _Nonnull op, NSError * _Nullable error) {
         
         // Check server error. For example 401 - failed authentication
         if ([APIManager checkOnServerAndOtherError:op apiMethodCompletion:completion]){
@@ -254,8 +291,9 @@ static AuthenticationCompletion  _authenticationCompletion = nil;
             return;
         }
         
-        // Mapper
-        NSArray<Friend*>* friends = [Mapper friendsFromJSON:op.json[@"response"] error:&error];
+        // Mapper. In the tracking mode the fields which the mapping did not read are printed to the console
+        NSDictionary* json = [NRC trackFieldUsageInJSON:op.json request:request];
+        NSArray<Friend*>* friends = [Mapper friendsFromJSON:json[@"response"] error:&error];
         if ([API callCompletionIfOccuredErrorInOp:op result:friends error:error block:completion]){
             return;
         }
@@ -285,7 +323,7 @@ static AuthenticationCompletion  _authenticationCompletion = nil;
     
     // NetworkOpeation
      DTO* netOp =
-    [DTO request:request uploadProgress:nil downloadProgress:nil completion:^(DTO * _Nonnull op, NSError * _Nullable error) {
+    [APIManager dataTaskForAPIMethod:APIMethod_WallGet request:request completion:^(DTO * _Nonnull op, NSError * _Nullable error) {
         
         // Check server error. For example 401 - failed authentication
         if ([APIManager  checkOnServerAndOtherError:op apiMethodCompletion:completion]){
@@ -402,7 +440,7 @@ static AuthenticationCompletion  _authenticationCompletion = nil;
     
     // NetworkOpeation
      DTO* netOp =
-    [DTO request:request uploadProgress:nil downloadProgress:nil completion:^(DTO * _Nonnull op, NSError * _Nullable error) {
+    [APIManager dataTaskForAPIMethod:APIMethod_WallPost request:request completion:^(DTO * _Nonnull op, NSError * _Nullable error) {
         
         // Check server error. For example 401 - failed authentication
         if ([APIManager  checkOnServerAndOtherError:op apiMethodCompletion:completion]){
@@ -525,7 +563,7 @@ static AuthenticationCompletion  _authenticationCompletion = nil;
     
     // NetworkOpeation
      DTO* netOp =
-    [DTO request:request uploadProgress:nil downloadProgress:nil completion:^(DTO * _Nonnull op, NSError * _Nullable error) {
+    [APIManager dataTaskForAPIMethod:APIMethod_Logout request:request completion:^(DTO * _Nonnull op, NSError * _Nullable error) {
         
         MainQueue(^{
             // Clear cookies
@@ -599,7 +637,7 @@ static AuthenticationCompletion  _authenticationCompletion = nil;
 {
     NSURLRequest* request = [NetworkRequestConstructor buildRequestForMethod_PhotosGetWallUploadServer:userID groupID:groupID];
     DTO* netOp =
-    [DTO request:request uploadProgress:nil downloadProgress:nil completion:^(DTO * _Nonnull op, NSError * _Nullable error) {
+    [APIManager dataTaskForAPIMethod:APIMethod_PhotosGetWallUploadServer request:request completion:^(DTO * _Nonnull op, NSError * _Nullable error) {
         
         // Check server error. For example 401 - failed authentication
         if ([APIManager checkOnServerAndOtherError:op apiMethodCompletion:nil]){
@@ -642,9 +680,28 @@ static AuthenticationCompletion  _authenticationCompletion = nil;
     void(^progressBlock)(UO* op, UOUpProgress p) = nil;
     if (progress) progressBlock =  progress;
 
+    // The circuit of the upload server is open. The request is not sent: the operation performs the local request
+    // and finishes with the circuit error
+    NSError* circuitError = [APIManager admitRequest:request];
+    if (circuitError){
+        UO* netOp =
+        [UO uploadByRequest:[APIManager requestInPlaceOfRejectedRequest:request] progress:progressBlock completion:^(UO * _Nonnull op, NSError * _Nullable error) {
+            op.json  = nil;
+            op.error = circuitError;
+            if (completion) completion(nil,op);
+        }];
+        // The result is also available before the start
+        netOp.error = circuitError;
+        netOp.privateSession = self.defaultSession;
+        return netOp;
+    }
+
     // Network Operation
     UO* netOp =
     [UO uploadByRequest:request progress:progressBlock completion:^(UO * _Nonnull op, NSError * _Nullable error) {
+        [APIManager recordOutcomeOfOperation:op forRequest:request];
+        [APIManager updateReachabilityWithOperation:op];
+
         // Check server error. For example 401 - failed authentication
         if ([APIManager checkOnServerAndOtherError:op apiMethodCompletion:nil]){
             return;
@@ -680,7 +737,7 @@ static AuthenticationCompletion  _authenticationCompletion = nil;
     
     // Network Operation
      DTO* netOp =
-    [DTO request:saveWallPhotoRequest uploadProgress:nil downloadProgress:nil completion:^(DTO * _Nonnull op, NSError * _Nullable error) {
+    [APIManager dataTaskForAPIMethod:APIMethod_PhotosSaveWallPhoto request:saveWallPhotoRequest completion:^(DTO * _Nonnull op, NSError * _Nullable error) {
         
         // Check server error. For example 401 - failed authentication
         if ([APIManager checkOnServerAndOtherError:op apiMethodCompletion:nil]){
@@ -693,6 +750,165 @@ static AuthenticationCompletion  _authenticationCompletion = nil;
     return netOp;
 }
 
+
+#pragma mark - Dispatch
+
+/*--------------------------------------------------------------------------------------------------------------
+ All data task operations of 'APIManager' are created through this method, so that the dispatch policies are
+ applied in one place:
+ - 'APIManager(RateGovernor)' holds the operation when it is started if the limit of requests per second is exhausted.
+ - If the server still answered "Too many requests per second", the request is sent again when a slot is free.
+ - 'APIManager(RetryPolicy)' repeats the request after transient failures (timeout, lost connection, etc.).
+ - 'APIManager(Hedging)' sends a duplicate of a slow reading request and delivers the first successful answer.
+ - 'APIManager(CircuitBreaker)' does not send the request if the host does not respond: the returned operation
+   performs the local request and receives the error (or the cached answer).
+ The 'completion' block receives only the final answer.
+ --------------------------------------------------------------------------------------------------------------*/
++ (DTO*) dataTaskForAPIMethod:(APIMethod)method
+                      request:(NSURLRequest*)request
+                   completion:(APIDispatchCompletion)completion
+{
+    // The host does not respond. The request is not sent: the operation performs the local request
+    // and finishes with the cached answer or the circuit error
+    NSError* circuitError = [APIManager admitRequest:request];
+    if (circuitError){
+        id cachedResponse = [APIManager cachedResponseForRequest:request APIMethod:method];
+        DTO* netOp =
+        [DTO request:[APIManager requestInPlaceOfRejectedRequest:request] uploadProgress:nil downloadProgress:nil completion:^(DTO * _Nonnull op, NSError * _Nullable error) {
+            op.json  = cachedResponse;
+            op.error = (cachedResponse) ? nil : circuitError;
+            if (completion) completion(op, op.error);
+        }];
+        // The result is also available before the start
+        netOp.json  = cachedResponse;
+        netOp.error = (cachedResponse) ? nil : circuitError;
+        netOp.queuePriority = APIMethodInfoFor(method)->lane;
+        return netOp;
+    }
+
+    APIDispatchContext* context = [APIDispatchContext new];
+    context.method     = method;
+    context.request    = request;
+    context.completion = completion;
+    context.createdAt  = CFAbsoluteTimeGetCurrent();
+
+    DTO* netOp =
+    [DTO request:request uploadProgress:nil downloadProgress:nil completion:^(DTO * _Nonnull op, NSError * _Nullable error) {
+        [APIManager finishAttempt:op ofOperation:op context:context];
+    }];
+
+    // The priority lane of the method: the profile header goes ahead of the lists, bulk photo pages go behind
+    netOp.queuePriority = APIMethodInfoFor(method)->lane;
+
+    [APIManager depositRetryBudget];
+    [APIManager governOperation:netOp forAPIMethod:method];
+
+    if ((APIManager.isHedgingEnabled) && ([APIManager isHedgeableAPIMethod:method]))
+    {
+        __weak DTO* weakOp = netOp;
+        __weak APIDispatchContext* weakContext = context;
+        context.hedgeRace =
+        [APIHedgeRace raceForOperation:netOp APIMethod:method request:request attemptCompletion:^(DTO * _Nonnull finishedOp) {
+            DTO* op = weakOp;
+            APIDispatchContext* strongContext = weakContext;
+            if ((op) && (strongContext)) [APIManager finishAttempt:finishedOp ofOperation:op context:strongContext];
+        }];
+        [APIManager depositHedgingBudget];
+    }
+    return netOp;
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ Called when one attempt to perform the request has finished.
+ Repeated attempts are performed by separate operations, their result is copied into the operation that was
+ returned to the user. Therefore the user always works with the same instance of the operation.
+ --------------------------------------------------------------------------------------------------------------*/
++ (void) finishAttempt:(DTO*)attemptOp ofOperation:(DTO*)op context:(APIDispatchContext*)context
+{
+    // The loser of the race and the first failure while the rival is in flight are not delivered
+    if ((context.hedgeRace) && (![context.hedgeRace shouldDeliverAttempt:attemptOp])){
+        return;
+    }
+    [APIManager recordOutcomeOfOperation:attemptOp forRequest:context.request];
+    [APIManager updateReachabilityWithOperation:attemptOp];
+    [APIManager cacheResponseOfOperation:attemptOp forRequest:context.request APIMethod:context.method];
+
+    if (attemptOp != op){
+        op.json  = attemptOp.json;
+        op.error = attemptOp.error;
+    }
+
+    NSTimeInterval delay = [APIManager delayBeforeRepeatingOperation:op context:context];
+    if (delay >= 0)
+    {
+        // ⚠️ We prohibit unblocking the thread of the synchronous operation until the final answer is received
+        if (op.isSync) { op.isMayUnlockSemaphore = NO; }
+
+        [APIManager resendRequestOfOperation:op context:context afterDelay:delay];
+        return;
+    }
+
+    if (context.completion) context.completion(op, op.error);
+
+    // The thread of the synchronous operation is released only after 'completion' has filled the operation with the result
+    if ((attemptOp != op) && (op.isSync)){
+        op.isMayUnlockSemaphore = YES;
+        [op unlockSemaphore];
+    }
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ Returns the delay before the request is sent again, or a negative value if 'op' contains the final answer.
+ --------------------------------------------------------------------------------------------------------------*/
++ (NSTimeInterval) delayBeforeRepeatingOperation:(DTO*)op context:(APIDispatchContext*)context
+{
+    // The server rejected the request because of the limit of requests per second
+    if ([APIManager isRateLimitErrorInOperation:op])
+    {
+        if (context.rateLimitRetries >= APIManager.maxRateLimitRetries){
+            return -1;
+        }
+        context.rateLimitRetries += 1;
+        return [APIManager delayAfterRateLimitErrorForAPIMethod:context.method];
+    }
+
+    // Transient failures
+    // The repeat is not sent to the host whose circuit is open. The probe of the half-open circuit is not taken
+    // The circuit is checked first, so the retry budget is spent only on a repeat which is really sent
+    if ([APIManager isCircuitOpenForRequest:context.request]){
+        return -1;
+    }
+    // The deadline is counted from the first sending: the time held by the rate governor does not use it up
+    CFAbsoluteTime sentAt  = [APIManager sendTimeOfOperation:op];
+    NSTimeInterval elapsed = CFAbsoluteTimeGetCurrent() - ((sentAt > 0) ? sentAt : context.createdAt);
+    NSTimeInterval delay   = [APIManager retryDelayForOperation:op APIMethod:context.method retries:context.retries elapsed:elapsed];
+    if (delay < 0){
+        return -1;
+    }
+    context.retries += 1;
+
+    // The repeat is a request too, so it also takes a slot from the rate governor
+    return MAX(delay, [APIManager reserveRequestSlotForAPIMethod:context.method]);
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ Performs the request again by a new operation on 'APIManager.aSyncQueue' no earlier than 'delay' seconds later.
+ --------------------------------------------------------------------------------------------------------------*/
++ (void) resendRequestOfOperation:(DTO*)op context:(APIDispatchContext*)context afterDelay:(NSTimeInterval)delay
+{
+    DTO* attemptOp =
+    [DTO request:context.request uploadProgress:nil downloadProgress:nil completion:^(DTO * _Nonnull finishedOp, NSError * _Nullable error) {
+        [APIManager finishAttempt:finishedOp ofOperation:op context:context];
+    }];
+    attemptOp.privateSession = op.privateSession;
+    // The repeat stays in the lane of the original operation
+    attemptOp.queuePriority  = op.queuePriority;
+
+    [APIManager holdOperation:attemptOp forTimeInterval:delay];
+    [APIManager.aSyncQueue addOperation:attemptOp];
+}
+
+
 #pragma mark - Logic
 
 ///////////////////////////////////////////////////////////////////////////////
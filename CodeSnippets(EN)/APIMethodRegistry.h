@@ -0,0 +1,74 @@
+//
+//  APIMethodRegistry.h
+//  vk-networkLayer
+//
+//  Created by Admin on 03/08/2020.
+//  Copyright © 2020 iOS-Team. All rights reserved.
+//
+
+#import <Foundation/Foundation.h>
+#import "APIMethods.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+/*--------------------------------------------------------------------------------------------------------------
+ (📄) File 'APIMethodRegistry.h' - the single table of the properties of all API methods.
+ ---------------
+ Each subsystem used to keep its own 'switch' over 'APIMethod': the name of the method, its version,
+ idempotency, the group of limits, hedging. The table collects all of them in one place, indexed by 'APIMethod',
+ so any property is read in O(1) and a new API method is described by one line.
+ ---------------
+ [⚖️] Used by:
+ - 'NetworkRequestConstructor' - address, version, fixed parameters, default fields, dictionary constructor.
+ - 'Validator'                 - validation method of the answer, check of the elements of arrays.
+ - 'APIManager' categories     - name, idempotency, group of limits, hedging, lifetime of the cached answer.
+ - 'APIManager'                - priority lane of the operations of the method.
+ ---------------
+ Additionally:
+ (⚠️) A new API method is added to the enum 'APIMethod' and to the table in 'APIMethodRegistry.m' at once.
+ (⚠️) Selectors are stored as strings and resolved once, on the first call.
+ --------------------------------------------------------------------------------------------------------------*/
+typedef struct {
+    // Name of the method in the address of the request ('users.get')
+    __unsafe_unretained NSString* _Nullable name;
+    // Value of the 'v' parameter
+    __unsafe_unretained NSString* _Nullable version;
+    // Parameters which never depend on the arguments, without 'v' ('extended=1')
+    __unsafe_unretained NSString* _Nullable fixedParams;
+    // Fields requested by default, separated by commas. See 'APIMethodDefaultFields()'
+    __unsafe_unretained NSString* _Nullable defaultFields;
+
+    APIMethodGroup group;
+    // Repeating the request does not change the state on the server
+    BOOL isIdempotent;
+    // The request may be duplicated by 'APIManager(Hedging)'
+    BOOL isHedgeable;
+    // Objects in the arrays of the answer are checked against the template ('CheckArrayElements')
+    BOOL checksArrayElements;
+    // How long the last successful answer may be returned instead of a new one. '0' - never
+    NSTimeInterval cacheTTL;
+    // Priority lane: the order in which a queue starts the ready operations of different methods.
+    // '0' - 'NSOperationQueuePriorityNormal'. 'group' is the bucket of the limits, not a lane
+    NSOperationQueuePriority lane;
+
+    // Selector of the 'NRC' constructor which takes the dictionary of parameters
+    const char* _Nullable requestBuilder;
+    // Selector of the 'Validator' method which validates the answer
+    const char* _Nullable responseValidator;
+} APIMethodInfo;
+
+
+/*--------------------------------------------------------------------------------------------------------------
+ Returns the properties of the API method. For values outside of the enum returns the line of 'APIMethod_Unknow'.
+ --------------------------------------------------------------------------------------------------------------*/
+const APIMethodInfo* APIMethodInfoFor(APIMethod method);
+
+/*--------------------------------------------------------------------------------------------------------------
+ Returns 'defaultFields' as an array. The array is built once per API method.
+ --------------------------------------------------------------------------------------------------------------*/
+NSArray<NSString*>* _Nullable APIMethodDefaultFields(APIMethod method);
+
+SEL _Nullable APIMethodRequestBuilder(APIMethod method);
+SEL _Nullable APIMethodResponseValidator(APIMethod method);
+
+NS_ASSUME_NONNULL_END
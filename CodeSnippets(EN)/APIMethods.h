@@ -17,6 +17,7 @@
 /*--------------------------------------------------------------------------------------------------------------
  API enumerations of methods supported by 'APIManager'.
  Used for convenience in 'NetworkRequestConstructor' as arguments to query building functions.
+ (⚠️) Each value has its line in the table of 'APIMethodRegistry.m' with all properties of the API method.
  --------------------------------------------------------------------------------------------------------------*/
 typedef NS_ENUM(NSInteger, APIMethod) {
     
@@ -34,23 +35,16 @@ typedef NS_ENUM(NSInteger, APIMethod) {
     APIMethod_Logout
 };
 
-
-#pragma mark - String Constants API Part
 /*--------------------------------------------------------------------------------------------------------------
- String constants containing the name EndPoint and the name of the API methods.
- Used by the 'NetworkRequestConstructor' constructor when constructing the NSURLRequest.
+ Groups of API methods that share one request budget.
+ 'Read'    - users.get, wall.get, friends.get, photos.getAll, photos.getWallUploadServer
+ 'Write'   - wall.post, photos.saveWallPhoto
+ 'Service' - auth.logout. Is not counted by the VK API limits, so it is never held by the per-token bucket.
  --------------------------------------------------------------------------------------------------------------*/
-static NSString *const usersGet = @"users.get"; // Returns extended information about users.
-static NSString *const wallGet  = @"wall.get";  // Returns entries from users' wall
-static NSString *const wallPost = @"wall.post"; // Lets you create a post on the wall
-
-static NSString *const photosGetAll  = @"photos.getAll"; // Returns all photos of a user or community in anti-chronological order.
-static NSString *const friendsGet    = @"friends.get";   // Returns a list of user friend ids or extended information about user friends
-
-
-static NSString *const photosGetWallUploadServer = @"photos.getWallUploadServer"; // Returns the server address for uploading a photo to a user or community wall.
-static NSString *const photosSaveWallPhoto       = @"photos.saveWallPhoto";       // Saves photos after successful upload to the URI obtained by the method
-
-static NSString *const logout = @"auth.logout";
+typedef NS_ENUM(NSInteger, APIMethodGroup) {
+    APIMethodGroup_Read = 0,
+    APIMethodGroup_Write,
+    APIMethodGroup_Service
+};
 
 #endif /* APIMethods_h */
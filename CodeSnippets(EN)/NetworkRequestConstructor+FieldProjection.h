@@ -0,0 +1,59 @@
+#import "NetworkRequestConstructor.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+/*--------------------------------------------------------------------------------------------------------------
+ 🏗🔎 'NRC(FieldProjection)' - requests from the server only the fields which are really used.
+ ---------------
+ 'users.get' and 'friends.get' return as many fields as they were asked for. Each extra field makes the answer
+ bigger, and its transfer, parsing and mapping slower.
+ ---------------
+ [⚖️] Duties:
+ - Keep the fields declared by each consumer (viewModel, mapping) for each API method.
+ - Return the union of the fields of all live consumers. NRC requests it instead of the default list.
+ - In the tracking mode, report the fields which were downloaded but never read while mapping.
+ ---------------
+ Additionally:
+ (⚠️) Consumers are held weakly. When a consumer is deallocated, its fields are no longer requested.
+ (⚠️) Fields passed directly to the constructor method replace the projection and the default list (they are
+      not concatenated with them).
+ (⚠️) The order of priority: fields of the call -> union of consumers -> default fields of the API method.
+ --------------------------------------------------------------------------------------------------------------*/
+@interface NetworkRequestConstructor (FieldProjection)
+
+/*--------------------------------------------------------------------------------------------------------------
+ Enables the tracking of the read fields. Intended for debugging, because every answer is wrapped into proxies.
+ Default 'NO'.
+ --------------------------------------------------------------------------------------------------------------*/
+@property (class, nonatomic, assign) BOOL isFieldUsageTrackingEnabled;
+
+
+#pragma mark - Projection
+
+/*--------------------------------------------------------------------------------------------------------------
+ Declares the fields of the API method which 'consumer' reads. A new call replaces the previous declaration.
+ For example in the initializer of the viewModel:
+ [NRC declareFields:@[@"photo_200",@"online",@"city"] forConsumer:self APIMethod:APIMethod_UserGet];
+ --------------------------------------------------------------------------------------------------------------*/
++ (void) declareFields:(NSArray<NSString*>*)fields forConsumer:(id)consumer APIMethod:(APIMethod)method;
+
++ (void) removeFieldsForConsumer:(id)consumer APIMethod:(APIMethod)method;
+
+/*--------------------------------------------------------------------------------------------------------------
+ Returns the sorted union of the fields of all live consumers, or 'nil' if no one has declared anything.
+ --------------------------------------------------------------------------------------------------------------*/
++ (nullable NSArray<NSString*>*) projectedFieldsForAPIMethod:(APIMethod)method;
+
+
+#pragma mark - Tracking
+
+/*--------------------------------------------------------------------------------------------------------------
+ If the tracking mode is enabled, returns a copy of 'json' which remembers what keys were read.
+ When the copy is deallocated, the fields requested in 'request' but never read are printed to the console.
+ If the mode is disabled, returns 'json' as is.
+ --------------------------------------------------------------------------------------------------------------*/
++ (nullable id) trackFieldUsageInJSON:(nullable id)json request:(NSURLRequest*)request;
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,199 @@
+#import "NetworkRequestConstructor+FieldProjection.h"
+#import "NetworkRequestConstructor+RequestBody.h"
+
+
+static BOOL _isFieldUsageTrackingEnabled = NO;
+static NSMutableDictionary<NSNumber*,NSMapTable<id,NSArray<NSString*>*>*>* _projections = nil;
+
+
+
+/*--------------------------------------------------------------------------------------------------------------
+ 'NRCFieldUsage' - collects the keys read from one answer. Reports unused fields when it is deallocated,
+ that is, when the last proxy of the answer is gone.
+ --------------------------------------------------------------------------------------------------------------*/
+@interface NRCFieldUsage : NSObject
+@property (nonatomic, strong) NSString* methodName;
+@property (nonatomic, strong) NSArray<NSString*>* requestedFields;
+@property (nonatomic, strong) NSMutableSet<NSString*>* readKeys;
+- (void) markKeyAsRead:(id)key;
+@end
+
+
+@implementation NRCFieldUsage
+
+- (instancetype) init
+{
+    self = [super init];
+    if (self) {
+        _readKeys = [NSMutableSet new];
+    }
+    return self;
+}
+
+- (void) markKeyAsRead:(id)key
+{
+    if (![key isKindOfClass:[NSString class]]) return;
+    @synchronized (self) {
+        [self.readKeys addObject:key];
+    }
+}
+
+- (void) dealloc
+{
+    NSMutableArray<NSString*>* unusedFields = [self.requestedFields mutableCopy];
+    [unusedFields removeObjectsInArray:self.readKeys.allObjects];
+
+    if (unusedFields.count > 0){
+        APILog(@"'%@' downloaded fields which were never read: %@",self.methodName,[unusedFields componentsJoinedByString:@","]);
+    }
+}
+
+@end
+
+
+
+/*--------------------------------------------------------------------------------------------------------------
+ 'NRCTrackedDictionary' - a proxy of the dictionary from the answer. Notes each key which is read through it.
+ Nested dictionaries and arrays are wrapped on reading, so the whole tree is tracked.
+ --------------------------------------------------------------------------------------------------------------*/
+@interface NRCTrackedDictionary : NSDictionary
+@property (nonatomic, strong) NSDictionary*  storage;
+@property (nonatomic, strong) NRCFieldUsage* usage;
+@end
+
+
+static id NRCTrack(id value, NRCFieldUsage* usage)
+{
+    if ([value isKindOfClass:[NSDictionary class]])
+    {
+        NRCTrackedDictionary* dictionary = [NRCTrackedDictionary new];
+        dictionary.storage = value;
+        dictionary.usage   = usage;
+        return dictionary;
+    }
+    if ([value isKindOfClass:[NSArray class]])
+    {
+        NSMutableArray* array = [NSMutableArray arrayWithCapacity:[value count]];
+        for (id item in value) [array addObject:NRCTrack(item, usage)];
+        return array;
+    }
+    return value;
+}
+
+
+@implementation NRCTrackedDictionary
+
+- (NSUInteger) count
+{
+    return self.storage.count;
+}
+
+- (id) objectForKey:(id)key
+{
+    [self.usage markKeyAsRead:key];
+    return NRCTrack(self.storage[key], self.usage);
+}
+
+- (NSEnumerator*) keyEnumerator
+{
+    return [self.storage keyEnumerator];
+}
+
+@end
+
+
+
+@implementation NetworkRequestConstructor (FieldProjection)
+
+#pragma mark - Projection
+
+/*--------------------------------------------------------------------------------------------------------------
+ Declares the fields of the API method which 'consumer' reads. A new call replaces the previous declaration.
+ --------------------------------------------------------------------------------------------------------------*/
++ (void) declareFields:(NSArray<NSString*>*)fields forConsumer:(id)consumer APIMethod:(APIMethod)method
+{
+    @synchronized ([NSNotificationCenter defaultCenter])
+    {
+        if (!_projections){
+             _projections = [NSMutableDictionary new];
+        }
+        NSMapTable* consumers = _projections[@(method)];
+        if (!consumers){
+            consumers = [NSMapTable weakToStrongObjectsMapTable];
+            _projections[@(method)] = consumers;
+        }
+        [consumers setObject:[fields copy] forKey:consumer];
+    }
+}
+
++ (void) removeFieldsForConsumer:(id)consumer APIMethod:(APIMethod)method
+{
+    @synchronized ([NSNotificationCenter defaultCenter]){
+        [_projections[@(method)] removeObjectForKey:consumer];
+    }
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ Returns the sorted union of the fields of all live consumers, or 'nil' if no one has declared anything.
+ --------------------------------------------------------------------------------------------------------------*/
++ (nullable NSArray<NSString*>*) projectedFieldsForAPIMethod:(APIMethod)method
+{
+    NSMutableSet<NSString*>* union_ = [NSMutableSet new];
+
+    @synchronized ([NSNotificationCenter defaultCenter])
+    {
+        // 'objectEnumerator' of the weak map table skips the consumers which were already deallocated
+        for (NSArray<NSString*>* fields in [_projections[@(method)] objectEnumerator]){
+            [union_ addObjectsFromArray:fields];
+        }
+    }
+    if (union_.count < 1) return nil;
+
+    // The sorted list gives the same address of the request for the same set of consumers
+    return [union_.allObjects sortedArrayUsingSelector:@selector(compare:)];
+}
+
+
+#pragma mark - Tracking
+
+/*--------------------------------------------------------------------------------------------------------------
+ If the tracking mode is enabled, returns a copy of 'json' which remembers what keys were read.
+ --------------------------------------------------------------------------------------------------------------*/
++ (nullable id) trackFieldUsageInJSON:(nullable id)json request:(NSURLRequest*)request
+{
+    if ((!json) || (!NRC.isFieldUsageTrackingEnabled)) return json;
+
+    NSURLComponents* components = [NSURLComponents componentsWithString:[NRC canonicalKeyForRequest:request]];
+    NSString* fields = nil;
+    for (NSURLQueryItem* item in components.queryItems){
+        if ([item.name isEqualToString:@"fields"]) fields = item.value;
+    }
+    if (fields.length < 1) return json;
+
+    NRCFieldUsage* usage  = [NRCFieldUsage new];
+    usage.methodName      = request.URL.lastPathComponent;
+    usage.requestedFields = [fields componentsSeparatedByString:@","];
+    return NRCTrack(json, usage);
+}
+
+
+#pragma mark - Setters & Getters
+
+/*--------------------------------------------------------------------------------------------------------------
+ @property (class, nonatomic, assign) BOOL isFieldUsageTrackingEnabled;
+ --------------------------------------------------------------------------------------------------------------*/
++ (void)setIsFieldUsageTrackingEnabled:(BOOL)isFieldUsageTrackingEnabled
+{
+    @synchronized ([NSNotificationCenter defaultCenter]){
+        _isFieldUsageTrackingEnabled = isFieldUsageTrackingEnabled;
+    }
+}
+
++ (BOOL)isFieldUsageTrackingEnabled
+{
+    @synchronized ([NSNotificationCenter defaultCenter]){
+        return _isFieldUsageTrackingEnabled;
+    }
+}
+
+@end
@@ -0,0 +1,61 @@
+#import "NetworkRequestConstructor.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+/*--------------------------------------------------------------------------------------------------------------
+ 🏗📦 'NRC(RequestBody)' - moves the parameters of long requests from the address into the body.
+ ---------------
+ All API methods are sent as 'GET' and carry their parameters in the query string. Long 'message' texts,
+ attachment lists and big 'user_ids' batches exceed the length limits of the address, and the whole address is
+ repeated in the request headers and proxy logs.
+ ---------------
+ [⚖️] Duties:
+ - Turn a 'GET' request whose address is longer than 'bodyThreshold' into a 'POST' request with the parameters
+   in the 'application/x-www-form-urlencoded' body.
+ - Compress the body with gzip if 'isBodyCompressionEnabled' is set.
+ - Keep the canonical key of the request, which does not depend on where the parameters are sent.
+ ---------------
+ Additionally:
+ (⚠️) All constructor methods of the API methods call 'moveParametersToBodyIfNeeded:' themselves.
+ (⚠️) Caches and dedupe must use 'canonicalKeyForRequest:' instead of 'request.URL', otherwise all 'POST'
+      requests of the same API method get the same key.
+ (⚠️) The compressed body is sent only if it is really smaller than the original one.
+ --------------------------------------------------------------------------------------------------------------*/
+@interface NetworkRequestConstructor (RequestBody)
+
+/*--------------------------------------------------------------------------------------------------------------
+ The length of the address (in characters) above which the parameters are moved into the body. Default 2048.
+ --------------------------------------------------------------------------------------------------------------*/
+@property (class, nonatomic, assign) NSUInteger bodyThreshold;
+
+/*--------------------------------------------------------------------------------------------------------------
+ Compresses the moved body with gzip and sets 'Content-Encoding: gzip'. Default 'NO'.
+ --------------------------------------------------------------------------------------------------------------*/
+@property (class, nonatomic, assign) BOOL isBodyCompressionEnabled;
+
+
+/*--------------------------------------------------------------------------------------------------------------
+ If the address of the 'GET' request is longer than 'bodyThreshold', moves the query into the body and turns
+ the request into 'POST'. Returns the same request.
+ --------------------------------------------------------------------------------------------------------------*/
++ (nullable NSMutableURLRequest*) moveParametersToBodyIfNeeded:(nullable NSMutableURLRequest*)request;
+
+/*--------------------------------------------------------------------------------------------------------------
+ Returns the address of the request with all its parameters, as if they were sent in the query string.
+ --------------------------------------------------------------------------------------------------------------*/
++ (NSString*) canonicalKeyForRequest:(NSURLRequest*)request;
+
+
+#pragma mark - Self-check
+
+#if DEBUG
+/*--------------------------------------------------------------------------------------------------------------
+ Moves a 'wall.post' request with '+' in a long message into the body, built by the template and by the dictionary.
+ The '+' must reach the body as '%2B', otherwise the server reads it as a space. Returns 'YES' if the check has passed.
+ --------------------------------------------------------------------------------------------------------------*/
++ (BOOL) checkPlusInMovedBody;
+#endif
+
+@end
+
+NS_ASSUME_NONNULL_END
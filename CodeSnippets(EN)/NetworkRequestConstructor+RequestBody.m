@@ -0,0 +1,157 @@
+#import "NetworkRequestConstructor+RequestBody.h"
+
+// System
+#import <zlib.h>
+
+
+#define defaultBodyThreshold 2048
+
+static NSString* const NRCCanonicalKeyProperty = @"NRCCanonicalKey";
+
+static NSUInteger _bodyThreshold            = defaultBodyThreshold;
+static BOOL       _isBodyCompressionEnabled = NO;
+
+
+/*--------------------------------------------------------------------------------------------------------------
+ Compresses 'data' into the gzip format. Returns 'nil' if zlib failed.
+ --------------------------------------------------------------------------------------------------------------*/
+static NSData* _Nullable NRCGzip(NSData* data)
+{
+    z_stream stream = {0};
+    // 15 + 16: the maximal window and the gzip header instead of the zlib one
+    if (deflateInit2(&stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK) return nil;
+
+    NSMutableData* compressed = [NSMutableData dataWithLength:deflateBound(&stream, (uLong)data.length)];
+    stream.next_in   = (Bytef*)data.bytes;
+    stream.avail_in  = (uInt)data.length;
+    stream.next_out  = (Bytef*)compressed.mutableBytes;
+    stream.avail_out = (uInt)compressed.length;
+
+    int status = deflate(&stream, Z_FINISH);
+    deflateEnd(&stream);
+    if (status != Z_STREAM_END) return nil;
+
+    compressed.length = stream.total_out;
+    return compressed;
+}
+
+
+
+@implementation NetworkRequestConstructor (RequestBody)
+
+/*--------------------------------------------------------------------------------------------------------------
+ If the address of the 'GET' request is longer than 'bodyThreshold', moves the query into the body and turns
+ the request into 'POST'. Returns the same request.
+ --------------------------------------------------------------------------------------------------------------*/
++ (nullable NSMutableURLRequest*) moveParametersToBodyIfNeeded:(nullable NSMutableURLRequest*)request
+{
+    if ((!request) || (request.HTTPBody) || (![request.HTTPMethod isEqualToString:@"GET"])) return request;
+
+    NSString* address = request.URL.absoluteString;
+    if (address.length <= NRC.bodyThreshold) return request;
+
+    NSRange separator = [address rangeOfString:@"?"];
+    if (separator.location == NSNotFound) return request;
+
+    // The query is already percent-encoded. It becomes a valid 'x-www-form-urlencoded' body when a literal '+' is
+    // escaped: in the body '+' is decoded as a space. The encoder of NRC escapes it itself, the one of RX may not
+    NSString* query = [[address substringFromIndex:NSMaxRange(separator)] stringByReplacingOccurrencesOfString:@"+" withString:@"%2B"];
+    NSURL*    url   = [NSURL URLWithString:[address substringToIndex:separator.location]];
+    NSData*   body  = [query dataUsingEncoding:NSUTF8StringEncoding];
+    if ((!url) || (!body)) return request;
+
+    [NSURLProtocol setProperty:address forKey:NRCCanonicalKeyProperty inRequest:request];
+    request.URL        = url;
+    request.HTTPMethod = @"POST";
+    [request setValue:@"application/x-www-form-urlencoded" forHTTPHeaderField:@"Content-Type"];
+
+    if (NRC.isBodyCompressionEnabled)
+    {
+        NSData* compressed = NRCGzip(body);
+        if ((compressed) && (compressed.length < body.length)){
+            body = compressed;
+            [request setValue:@"gzip" forHTTPHeaderField:@"Content-Encoding"];
+        }
+    }
+    request.HTTPBody = body;
+    return request;
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ Returns the address of the request with all its parameters, as if they were sent in the query string.
+ --------------------------------------------------------------------------------------------------------------*/
++ (NSString*) canonicalKeyForRequest:(NSURLRequest*)request
+{
+    NSString* canonicalKey = [NSURLProtocol propertyForKey:NRCCanonicalKeyProperty inRequest:request];
+    return canonicalKey ?: (request.URL.absoluteString ?: @"");
+}
+
+
+#pragma mark - Setters & Getters
+
+/*--------------------------------------------------------------------------------------------------------------
+ @property (class, nonatomic, assign) NSUInteger bodyThreshold;
+ --------------------------------------------------------------------------------------------------------------*/
++ (void)setBodyThreshold:(NSUInteger)bodyThreshold
+{
+    @synchronized ([NSNotificationCenter defaultCenter]){
+        _bodyThreshold = bodyThreshold;
+    }
+}
+
++ (NSUInteger)bodyThreshold
+{
+    @synchronized ([NSNotificationCenter defaultCenter]){
+        return _bodyThreshold;
+    }
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ @property (class, nonatomic, assign) BOOL isBodyCompressionEnabled;
+ --------------------------------------------------------------------------------------------------------------*/
++ (void)setIsBodyCompressionEnabled:(BOOL)isBodyCompressionEnabled
+{
+    @synchronized ([NSNotificationCenter defaultCenter]){
+        _isBodyCompressionEnabled = isBodyCompressionEnabled;
+    }
+}
+
++ (BOOL)isBodyCompressionEnabled
+{
+    @synchronized ([NSNotificationCenter defaultCenter]){
+        return _isBodyCompressionEnabled;
+    }
+}
+
+
+#pragma mark - Self-check
+
+#if DEBUG
+/*--------------------------------------------------------------------------------------------------------------
+ Moves a 'wall.post' request with '+' in a long message into the body, built by the template and by the dictionary.
+ The '+' must reach the body as '%2B', otherwise the server reads it as a space. Returns 'YES' if the check has passed.
+ --------------------------------------------------------------------------------------------------------------*/
++ (BOOL) checkPlusInMovedBody
+{
+    NSString* message = [@"1+1=2 " stringByPaddingToLength:NRC.bodyThreshold + 1 withString:@"1+1=2 " startingAtIndex:0];
+
+    // The body is checked as it is, without gzip
+    BOOL isBodyCompressionEnabled = NRC.isBodyCompressionEnabled;
+    NRC.isBodyCompressionEnabled  = NO;
+    NSArray<NSURLRequest*>* requests = @[ [NRC buildRequestForMethod_WallPost:@"1" message:message attachments:nil] ?: [NSURLRequest new],
+                                          [NRC buildRequestForMethod_WallPost:@{ @"message" : message }] ?: [NSURLRequest new] ];
+    NRC.isBodyCompressionEnabled  = isBodyCompressionEnabled;
+
+    BOOL isPassed = YES;
+    for (NSURLRequest* request in requests)
+    {
+        NSString* body = [[NSString alloc] initWithData:request.HTTPBody encoding:NSUTF8StringEncoding];
+        isPassed = (isPassed) && ([request.HTTPMethod isEqualToString:@"POST"]) &&
+                   ([body containsString:@"1%2B1"]) && (![body containsString:@"+"]);
+    }
+    if (!isPassed) APILog(@"+[checkPlusInMovedBody] failed");
+    return isPassed;
+}
+#endif
+
+@end
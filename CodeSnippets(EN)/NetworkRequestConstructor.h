@@ -29,6 +29,9 @@ NS_ASSUME_NONNULL_BEGIN
  (⚠️) For some method APIs, the class provides several kinds of constructor methods.
       The first type takes several raw arguments (int / nsstring / float / etc.) and forms the request itself.
       The second type takes a ready-made dictionary with parameters, and, if necessary, independently adds the necessary values.
+ (⚠️) Methods of the first type build the address from the compiled template of the API method: the static part
+      is encoded once, and each call encodes only the arguments.
+ (⚠️) Requests with a long address are sent as 'POST' with the parameters in the body. See 'NRC(RequestBody)'.
  --------------------------------------------------------------------------------------------------------------*/
 
 @interface NetworkRequestConstructor : NSObject
@@ -254,6 +257,17 @@ NS_ASSUME_NONNULL_BEGIN
 + (NSMutableURLRequest*) buildRequestForMethod_logout;
 
 
+#pragma mark - Benchmark
+
+#if DEBUG
+/*--------------------------------------------------------------------------------------------------------------
+ Builds the same requests 'iterations' times in the old way (through dictionaries of parameters) and through the
+ compiled templates. Prints the time and the memory held per request to the console.
+ --------------------------------------------------------------------------------------------------------------*/
++ (void) benchmarkRequestBuilding:(NSUInteger)iterations;
+#endif
+
+
 @end
 
 NS_ASSUME_NONNULL_END
@@ -11,6 +11,13 @@
 // APIManager's Categories
 #import "APIManager+Utilites.h"
 
+// Properties of API methods
+#import "APIMethodRegistry.h"
+
+// NRC's Categories
+#import "NetworkRequestConstructor+FieldProjection.h"
+#import "NetworkRequestConstructor+RequestBody.h"
+
 // Models
 #import "Token.h"
 
@@ -20,6 +27,12 @@
 // Third-party frameworks
 #import <RXNetworkOperation/RXNetworkOperation.h>
 
+// System
+#import <pthread.h>
+#if DEBUG
+#import <malloc/malloc.h>
+#endif
+
 
 /*--------------------------------------------------------------------------------------------------------------
  🏗 'NetworkRequestConstructor' (aka NRC) - constructs requests ('NSURLRequest') for the API.
@@ -38,7 +51,230 @@
  (⚠️) For some method APIs, the class provides several kinds of constructor methods.
  The first type takes several raw arguments (int / nsstring / float / etc.) and forms the request itself.
  The second type takes a ready-made dictionary with parameters, and, if necessary, independently adds the necessary values.
+ (⚠️) Methods of the first type build the address from the compiled template of the API method: the static part
+      is encoded once, and each call encodes only the arguments.
+ (⚠️) Requests with a long address are sent as 'POST' with the parameters in the body. See 'NRC(RequestBody)'.
+ --------------------------------------------------------------------------------------------------------------*/
+
+
+#pragma mark - Request templates
+
+/*--------------------------------------------------------------------------------------------------------------
+ 'NRCBuffer' - the buffer in which the address of the request is assembled.
+ Each thread has its own buffer. It is created once and only grows, so the assembly of the address does not
+ allocate memory for intermediate strings, dictionaries and numbers.
+ --------------------------------------------------------------------------------------------------------------*/
+typedef struct {
+    char*  bytes;
+    size_t length;
+    size_t capacity;
+} NRCBuffer;
+
+#define initialBufferCapacity 512
+
+static pthread_key_t _bufferKey;
+static bool          _unreservedChars[256];
+static const char    _hexDigits[] = "0123456789ABCDEF";
+
+
+static void NRCBufferDestroy(void* value)
+{
+    NRCBuffer* buffer = value;
+    free(buffer->bytes);
+    free(buffer);
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ Returns the empty buffer of the current thread.
+ --------------------------------------------------------------------------------------------------------------*/
+static NRCBuffer* NRCThreadBuffer(void)
+{
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        pthread_key_create(&_bufferKey, NRCBufferDestroy);
+
+        // RFC 3986 'unreserved' characters. All others are percent-encoded
+        for (int c = 0; c < 256; c++){
+            _unreservedChars[c] = ((c >= 'A') && (c <= 'Z')) || ((c >= 'a') && (c <= 'z')) || ((c >= '0') && (c <= '9')) ||
+                                   (c == '-') || (c == '.') || (c == '_') || (c == '~');
+        }
+    });
+
+    NRCBuffer* buffer = pthread_getspecific(_bufferKey);
+    if (!buffer){
+        buffer = calloc(1, sizeof(NRCBuffer));
+        buffer->capacity = initialBufferCapacity;
+        buffer->bytes    = malloc(buffer->capacity);
+        pthread_setspecific(_bufferKey, buffer);
+    }
+    buffer->length = 0;
+    return buffer;
+}
+
+static inline void NRCBufferReserve(NRCBuffer* buffer, size_t extra)
+{
+    if (buffer->length + extra <= buffer->capacity) return;
+    while (buffer->length + extra > buffer->capacity) buffer->capacity *= 2;
+    buffer->bytes = realloc(buffer->bytes, buffer->capacity);
+}
+
+static inline void NRCBufferAppendBytes(NRCBuffer* buffer, const void* bytes, size_t length)
+{
+    NRCBufferReserve(buffer, length);
+    memcpy(buffer->bytes + buffer->length, bytes, length);
+    buffer->length += length;
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ Percent-encoding in one pass. The place for the worst case ('%XX' for each byte) is reserved in advance.
+ --------------------------------------------------------------------------------------------------------------*/
+static void NRCBufferAppendEncodedBytes(NRCBuffer* buffer, const unsigned char* bytes, size_t length)
+{
+    NRCBufferReserve(buffer, length * 3);
+
+    char* out = buffer->bytes + buffer->length;
+    for (size_t i = 0; i < length; i++)
+    {
+        unsigned char c = bytes[i];
+        if (_unreservedChars[c]){
+            *out++ = c;
+        } else {
+            *out++ = '%';
+            *out++ = _hexDigits[c >> 4];
+            *out++ = _hexDigits[c & 0x0F];
+        }
+    }
+    buffer->length = out - buffer->bytes;
+}
+
+static void NRCBufferAppendEncoded(NRCBuffer* buffer, NSString* string)
+{
+    // Most strings (ids, tokens, field names) already store UTF-8 inside
+    const char* utf8 = CFStringGetCStringPtr((__bridge CFStringRef)string, kCFStringEncodingUTF8);
+    if (utf8){
+        NRCBufferAppendEncodedBytes(buffer, (const unsigned char*)utf8, strlen(utf8));
+        return;
+    }
+
+    // Otherwise the string is converted by pieces through the buffer on the stack
+    unsigned char chunk[256];
+    NSRange range = NSMakeRange(0, string.length);
+    while (range.length > 0)
+    {
+        NSUInteger used = 0;
+        [string getBytes:chunk maxLength:sizeof(chunk) usedLength:&used encoding:NSUTF8StringEncoding options:0 range:range remainingRange:&range];
+        if (used == 0) break;
+        NRCBufferAppendEncodedBytes(buffer, chunk, used);
+    }
+}
+
+static inline void NRCBufferAppendKey(NRCBuffer* buffer, const char* key)
+{
+    NRCBufferAppendBytes(buffer, "&", 1);
+    NRCBufferAppendBytes(buffer, key, strlen(key));
+    NRCBufferAppendBytes(buffer, "=", 1);
+}
+
+static void NRCAppendString(NRCBuffer* buffer, const char* key, NSString* _Nullable value)
+{
+    if (!value) return;
+    NRCBufferAppendKey(buffer, key);
+    NRCBufferAppendEncoded(buffer, value);
+}
+
+static void NRCAppendInteger(NRCBuffer* buffer, const char* key, NSInteger value)
+{
+    char digits[24];
+    size_t index = sizeof(digits);
+    unsigned long long magnitude = (value < 0) ? -(unsigned long long)value : (unsigned long long)value;
+    do {
+        digits[--index] = '0' + (magnitude % 10);
+        magnitude /= 10;
+    } while (magnitude > 0);
+    if (value < 0) digits[--index] = '-';
+
+    NRCBufferAppendKey(buffer, key);
+    NRCBufferAppendBytes(buffer, digits + index, sizeof(digits) - index);
+}
+
+static BOOL NRCAppendListValues(NRCBuffer* buffer, NSArray* _Nullable values, NSArray* _Nullable skippedValues, BOOL isFirst)
+{
+    for (id value in values)
+    {
+        if ([skippedValues containsObject:value]) continue;
+
+        if (!isFirst) NRCBufferAppendBytes(buffer, ",", 1);
+        NRCBufferAppendEncoded(buffer, ([value isKindOfClass:[NSString class]]) ? value : [value description]);
+        isFirst = NO;
+    }
+    return isFirst;
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ Appends the list of values separated by commas: at first 'values', then 'extraValues' which are not in 'values'.
+ --------------------------------------------------------------------------------------------------------------*/
+static void NRCAppendList(NRCBuffer* buffer, const char* key, NSArray* _Nullable values, NSArray* _Nullable extraValues)
+{
+    if ((values.count < 1) && (extraValues.count < 1)) return;
+
+    NRCBufferAppendKey(buffer, key);
+    BOOL isFirst = NRCAppendListValues(buffer, values, nil, YES);
+    NRCAppendListValues(buffer, extraValues, values, isFirst);
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ Chooses the fields to request: the fields of the call replace everything else; without them the union of the
+ consumers declared in 'NRC(FieldProjection)' is requested; and only if there are none - 'defaultFields'.
+ --------------------------------------------------------------------------------------------------------------*/
+static NSArray<NSString*>* _Nullable NRCFieldsForMethod(APIMethod method, NSArray<NSString*>* _Nullable fields, NSArray<NSString*>* _Nullable defaultFields)
+{
+    if (fields.count > 0) return fields;
+    return [NRC projectedFieldsForAPIMethod:method] ?: defaultFields;
+}
+
+
+
+/*--------------------------------------------------------------------------------------------------------------
+ 'NRCRequestTemplate' - the static part of the request of one API method, compiled once.
+ 'prefix' contains the already encoded '<baseURL><method>?<fixed parameters>'. Each request copies it into the
+ buffer and appends only the parameters which change from call to call.
  --------------------------------------------------------------------------------------------------------------*/
+@interface NRCRequestTemplate : NSObject
+@property (nonatomic, strong) NSString* baseURL;
+@property (nonatomic, strong) NSData*   prefix;
+@property (nonatomic, strong, nullable) NSArray<NSString*>* defaultFields;
+@end
+
+@implementation NRCRequestTemplate
+@end
+
+
+/*--------------------------------------------------------------------------------------------------------------
+ Returns the buffer of the current thread, which already contains the static part of the request.
+ --------------------------------------------------------------------------------------------------------------*/
+static NRCBuffer* _Nullable NRCBufferWithTemplate(NRCRequestTemplate* _Nullable requestTemplate)
+{
+    if (!requestTemplate) return NULL;
+
+    NRCBuffer* buffer = NRCThreadBuffer();
+    NRCBufferAppendBytes(buffer, requestTemplate.prefix.bytes, requestTemplate.prefix.length);
+    return buffer;
+}
+
+static NSMutableURLRequest* _Nullable NRCRequestFromBuffer(NRCBuffer* _Nullable buffer)
+{
+    if (!buffer) return nil;
+
+    CFURLRef url = CFURLCreateWithBytes(kCFAllocatorDefault, (const UInt8*)buffer->bytes, buffer->length, kCFStringEncodingUTF8, NULL);
+    if (!url) return nil;
+
+    NSMutableURLRequest* request = [NSMutableURLRequest requestWithURL:(__bridge_transfer NSURL*)url];
+    return (buffer->length > NRC.bodyThreshold) ? [NRC moveParametersToBodyIfNeeded:request] : request;
+}
+
+
+static NSMutableDictionary<NSNumber*,NRCRequestTemplate*>* _templates = nil;
+
 
 
 @implementation NetworkRequestConstructor
@@ -63,30 +299,65 @@
 + (NSMutableURLRequest* _Nullable) buildRequestForMethod:(APIMethod)method
                                               properties:(nullable NSDictionary<NSString*,id>*)properties
 {
-    NSMutableURLRequest* request;
-    switch (method) {
-        case APIMethod_Unknow:     request = nil;                                                break;
-        case APIMethod_UserGet:    request = [NRC buildRequestForMethod_UsersGet:properties];    break;
-        case APIMethod_FriendsGet: request = [NRC buildRequestForMethod_FriendsGet:properties];  break;
-
-            
-        case APIMethod_WallGet:  request = [NRC buildRequestForMethod_WallGet:properties];  break;
-        case APIMethod_WallPost: request = [NRC buildRequestForMethod_WallPost:properties]; break;
-
-        case APIMethod_PhotosGetAll:              request = [NRC buildRequestForMethod_PhotosGetAll:properties];                break;
-        case APIMethod_PhotosGetWallUploadServer: request = [NRC buildRequestForMethod_PhotosGetWallUploadServer:properties];   break;
-      
-        case APIMethod_Logout: request = [NRC buildRequestForMethod_logout]; break;
-        
-        default: APILog(@"+buildRequestForMethod:properties:| Switch not found mathes!"); break;
+    SEL builder = APIMethodRequestBuilder(method);
+    if (!builder){
+        APILog(@"+buildRequestForMethod:properties:| Constructor is not registered for '%@'",[APIManager convertAPIMethodToString:method]);
+        return nil;
     }
-    return request;
+    NSMutableURLRequest* (*build)(id, SEL, NSDictionary*) = (void*)[NRC methodForSelector:builder];
+    return build([NRC class], builder, properties);
 }
 
 
 
 
 
+#pragma mark - Templates
+
+/*--------------------------------------------------------------------------------------------------------------
+ Returns the compiled template of the API method. The template is compiled on the first call and again
+ only if 'APIManager.baseURL' has changed.
+ --------------------------------------------------------------------------------------------------------------*/
++ (nullable NRCRequestTemplate*) templateForMethod:(APIMethod)method
+{
+    NSString* baseURL = API.baseURL;
+
+    @synchronized ([NRCRequestTemplate class])
+    {
+        NRCRequestTemplate* requestTemplate = _templates[@(method)];
+        if ((requestTemplate) && ((requestTemplate.baseURL == baseURL) || ([requestTemplate.baseURL isEqualToString:baseURL]))){
+            return requestTemplate;
+        }
+
+        requestTemplate = [NRC compileTemplateForMethod:method baseURL:baseURL];
+        if (!_templates){
+             _templates = [NSMutableDictionary new];
+        }
+        _templates[@(method)] = requestTemplate;
+        return requestTemplate;
+    }
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ Fixed parameters are the ones which never depend on the arguments of the constructor methods.
+ --------------------------------------------------------------------------------------------------------------*/
++ (nullable NRCRequestTemplate*) compileTemplateForMethod:(APIMethod)method baseURL:(NSString*)baseURL
+{
+    const APIMethodInfo* info = APIMethodInfoFor(method);
+    // 'auth.logout' is sent to another host and is built without the template
+    if ((!info->version) || (method == APIMethod_Logout)) return nil;
+
+    NSString* fixedParams = (info->fixedParams) ? str(@"%@&v=%@",info->fixedParams,info->version) : str(@"v=%@",info->version);
+
+    NRCRequestTemplate* requestTemplate = [NRCRequestTemplate new];
+    requestTemplate.baseURL       = baseURL;
+    requestTemplate.prefix        = [str(@"%@%@?%@",baseURL,info->name,fixedParams) dataUsingEncoding:NSUTF8StringEncoding];
+    requestTemplate.defaultFields = APIMethodDefaultFields(method);
+    return requestTemplate;
+}
+
+
+
 #pragma mark - Individual methods
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -118,13 +389,18 @@
                                                            fields:(nullable NSArray<NSString*>*)fields
                                                          nameCase:(nullable NSString*)nameCase
 {
-    NSMutableDictionary* properties = [NSMutableDictionary new];
+    NRCRequestTemplate* requestTemplate = [NRC templateForMethod:APIMethod_UserGet];
+    NRCBuffer* buffer = NRCBufferWithTemplate(requestTemplate);
+    if (!buffer) return nil;
     
-    properties[@"user_ids"]  = (userIds.count   > 0) ? userIds  : @[APIManager.token.userID];
-    properties[@"fields"]    = (fields.count    > 0) ? fields   : @[@"photo_50",@"photo_100",@"photo_200",@"online",@"last_seen",@"counters",@"city",@"country",@"home_town"];
-    properties[@"name_case"] = (nameCase.length > 0) ? nameCase : @"Nom";
-
-    return [NRC buildRequestForMethod_UsersGet:properties];
+    if (userIds.count > 0) NRCAppendList(buffer, "user_ids", userIds, nil);
+    else NRCAppendString(buffer, "user_ids", APIManager.token.userID);
+    
+    NRCAppendList  (buffer, "fields",       NRCFieldsForMethod(APIMethod_UserGet, fields, requestTemplate.defaultFields), nil);
+    NRCAppendString(buffer, "name_case",    (nameCase.length > 0) ? nameCase : @"Nom");
+    NRCAppendString(buffer, "access_token", APIManager.token.access_token);
+    
+    return NRCRequestFromBuffer(buffer);
 }
 
 
@@ -133,21 +409,21 @@
     // Create a boilerplate initial parameter structure
     NSMutableDictionary* params = [NSMutableDictionary new];
     params[@"user_ids"]     =  @[];
-    params[@"fields"]       =  @[@"photo_50",@"photo_100",@"photo_200",@"photo_max_orig",@"online",@"last_seen",@"counters"];
+    params[@"fields"]       =  NRCFieldsForMethod(APIMethod_UserGet, nil, APIMethodDefaultFields(APIMethod_UserGet));
     params[@"name_case"]    =  @"Nom";
-    params[@"v"]            =  @"5.122";
+    params[@"v"]            =  APIMethodInfoFor(APIMethod_UserGet)->version;
     params[@"access_token"] =  APIManager.token.access_token;
 
     // We combine the dictionaries if there is anything at all in the 'properties' of the arguments.
     if ((properties.allKeys.count > 0) || (properties != nil)){
-         params = (NSMutableDictionary*)[params mergeWithHighPriority:properties isConcatenateArrays:YES];
+         params = (NSMutableDictionary*)[params mergeWithHighPriority:properties isConcatenateArrays:NO];
     }
     
     // Build request
     NSMutableURLRequest* request =
-    [BO createRequestWithURL:[API baseURLappend:usersGet] HTTPMethod:GET params:params headers:nil];
+    [BO createRequestWithURL:[API baseURLappend:APIMethodInfoFor(APIMethod_UserGet)->name] HTTPMethod:GET params:params headers:nil];
     
-    return request;
+    return [NRC moveParametersToBodyIfNeeded:request];
 }
 
 
@@ -170,14 +446,16 @@
                                                            count:(NSInteger)count
                                                           filter:(nullable NSString*)filter
 {
-    NSMutableDictionary* properties = [NSMutableDictionary new];
+    NRCBuffer* buffer = NRCBufferWithTemplate([NRC templateForMethod:APIMethod_WallGet]);
+    if (!buffer) return nil;
     
-    properties[@"owner_id"] = (ownerID.length  > 0) ? ownerID  : APIManager.token.userID;
-    properties[@"offset"]   = [NSString stringWithFormat:@"%d",(int)offset];
-    properties[@"count"]    = (count > 0) ? [NSString stringWithFormat:@"%d",(int)count] : @"1";
-    properties[@"filter"]   = (filter.length > 0) ? filter : @"all";
+    NRCAppendString (buffer, "owner_id",     (ownerID.length > 0) ? ownerID : APIManager.token.userID);
+    NRCAppendInteger(buffer, "offset",       offset);
+    NRCAppendInteger(buffer, "count",        (count > 0) ? count : 1);
+    NRCAppendString (buffer, "filter",       (filter.length > 0) ? filter : @"all");
+    NRCAppendString (buffer, "access_token", APIManager.token.access_token);
     
-    return [NRC buildRequestForMethod_WallGet:properties];
+    return NRCRequestFromBuffer(buffer);
 }
 
 
@@ -190,18 +468,18 @@
     params[@"count"]    = @"1";
     params[@"filter"]   = @"all";
     params[@"extended"]     = @(YES);
-    params[@"v"]            =  @"5.122";
+    params[@"v"]            =  APIMethodInfoFor(APIMethod_WallGet)->version;
     params[@"access_token"] =  APIManager.token.access_token;
     
     // We combine the dictionaries if there is anything at all in the 'properties' of the arguments.
     if ((properties.allKeys.count > 0) || (properties != nil)){
-        params = (NSMutableDictionary*)[params mergeWithHighPriority:properties isConcatenateArrays:YES];
+        params = (NSMutableDictionary*)[params mergeWithHighPriority:properties isConcatenateArrays:NO];
     }
     
     // Build request
     NSMutableURLRequest* request =
-    [BO createRequestWithURL:[API baseURLappend:wallGet] HTTPMethod:GET params:params headers:nil];
-    return request;
+    [BO createRequestWithURL:[API baseURLappend:APIMethodInfoFor(APIMethod_WallGet)->name] HTTPMethod:GET params:params headers:nil];
+    return [NRC moveParametersToBodyIfNeeded:request];
 }
 
 
@@ -229,13 +507,15 @@
                                                           message:(nullable NSString*)message
                                                       attachments:(nullable NSString*)attachments
 {
-    NSMutableDictionary* properties = [NSMutableDictionary new];
+    NRCBuffer* buffer = NRCBufferWithTemplate([NRC templateForMethod:APIMethod_WallPost]);
+    if (!buffer) return nil;
     
-    properties[@"owner_id"]    = (ownerID.length  > 0) ? ownerID : APIManager.token.userID;
-    properties[@"message"]     = (message.length > 0)  ? message : @"";
-    properties[@"attachments"] = (attachments.length > 0) ? attachments : @"";
+    NRCAppendString(buffer, "owner_id",     (ownerID.length > 0) ? ownerID : APIManager.token.userID);
+    NRCAppendString(buffer, "message",      (message.length > 0) ? message : @"");
+    NRCAppendString(buffer, "attachments",  (attachments.length > 0) ? attachments : @"");
+    NRCAppendString(buffer, "access_token", APIManager.token.access_token);
     
-    return [NRC buildRequestForMethod_WallPost:properties];
+    return NRCRequestFromBuffer(buffer);
 }
 
 
@@ -249,19 +529,19 @@
     // Create a boilerplate initial parameter structure
     NSMutableDictionary* params = [NSMutableDictionary new];
     params[@"owner_id"]     = APIManager.token.userID;
-    params[@"v"]            =  @"5.21";
+    params[@"v"]            =  APIMethodInfoFor(APIMethod_WallPost)->version;
     params[@"access_token"] =  APIManager.token.access_token;
     
     
     // We combine the dictionaries if there is anything at all in the 'properties' of the arguments.
     if ((properties.allKeys.count > 0) || (properties != nil)){
-        params = (NSMutableDictionary*)[params mergeWithHighPriority:properties isConcatenateArrays:YES];
+        params = (NSMutableDictionary*)[params mergeWithHighPriority:properties isConcatenateArrays:NO];
     }
     
     // Build request
     NSMutableURLRequest* request =
-    [BO createRequestWithURL:[API baseURLappend:wallPost] HTTPMethod:GET params:params headers:nil];
-    return request;
+    [BO createRequestWithURL:[API baseURLappend:APIMethodInfoFor(APIMethod_WallPost)->name] HTTPMethod:GET params:params headers:nil];
+    return [NRC moveParametersToBodyIfNeeded:request];
 }
 
 #pragma mark - APIMethod -  photos.getWallUploadServer
@@ -279,10 +559,14 @@
 + (NSMutableURLRequest* _Nullable) buildRequestForMethod_PhotosGetWallUploadServer:(nullable NSString*)userID
                                                                            groupID:(nullable NSString*)groupID
 {
-    NSMutableDictionary* properties = [NSMutableDictionary new];
-    if (userID.length  > 0)  properties[@"user_id"] = userID;
-    if (groupID.length > 0) properties[@"groupID"] = userID;
-    return [NRC buildRequestForMethod_PhotosGetWallUploadServer:properties];
+    NRCBuffer* buffer = NRCBufferWithTemplate([NRC templateForMethod:APIMethod_PhotosGetWallUploadServer]);
+    if (!buffer) return nil;
+    
+    NRCAppendString(buffer, "user_id", (userID.length > 0) ? userID : APIManager.token.userID);
+    if (groupID.length > 0) NRCAppendString(buffer, "group_id", groupID);
+    NRCAppendString(buffer, "access_token", APIManager.token.access_token);
+    
+    return NRCRequestFromBuffer(buffer);
 }
 
 
@@ -291,18 +575,18 @@
     // Create a boilerplate initial parameter structure
     NSMutableDictionary* params = [NSMutableDictionary new];
     params[@"user_id"]      = APIManager.token.userID;
-    params[@"v"]            =  @"5.126";
+    params[@"v"]            =  APIMethodInfoFor(APIMethod_PhotosGetWallUploadServer)->version;
     params[@"access_token"] =  APIManager.token.access_token;
     
     // We combine the dictionaries if there is anything at all in the 'properties' of the arguments.
     if ((properties.allKeys.count > 0) || (properties != nil)){
-        params = (NSMutableDictionary*)[params mergeWithHighPriority:properties isConcatenateArrays:YES];
+        params = (NSMutableDictionary*)[params mergeWithHighPriority:properties isConcatenateArrays:NO];
     }
     
     // Build request
     NSMutableURLRequest* request =
-    [BO createRequestWithURL:[API baseURLappend:photosGetWallUploadServer] HTTPMethod:GET params:params headers:nil];
-    return request;
+    [BO createRequestWithURL:[API baseURLappend:APIMethodInfoFor(APIMethod_PhotosGetWallUploadServer)->name] HTTPMethod:GET params:params headers:nil];
+    return [NRC moveParametersToBodyIfNeeded:request];
 }
 
 
@@ -327,13 +611,15 @@
                                                                offset:(NSInteger)offset
                                                                 count:(NSInteger)count
 {
-    NSMutableDictionary* properties = [NSMutableDictionary new];
+    NRCBuffer* buffer = NRCBufferWithTemplate([NRC templateForMethod:APIMethod_PhotosGetAll]);
+    if (!buffer) return nil;
     
-    properties[@"owner_id"] = (ownerID.length  > 0) ? ownerID  : APIManager.token.userID;
-    properties[@"offset"]   = [NSString stringWithFormat:@"%d",(int)offset];
-    properties[@"count"]    = (count > 0) ? [NSString stringWithFormat:@"%d",(int)count] : @"1";
+    NRCAppendString (buffer, "owner_id",     (ownerID.length > 0) ? ownerID : APIManager.token.userID);
+    NRCAppendInteger(buffer, "offset",       offset);
+    NRCAppendInteger(buffer, "count",        (count > 0) ? count : 1);
+    NRCAppendString (buffer, "access_token", APIManager.token.access_token);
    
-    return [NRC buildRequestForMethod_PhotosGetAll:properties];
+    return NRCRequestFromBuffer(buffer);
 }
 
 
@@ -348,18 +634,18 @@
     params[@"photo_sizes"]  = @(NO);
     params[@"skip_hidden"]  = @(YES);
     
-    params[@"v"]            =  @"5.21";
+    params[@"v"]            =  APIMethodInfoFor(APIMethod_PhotosGetAll)->version;
     params[@"access_token"] =  APIManager.token.access_token;
     
     // We combine the dictionaries if there is anything at all in the 'properties' of the arguments.
     if ((properties.allKeys.count > 0) || (properties != nil)){
-        params = (NSMutableDictionary*)[params mergeWithHighPriority:properties isConcatenateArrays:YES];
+        params = (NSMutableDictionary*)[params mergeWithHighPriority:properties isConcatenateArrays:NO];
     }
     
     // Build request
     NSMutableURLRequest* request =
-    [BO createRequestWithURL:[API baseURLappend:photosGetAll] HTTPMethod:GET params:params headers:nil];
-    return request;
+    [BO createRequestWithURL:[API baseURLappend:APIMethodInfoFor(APIMethod_PhotosGetAll)->name] HTTPMethod:GET params:params headers:nil];
+    return [NRC moveParametersToBodyIfNeeded:request];
 }
 
 
@@ -387,16 +673,19 @@
                                                                       server:(NSInteger)server
                                                                         hash:(NSString*)hash
 {
-    NSMutableDictionary* properties = [NSMutableDictionary new];
+    NRCBuffer* buffer = NRCBufferWithTemplate([NRC templateForMethod:APIMethod_PhotosSaveWallPhoto]);
+    if (!buffer) return nil;
     
-    if (userID.length  > 0) properties[@"user_id"]  = userID;
-    if (groupID.length > 0) properties[@"group_id"] = groupID;
-
-    if (photo.length > 0) properties[@"photo"] = photo;
-    if (hash.length  > 0) properties[@"hash"]  = hash;
-    if (server) properties[@"server"] = @(server);
+    if (userID.length  > 0) NRCAppendString(buffer, "user_id",  userID);
+    if (groupID.length > 0) NRCAppendString(buffer, "group_id", groupID);
+    if ((userID.length < 1) && (groupID.length < 1)) NRCAppendString(buffer, "user_id", APIManager.token.userID);
+
+    if (photo.length > 0) NRCAppendString (buffer, "photo",  photo);
+    if (hash.length  > 0) NRCAppendString (buffer, "hash",   hash);
+    if (server)           NRCAppendInteger(buffer, "server", server);
+    NRCAppendString(buffer, "access_token", APIManager.token.access_token);
     
-    return [NRC buildRequestForMethod_PhotosSaveWallPhoto:properties];
+    return NRCRequestFromBuffer(buffer);
 }
 
 
@@ -408,18 +697,18 @@
     if (!properties[@"user_id"] && !properties[@"group_id"]){
          params[@"user_id"] = APIManager.token.userID;
     }
-    params[@"v"]            =  @"5.126";
+    params[@"v"]            =  APIMethodInfoFor(APIMethod_PhotosSaveWallPhoto)->version;
     params[@"access_token"] =  APIManager.token.access_token;
     
     // We combine the dictionaries if there is anything at all in the 'properties' of the arguments.
     if ((properties.allKeys.count > 0) || (properties != nil)){
-        params = (NSMutableDictionary*)[params mergeWithHighPriority:properties isConcatenateArrays:YES];
+        params = (NSMutableDictionary*)[params mergeWithHighPriority:properties isConcatenateArrays:NO];
     }
     
     // Build request
     NSMutableURLRequest* request =
-    [BO createRequestWithURL:[API baseURLappend:photosSaveWallPhoto] HTTPMethod:GET params:params headers:nil];
-    return request;
+    [BO createRequestWithURL:[API baseURLappend:APIMethodInfoFor(APIMethod_PhotosSaveWallPhoto)->name] HTTPMethod:GET params:params headers:nil];
+    return [NRC moveParametersToBodyIfNeeded:request];
 }
 
 
@@ -449,12 +738,17 @@
                                                               count:(NSInteger)count
                                                              offset:(NSInteger)offset
 {
-    NSMutableDictionary* properties = [NSMutableDictionary new];
+    NRCRequestTemplate* requestTemplate = [NRC templateForMethod:APIMethod_FriendsGet];
+    NRCBuffer* buffer = NRCBufferWithTemplate(requestTemplate);
+    if (!buffer) return nil;
     
-    properties[@"user_id"] = (ownerID.length  > 0) ? ownerID  : APIManager.token.userID;
-    properties[@"offset"]  = [NSString stringWithFormat:@"%d",(int)offset];
-    properties[@"count"]   = (count > 0) ? [NSString stringWithFormat:@"%d",(int)count] : @"1";
-    return [NRC buildRequestForMethod_FriendsGet:properties];
+    NRCAppendString (buffer, "user_id",      (ownerID.length > 0) ? ownerID : APIManager.token.userID);
+    NRCAppendInteger(buffer, "offset",       offset);
+    NRCAppendInteger(buffer, "count",        (count > 0) ? count : 1);
+    NRCAppendString (buffer, "order",        (order.length > 0) ? order : @"hints");
+    NRCAppendList   (buffer, "fields",       NRCFieldsForMethod(APIMethod_FriendsGet, fields, requestTemplate.defaultFields), nil);
+    NRCAppendString (buffer, "access_token", APIManager.token.access_token);
+    return NRCRequestFromBuffer(buffer);
 }
 
 
@@ -467,21 +761,21 @@
     params[@"count"]   = @"1";
     
     params[@"order"]   = @"hints";
-    params[@"fields"]  = @[@"photo_50",@"photo_100"];
+    params[@"fields"]  = NRCFieldsForMethod(APIMethod_FriendsGet, nil, APIMethodDefaultFields(APIMethod_FriendsGet));
     
     params[@"name_case"]    =  @"nom";
-    params[@"v"]            =  @"5.21";
+    params[@"v"]            =  APIMethodInfoFor(APIMethod_FriendsGet)->version;
     params[@"access_token"] =  APIManager.token.access_token;
     
     // We combine the dictionaries if there is anything at all in the 'properties' of the arguments.
     if ((properties.allKeys.count > 0) || (properties != nil)){
-        params = (NSMutableDictionary*)[params mergeWithHighPriority:properties isConcatenateArrays:YES];
+        params = (NSMutableDictionary*)[params mergeWithHighPriority:properties isConcatenateArrays:NO];
     }
     
     // We form a request
     NSMutableURLRequest* request =
-    [BO createRequestWithURL:[API baseURLappend:friendsGet] HTTPMethod:GET params:params headers:nil];
-    return request;
+    [BO createRequestWithURL:[API baseURLappend:APIMethodInfoFor(APIMethod_FriendsGet)->name] HTTPMethod:GET params:params headers:nil];
+    return [NRC moveParametersToBodyIfNeeded:request];
 }
 
 #pragma mark - Another methods
@@ -508,10 +802,78 @@
     urlComponents.queryItems = @[[NSURLQueryItem queryItemWithName:@"access_token" value:APIManager.token.access_token],
                                  [NSURLQueryItem queryItemWithName:@"client_id" value:@"7531597"],
                                  [NSURLQueryItem queryItemWithName:@"revoke"    value:@"1"],
-                                 [NSURLQueryItem queryItemWithName:@"v"         value:@"5.52"]];
+                                 [NSURLQueryItem queryItemWithName:@"v"         value:APIMethodInfoFor(APIMethod_Logout)->version]];
     
     return [NSURLRequest requestWithURL:urlComponents.URL].mutableCopy;
 }
 
+/*--------------------------------------------------------------------------------------------------------------
+ [Internal method] The form with the dictionary for 'buildRequestForMethod:properties:'. 'properties' are ignored.
+ --------------------------------------------------------------------------------------------------------------*/
++ (NSMutableURLRequest*) buildRequestForMethod_logout:(nullable NSDictionary<NSString*,id>*)properties
+{
+    return [NRC buildRequestForMethod_logout];
+}
+
+
+#pragma mark - Benchmark
+
+#if DEBUG
+/*--------------------------------------------------------------------------------------------------------------
+ Measures one way of building the request. 'blocks' - how many memory blocks stay alive per request until the
+ autorelease pool is drained (temporary objects freed earlier are not counted, so it is the lower estimate).
+ --------------------------------------------------------------------------------------------------------------*/
+static void NRCMeasure(NSString* name, NSUInteger iterations, void(^build)(void))
+{
+    build(); // The template and the buffer are created before the measurement
+
+    malloc_statistics_t before, after;
+    CFAbsoluteTime elapsed = 0;
+    @autoreleasepool {
+        malloc_zone_statistics(NULL, &before);
+        CFAbsoluteTime start = CFAbsoluteTimeGetCurrent();
+        for (NSUInteger i = 0; i < iterations; i++) build();
+        elapsed = CFAbsoluteTimeGetCurrent() - start;
+        malloc_zone_statistics(NULL, &after);
+    }
+
+    double blocks = ((double)after.blocks_in_use - (double)before.blocks_in_use) / iterations;
+    double bytes  = ((double)after.size_in_use   - (double)before.size_in_use)   / iterations;
+    APILog(@"%@: %.2f µs per request | %.1f blocks (%.0f bytes) per request", name, elapsed * 1e6 / iterations, blocks, bytes);
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ Compares building through the dictionaries of parameters with building through the compiled templates.
+ --------------------------------------------------------------------------------------------------------------*/
++ (void) benchmarkRequestBuilding:(NSUInteger)iterations
+{
+    iterations = MAX(1, iterations);
+    NSArray<NSString*>* userIDs = @[@"155510513"];
+
+    NRCMeasure(@"users.get (dictionary)", iterations, ^{
+        NSMutableDictionary* properties = [NSMutableDictionary new];
+        properties[@"user_ids"]  = userIDs;
+        properties[@"fields"]    = @[@"photo_50",@"photo_100",@"photo_200",@"online",@"last_seen",@"counters",@"city",@"country",@"home_town"];
+        properties[@"name_case"] = @"Nom";
+        [NRC buildRequestForMethod_UsersGet:properties];
+    });
+    NRCMeasure(@"users.get (template)  ", iterations, ^{
+        [NRC buildRequestForMethod_UsersGet:userIDs fields:nil nameCase:nil];
+    });
+
+    NRCMeasure(@"wall.get  (dictionary)", iterations, ^{
+        NSMutableDictionary* properties = [NSMutableDictionary new];
+        properties[@"owner_id"] = userIDs.firstObject;
+        properties[@"offset"]   = [NSString stringWithFormat:@"%d",20];
+        properties[@"count"]    = [NSString stringWithFormat:@"%d",10];
+        properties[@"filter"]   = @"all";
+        [NRC buildRequestForMethod_WallGet:properties];
+    });
+    NRCMeasure(@"wall.get  (template)  ", iterations, ^{
+        [NRC buildRequestForMethod_WallGet:userIDs.firstObject offset:20 count:10 filter:nil];
+    });
+}
+#endif
+
 
 @end
@@ -9,6 +9,8 @@
 #import <Foundation/Foundation.h>
 #import "APIMethods.h"
 
+@class TemplaterWarmUpReport;
+
 
 NS_ASSUME_NONNULL_BEGIN
 
@@ -43,9 +45,28 @@ NS_ASSUME_NONNULL_BEGIN
  which will unzip the folder to the desired directory (by default in 'pathToTemplateDirectory').
  
  In the subsequent use of the application, you get json files from disk, and also modify them.
+ 
+ (⚠️) Templates are read concurrently. Writing, removal and moving of the folder run with barriers:
+      they wait for the current readers.
+ (⚠️) Without a warm-up the first response of each API method reads and parses its template from disk.
+      +warmUpTemplates: does this for all API methods in the background right after the launch.
+ (⚠️) If the bundle of the application contains 'APIManagerResponseDefaultTemplates.templates' (see 'TemplaterBundle'),
+      the templates which are not on disk are decoded from it, and the archive is not unzipped.
+ (⚠️) The archive itself is not unpacked either: templates which are not on disk are read from its entries
+      (see 'TemplaterArchive'). Only the templates changed by the application are stored on disk.
+ (⚠️) While 'watchesTemplateDirectory' is 'YES', json files added, replaced or removed in the folder by anyone
+      are noticed: only their templates are read again, and 'Validator' compiles new plans for them.
  --------------------------------------------------------------------------------------------------------------*/
 
 
+/*--------------------------------------------------------------------------------------------------------------
+ Posted on the main thread when +warmUpTemplates: has finished.
+ 'userInfo[TemplaterWarmUpReportKey]' contains 'TemplaterWarmUpReport'.
+ --------------------------------------------------------------------------------------------------------------*/
+extern NSNotificationName const TemplaterDidWarmUpTemplatesNotification;
+extern NSString* const TemplaterWarmUpReportKey;
+
+
 @interface Templater : NSObject
 
 /*--------------------------------------------------------------------------------------------------------------
@@ -60,6 +81,30 @@ NS_ASSUME_NONNULL_BEGIN
  --------------------------------------------------------------------------------------------------------------*/
 @property (nonatomic, assign, class) BOOL loadTemplateFromBundle;
 
+/*--------------------------------------------------------------------------------------------------------------
+ 'YES' after the first pass of +warmUpTemplates: has finished. Since then the first responses do not wait
+ for reading of the templates from disk.
+ --------------------------------------------------------------------------------------------------------------*/
+@property (atomic, readonly, assign, class) BOOL areTemplatesWarmedUp;
+
+/*--------------------------------------------------------------------------------------------------------------
+ SHA-256 of the compiled default templates in the bundle of the application. Changes with any template,
+ so it is the version of the default templates. nil if the bundle does not contain the compiled file.
+ When it changes, +unarchiveFolderWithDefaultTemplates: removes the copies on disk unpacked from the previous version.
+ --------------------------------------------------------------------------------------------------------------*/
+@property (nonatomic, readonly, copy, class, nullable) NSString* defaultTemplatesHash;
+
+/*--------------------------------------------------------------------------------------------------------------
+ 'YES' - the folder with templates is watched by a dispatch source. When json files of the folder are added,
+ replaced or removed (by a file manager, a debug tool, another process), only their templates are removed
+ from RAM, and those that were in RAM are read again. The other templates and their validation plans are kept.
+ Default is 'NO'. Debug builds turn it on in 'prepareAPIManagerBeforeUsing:' when the warm-up has finished.
+ (⚠️) Turning on takes a snapshot of the files of the folder: do it off the main thread.
+ (⚠️) The source reports changes of the folder. A file changed in place, without replacing it,
+      is noticed with the next change of the folder.
+ --------------------------------------------------------------------------------------------------------------*/
+@property (nonatomic, assign, class) BOOL watchesTemplateDirectory;
+
 #pragma mark - Methods
 
 /*--------------------------------------------------------------------------------------------------------------
@@ -87,16 +132,61 @@ NS_ASSUME_NONNULL_BEGIN
  --------------------------------------------------------------------------------------------------------------*/
 + (nullable NSError*) removeAllTemplates;
 
+/*--------------------------------------------------------------------------------------------------------------
+ Loads the templates of all API methods whose answers are validated into RAM. The templates are read and parsed
+ concurrently on background threads. Templates which are already in RAM are not read again.
+ Called from 'prepareAPIManagerBeforeUsing:' and after the archive with default templates is unzipped.
+ When the pass is finished, 'areTemplatesWarmedUp' becomes 'YES', 'completion' is called on the main thread
+ and 'TemplaterDidWarmUpTemplatesNotification' is posted.
+ --------------------------------------------------------------------------------------------------------------*/
++ (void) warmUpTemplates:(nullable void(^)(TemplaterWarmUpReport* report))completion;
+
 
 /*--------------------------------------------------------------------------------------------------------------
- The method unpacks an archive with a folder of standard json files (responses from the server).
- If you specify nil in the 'atPath' argument, then the algorithm will automatically unzip the folder to the 'Templater.pathToTemplateDirectory' path.
- You can call this method every time you start the application inside the +APIManager.prepareBeforeUsing: method,
- inside built-in protection against repeated unzipping.
+ Prepares the default templates from the bundle of the application: the compiled
+ 'APIManagerResponseDefaultTemplates.templates' or, if there is none, 'APIManagerResponseDefaultTemplates.zip'.
+ Neither is unpacked: templates are read from them on demand. When the default templates were changed by
+ an update of the application ('contentHash' of the compiled file or the CRC-32 of the entries of the archive),
+ a copy on disk of a changed template is removed, if the copy was not changed since it was unpacked.
+ If you specify a path in the 'atPath' argument, the folder with templates is moved there.
+ You can call this method every time you start the application inside the +APIManager.prepareBeforeUsing: method.
  --------------------------------------------------------------------------------------------------------------*/
 + (void) unarchiveFolderWithDefaultTemplates:(nullable NSString*)atPath
                                   completion:(nullable void(^)(NSError* error))completion;
 
+
+#pragma mark - Benchmark
+
+#if DEBUG
+/*--------------------------------------------------------------------------------------------------------------
+ Looks up templates from RAM 'iterations' times on 1, 2, 4 and 8 threads through a serial queue and through
+ the concurrent queue of 'Templater'. Prints the lookups per second to the console.
+ --------------------------------------------------------------------------------------------------------------*/
++ (void) benchmarkTemplateLookup:(NSUInteger)iterations;
+#endif
+
+@end
+
+
+
+/*--------------------------------------------------------------------------------------------------------------
+ Report of one pass of +warmUpTemplates:.
+ --------------------------------------------------------------------------------------------------------------*/
+@interface TemplaterWarmUpReport : NSObject
+
+// Time of the whole pass: from the call to the last parsed template
+@property (nonatomic, readonly, assign) NSTimeInterval duration;
+
+// API methods whose templates are in RAM after the pass
+@property (nonatomic, readonly, copy) NSArray<NSNumber*>* loadedMethods;
+
+// API methods without a template or with an invalid json file
+@property (nonatomic, readonly, copy) NSArray<NSNumber*>* missingMethods;
+
+// Time of reading and parsing of each template by the name of the API method.
+// For templates which were already in RAM it is close to zero
+@property (nonatomic, readonly, copy) NSDictionary<NSString*,NSNumber*>* durationByMethod;
+
 @end
 
 NS_ASSUME_NONNULL_END
@@ -10,15 +10,30 @@
 // APIManager's Categories
 #import "APIManager+Utilites.h"
 
+// Other Network layer components
+#import "APIMethodRegistry.h"
+
 // Own Categories
 #import "TemplaterFileManager.h"
+#import "TemplaterBundle.h"
+#import "TemplaterArchive.h"
 
-// Thrid-party frameworks
-#import <RXZipArchive/RXZipArchive.h>
+// System
+#import <zlib.h>
 
 // Ключи для NSUserDefualt
 static NSString *const templateDirectoryUserDefaultKey   = @"templateDirectoryUserDefaultKey";
+static NSString *const defaultTemplateHashesUserDefaultKey = @"defaultTemplateHashesUserDefaultKey";
+// The version of the compiled default templates whose copies were checked last
+static NSString *const defaultTemplatesContentHashUserDefaultKey = @"defaultTemplatesContentHashUserDefaultKey";
+// Set by the versions which unpacked the whole archive once. Read only to remove their copies
 static NSString *const wasArchiveExtractedUserDefaultKey = @"wasArchiveExtractedUserDefaultKey";
+// A copy on disk is treated as unpacked by those versions if it was not changed later than this after the folder
+// with templates was created
+static const NSTimeInterval legacyExtractionInterval = 60;
+
+NSNotificationName const TemplaterDidWarmUpTemplatesNotification = @"TemplaterDidWarmUpTemplatesNotification";
+NSString* const TemplaterWarmUpReportKey = @"TemplaterWarmUpReportKey";
 
 
 /*--------------------------------------------------------------------------------------------------------------
@@ -72,24 +87,66 @@ static NSString *const wasArchiveExtractedUserDefaultKey = @"wasArchiveExtracted
 @property (atomic, strong, class) NSMutableDictionary<NSString*,NSDictionary*>* templates;
 
 /*--------------------------------------------------------------------------------------------------------------
- Serial queue that does not allow changes to the value in property 'pathToTemplateDirectory'
- and then moving the folder with templates to another directory.
- The methods listed below execute their code inside the block that is inserted into this queue.
+ Concurrent queue of the templates. Reading runs concurrently, so the responses validated in parallel do not wait
+ for each other. The methods that change the templates or their folder run with barriers: they wait for
+ the current readers, and no reader runs until they finish.
  
- +templateForAPIMethod:
- +writeTemplate:forAPIMethod:
- +removeTemplateForAPIMethod:
- +removeAllTemplates:
+ +templateForAPIMethod:           - dispatch_sync
+ +writeTemplate:forAPIMethod:     - dispatch_barrier_sync
+ +removeTemplateForAPIMethod:     - dispatch_barrier_sync
+ +removeAllTemplates              - dispatch_barrier_sync
+ +setNewPathToTemplateDirectory:  - dispatch_barrier_sync
+ +setWatchesTemplateDirectory:    - dispatch_barrier_sync
+ Events of the folder             - dispatch_barrier_sync
+ --------------------------------------------------------------------------------------------------------------*/
+@property (nonatomic, readonly, strong, class) dispatch_queue_t templatesQueue;
+
+/*--------------------------------------------------------------------------------------------------------------
+ Compiled default templates from 'APIManagerResponseDefaultTemplates.templates' in the bundle of the application.
+ Mapped once, on the first request. Used for the templates which are not on disk.
+ --------------------------------------------------------------------------------------------------------------*/
+@property (nonatomic, readonly, strong, class, nullable) TemplaterBundle* defaultTemplates;
+
+/*--------------------------------------------------------------------------------------------------------------
+ 'APIManagerResponseDefaultTemplates.zip' from the bundle of the application. Opened once, on the first request.
+ Used for the templates which are neither on disk nor in the compiled default templates.
  --------------------------------------------------------------------------------------------------------------*/
-@property (nonatomic, strong, class) dispatch_queue_t serialDispatchQueue;
+@property (nonatomic, readonly, strong, class, nullable) TemplaterArchive* defaultArchive;
 
 @end
 
 
+@interface TemplaterWarmUpReport ()
+@property (nonatomic, readwrite, assign) NSTimeInterval duration;
+@property (nonatomic, readwrite, copy) NSArray<NSNumber*>* loadedMethods;
+@property (nonatomic, readwrite, copy) NSArray<NSNumber*>* missingMethods;
+@property (nonatomic, readwrite, copy) NSDictionary<NSString*,NSNumber*>* durationByMethod;
+@end
+
+
 static NSMutableDictionary *_templates               = nil;
 static NSString            *_pathToTemplateDirectory = nil;
-static dispatch_queue_t     _serialDispatchQueue     = nil;
+static dispatch_queue_t     _templatesQueue          = nil;
 static BOOL                 _loadTemplateFromBundle  = NO;
+static BOOL                 _areTemplatesWarmedUp    = NO;
+
+// Changed with a barrier by each write, removal and relocation. A template read from disk before the change
+// is not put into RAM after it
+static NSUInteger           _templatesGeneration     = 0;
+
+// Watching of the folder. Changed only with barriers of 'templatesQueue'
+static dispatch_source_t    _directorySource         = nil;
+// Modification date and size of each json file of the folder at the last check, by the name of the API method
+static NSMutableDictionary<NSString*,NSString*>* _templateFileStamps = nil;
+
+/*--------------------------------------------------------------------------------------------------------------
+ Modification date and size of the file. Changes when the file is replaced or rewritten.
+ --------------------------------------------------------------------------------------------------------------*/
+static NSString* TemplaterFileStamp(NSURL* url)
+{
+    NSDictionary<NSURLResourceKey,id>* values = [url resourceValuesForKeys:@[NSURLContentModificationDateKey, NSURLFileSizeKey] error:nil];
+    return [NSString stringWithFormat:@"%f-%@",[values[NSURLContentModificationDateKey] timeIntervalSinceReferenceDate],values[NSURLFileSizeKey]];
+}
 
 @implementation Templater
 
@@ -109,50 +166,82 @@ static BOOL                 _loadTemplateFromBundle  = NO;
 
 /*--------------------------------------------------------------------------------------------------------------
 Recovers a previously written json file from disk or returns it from RAM memory.
+ Templates from RAM are returned by concurrent readers. A template read from disk is put into RAM with a barrier.
  --------------------------------------------------------------------------------------------------------------*/
 + (nullable NSDictionary*) templateForAPIMethod:(APIMethod)method
 {
-    __block NSDictionary* template = nil;
+    if (method == APIMethod_Unknow){
+        return nil;
+    }
+    NSString* apiMethod = [APIManager convertAPIMethodToString:method];
     
-    dispatch_sync(self.serialDispatchQueue, ^{
-
-        if (method == APIMethod_Unknow){
-            return;
-        }
-        NSString* apiMethod = [APIManager convertAPIMethodToString:method];
-
-        // If the template was previously initialized from disk, then we try to get it from RAM
-           template = self.templates[apiMethod];
-        if (template) return;
+    __block NSDictionary* template   = nil;
+    __block NSUInteger    generation = 0;
+    __block BOOL          isCached   = NO;
+    
+    dispatch_sync(self.templatesQueue, ^{
         
-        NSData* data =  nil;
-       
-        if (self.loadTemplateFromBundle){
-            // Load from Bundle
-            NSString *localPathBundle = [[NSBundle mainBundle] pathForResource:apiMethod ofType:@"json"];
-            data = [NSData dataWithContentsOfFile:localPathBundle];
-        } else {
-           //  Load from disk
-            NSString* localPath = [NSString stringWithFormat:@"%@/%@.json",self.pathToTemplateDirectory,apiMethod];
-           data = [NSData dataWithContentsOfFile:localPath];
-        }
+        // If the template was previously initialized from disk, then we try to get it from RAM
+        template = self.templates[apiMethod];
+        isCached = (template != nil);
+        if (isCached) return;
         
-        if (!data) return;
+        generation = _templatesGeneration;
+        template   = [self loadTemplateForAPIMethod:apiMethod];
+    });
+    if ((isCached) || (!template)) return template;
+    
+    // put in RAM memory.
+    // If another reader has already put the template, its instance is returned, so all callers share one instance
+    dispatch_barrier_sync(self.templatesQueue, ^{
         
-        NSError* error;
-        template = [NSJSONSerialization JSONObjectWithData:data options:kNilOptions error:&error];
-        if (error){
-            NSLog(@"+templateForAPIMethod recovered invalid error from disk. By APIMethod(%@)| error: %@",apiMethod,error);
-        }
-        // put in RAM memory
-        if ((template) && (!error)){
-            [self.templates setObject:template forKey:apiMethod];
+        NSDictionary* cachedTemplate = self.templates[apiMethod];
+        if (cachedTemplate){
+            template = cachedTemplate;
+        } else if (generation == _templatesGeneration){
+            self.templates[apiMethod] = template;
         }
     });
     return template;
 }
 
 
+/*--------------------------------------------------------------------------------------------------------------
+ Reads the json file of the template from the bundle or from disk. If there is no file, the template is decoded
+ from the compiled default templates or read from the entry of the default archive.
+ Called inside 'templatesQueue', so the folder with templates is not moved while the file is read.
+ --------------------------------------------------------------------------------------------------------------*/
++ (nullable NSDictionary*) loadTemplateForAPIMethod:(NSString*)apiMethod
+{
+    NSData* data = nil;
+    
+    if (self.loadTemplateFromBundle){
+        // Load from Bundle
+        NSString *localPathBundle = [[NSBundle mainBundle] pathForResource:apiMethod ofType:@"json"];
+        data = [NSData dataWithContentsOfFile:localPathBundle];
+    } else {
+        //  Load from disk
+        NSString* localPath = [NSString stringWithFormat:@"%@/%@.json",self.pathToTemplateDirectory,apiMethod];
+        data = [NSData dataWithContentsOfFile:localPath];
+    }
+    
+    // Templates written to disk take precedence over the compiled ones, so they can still be changed dynamically
+    if ((!data) && (self.defaultTemplates)) return [self.defaultTemplates templateForAPIMethod:apiMethod];
+    
+    // Default templates are read straight from the archive of the bundle, without unpacking it
+    if (!data) data = [self.defaultArchive dataForAPIMethod:apiMethod];
+    if (!data) return nil;
+    
+    NSError* error;
+    NSDictionary* template = [NSJSONSerialization JSONObjectWithData:data options:kNilOptions error:&error];
+    if (error){
+        NSLog(@"+templateForAPIMethod recovered invalid error from disk. By APIMethod(%@)| error: %@",apiMethod,error);
+        return nil;
+    }
+    return template;
+}
+
+
 /*--------------------------------------------------------------------------------------------------------------
    Writes a sample file named method API
  --------------------------------------------------------------------------------------------------------------*/
@@ -160,7 +249,7 @@ Recovers a previously written json file from disk or returns it from RAM memory.
 {
     __block NSError* error = nil;
 
-    dispatch_sync(self.serialDispatchQueue, ^{
+    dispatch_barrier_sync(self.templatesQueue, ^{
 
         if ((method == APIMethod_Unknow) || (template.allKeys.count < 1)){
             error = [NSError errorWithDomain:@"template or apiMethod in +writeTemplate:forAPIMethod: is incorrect" code:0 userInfo:nil];
@@ -177,12 +266,14 @@ Recovers a previously written json file from disk or returns it from RAM memory.
         NSString* localPath = [NSString stringWithFormat:@"%@/%@.json",self.pathToTemplateDirectory,apiMethod];
 
         [jsonData writeToFile:localPath atomically:YES];
+        _templatesGeneration++;
         
+        // The own write is not reported as an external change of the folder
+        _templateFileStamps[apiMethod] = TemplaterFileStamp([NSURL fileURLWithPath:localPath]);
  
-        // If a sample was already stored by the 'apiMethod' key in the 'templates' dictionary, then it needs to be updated
-        if (self.templates[apiMethod]){
-            self.templates[apiMethod] = template;
-        }
+        // RAM gets exactly what was written, as a new instance: the caller may change its dictionary later,
+        // and 'Validator' compiles a new plan for the new instance
+        self.templates[apiMethod] = [NSJSONSerialization JSONObjectWithData:jsonData options:kNilOptions error:nil];
     });
     return error;
 }
@@ -195,7 +286,7 @@ Removes sample file from disk and from RAM by method API name
 {
     __block NSError* error = nil;
 
-    dispatch_sync(self.serialDispatchQueue, ^{
+    dispatch_barrier_sync(self.templatesQueue, ^{
         
         if (method == APIMethod_Unknow){
             error = [NSError errorWithDomain:@"apiMethod in +removeTemplateForAPIMethod: is incorrect" code:0 userInfo:nil];
@@ -206,9 +297,11 @@ Removes sample file from disk and from RAM by method API name
         // Remove from disk
         NSString* localPath = [NSString stringWithFormat:@"%@/%@.json",self.pathToTemplateDirectory,apiMethod];
         [TemplaterFileManager removeItemAtPath:localPath error:&error];
+        _templatesGeneration++;
 
         // Remove from RAM
         [self.templates removeObjectForKey:apiMethod];
+        [_templateFileStamps removeObjectForKey:apiMethod];
     });
     return error;
 }
@@ -220,13 +313,197 @@ Removes sample file from disk and from RAM by method API name
 + (nullable NSError*) removeAllTemplates
 {
     __block NSError* error = nil;
-    dispatch_sync(self.serialDispatchQueue, ^{
+    dispatch_barrier_sync(self.templatesQueue, ^{
         [TemplaterFileManager removeItemAtPath:self.pathToTemplateDirectory error:&error];
+        _templatesGeneration++;
     });
     return error;
 }
 
 
+#pragma mark - Warm-up
+
+/*--------------------------------------------------------------------------------------------------------------
+ Loads the templates of all API methods whose answers are validated into RAM, concurrently on background threads.
+ Each template goes through +templateForAPIMethod:, so the readers share 'templatesQueue' and the parsed
+ templates are put into RAM with barriers.
+ --------------------------------------------------------------------------------------------------------------*/
++ (void) warmUpTemplates:(nullable void(^)(TemplaterWarmUpReport* report))completion
+{
+    // Templates are needed only by the API methods which have a validation method
+    NSMutableArray<NSNumber*>* methods = [NSMutableArray new];
+    for (APIMethod method = APIMethod_UserGet; method <= APIMethod_Logout; method++){
+        if (APIMethodResponseValidator(method)) [methods addObject:@(method)];
+    }
+    
+    dispatch_queue_t workers = dispatch_get_global_queue(QOS_CLASS_UTILITY, 0);
+    dispatch_async(workers, ^{
+        NSUInteger      count     = methods.count;
+        BOOL*           loaded    = calloc(count, sizeof(BOOL));
+        CFAbsoluteTime* durations = calloc(count, sizeof(CFAbsoluteTime));
+        CFAbsoluteTime  start     = CFAbsoluteTimeGetCurrent();
+        
+        // Each template is read and parsed on its own worker. The results are written to their own cells
+        dispatch_apply(count, workers, ^(size_t i){
+            @autoreleasepool {
+                CFAbsoluteTime methodStart = CFAbsoluteTimeGetCurrent();
+                loaded[i]    = ([self templateForAPIMethod:methods[i].integerValue] != nil);
+                durations[i] = CFAbsoluteTimeGetCurrent() - methodStart;
+            }
+        });
+        
+        TemplaterWarmUpReport* report = [TemplaterWarmUpReport new];
+        report.duration = CFAbsoluteTimeGetCurrent() - start;
+        
+        NSMutableArray<NSNumber*>*               loadedMethods    = [NSMutableArray new];
+        NSMutableArray<NSNumber*>*               missingMethods   = [NSMutableArray new];
+        NSMutableDictionary<NSString*,NSNumber*>* durationByMethod = [NSMutableDictionary new];
+        for (NSUInteger i = 0; i < count; i++){
+            [(loaded[i] ? loadedMethods : missingMethods) addObject:methods[i]];
+            durationByMethod[[APIManager convertAPIMethodToString:methods[i].integerValue]] = @(durations[i]);
+        }
+        free(loaded);
+        free(durations);
+        
+        report.loadedMethods    = loadedMethods;
+        report.missingMethods   = missingMethods;
+        report.durationByMethod = durationByMethod;
+        
+        @synchronized (self) {
+            _areTemplatesWarmedUp = YES;
+        }
+        APILog(@"%@", report);
+        
+        dispatch_async(dispatch_get_main_queue(), ^{
+            if (completion) completion(report);
+            [[NSNotificationCenter defaultCenter] postNotificationName:TemplaterDidWarmUpTemplatesNotification
+                                                                object:nil
+                                                              userInfo:@{TemplaterWarmUpReportKey : report}];
+        });
+    });
+}
+
+
+#pragma mark - Watching
+
+/*--------------------------------------------------------------------------------------------------------------
+ Returns the stamps of all json files of the folder. The attributes are fetched together with the list of files.
+ --------------------------------------------------------------------------------------------------------------*/
++ (NSMutableDictionary<NSString*,NSString*>*) templateFileStamps
+{
+    NSArray<NSURLResourceKey>* keys = @[NSURLContentModificationDateKey, NSURLFileSizeKey];
+    NSArray<NSURL*>* files = [[NSFileManager defaultManager] contentsOfDirectoryAtURL:[NSURL fileURLWithPath:self.pathToTemplateDirectory]
+                                                           includingPropertiesForKeys:keys
+                                                                              options:NSDirectoryEnumerationSkipsHiddenFiles
+                                                                                error:nil];
+    NSMutableDictionary<NSString*,NSString*>* stamps = [NSMutableDictionary dictionaryWithCapacity:files.count];
+    for (NSURL* file in files)
+    {
+        if (![file.pathExtension isEqualToString:@"json"]) continue;
+        stamps[file.lastPathComponent.stringByDeletingPathExtension] = TemplaterFileStamp(file);
+    }
+    return stamps;
+}
+
+
+/*--------------------------------------------------------------------------------------------------------------
+ @property (nonatomic, assign, class) BOOL watchesTemplateDirectory;
+ Turning on takes the first snapshot of the files of the folder. Turning off cancels the source.
+ --------------------------------------------------------------------------------------------------------------*/
++ (BOOL)watchesTemplateDirectory
+{
+    __block BOOL watches = NO;
+    dispatch_sync(self.templatesQueue, ^{
+        watches = (_directorySource != nil);
+    });
+    return watches;
+}
+
++ (void)setWatchesTemplateDirectory:(BOOL)watchesTemplateDirectory
+{
+    dispatch_barrier_sync(self.templatesQueue, ^{
+        if (watchesTemplateDirectory == (_directorySource != nil)) return;
+        
+        if (watchesTemplateDirectory){
+            _templateFileStamps = [self templateFileStamps];
+            [self startWatchingTemplateDirectory];
+        } else {
+            dispatch_source_cancel(_directorySource);
+            _directorySource    = nil;
+            _templateFileStamps = nil;
+        }
+    });
+}
+
+
+/*--------------------------------------------------------------------------------------------------------------
+ Opens the folder for events and creates a dispatch source for it. The previous source is cancelled.
+ Called inside a barrier of 'templatesQueue'.
+ --------------------------------------------------------------------------------------------------------------*/
++ (void) startWatchingTemplateDirectory
+{
+    if (_directorySource) dispatch_source_cancel(_directorySource);
+    _directorySource = nil;
+    
+    NSString* path = self.pathToTemplateDirectory;
+    int descriptor = open(path.fileSystemRepresentation, O_EVTONLY);
+    if (descriptor < 0){
+        NSLog(@"+startWatchingTemplateDirectory can't open the folder: %@",path);
+        return;
+    }
+    
+    unsigned long events = DISPATCH_VNODE_WRITE | DISPATCH_VNODE_DELETE | DISPATCH_VNODE_RENAME;
+    dispatch_source_t source = dispatch_source_create(DISPATCH_SOURCE_TYPE_VNODE, descriptor, events,
+                                                      dispatch_get_global_queue(QOS_CLASS_UTILITY, 0));
+    dispatch_source_set_event_handler(source, ^{
+        [self reloadChangedTemplates:dispatch_source_get_data(source)];
+    });
+    dispatch_source_set_cancel_handler(source, ^{
+        close(descriptor);
+    });
+    _directorySource = source;
+    dispatch_resume(source);
+}
+
+
+/*--------------------------------------------------------------------------------------------------------------
+ Compares the files of the folder with the previous check. The templates of the added, replaced and removed
+ files are removed from RAM, and those that were in RAM are read again. The validation plans of the old instances
+ are released together with them (the cache of 'Validator' holds the templates weakly).
+ --------------------------------------------------------------------------------------------------------------*/
++ (void) reloadChangedTemplates:(unsigned long)events
+{
+    dispatch_barrier_sync(self.templatesQueue, ^{
+        if (!_directorySource) return;
+        
+        // The folder itself was removed or moved: the folder at 'pathToTemplateDirectory' is watched anew
+        if (events & (DISPATCH_VNODE_DELETE | DISPATCH_VNODE_RENAME)){
+            [self startWatchingTemplateDirectory];
+        }
+        
+        NSMutableDictionary<NSString*,NSString*>* stamps = [self templateFileStamps];
+        NSMutableSet<NSString*>* changed = [NSMutableSet new];
+        for (NSString* apiMethod in stamps){
+            if (![stamps[apiMethod] isEqualToString:_templateFileStamps[apiMethod]]) [changed addObject:apiMethod];
+        }
+        for (NSString* apiMethod in _templateFileStamps){
+            if (!stamps[apiMethod]) [changed addObject:apiMethod];
+        }
+        _templateFileStamps = stamps;
+        if (changed.count < 1) return;
+        
+        _templatesGeneration++;
+        for (NSString* apiMethod in changed)
+        {
+            BOOL wasInRAM = (self.templates[apiMethod] != nil);
+            [self.templates removeObjectForKey:apiMethod];
+            if (wasInRAM) self.templates[apiMethod] = [self loadTemplateForAPIMethod:apiMethod];
+        }
+        APILog(@"Templates changed on disk: %@",changed.allObjects);
+    });
+}
+
+
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 /*
@@ -307,19 +584,73 @@ Removes sample file from disk and from RAM by method API name
 
 
 /*--------------------------------------------------------------------------------------------------------------
- @property (nonatomic, strong, class) dispatch_queue_t serialDispatchQueue;
+ @property (atomic, readonly, assign, class) BOOL areTemplatesWarmedUp;
  --------------------------------------------------------------------------------------------------------------*/
-+ (dispatch_queue_t)serialDispatchQueue
++ (BOOL)areTemplatesWarmedUp
 {
-    if (!_serialDispatchQueue){
-         _serialDispatchQueue = dispatch_queue_create("Templater.serial.aSyncQueue", NULL);
+    @synchronized (self) {
+        return _areTemplatesWarmedUp;
     }
-    return _serialDispatchQueue;
 }
 
-+ (void)setSerialDispatchQueue:(dispatch_queue_t)serialDispatchQueue
+
+/*--------------------------------------------------------------------------------------------------------------
+ @property (nonatomic, readonly, copy, class, nullable) NSString* defaultTemplatesHash;
+ --------------------------------------------------------------------------------------------------------------*/
++ (nullable NSString*)defaultTemplatesHash
+{
+    return self.defaultTemplates.contentHash;
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ @property (nonatomic, readonly, strong, class, nullable) TemplaterBundle* defaultTemplates;
+ --------------------------------------------------------------------------------------------------------------*/
++ (nullable TemplaterBundle*)defaultTemplates
+{
+    static TemplaterBundle* defaultTemplates = nil;
+    static dispatch_once_t  onceToken;
+    dispatch_once(&onceToken, ^{
+        NSString* path = [[NSBundle mainBundle] pathForResource:@"APIManagerResponseDefaultTemplates" ofType:@"templates"];
+        if (!path) return;
+        
+        NSError* error = nil;
+        defaultTemplates = [TemplaterBundle bundleAtPath:path error:&error];
+        if (error) NSLog(@"+defaultTemplates error: %@",error);
+    });
+    return defaultTemplates;
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ @property (nonatomic, readonly, strong, class, nullable) TemplaterArchive* defaultArchive;
+ --------------------------------------------------------------------------------------------------------------*/
++ (nullable TemplaterArchive*)defaultArchive
 {
-    _serialDispatchQueue = serialDispatchQueue;
+    static TemplaterArchive* defaultArchive = nil;
+    static dispatch_once_t   onceToken;
+    dispatch_once(&onceToken, ^{
+        NSString* path = [[NSBundle mainBundle] pathForResource:@"APIManagerResponseDefaultTemplates" ofType:@"zip"];
+        if (!path) return;
+        
+        NSError* error = nil;
+        defaultArchive = [TemplaterArchive archiveAtPath:path error:&error];
+        if (error) NSLog(@"+defaultArchive error: %@",error);
+    });
+    return defaultArchive;
+}
+
+
+/*--------------------------------------------------------------------------------------------------------------
+ @property (nonatomic, readonly, strong, class) dispatch_queue_t templatesQueue;
+ The queue and the dictionary of templates are created once, before the first reader can use them.
+ --------------------------------------------------------------------------------------------------------------*/
++ (dispatch_queue_t)templatesQueue
+{
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        _templatesQueue = dispatch_queue_create("Templater.templates.concurrentQueue", DISPATCH_QUEUE_CONCURRENT);
+        if (!_templates) _templates = [NSMutableDictionary new];
+    });
+    return _templatesQueue;
 }
 
 /*--------------------------------------------------------------------------------------------------------------
@@ -340,13 +671,17 @@ Removes sample file from disk and from RAM by method API name
 
 /*--------------------------------------------------------------------------------------------------------------
  The method allows you to change the location of the folder with templates.
- The 'dispatch_barrier_sync' block allows you to first wait for all other operations to complete, and then execute
- renaming.
+ The barrier waits for the readers of 'templatesQueue' to finish, and then moves the folder. No template is read
+ from the folder while it is being moved.
  --------------------------------------------------------------------------------------------------------------*/
 + (void) setNewPathToTemplateDirectory:(NSString*)path
 {
-    dispatch_barrier_sync(self.serialDispatchQueue, ^{
+    dispatch_barrier_sync(self.templatesQueue, ^{
         [self setPathToTemplateDirectory:path];
+        _templatesGeneration++;
+        
+        // The folder is watched at its new location
+        if (_directorySource) [self startWatchingTemplateDirectory];
     });
 }
 
@@ -356,26 +691,29 @@ Removes sample file from disk and from RAM by method API name
 
 + (NSString *)pathToTemplateDirectory
 {
-    // Recovers from UserDefault
-    if ((!_pathToTemplateDirectory) && ([Templater shortPathFromUserDefault].length > 0)) {
-          _pathToTemplateDirectory = [Templater fullPathFromUserDefault];
-    }
+    // Readers of 'templatesQueue' may resolve the path at the same time
+    @synchronized (self) {
+        // Recovers from UserDefault
+        if ((!_pathToTemplateDirectory) && ([Templater shortPathFromUserDefault].length > 0)) {
+              _pathToTemplateDirectory = [Templater fullPathFromUserDefault];
+        }
     
-    // If there was nothing in UserDefault, then set the default value and write
-    if (!_pathToTemplateDirectory){
+        // If there was nothing in UserDefault, then set the default value and write
+        if (!_pathToTemplateDirectory){
         
-        NSString* pathToLibraryCaches = [NSSearchPathForDirectoriesInDomains(NSLibraryDirectory, NSUserDomainMask,YES) firstObject];
-        NSString* pathToFolder = [pathToLibraryCaches stringByAppendingPathComponent:@"/APIManagerResponseTemplates"];
+            NSString* pathToLibraryCaches = [NSSearchPathForDirectoriesInDomains(NSLibraryDirectory, NSUserDomainMask,YES) firstObject];
+            NSString* pathToFolder = [pathToLibraryCaches stringByAppendingPathComponent:@"/APIManagerResponseTemplates"];
 
-        [Templater saveAnyPathToUserDefault:pathToFolder];
-        _pathToTemplateDirectory = pathToFolder;
-    }
+            [Templater saveAnyPathToUserDefault:pathToFolder];
+            _pathToTemplateDirectory = pathToFolder;
+        }
     
-    if ((_pathToTemplateDirectory) && (![TemplaterFileManager existsItemAtPath:_pathToTemplateDirectory])){
-        [self createFolderIfItDoesntExitByPath:_pathToTemplateDirectory];
-    }
+        if ((_pathToTemplateDirectory) && (![TemplaterFileManager existsItemAtPath:_pathToTemplateDirectory])){
+            [self createFolderIfItDoesntExitByPath:_pathToTemplateDirectory];
+        }
     
-    return _pathToTemplateDirectory;
+        return _pathToTemplateDirectory;
+    }
 }
 
 
@@ -465,56 +803,157 @@ Removes sample file from disk and from RAM by method API name
 #pragma mark - Strings / Logics / UserDefault
 
 /*--------------------------------------------------------------------------------------------------------------
- The method unpacks an archive with a folder of standard json files (responses from the server).
- If you specify nil in the 'atPath' argument, then the algorithm will automatically unzip the folder to the 'Templater.pathToTemplateDirectory' path.
- You can call this method every time you start the application inside the +APIManager.prepareBeforeUsing: method,
- inside built-in protection against repeated unzipping.
+ Prepares the default templates from the bundle of the application: the compiled
+ 'APIManagerResponseDefaultTemplates.templates' or, if there is none, 'APIManagerResponseDefaultTemplates.zip'.
+ Neither is unpacked: templates are read from them on demand. When the default templates were changed by
+ an update of the application ('contentHash' of the compiled file or the CRC-32 of the entries of the archive),
+ a copy on disk of a changed template is removed, if the copy was not changed since it was unpacked.
+ If you specify a path in the 'atPath' argument, the folder with templates is moved there.
+ You can call this method every time you start the application inside the +APIManager.prepareBeforeUsing: method.
  --------------------------------------------------------------------------------------------------------------*/
-
 + (void) unarchiveFolderWithDefaultTemplates:(nullable NSString*)atPath
                                   completion:(nullable void(^)(NSError* error))completion
 {
-    // Check if the archive was previously unzipped
-    BOOL wasZipExtractedEarly = [[NSUserDefaults standardUserDefaults] boolForKey:wasArchiveExtractedUserDefaultKey];
-    if (wasZipExtractedEarly){
-        return;
-    }
-    
-    // Set the path where the unzip will be performed
-    if (atPath.length < 1){
-        atPath = Templater.pathToTemplateDirectory;
-    } else {
+    // Set the path where the changed templates are stored
+    if (atPath.length > 0){
         [Templater setNewPathToTemplateDirectory:atPath];
     }
     
-    // Delete the folder name at the end of the line
-    atPath = [Templater removeDefaultFolderNameToPathIfItNeeded:atPath];
+    // The compiled default templates are read from the bundle directly, so there is nothing to unzip.
+    // The copies unpacked from the previous defaults still take precedence over them and are removed
+    if (self.defaultTemplates){
+        [Templater removeOutdatedCopiesOfDefaultTemplates:self.defaultTemplates];
+        if (completion) completion(nil);
+        return;
+    }
     
-    // We are looking for the path to the archive in the bundle of the application
-    NSString *localPathAtZip = [[NSBundle mainBundle] pathForResource:@"APIManagerResponseDefaultTemplates" ofType:@"zip"];
-    if (localPathAtZip.length < 1){
+    // We are looking for the archive in the bundle of the application
+    TemplaterArchive* archive = self.defaultArchive;
+    if (!archive){
         if (completion)
             completion([NSError errorWithDomain:@"APIManagerResponseDefaultTemplates.zip wasn't find in bundle" code:0 userInfo:nil]);
         return;
     }
     
-    // Unzip the archive
-    [SSZipArchive unzipFileAtPath:localPathAtZip
-                    toDestination:atPath
-                  progressHandler:^(NSString * _Nonnull entry, unz_file_info zipInfo, long entryNumber, long total) {
-                      
-                  } completionHandler:^(NSString * _Nonnull path, BOOL succeeded, NSError * _Nullable errorUnpackZip) {
-                      
-                      if (errorUnpackZip){
-                          if (completion) { completion(errorUnpackZip); };
-                      }else if (succeeded){
-                          if (completion) completion(nil);
-                          
-                          // We write down the flag indicating that the unpacking was carried out
-                          [[NSUserDefaults standardUserDefaults] setBool:YES forKey:wasArchiveExtractedUserDefaultKey];
-                          [[NSUserDefaults standardUserDefaults] synchronize];
-                      }
-    }];
+    [Templater removeOutdatedCopiesOfArchive:archive];
+    if (completion) completion(nil);
+    
+    // The default templates are put into RAM before the first responses
+    [Templater warmUpTemplates:nil];
+}
+
+
+/*--------------------------------------------------------------------------------------------------------------
+ Compares the hashes of the default templates with the ones saved on the previous launch.
+ For each changed template, the copy on disk is removed if it is equal to the previous or to the new default
+ template: such a copy was unpacked earlier and was not changed by the application.
+ Copies written by the application are kept.
+ On the first launch after the versions which unpacked the whole archive once, there are no saved CRC-32
+ and the archive of those versions is unknown. A copy equal to the new entry is removed. Another copy is removed
+ only if it was not modified later than 'legacyExtractionInterval' after the folder with templates was created,
+ that is, when those versions unpacked the archive (the unpacked files may also keep the dates of the archive,
+ which are earlier). Trade-off: a template which the application rewrote within that minute is removed as well,
+ and an unpacked copy touched later is kept and shadows the new default template until it is removed by hand.
+ --------------------------------------------------------------------------------------------------------------*/
++ (void) removeCopiesOutdatedByDefaultHashes:(NSDictionary<NSString*,NSNumber*>*)entryHashes
+{
+    NSDictionary<NSString*,NSNumber*>* savedHashes  = [[NSUserDefaults standardUserDefaults] dictionaryForKey:defaultTemplateHashesUserDefaultKey];
+    
+    // The default templates were not changed since the previous launch
+    if ([savedHashes isEqualToDictionary:entryHashes]){
+        return;
+    }
+    // The copies were unpacked by the previous version, the hashes of its archive were not saved
+    BOOL isLegacyExtraction = (!savedHashes) &&
+                              ([[NSUserDefaults standardUserDefaults] boolForKey:wasArchiveExtractedUserDefaultKey]);
+    // It created the folder with templates when it unpacked the archive
+    NSDate* legacyExtractionDate = (isLegacyExtraction) ? [TemplaterFileManager creationDateOfItemAtPath:self.pathToTemplateDirectory] : nil;
+    
+    dispatch_barrier_sync(self.templatesQueue, ^{
+        for (NSString* apiMethod in entryHashes)
+        {
+            NSNumber* entryHash = entryHashes[apiMethod];
+            NSNumber* savedHash = savedHashes[apiMethod];
+            if ([savedHash isEqualToNumber:entryHash]) continue;
+            
+            NSString* localPath = [NSString stringWithFormat:@"%@/%@.json",self.pathToTemplateDirectory,apiMethod];
+            NSData*   data      = [NSData dataWithContentsOfFile:localPath];
+            if (!data) continue;
+            
+            // The hashes of the archive are the CRC-32 of the files, the ones of the compiled templates are the CRC-32
+            // of the canonical json. The copy is compared in both forms
+            id    localTemplate  = [NSJSONSerialization JSONObjectWithData:data options:kNilOptions error:nil];
+            uLong localHash      = crc32(0L, data.bytes, (uInt)data.length);
+            uLong canonicalHash  = (localTemplate) ? [Templater canonicalHashOfTemplate:localTemplate] : 0;
+            BOOL  isUnpackedCopy = (localHash == entryHash.unsignedLongValue) || (canonicalHash == entryHash.unsignedLongValue) ||
+                                   ((savedHash) && ((localHash == savedHash.unsignedLongValue) || (canonicalHash == savedHash.unsignedLongValue)));
+            if ((!isUnpackedCopy) && (legacyExtractionDate)){
+                // The CRC-32 of the old archive are unknown. The copy which was not modified after the extraction was unpacked,
+                // a later one was written by the application
+                NSDate* modificationDate = [TemplaterFileManager modificationDateOfItemAtPath:localPath];
+                isUnpackedCopy = (modificationDate) && ([modificationDate timeIntervalSinceDate:legacyExtractionDate] < legacyExtractionInterval);
+            }
+            if (!isUnpackedCopy) continue;
+            
+            [TemplaterFileManager removeItemAtPath:localPath error:nil];
+            [self.templates removeObjectForKey:apiMethod];
+            _templatesGeneration++;
+        }
+    });
+    
+    [[NSUserDefaults standardUserDefaults] setObject:entryHashes forKey:defaultTemplateHashesUserDefaultKey];
+    [[NSUserDefaults standardUserDefaults] removeObjectForKey:wasArchiveExtractedUserDefaultKey];
+    [[NSUserDefaults standardUserDefaults] synchronize];
+}
+
+
+/*--------------------------------------------------------------------------------------------------------------
+ Removes the copies on disk which the default templates of the archive make outdated.
+ The rule is the one of +removeCopiesOutdatedByDefaultHashes:.
+ --------------------------------------------------------------------------------------------------------------*/
++ (void) removeOutdatedCopiesOfArchive:(TemplaterArchive*)archive
+{
+    [Templater removeCopiesOutdatedByDefaultHashes:archive.entryHashes];
+
+    // The next archive compares its copies with these hashes, the next compiled file is checked anew
+    [[NSUserDefaults standardUserDefaults] removeObjectForKey:defaultTemplatesContentHashUserDefaultKey];
+}
+
+
+/*--------------------------------------------------------------------------------------------------------------
+ Removes the copies on disk which the compiled default templates make outdated.
+ Runs only when 'contentHash' differs from the saved one. The hashes of the templates are the CRC-32 of their
+ canonical json (see +canonicalHashOfTemplate:), since the compiled file does not keep the json files.
+ The rule is the one of +removeCopiesOutdatedByDefaultHashes:.
+ --------------------------------------------------------------------------------------------------------------*/
++ (void) removeOutdatedCopiesOfDefaultTemplates:(TemplaterBundle*)bundle
+{
+    NSString* savedContentHash = [[NSUserDefaults standardUserDefaults] stringForKey:defaultTemplatesContentHashUserDefaultKey];
+    if ([savedContentHash isEqualToString:bundle.contentHash]){
+        return;
+    }
+
+    NSMutableDictionary<NSString*,NSNumber*>* entryHashes = [NSMutableDictionary new];
+    for (NSString* apiMethod in bundle.apiMethods)
+    {
+        NSDictionary* template = [bundle templateForAPIMethod:apiMethod];
+        if (template) entryHashes[apiMethod] = @([Templater canonicalHashOfTemplate:template]);
+    }
+    [Templater removeCopiesOutdatedByDefaultHashes:entryHashes];
+
+    [[NSUserDefaults standardUserDefaults] setObject:bundle.contentHash forKey:defaultTemplatesContentHashUserDefaultKey];
+    [[NSUserDefaults standardUserDefaults] synchronize];
+}
+
+
+/*--------------------------------------------------------------------------------------------------------------
+ CRC-32 of the template serialized with sorted keys and without formatting. Does not depend on the formatting
+ and the order of the keys of the json file, so a copy written by +writeTemplate: is equal to its default template.
+ --------------------------------------------------------------------------------------------------------------*/
++ (uLong) canonicalHashOfTemplate:(id)template
+{
+    NSData* data = [NSJSONSerialization dataWithJSONObject:template options:NSJSONWritingSortedKeys error:nil];
+    return (data) ? crc32(0L, data.bytes, (uInt)data.length) : 0;
 }
 
 
@@ -621,4 +1060,83 @@ Removes sample file from disk and from RAM by method API name
 }
 
 
+#pragma mark - Benchmark
+
+#if DEBUG
+static const APIMethod TemplaterBenchmarkMethods[] = { APIMethod_UserGet, APIMethod_FriendsGet, APIMethod_WallGet, APIMethod_PhotosGetAll };
+#define TemplaterBenchmarkMethodsCount (sizeof(TemplaterBenchmarkMethods) / sizeof(TemplaterBenchmarkMethods[0]))
+
+/*--------------------------------------------------------------------------------------------------------------
+ Runs 'lookup' 'iterations' times on each of 'threads' parallel workers. Returns the time of all workers.
+ --------------------------------------------------------------------------------------------------------------*/
+static CFAbsoluteTime TemplaterMeasure(NSUInteger threads, NSUInteger iterations, void(^lookup)(NSUInteger index))
+{
+    dispatch_queue_t workers = dispatch_get_global_queue(QOS_CLASS_USER_INITIATED, 0);
+    CFAbsoluteTime start = CFAbsoluteTimeGetCurrent();
+    dispatch_apply(threads, workers, ^(size_t thread){
+        @autoreleasepool {
+            for (NSUInteger i = 0; i < iterations; i++) lookup(thread + i);
+        }
+    });
+    return CFAbsoluteTimeGetCurrent() - start;
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ Looks up the templates of four API methods from 1, 2, 4 and 8 threads: through a serial queue (as it was done
+ before) and through 'templatesQueue'. Only the RAM path is measured: the templates which are not in RAM
+ are replaced by stubs for the time of the benchmark.
+ --------------------------------------------------------------------------------------------------------------*/
++ (void) benchmarkTemplateLookup:(NSUInteger)iterations
+{
+    iterations = MAX(1, iterations);
+    
+    NSMutableArray<NSString*>* stubs = [NSMutableArray new];
+    dispatch_barrier_sync(self.templatesQueue, ^{
+        for (NSUInteger i = 0; i < TemplaterBenchmarkMethodsCount; i++){
+            NSString* apiMethod = [APIManager convertAPIMethodToString:TemplaterBenchmarkMethods[i]];
+            if (self.templates[apiMethod]) continue;
+            
+            self.templates[apiMethod] = @{ @"response" : @{ @"count" : @(1), @"items" : @[] } };
+            [stubs addObject:apiMethod];
+        }
+    });
+    
+    dispatch_queue_t serialQueue = dispatch_queue_create("Templater.benchmark.serialQueue", NULL);
+    
+    for (NSUInteger threads = 1; threads <= 8; threads *= 2)
+    {
+        CFAbsoluteTime serial = TemplaterMeasure(threads, iterations, ^(NSUInteger index){
+            APIMethod method = TemplaterBenchmarkMethods[index % TemplaterBenchmarkMethodsCount];
+            dispatch_sync(serialQueue, ^{
+                (void)self.templates[[APIManager convertAPIMethodToString:method]];
+            });
+        });
+        CFAbsoluteTime concurrent = TemplaterMeasure(threads, iterations, ^(NSUInteger index){
+            [Templater templateForAPIMethod:TemplaterBenchmarkMethods[index % TemplaterBenchmarkMethodsCount]];
+        });
+        
+        double lookups = (double)threads * iterations;
+        APILog(@"%lu threads: serial queue %.0f, concurrent queue %.0f lookups per second",
+               (unsigned long)threads, lookups / serial, lookups / concurrent);
+    }
+    
+    dispatch_barrier_sync(self.templatesQueue, ^{
+        [self.templates removeObjectsForKeys:stubs];
+    });
+}
+#endif
+
+@end
+
+
+
+@implementation TemplaterWarmUpReport
+
+- (NSString*) description
+{
+    return [NSString stringWithFormat:@"<%@: %lu loaded, %lu missing %@, %.1f ms>", NSStringFromClass([self class]),
+            (unsigned long)self.loadedMethods.count, (unsigned long)self.missingMethods.count, self.missingMethods,
+            self.duration * 1000];
+}
+
 @end
@@ -0,0 +1,47 @@
+//
+//  TemplaterArchive.h
+//  vk-networkLayer
+//
+//  Created by Admin on 06/08/2020.
+//  Copyright © 2020 iOS-Team. All rights reserved.
+//
+
+#import <Foundation/Foundation.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+/*--------------------------------------------------------------------------------------------------------------
+ 🗜 'TemplaterArchive' - reads single templates straight from 'APIManagerResponseDefaultTemplates.zip'.
+ ---------------
+ Only the central directory of the archive is read when it is opened: names of the entries, their positions
+ and CRC-32. An entry is found by the name of the API method and decompressed on the first request of its template,
+ so the archive does not have to be unpacked into the sandbox.
+ ---------------
+ Additionally:
+ (⚠️) 'entryHashes' are the CRC-32 of the entries, taken from the central directory without decompression.
+      'Templater' compares them with the previous launch to find the templates changed by an update of the application.
+ --------------------------------------------------------------------------------------------------------------*/
+@interface TemplaterArchive : NSObject
+
+// Path to the archive
+@property (nonatomic, readonly, copy) NSString* path;
+
+// CRC-32 of the entries by the name of the API method ('users.get')
+@property (nonatomic, readonly, copy) NSDictionary<NSString*,NSNumber*>* entryHashes;
+
+
+/*--------------------------------------------------------------------------------------------------------------
+ Opens the archive and reads its central directory. Entries with json files are indexed by their names
+ without the folder and the extension. Returns nil if the archive does not exist or cannot be read.
+ --------------------------------------------------------------------------------------------------------------*/
++ (nullable instancetype) archiveAtPath:(NSString*)path error:(NSError**)error;
+
+/*--------------------------------------------------------------------------------------------------------------
+ Decompresses the entry of the API method. Returns nil if there is no such entry or it is damaged.
+ Safe to call from any thread: reads of the archive are serialized.
+ --------------------------------------------------------------------------------------------------------------*/
+- (nullable NSData*) dataForAPIMethod:(NSString*)apiMethod;
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,69 @@
+//
+//  TemplaterBundle.h
+//  vk-networkLayer
+//
+//  Created by Admin on 06/08/2020.
+//  Copyright © 2020 iOS-Team. All rights reserved.
+//
+
+#import <Foundation/Foundation.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+/*--------------------------------------------------------------------------------------------------------------
+ 📦 'TemplaterBundle' - one precompiled file with the templates of all API methods.
+ ---------------
+ A template stored as '<method>.json' is parsed by 'NSJSONSerialization' on the first response of its API method,
+ and the default set has to be unzipped into the sandbox on the first launch.
+ The compiled file is added to the bundle of the application instead of 'APIManagerResponseDefaultTemplates.zip'.
+ It is mapped into memory and each template is decoded from its binary form on the first request,
+ without reading and parsing json files.
+ ---------------
+ File format (little-endian):
+ - Header:  magic 'APTB', format version, number of templates, SHA-256 of the index and the data.
+ - Index:   one line per template, sorted by the name of the API method: offset and length of the name
+            and offset and length of the template. Looked up by binary search.
+ - Data:    names of the API methods in UTF-8 and templates in a binary form: each value is a one-byte tag
+            followed by its bytes, so decoding is a single pass without searching for delimiters.
+ ---------------
+ Additionally:
+ (⚠️) The file is built by +compileTemplatesAtDirectory:toPath: from the folder of json files, for example
+      by a Run Script build phase of a command line target. Rules of the templates are compiled together with them.
+ (⚠️) 'contentHash' changes with any template, so it can be used as the version of the default templates.
+ --------------------------------------------------------------------------------------------------------------*/
+@interface TemplaterBundle : NSObject
+
+// Path to the mapped file
+@property (nonatomic, readonly, copy) NSString* path;
+
+// SHA-256 of the templates written at compile time, in hex
+@property (nonatomic, readonly, copy) NSString* contentHash;
+
+// Names of the API methods of all templates, sorted
+@property (nonatomic, readonly, copy) NSArray<NSString*>* apiMethods;
+
+
+/*--------------------------------------------------------------------------------------------------------------
+ Maps the file into memory and checks its header. The templates are not read until they are requested.
+ Returns nil if the file does not exist or has another format.
+ --------------------------------------------------------------------------------------------------------------*/
++ (nullable instancetype) bundleAtPath:(NSString*)path error:(NSError**)error;
+
+/*--------------------------------------------------------------------------------------------------------------
+ Decodes the template of the API method ('users.get') from the mapped file. Returns nil if there is no such template.
+ Safe to call from any thread.
+ --------------------------------------------------------------------------------------------------------------*/
+- (nullable NSDictionary*) templateForAPIMethod:(NSString*)apiMethod;
+
+
+#pragma mark - Build tool
+
+/*--------------------------------------------------------------------------------------------------------------
+ Compiles all '<method>.json' files of the folder into one file at 'path'.
+ Returns an error if any json file is invalid, so a broken template does not reach the application.
+ --------------------------------------------------------------------------------------------------------------*/
++ (nullable NSError*) compileTemplatesAtDirectory:(NSString*)directory toPath:(NSString*)path;
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,429 @@
+//
+//  TemplaterBundle.m
+//  vk-networkLayer
+//
+//  Created by Admin on 06/08/2020.
+//  Copyright © 2020 iOS-Team. All rights reserved.
+//
+
+#import "TemplaterBundle.h"
+// System
+#import <CommonCrypto/CommonDigest.h>
+
+
+#define TemplaterBundleMagic          "APTB"
+#define TemplaterBundleFormatVersion  1
+
+// Tags of the values in the data of a template
+#define TemplaterBundleTagDictionary  'd'
+#define TemplaterBundleTagArray       'a'
+#define TemplaterBundleTagString      's'
+#define TemplaterBundleTagInteger     'i'
+#define TemplaterBundleTagFloat       'f'
+#define TemplaterBundleTagTrue        'T'
+#define TemplaterBundleTagFalse       'F'
+#define TemplaterBundleTagNull        'n'
+
+
+typedef struct {
+    char     magic[4];
+    uint32_t formatVersion;
+    uint32_t count;
+    uint32_t reserved;
+    uint8_t  contentHash[CC_SHA256_DIGEST_LENGTH];
+} TemplaterBundleHeader;
+
+typedef struct {
+    uint32_t nameOffset;
+    uint32_t nameLength;
+    uint32_t templateOffset;
+    uint32_t templateLength;
+} TemplaterBundleEntry;
+
+// Position of the decoder inside the data of one template
+typedef struct {
+    const uint8_t* cursor;
+    const uint8_t* end;
+} TemplaterBundleReader;
+
+
+
+@interface TemplaterBundle ()
+@property (nonatomic, readwrite, copy) NSString* path;
+@property (nonatomic, readwrite, copy) NSString* contentHash;
+@property (nonatomic, readwrite, copy) NSArray<NSString*>* apiMethods;
+
+// Mapped file. Templates are decoded straight from its pages
+@property (nonatomic, strong) NSData*   data;
+@property (nonatomic, assign) uint32_t  count;
+@end
+
+
+
+@implementation TemplaterBundle
+
+#pragma mark - Names
+
+/*--------------------------------------------------------------------------------------------------------------
+ Byte order of the names of API methods. The index is sorted by it at compile time and searched by it at runtime.
+ --------------------------------------------------------------------------------------------------------------*/
+static int TemplaterBundleCompareNames(const void* name, size_t length, const void* otherName, size_t otherLength)
+{
+    int order = memcmp(name, otherName, MIN(length, otherLength));
+    if (order != 0) return order;
+    return (length < otherLength) ? -1 : (length > otherLength) ? 1 : 0;
+}
+
+static inline const TemplaterBundleEntry* TemplaterBundleEntries(NSData* data)
+{
+    return (const TemplaterBundleEntry*)((const uint8_t*)data.bytes + sizeof(TemplaterBundleHeader));
+}
+
+static const TemplaterBundleEntry* _Nullable TemplaterBundleFind(NSData* data, uint32_t count, const char* name, size_t length)
+{
+    const uint8_t*              bytes   = data.bytes;
+    const TemplaterBundleEntry* entries = TemplaterBundleEntries(data);
+
+    NSInteger low  = 0;
+    NSInteger high = (NSInteger)count - 1;
+    while (low <= high)
+    {
+        NSInteger middle = (low + high) / 2;
+        const TemplaterBundleEntry* entry = &entries[middle];
+
+        int order = TemplaterBundleCompareNames(bytes + CFSwapInt32LittleToHost(entry->nameOffset),
+                                                CFSwapInt32LittleToHost(entry->nameLength), name, length);
+        if (order == 0) return entry;
+        if (order < 0) low  = middle + 1;
+        else           high = middle - 1;
+    }
+    return NULL;
+}
+
+
+#pragma mark - Opening
+
+/*--------------------------------------------------------------------------------------------------------------
+ Checks the header and that every line of the index points inside the file.
+ Returns the reason why the file cannot be used, or nil.
+ --------------------------------------------------------------------------------------------------------------*/
+static NSString* _Nullable TemplaterBundleValidate(NSData* data)
+{
+    if (data.length < sizeof(TemplaterBundleHeader)) return @"the file is shorter than the header";
+
+    const TemplaterBundleHeader* header = data.bytes;
+    if (memcmp(header->magic, TemplaterBundleMagic, sizeof(header->magic)) != 0) return @"unknown format";
+    if (CFSwapInt32LittleToHost(header->formatVersion) != TemplaterBundleFormatVersion) return @"unsupported version of the format";
+
+    uint64_t count = CFSwapInt32LittleToHost(header->count);
+    if (sizeof(TemplaterBundleHeader) + count * sizeof(TemplaterBundleEntry) > data.length) return @"the index is cut";
+
+    const TemplaterBundleEntry* entries = TemplaterBundleEntries(data);
+    for (uint64_t i = 0; i < count; i++)
+    {
+        uint64_t nameEnd     = (uint64_t)CFSwapInt32LittleToHost(entries[i].nameOffset)     + CFSwapInt32LittleToHost(entries[i].nameLength);
+        uint64_t templateEnd = (uint64_t)CFSwapInt32LittleToHost(entries[i].templateOffset) + CFSwapInt32LittleToHost(entries[i].templateLength);
+        if ((nameEnd > data.length) || (templateEnd > data.length)) return @"the index points outside of the file";
+    }
+    return nil;
+}
+
+static NSString* TemplaterBundleHexString(const uint8_t* bytes, size_t length)
+{
+    NSMutableString* hex = [NSMutableString stringWithCapacity:length * 2];
+    for (size_t i = 0; i < length; i++) [hex appendFormat:@"%02x", bytes[i]];
+    return hex;
+}
+
+
++ (nullable instancetype) bundleAtPath:(NSString*)path error:(NSError**)error
+{
+    // Pages of the file are read by the system only when a template located on them is decoded
+    NSData* data = [NSData dataWithContentsOfFile:path options:NSDataReadingMappedAlways error:error];
+    if (!data) return nil;
+
+    NSString* reason = TemplaterBundleValidate(data);
+    if (reason){
+        if (error) *error = [NSError errorWithDomain:[NSString stringWithFormat:@"%@ is not a template bundle: %@",path.lastPathComponent,reason] code:0 userInfo:nil];
+        return nil;
+    }
+
+    const TemplaterBundleHeader* header = data.bytes;
+
+    TemplaterBundle* bundle = [TemplaterBundle new];
+    bundle.path        = path;
+    bundle.data        = data;
+    bundle.count       = CFSwapInt32LittleToHost(header->count);
+    bundle.contentHash = TemplaterBundleHexString(header->contentHash, sizeof(header->contentHash));
+
+    NSMutableArray<NSString*>* apiMethods = [NSMutableArray arrayWithCapacity:bundle.count];
+    const TemplaterBundleEntry* entries = TemplaterBundleEntries(data);
+    for (uint32_t i = 0; i < bundle.count; i++)
+    {
+        NSString* apiMethod = [[NSString alloc] initWithBytes:(const uint8_t*)data.bytes + CFSwapInt32LittleToHost(entries[i].nameOffset)
+                                                       length:CFSwapInt32LittleToHost(entries[i].nameLength)
+                                                     encoding:NSUTF8StringEncoding];
+        if (apiMethod) [apiMethods addObject:apiMethod];
+    }
+    bundle.apiMethods = apiMethods;
+    return bundle;
+}
+
+
+#pragma mark - Reading
+
+static inline BOOL TemplaterBundleReadBytes(TemplaterBundleReader* reader, void* bytes, size_t length)
+{
+    if ((size_t)(reader->end - reader->cursor) < length) return NO;
+    memcpy(bytes, reader->cursor, length);
+    reader->cursor += length;
+    return YES;
+}
+
+static inline BOOL TemplaterBundleReadLength(TemplaterBundleReader* reader, uint32_t* length)
+{
+    if (!TemplaterBundleReadBytes(reader, length, sizeof(uint32_t))) return NO;
+    *length = CFSwapInt32LittleToHost(*length);
+    return YES;
+}
+
+static NSString* _Nullable TemplaterBundleReadString(TemplaterBundleReader* reader)
+{
+    uint32_t length = 0;
+    if (!TemplaterBundleReadLength(reader, &length))        return nil;
+    if ((size_t)(reader->end - reader->cursor) < length)    return nil;
+
+    NSString* string = [[NSString alloc] initWithBytes:reader->cursor length:length encoding:NSUTF8StringEncoding];
+    reader->cursor += length;
+    return string;
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ Decodes one value. The values are the same as 'NSJSONSerialization' returns, including 'NSNull' and
+ 'NSNumber' with a boolean, so 'Validator' sees no difference between the compiled template and the json file.
+ Returns nil if the data is cut or damaged.
+ --------------------------------------------------------------------------------------------------------------*/
+static id _Nullable TemplaterBundleReadValue(TemplaterBundleReader* reader)
+{
+    uint8_t tag = 0;
+    if (!TemplaterBundleReadBytes(reader, &tag, sizeof(tag))) return nil;
+
+    switch (tag) {
+        case TemplaterBundleTagDictionary: {
+            uint32_t count = 0;
+            if (!TemplaterBundleReadLength(reader, &count)) return nil;
+
+            NSMutableDictionary* dictionary = [NSMutableDictionary dictionaryWithCapacity:MIN(count, 1024)];
+            for (uint32_t i = 0; i < count; i++)
+            {
+                NSString* key   = TemplaterBundleReadString(reader);
+                id        value = key ? TemplaterBundleReadValue(reader) : nil;
+                if (!value) return nil;
+                dictionary[key] = value;
+            }
+            return dictionary;
+        }
+        case TemplaterBundleTagArray: {
+            uint32_t count = 0;
+            if (!TemplaterBundleReadLength(reader, &count)) return nil;
+
+            NSMutableArray* array = [NSMutableArray arrayWithCapacity:MIN(count, 1024)];
+            for (uint32_t i = 0; i < count; i++)
+            {
+                id value = TemplaterBundleReadValue(reader);
+                if (!value) return nil;
+                [array addObject:value];
+            }
+            return array;
+        }
+        case TemplaterBundleTagString:
+            return TemplaterBundleReadString(reader);
+
+        case TemplaterBundleTagInteger: {
+            int64_t number = 0;
+            if (!TemplaterBundleReadBytes(reader, &number, sizeof(number))) return nil;
+            return @((int64_t)CFSwapInt64LittleToHost((uint64_t)number));
+        }
+        case TemplaterBundleTagFloat: {
+            CFSwappedFloat64 number;
+            if (!TemplaterBundleReadBytes(reader, &number, sizeof(number))) return nil;
+            return @(CFConvertDoubleSwappedToHost(number));
+        }
+        case TemplaterBundleTagTrue:  return @YES;
+        case TemplaterBundleTagFalse: return @NO;
+        case TemplaterBundleTagNull:  return [NSNull null];
+    }
+    return nil;
+}
+
+
+- (nullable NSDictionary*) templateForAPIMethod:(NSString*)apiMethod
+{
+    const char* name = apiMethod.UTF8String;
+    if (!name) return nil;
+
+    const TemplaterBundleEntry* entry = TemplaterBundleFind(self.data, self.count, name, strlen(name));
+    if (!entry) return nil;
+
+    const uint8_t* start = (const uint8_t*)self.data.bytes + CFSwapInt32LittleToHost(entry->templateOffset);
+    TemplaterBundleReader reader = { start, start + CFSwapInt32LittleToHost(entry->templateLength) };
+
+    id template = TemplaterBundleReadValue(&reader);
+    if (![template isKindOfClass:[NSDictionary class]]){
+        NSLog(@"TemplaterBundle: template of %@ is damaged in %@",apiMethod,self.path.lastPathComponent);
+        return nil;
+    }
+    return template;
+}
+
+
+#pragma mark - Build tool
+
+static inline void TemplaterBundleWriteLength(NSMutableData* data, NSUInteger length)
+{
+    uint32_t value = CFSwapInt32HostToLittle((uint32_t)length);
+    [data appendBytes:&value length:sizeof(value)];
+}
+
+static inline void TemplaterBundleWriteTag(NSMutableData* data, uint8_t tag)
+{
+    [data appendBytes:&tag length:sizeof(tag)];
+}
+
+static void TemplaterBundleWriteString(NSMutableData* data, NSString* string)
+{
+    NSData* utf8 = [string dataUsingEncoding:NSUTF8StringEncoding];
+    TemplaterBundleWriteLength(data, utf8.length);
+    [data appendData:utf8];
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ Encodes a value returned by 'NSJSONSerialization'. Returns NO for values which json cannot contain.
+ --------------------------------------------------------------------------------------------------------------*/
+static BOOL TemplaterBundleWriteValue(NSMutableData* data, id value)
+{
+    if ([value isKindOfClass:[NSDictionary class]]){
+        TemplaterBundleWriteTag(data, TemplaterBundleTagDictionary);
+        TemplaterBundleWriteLength(data, [value count]);
+        for (id key in value)
+        {
+            if (![key isKindOfClass:[NSString class]]) return NO;
+            TemplaterBundleWriteString(data, key);
+            if (!TemplaterBundleWriteValue(data, value[key])) return NO;
+        }
+        return YES;
+    }
+    if ([value isKindOfClass:[NSArray class]]){
+        TemplaterBundleWriteTag(data, TemplaterBundleTagArray);
+        TemplaterBundleWriteLength(data, [value count]);
+        for (id element in value){
+            if (!TemplaterBundleWriteValue(data, element)) return NO;
+        }
+        return YES;
+    }
+    if ([value isKindOfClass:[NSString class]]){
+        TemplaterBundleWriteTag(data, TemplaterBundleTagString);
+        TemplaterBundleWriteString(data, value);
+        return YES;
+    }
+    if ([value isKindOfClass:[NSNumber class]]){
+        // Booleans of json are 'kCFBooleanTrue' / 'kCFBooleanFalse' and must stay booleans after decoding
+        if (CFGetTypeID((__bridge CFTypeRef)value) == CFBooleanGetTypeID()){
+            TemplaterBundleWriteTag(data, [value boolValue] ? TemplaterBundleTagTrue : TemplaterBundleTagFalse);
+        } else if (([value isKindOfClass:[NSDecimalNumber class]]) || (CFNumberIsFloatType((__bridge CFNumberRef)value))){
+            CFSwappedFloat64 number = CFConvertDoubleHostToSwapped([value doubleValue]);
+            TemplaterBundleWriteTag(data, TemplaterBundleTagFloat);
+            [data appendBytes:&number length:sizeof(number)];
+        } else {
+            uint64_t number = CFSwapInt64HostToLittle((uint64_t)[value longLongValue]);
+            TemplaterBundleWriteTag(data, TemplaterBundleTagInteger);
+            [data appendBytes:&number length:sizeof(number)];
+        }
+        return YES;
+    }
+    if ([value isKindOfClass:[NSNull class]]){
+        TemplaterBundleWriteTag(data, TemplaterBundleTagNull);
+        return YES;
+    }
+    return NO;
+}
+
+
++ (nullable NSError*) compileTemplatesAtDirectory:(NSString*)directory toPath:(NSString*)path
+{
+    // 'NSFileManager' instead of 'TemplaterFileManager', so the tool also builds for a macOS command line target
+    NSError* error = nil;
+    NSArray<NSString*>* fileNames = [[NSFileManager defaultManager] contentsOfDirectoryAtPath:directory error:&error];
+    if (error) return error;
+
+    NSMutableArray<NSData*>* names     = [NSMutableArray new];
+    NSMutableArray<NSData*>* templates = [NSMutableArray new];
+
+    for (NSString* fileName in fileNames)
+    {
+        if (![fileName.pathExtension isEqualToString:@"json"]) continue;
+
+        NSData* json = [NSData dataWithContentsOfFile:[directory stringByAppendingPathComponent:fileName]];
+        id template  = json ? [NSJSONSerialization JSONObjectWithData:json options:kNilOptions error:nil] : nil;
+
+        NSMutableData* encoded = [NSMutableData new];
+        if ((![template isKindOfClass:[NSDictionary class]]) || (!TemplaterBundleWriteValue(encoded, template))){
+            return [NSError errorWithDomain:[NSString stringWithFormat:@"%@ is not a valid template",fileName] code:0 userInfo:nil];
+        }
+        [names     addObject:[fileName.stringByDeletingPathExtension dataUsingEncoding:NSUTF8StringEncoding]];
+        [templates addObject:encoded];
+    }
+
+    // The index is sorted by the names, so the order of the files in the folder does not change the hash
+    NSMutableArray<NSNumber*>* order = [NSMutableArray arrayWithCapacity:names.count];
+    for (NSUInteger i = 0; i < names.count; i++) [order addObject:@(i)];
+    [order sortUsingComparator:^NSComparisonResult(NSNumber* first, NSNumber* second) {
+        NSData* name      = names[first.unsignedIntegerValue];
+        NSData* otherName = names[second.unsignedIntegerValue];
+        int result = TemplaterBundleCompareNames(name.bytes, name.length, otherName.bytes, otherName.length);
+        return (result < 0) ? NSOrderedAscending : (result > 0) ? NSOrderedDescending : NSOrderedSame;
+    }];
+
+    NSUInteger offset = sizeof(TemplaterBundleHeader) + order.count * sizeof(TemplaterBundleEntry);
+    NSMutableData* index   = [NSMutableData dataWithCapacity:order.count * sizeof(TemplaterBundleEntry)];
+    NSMutableData* payload = [NSMutableData new];
+
+    for (NSNumber* position in order)
+    {
+        NSData* name     = names[position.unsignedIntegerValue];
+        NSData* template = templates[position.unsignedIntegerValue];
+
+        TemplaterBundleEntry entry;
+        entry.nameOffset     = CFSwapInt32HostToLittle((uint32_t)(offset + payload.length));
+        entry.nameLength     = CFSwapInt32HostToLittle((uint32_t)name.length);
+        [payload appendData:name];
+        entry.templateOffset = CFSwapInt32HostToLittle((uint32_t)(offset + payload.length));
+        entry.templateLength = CFSwapInt32HostToLittle((uint32_t)template.length);
+        [payload appendData:template];
+
+        [index appendBytes:&entry length:sizeof(entry)];
+    }
+    if (offset + payload.length > UINT32_MAX){
+        return [NSError errorWithDomain:@"Templates do not fit into the 32-bit offsets of the template bundle" code:0 userInfo:nil];
+    }
+
+    TemplaterBundleHeader header = {0};
+    memcpy(header.magic, TemplaterBundleMagic, sizeof(header.magic));
+    header.formatVersion = CFSwapInt32HostToLittle(TemplaterBundleFormatVersion);
+    header.count         = CFSwapInt32HostToLittle((uint32_t)order.count);
+
+    CC_SHA256_CTX context;
+    CC_SHA256_Init(&context);
+    CC_SHA256_Update(&context, index.bytes,   (CC_LONG)index.length);
+    CC_SHA256_Update(&context, payload.bytes, (CC_LONG)payload.length);
+    CC_SHA256_Final(header.contentHash, &context);
+
+    NSMutableData* file = [NSMutableData dataWithBytes:&header length:sizeof(header)];
+    [file appendData:index];
+    [file appendData:payload];
+
+    [file writeToFile:path options:NSDataWritingAtomic error:&error];
+    return error;
+}
+
+@end
@@ -3,6 +3,9 @@
 #import "APIManager.h"
 #import "Token.h"
 
+// Other Network layer components
+#import "NetworkRequestConstructor+FieldProjection.h"
+
 // Other ViewModels
 #import "UserProfileCellVM.h"
 #import "UserProfileGalleryCellVM.h"
@@ -47,6 +50,11 @@
         __weak UserProfileVM* weak = self;      
         NSArray<NSString*>* userIDs = (self.userID) ? @[self.userID] : @[];
         
+        // Fields read by the profile header: one avatar, online status, 'last_seen', followers from 'counters', city.
+        // 'first_name', 'last_name' and 'id' are always returned. While the viewModel is alive, NRC requests only them
+        [NRC declareFields:@[@"photo_200",@"online",@"last_seen",@"counters",@"city"]
+               forConsumer:self APIMethod:APIMethod_UserGet];
+        
         // Network operation initialization
         self.userInfoNetOp =
         [APIManager usersGet:userIDs
@@ -21,11 +21,88 @@ typedef NS_OPTIONS(NSUInteger, ResponseValidationMask) {
     CheckSubEntityOnKeys  = 1 << 1, // Checks for keys from a template in nested structures
     CheckOnTypesOfValues  = 1 << 2, // Checks the correspondence of data types by keys
     CheckOnExtendedRules  = 1 << 3, // Checks for rules (if they were listed in the template)
+    CheckArrayElements    = 1 << 4, // Checks each element of arrays against the first element of the array in the template
     
     AllChecks = CheckOnKeys | CheckSubEntityOnKeys | CheckOnTypesOfValues | CheckOnExtendedRules
 };
 
 
+/*--------------------------------------------------------------------------------------------------------------
+  The policy by which the responses of an API method are validated. See '+setValidationPolicy:forAPIMethod:'.
+ --------------------------------------------------------------------------------------------------------------*/
+typedef NS_ENUM(NSInteger, ValidationPolicy) {
+    
+    ValidationPolicy_Full = 0,      // Each response is validated (default)
+    ValidationPolicy_Sampled,       // One of 'validationSampleRate' responses is validated
+    ValidationPolicy_ShapeChanged,  // Only the responses whose structure differs from the last valid one are validated
+    ValidationPolicy_Off            // Responses are not validated
+};
+
+/*--------------------------------------------------------------------------------------------------------------
+  Called on 'backgroundValidationQueue' when the background validation has found an error.
+ --------------------------------------------------------------------------------------------------------------*/
+typedef void(^ValidationDriftHandler)(APIMethod method, NSError* error);
+
+
+/*--------------------------------------------------------------------------------------------------------------
+  Type of a value of json, as the validator sees it.
+ --------------------------------------------------------------------------------------------------------------*/
+typedef NS_ENUM(uint8_t, ValidationValueType) {
+    ValidationValueType_None = 0,   // There is no value for the key
+    ValidationValueType_String,
+    ValidationValueType_Number,
+    ValidationValueType_Array,
+    ValidationValueType_Dictionary,
+    ValidationValueType_Null,
+    ValidationValueType_Other
+};
+
+/*--------------------------------------------------------------------------------------------------------------
+  Kind of the issue found by the automatic validation. See 'ValidationIssue'.
+ --------------------------------------------------------------------------------------------------------------*/
+typedef NS_ENUM(NSInteger, ValidationIssueKind) {
+    
+    ValidationIssueKind_MissingKey = 0,     // The key of the template is missing in json
+    ValidationIssueKind_TypeMismatch,       // The value has a different type than in the template
+    ValidationIssueKind_RuleViolation,      // The value does not satisfy the rule of the template
+    ValidationIssueKind_InvalidRules,       // The rules of the template contradict each other
+    ValidationIssueKind_InvalidParams,      // The rule method was called without the template or the rules
+    ValidationIssueKind_ArrayCheckStopped,  // The check of the array was stopped after 'arrayValidationErrorLimit'
+    
+    ValidationIssueKindCount
+};
+
+
+/*--------------------------------------------------------------------------------------------------------------
+ 📋 'ValidationIssue' - one issue found by the automatic validation.
+ ---------------
+ The issue keeps only the kind, the key, the rule and the values: nothing is formatted while the response is validated.
+ 'message' and 'keyPath' are built when they are read, so a failed validation whose error is only counted
+ or dropped costs no string formatting.
+ ---------------
+ The issues are available in 'error.userInfo[@"validationIssues"]'.
+ 'error.userInfo[@"userInfoArray"]' contains their messages, as before.
+ --------------------------------------------------------------------------------------------------------------*/
+@interface ValidationIssue : NSObject
+
+@property (nonatomic, assign, readonly) ValidationIssueKind kind;
+// Key of the template. 'nil' for an element of an array whose type differs from the template
+@property (nonatomic, strong, readonly, nullable) NSString* key;
+// Rule key of the template ('mustMatch', 'minimum', ...). 'nil' if the issue is not about a rule
+@property (nonatomic, strong, readonly, nullable) NSString* rule;
+@property (nonatomic, assign, readonly) ValidationValueType expectedType;
+@property (nonatomic, assign, readonly) ValidationValueType actualType;
+// Value from json and the value required by the rule
+@property (nonatomic, strong, readonly, nullable) id value;
+@property (nonatomic, strong, readonly, nullable) id limit;
+
+// Path to the element of the array ('items[12]'). 'nil' outside of arrays
+@property (nonatomic, readonly, nullable) NSString* keyPath;
+@property (nonatomic, readonly) NSString* message;
+
+@end
+
+
 /*--------------------------------------------------------------------------------------------------------------
  🚦⚖️  'Validator' - validates responses received from the server
  ---------------
@@ -43,9 +120,23 @@ typedef NS_OPTIONS(NSUInteger, ResponseValidationMask) {
    You can write your own custom check here, and if you have a template, you can use the method automatic testing.
  ---------------
  Additionally:
- (⚠️) When using automatic validation, objects located in arrays are not subject to verification.
-      If your response from the server returns you an array of objects, then to carry out validation to disk as
-      template and always pass the object directly to the validator.
+ (⚠️) Objects located in arrays are checked only with 'CheckArrayElements' (it is not part of 'AllChecks').
+      The validation methods of the API methods add it when 'checksArrayElements' is set in 'APIMethodRegistry':
+      each element is compared with the first element of the array in the template. Long arrays are checked
+      in parallel chunks, the check stops after 'arrayValidationErrorLimit' invalid elements.
+ (⚠️) Automatic validation compiles each template once into a validation plan (ordered keys, type tags,
+      rules and plans of nested dictionaries). Responses are checked against the plan in one pass.
+ (⚠️) The dictionaries '<key>-Rules' are compiled with the plan: regular expressions of 'matchesPattern' are compiled
+      once, 'matchWithOneOf' is kept as a set of lowercased strings.
+ (⚠️) The plan remembers the structural fingerprints of the responses which passed it: the keys of the template
+      and their types, the last 16 of them. Keys which the template does not describe are ignored.
+      For a response with a known fingerprint only the rules ('mustMatch', lengths, ranges) are checked again.
+ (⚠️) '+validateResponse:fromAPIMethod:' validates responses according to the policy of the API method: each one,
+      one of N, only the changed structure or none. Specific validation methods ignore the policy.
+ (⚠️) In the background mode the validation of the API method does not block the mapper and the completion.
+      The schema drift is reported through 'validationDriftHandler' and the counters instead of the error.
+ (⚠️) Errors of the automatic validation are recorded as 'ValidationIssue' objects. The messages of 'userInfoArray'
+      are formatted only when they are read. The issues are counted by kind, see '+validationIssueCountOfKind:'.
  --------------------------------------------------------------------------------------------------------------*/
 
 
@@ -59,6 +150,45 @@ typedef NS_OPTIONS(NSUInteger, ResponseValidationMask) {
 
 
 
+#pragma mark - Validation Policy
+/*--------------------------------------------------------------------------------------------------------------
+ Sets the validation policy of the API method for '+validateResponse:fromAPIMethod:'. Default 'ValidationPolicy_Full'.
+ After the failure of the sampled validation the API method is validated fully for the next
+ 'validationEscalationLength' responses, regardless of the policy.
+ --------------------------------------------------------------------------------------------------------------*/
++ (void) setValidationPolicy:(ValidationPolicy)policy forAPIMethod:(APIMethod)method;
++ (ValidationPolicy) validationPolicyForAPIMethod:(APIMethod)method;
+
+/*--------------------------------------------------------------------------------------------------------------
+ Returns 'YES' while the API method is validated fully after the failure.
+ --------------------------------------------------------------------------------------------------------------*/
++ (BOOL) isValidationEscalatedForAPIMethod:(APIMethod)method;
+
+@property (class, nonatomic, assign) NSUInteger validationSampleRate;        // default 20 (one of 20 responses)
+@property (class, nonatomic, assign) NSUInteger validationEscalationLength;  // default 50 responses
+
+
+
+#pragma mark - Background Validation
+/*--------------------------------------------------------------------------------------------------------------
+ Validates the responses of the API method on 'backgroundValidationQueue' (QOS_CLASS_UTILITY).
+ '+validateResponse:fromAPIMethod:' returns 'nil' at once, mapping and delivery do not wait for the validation.
+ Failures do not fail the request: they are counted and passed to 'validationDriftHandler'. Default 'NO'.
+ --------------------------------------------------------------------------------------------------------------*/
++ (void) setAsynchronousValidation:(BOOL)isAsynchronous forAPIMethod:(APIMethod)method;
++ (BOOL) isAsynchronousValidationForAPIMethod:(APIMethod)method;
+
+/*--------------------------------------------------------------------------------------------------------------
+ Counters of the background validation: responses processed and responses which failed the validation.
+ --------------------------------------------------------------------------------------------------------------*/
++ (NSUInteger) backgroundValidationCountForAPIMethod:(APIMethod)method;
++ (NSUInteger) driftCountForAPIMethod:(APIMethod)method;
+
+@property (class, nonatomic, copy, nullable) ValidationDriftHandler validationDriftHandler;
+@property (class, nonatomic, readonly, strong) dispatch_queue_t backgroundValidationQueue;
+
+
+
 #pragma mark - Automatic Validation (for pair json + template)
 /*--------------------------------------------------------------------------------------------------------------
  The automatic validation method verifies the received json and the sample from disk.
@@ -78,6 +208,17 @@ typedef NS_OPTIONS(NSUInteger, ResponseValidationMask) {
                                   validationMask:(ResponseValidationMask)mask
                                    fromAPIMethod:(APIMethod)method;
 
+/*--------------------------------------------------------------------------------------------------------------
+ Number of invalid elements after which the check of an array is stopped ('CheckArrayElements'). Default 10.
+ --------------------------------------------------------------------------------------------------------------*/
+@property (class, nonatomic, assign) NSUInteger arrayValidationErrorLimit;
+
+/*--------------------------------------------------------------------------------------------------------------
+ Number of issues of the kind found by the automatic validation since the start or the last reset.
+ --------------------------------------------------------------------------------------------------------------*/
++ (NSUInteger) validationIssueCountOfKind:(ValidationIssueKind)kind;
++ (void) resetValidationIssueCounters;
+
 
 
 
@@ -103,6 +244,19 @@ typedef NS_OPTIONS(NSUInteger, ResponseValidationMask) {
  --------------------------------------------------------------------------------------------------------------*/
 + (NSError* _Nullable) validateResponseFrom_friendsGet:(NSDictionary*)recievedJSON;
 
+
+
+#pragma mark - Benchmark
+
+#if DEBUG
+/*--------------------------------------------------------------------------------------------------------------
+ Validates a synthetic 'wall.get' payload with 100 posts 'iterations' times: without the compiled plan,
+ with the plan and with the plan and the fingerprints of the passed structures.
+ Prints the time per response to the console.
+ --------------------------------------------------------------------------------------------------------------*/
++ (void) benchmarkValidation:(NSUInteger)iterations;
+#endif
+
 @end
 
 
@@ -164,6 +318,7 @@ typedef NS_OPTIONS(NSUInteger, ResponseValidationMask) {
   👉🏻 "lengthMustBeEqualOrLessThan"    - The length of the value in json must be greater than or equal to this digit.
   👉🏻 "hasSuffix"                      - The value in json must contain this suffix.
   👉🏻 "matchWithOneOf"                 - The value in json must be indentical to one of the objects in the array.
+  👉🏻 "matchesPattern"                 - The whole value in json must match this regular expression.
  
  
   Example:
@@ -9,8 +9,12 @@
 #import "Validator.h"
 // APIManager's Categories
 #import "APIManager+Utilites.h"
+// Properties of API methods
+#import "APIMethodRegistry.h"
 // Recovers json files from disk using APIMethod keys
 #import "Templater.h"
+// System
+#import <stdatomic.h>
 
 
 /*--------------------------------------------------------------------------------------------------------------
@@ -27,6 +31,7 @@ NSString * const lengthMustBeEqualOrGreaterThanKey = @"lengthMustBeEqualOrGreate
 NSString * const lengthMustBeEqualOrLessThanKey    = @"lengthMustBeEqualOrLessThan";
 NSString * const hasSuffixKey                      = @"hasSuffix";
 NSString * const matchWithOneOfKey                 = @"matchWithOneOf";
+NSString * const matchesPatternKey                 = @"matchesPattern";
 
 // For Arrays
 NSString * const elementsMustBeEqualOrMoreThanKey  = @"elementsMustBeEqualOrMoreThan";
@@ -43,7 +48,8 @@ NSString * const maximumKey  = @"maximum";
  ---------------------------------------------------------------------------------------------------------------
  
  1. Add the new key as a constant in the header of the file.
- 2. Add new key handling to different types of validation methods:
+ 2. Read the key into 'ValidationRules' in 'ValidationRulesCompile()'. It is called once per template.
+ 3. Add new key handling to different types of validation methods:
      +validateString:
      +validateArray:
      +validateDictionary:
@@ -63,10 +69,582 @@ NSString * const maximumKey  = @"maximum";
  
  3. By pre-adding the value for the new API method to the APIMethod enumeration.
  
- 4. In the +validateResponse:fromAPIMethod: method, add your validation method to the switch construct.
+ 4. Add the name of your validation method to the line of the API method in 'APIMethodRegistry.m'.
  --------------------------------------------------------------------------------------------------------------*/
 
 
+#pragma mark - Validation Plans
+
+/*--------------------------------------------------------------------------------------------------------------
+ Type tags of values. Replace the comparison of the names of superclasses: one 'isKindOfClass:' instead of
+ 'NSStringFromClass' and string comparison for each value.
+ --------------------------------------------------------------------------------------------------------------*/
+static inline ValidationValueType ValidationTypeOf(id _Nullable value)
+{
+    if (!value) return ValidationValueType_None;
+    if ([value isKindOfClass:[NSString class]])     return ValidationValueType_String;
+    if ([value isKindOfClass:[NSNumber class]])     return ValidationValueType_Number;
+    if ([value isKindOfClass:[NSDictionary class]]) return ValidationValueType_Dictionary;
+    if ([value isKindOfClass:[NSArray class]])      return ValidationValueType_Array;
+    if ([value isKindOfClass:[NSNull class]])       return ValidationValueType_Null;
+    return ValidationValueType_Other;
+}
+
+static NSString* ValidationTypeName(ValidationValueType type)
+{
+    switch (type) {
+        case ValidationValueType_None:       return @"(null)";
+        case ValidationValueType_String:     return @"NSString";
+        case ValidationValueType_Number:     return @"NSNumber";
+        case ValidationValueType_Array:      return @"NSArray";
+        case ValidationValueType_Dictionary: return @"NSDictionary";
+        case ValidationValueType_Null:       return @"NSNull";
+        default:                             return @"NSObject";
+    }
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ 'mustMatch' of arrays: the strings of 'jsonArray' are compared with the lowercased strings of the template,
+ ignoring case. Other elements are skipped. Nothing is allocated.
+ --------------------------------------------------------------------------------------------------------------*/
+static BOOL ValidationStringsMatchIgnoringCase(NSArray* jsonArray, NSArray<NSString*>* lowercaseTemplate)
+{
+    NSUInteger index = 0;
+    for (id value in jsonArray){
+        if (![value isKindOfClass:[NSString class]]) continue;
+        if ((index >= lowercaseTemplate.count) ||
+            ([value caseInsensitiveCompare:lowercaseTemplate[index]] != NSOrderedSame)) return NO;
+        index++;
+    }
+    return (index == lowercaseTemplate.count);
+}
+
+
+/*--------------------------------------------------------------------------------------------------------------
+ 'ValidationRules' - the dictionary '<key>-Rules' compiled into typed fields.
+ The dictionary is read once, when the plan is compiled: the values for 'mustMatch' are cleaned of rules and
+ lowercased, 'matchWithOneOf' becomes a set of lowercased strings, 'matchesPattern' a compiled regular expression.
+ Checking a value against the rules allocates nothing until a rule fails.
+ --------------------------------------------------------------------------------------------------------------*/
+@interface ValidationRules : NSObject
+@property (nonatomic, assign) BOOL isOptional;
+@property (nonatomic, assign) BOOL mustMatch;
+@property (nonatomic, assign) BOOL equalInLength;
+// Template value prepared for 'mustMatch': lowercased strings of an array, a dictionary without rules
+@property (nonatomic, strong, nullable) id mustMatchValue;
+// Bounds as they are written in the template. They are also the 'limit' of the issues
+@property (nonatomic, strong, nullable) NSNumber* lengthMin;
+@property (nonatomic, strong, nullable) NSNumber* lengthMax;
+@property (nonatomic, strong, nullable) NSNumber* elementsMin;
+@property (nonatomic, strong, nullable) NSNumber* elementsMax;
+@property (nonatomic, strong, nullable) NSNumber* minimum;
+@property (nonatomic, strong, nullable) NSNumber* maximum;
+// 'lengthMin > lengthMax' or 'minimum > maximum'. The value is not checked against such bounds
+@property (nonatomic, assign) BOOL hasInvalidLength;
+@property (nonatomic, assign) BOOL hasInvalidRange;
+@property (nonatomic, strong, nullable) NSString* hasSuffix;
+@property (nonatomic, strong, nullable) NSArray*  matchWithOneOf;
+@property (nonatomic, strong, nullable) NSSet<NSString*>* matchWithOneOfSet;
+// 'patternExpression' is nil if 'pattern' is not a valid regular expression
+@property (nonatomic, strong, nullable) NSString* pattern;
+@property (nonatomic, strong, nullable) NSRegularExpression* patternExpression;
+@end
+
+@implementation ValidationRules
+@end
+
+
+@interface Validator ()
+// Helpers. Called once, when the rules are compiled
++ (NSArray*) lowercaseArray:(NSArray*)array;
++ (NSDictionary* _Nullable) removeAllRulesFromDictionaryAndNastedStructure:(NSDictionary*)dictionary;
+@end
+
+
+// Compiled regular expressions by their patterns. 'NSNull' - the pattern is invalid
+static NSMutableDictionary<NSString*,id>* _patternExpressions = nil;
+
+static NSRegularExpression* _Nullable ValidationPatternExpression(NSString* pattern)
+{
+    @synchronized ([NSNotificationCenter defaultCenter]){
+        if (!_patternExpressions) _patternExpressions = [NSMutableDictionary new];
+
+        id expression = _patternExpressions[pattern];
+        if (!expression){
+            expression = [NSRegularExpression regularExpressionWithPattern:pattern options:0 error:nil] ?: [NSNull null];
+            _patternExpressions[pattern] = expression;
+        }
+        return (expression == [NSNull null]) ? nil : expression;
+    }
+}
+
+static NSNumber* _Nullable ValidationRuleNumber(NSDictionary* rules, NSString* key)
+{
+    id value = rules[key];
+    if ([value isKindOfClass:[NSNumber class]]) return value;
+    if ([value isKindOfClass:[NSString class]]) return @([value doubleValue]);
+    return nil;
+}
+
+static ValidationRules* ValidationRulesCompile(NSDictionary* rules, id templateValue)
+{
+    ValidationRules* compiled = [ValidationRules new];
+    compiled.isOptional    = [rules[isOptionalKey]    boolValue];
+    compiled.mustMatch     = [rules[mustMatchKey]     boolValue];
+    compiled.equalInLength = [rules[equalInLengthKey] boolValue];
+
+    compiled.lengthMin   = ValidationRuleNumber(rules, lengthMustBeEqualOrGreaterThanKey);
+    compiled.lengthMax   = ValidationRuleNumber(rules, lengthMustBeEqualOrLessThanKey);
+    compiled.elementsMin = ValidationRuleNumber(rules, elementsMustBeEqualOrMoreThanKey);
+    compiled.elementsMax = ValidationRuleNumber(rules, elementsMustBeEqualOrLessThanKey);
+    compiled.minimum     = ValidationRuleNumber(rules, minimumKey);
+    compiled.maximum     = ValidationRuleNumber(rules, maximumKey);
+
+    compiled.hasInvalidLength = (compiled.lengthMin) && (compiled.lengthMax) &&
+                                ([compiled.lengthMin integerValue] > [compiled.lengthMax integerValue]);
+    compiled.hasInvalidRange  = (compiled.minimum) && (compiled.maximum) &&
+                                ([compiled.minimum floatValue] > [compiled.maximum floatValue]);
+
+    NSString* hasSuffix = rules[hasSuffixKey];
+    if ([hasSuffix isKindOfClass:[NSString class]]) compiled.hasSuffix = hasSuffix;
+
+    NSArray* matchWithOneOf = rules[matchWithOneOfKey];
+    if (([matchWithOneOf isKindOfClass:[NSArray class]]) && (matchWithOneOf.count > 0)){
+        compiled.matchWithOneOf    = matchWithOneOf;
+        compiled.matchWithOneOfSet = [NSSet setWithArray:[Validator lowercaseArray:matchWithOneOf]];
+    }
+
+    NSString* pattern = rules[matchesPatternKey];
+    if ([pattern isKindOfClass:[NSString class]]){
+        compiled.pattern           = pattern;
+        compiled.patternExpression = ValidationPatternExpression(pattern);
+    }
+
+    if (compiled.mustMatch){
+        switch (ValidationTypeOf(templateValue)) {
+            case ValidationValueType_Array:
+                compiled.mustMatchValue = [Validator lowercaseArray:templateValue];
+                break;
+            case ValidationValueType_Dictionary:
+                compiled.mustMatchValue = [Validator removeAllRulesFromDictionaryAndNastedStructure:templateValue];
+                break;
+            default:
+                compiled.mustMatchValue = templateValue;
+                break;
+        }
+    }
+    return compiled;
+}
+
+
+/*--------------------------------------------------------------------------------------------------------------
+ 'ValidationPlanEntry' - one key of the template with everything that is needed to check it.
+ --------------------------------------------------------------------------------------------------------------*/
+@class ValidationPlan;
+
+@interface ValidationPlanEntry : NSObject
+@property (nonatomic, strong) NSString* key;
+@property (nonatomic, strong) id        templateValue;
+@property (nonatomic, assign) ValidationValueType type;
+// Dictionary '<key>-Rules' from the template, if it exists
+@property (nonatomic, strong, nullable) ValidationRules* rules;
+@property (nonatomic, assign)           BOOL            isOptional;
+// Plan of the nested dictionary, if the template value is a non-empty dictionary
+@property (nonatomic, strong, nullable) ValidationPlan* subPlan;
+// The key or its nested dictionaries have rules
+@property (nonatomic, assign)           BOOL            hasRules;
+// Type and plan of the first element of the template array. All elements of the received array are checked by them
+@property (nonatomic, assign)           ValidationValueType elementType;
+@property (nonatomic, strong, nullable) ValidationPlan*     elementPlan;
+@end
+
+@implementation ValidationPlanEntry
+@end
+
+
+/*--------------------------------------------------------------------------------------------------------------
+ 'ValidationPlan' - the template compiled into a flat ordered list of keys.
+ The template is walked once, when the plan is compiled. Each response is then checked against the list in one
+ pass: every key is looked up in the response by hash, without scanning the array of its keys.
+ --------------------------------------------------------------------------------------------------------------*/
+@interface ValidationPlan : NSObject
+@property (nonatomic, strong) NSArray<ValidationPlanEntry*>* entries;
+@property (nonatomic, assign) BOOL hasRules;
+// Fingerprints of the responses (mixed with the mask) which passed all structural checks of the plan.
+// The least recently passed one is first
+@property (nonatomic, strong) NSMutableOrderedSet<NSNumber*>* passedShapes;
+@end
+
+@implementation ValidationPlan
+@end
+
+
+static ValidationPlan* ValidationPlanCompile(NSDictionary* templateJSON)
+{
+    NSMutableArray<ValidationPlanEntry*>* entries = [NSMutableArray arrayWithCapacity:templateJSON.count];
+    BOOL hasRules = NO;
+
+    for (NSString* key in templateJSON)
+    {
+        if ([key hasSuffix:@"-Rules"]) continue;
+
+        ValidationPlanEntry* entry = [ValidationPlanEntry new];
+        entry.key           = key;
+        entry.templateValue = templateJSON[key];
+        entry.type          = ValidationTypeOf(entry.templateValue);
+
+        NSDictionary* rules = templateJSON[str(@"%@-Rules",key)];
+        if (([rules isKindOfClass:[NSDictionary class]]) && (rules.count > 0)){
+            entry.rules      = ValidationRulesCompile(rules, entry.templateValue);
+            entry.isOptional = entry.rules.isOptional;
+        }
+        if ((entry.type == ValidationValueType_Dictionary) && ([entry.templateValue count] > 0)){
+            entry.subPlan = ValidationPlanCompile(entry.templateValue);
+        }
+        if ((entry.type == ValidationValueType_Array) && ([entry.templateValue count] > 0)){
+            id element = [entry.templateValue firstObject];
+            entry.elementType = ValidationTypeOf(element);
+            if ((entry.elementType == ValidationValueType_Dictionary) && ([element count] > 0)){
+                entry.elementPlan = ValidationPlanCompile(element);
+            }
+        }
+        entry.hasRules = (entry.rules) || (entry.subPlan.hasRules) || (entry.elementPlan.hasRules);
+        hasRules = hasRules || entry.hasRules;
+        [entries addObject:entry];
+    }
+
+    ValidationPlan* plan = [ValidationPlan new];
+    plan.entries      = entries;
+    plan.hasRules     = hasRules;
+    plan.passedShapes = [NSMutableOrderedSet new];
+    return plan;
+}
+
+// Arrays shorter than this are checked on the calling thread
+#define parallelElementsThreshold 512
+// The smallest part of the array which is checked by one thread
+#define minElementsPerChunk       128
+#define defaultArrayValidationErrorLimit 10
+
+static NSUInteger _arrayValidationErrorLimit = defaultArrayValidationErrorLimit;
+
+// Fingerprints remembered by one plan. The least recently passed one is forgotten first
+#define maxPassedShapes 16
+
+// Compiled plans. Keys are the templates themselves (by address), held weakly
+static NSMapTable<NSDictionary*,ValidationPlan*>* _plans = nil;
+
+
+#pragma mark - Validation Issues
+
+/*--------------------------------------------------------------------------------------------------------------
+ 'ValidationElementPath' - one step of the path to the invalid array element ('items[12]').
+ Created only for the elements which have issues.
+ --------------------------------------------------------------------------------------------------------------*/
+@interface ValidationElementPath : NSObject
+@property (nonatomic, strong) NSString*   key;
+@property (nonatomic, assign) NSUInteger  index;
+// Path inside the element, if the issue is in a nested array
+@property (nonatomic, strong, nullable) ValidationElementPath* next;
+@end
+
+@implementation ValidationElementPath
+@end
+
+
+@interface ValidationIssue ()
+@property (nonatomic, assign, readwrite) ValidationIssueKind kind;
+@property (nonatomic, strong, readwrite, nullable) NSString* key;
+@property (nonatomic, strong, readwrite, nullable) NSString* rule;
+@property (nonatomic, assign, readwrite) ValidationValueType expectedType;
+@property (nonatomic, assign, readwrite) ValidationValueType actualType;
+@property (nonatomic, strong, readwrite, nullable) id value;
+@property (nonatomic, strong, readwrite, nullable) id limit;
+@property (nonatomic, strong, nullable) ValidationElementPath* elementPath;
+@end
+
+
+/*--------------------------------------------------------------------------------------------------------------
+ Records the issue without formatting anything. 'key' and 'rule' are the strings of the template and of the
+ constants, so the issue holds only pointers to the existing objects.
+ --------------------------------------------------------------------------------------------------------------*/
+static ValidationIssue* ValidationIssueMake(ValidationIssueKind kind, NSString* _Nullable key, NSString* _Nullable rule,
+                                            id _Nullable value, id _Nullable limit)
+{
+    ValidationIssue* issue = [ValidationIssue new];
+    issue.kind       = kind;
+    issue.key        = key;
+    issue.rule       = rule;
+    issue.value      = value;
+    issue.limit      = limit;
+    issue.actualType = ValidationTypeOf(value);
+    return issue;
+}
+
+static ValidationIssue* ValidationTypeIssueMake(NSString* _Nullable key, ValidationValueType actualType, ValidationValueType expectedType)
+{
+    ValidationIssue* issue = [ValidationIssue new];
+    issue.kind         = ValidationIssueKind_TypeMismatch;
+    issue.key          = key;
+    issue.actualType   = actualType;
+    issue.expectedType = expectedType;
+    return issue;
+}
+
+
+@implementation ValidationIssue
+
+- (nullable NSString*) keyPath
+{
+    if (!self.elementPath) return nil;
+
+    NSMutableString* keyPath = [NSMutableString new];
+    for (ValidationElementPath* step = self.elementPath; step; step = step.next){
+        if (keyPath.length > 0) [keyPath appendString:@"."];
+        [keyPath appendFormat:@"%@[%lu]",step.key,(unsigned long)step.index];
+    }
+    return keyPath;
+}
+
+- (NSString*) message
+{
+    NSString* message = nil;
+    NSString* key     = self.key;
+
+    switch (self.kind) {
+        case ValidationIssueKind_MissingKey:
+            message = str(@"json hasn't '%@' key",key);
+            break;
+        case ValidationIssueKind_TypeMismatch:
+            message = (key) ? str(@"Value for key '%@' in recievedJSON has class (%@)\n"
+                                  "Value for key '%@' in templateJSON has class (%@).",
+                                  key,ValidationTypeName(self.actualType),key,ValidationTypeName(self.expectedType))
+                            : str(@"Element has class (%@), element of templateJSON has class (%@).",
+                                  ValidationTypeName(self.actualType),ValidationTypeName(self.expectedType));
+            break;
+        case ValidationIssueKind_RuleViolation:
+            message = [self ruleViolationMessage];
+            break;
+        case ValidationIssueKind_InvalidRules:
+            if ([self.rule isEqualToString:minimumKey])
+                message = str(@"Invalid rules (minimum (cannot be greater than)> maximum) in key(%@))",key);
+            else if ([self.rule isEqualToString:matchesPatternKey])
+                message = str(@"Invalid rules (matchesPattern (%@) is not a regular expression) in key(%@)",self.limit,key);
+            else
+                message = str(@"Invalid rules (lengthMustBeEqualOrGreaterThan (cannot be greater than)> lengthMustBeEqualOrLessThan) in key(%@) value(%@)",key,self.value);
+            break;
+        case ValidationIssueKind_InvalidParams:
+            message = str(@"One of params (in +validateJSONValue:...) is nil. By key (%@)",key);
+            break;
+        case ValidationIssueKind_ArrayCheckStopped:
+            message = str(@"Check of '%@' was stopped after %@ invalid elements of %@",key,self.value,self.limit);
+            break;
+        default:
+            message = str(@"Unknown issue by key(%@)",key);
+            break;
+    }
+
+    NSString* keyPath = self.keyPath;
+    return (keyPath) ? str(@"%@: %@",keyPath,message) : message;
+}
+
+- (NSString*) ruleViolationMessage
+{
+    NSString* key  = self.key;
+    NSString* rule = self.rule;
+
+    if ([rule isEqualToString:hasSuffixKey])
+        return str(@"The value(%@) by key(%@) hasn't requiered suffix(%@)",self.value,key,self.limit);
+    if ([rule isEqualToString:matchWithOneOfKey])
+        return str(@"The value(%@) by key(%@) not found in the allowed array(%@))",self.value,key,self.limit);
+    if ([rule isEqualToString:matchesPatternKey])
+        return str(@"The value(%@) by key(%@) does not match the pattern(%@)",self.value,key,self.limit);
+    if (([rule isEqualToString:mustMatchKey]) && (self.actualType == ValidationValueType_Number))
+        return str(@"Number by key(%@) from json not matches with templete value(%@))",key,self.limit);
+    if (([rule isEqualToString:mustMatchKey]) && (self.actualType == ValidationValueType_Dictionary))
+        return str(@"The value by key(%@) not match with required=(%@)",key,self.limit);
+    if ([rule isEqualToString:mustMatchKey])
+        return str(@"The value by key(%@) not match with required=%@)",key,self.limit);
+    if ([rule isEqualToString:equalInLengthKey])
+        return str(@"The length of values for key(%@) does not match",key);
+    if ([rule isEqualToString:lengthMustBeEqualOrGreaterThanKey])
+        return str(@"The length of the key(%@) value is less than the required length. Must be greater than %@",key,self.limit);
+    if ([rule isEqualToString:lengthMustBeEqualOrLessThanKey])
+        return str(@"The length of the key(%@) value is greater than the required length. Must be less than %@",key,self.limit);
+    if ([rule isEqualToString:elementsMustBeEqualOrMoreThanKey])
+        return str(@"Array by key(%@) from json has less elements than required(%@)",key,self.limit);
+    if ([rule isEqualToString:elementsMustBeEqualOrLessThanKey])
+        return str(@"Array by key(%@) from json has greater elements than required(%@)",key,self.limit);
+    if ([rule isEqualToString:minimumKey])
+        return str(@"Number by key(%@) from json has value(%f). But mandatory minimum is (%f))",key,[self.value floatValue],[self.limit floatValue]);
+    if ([rule isEqualToString:maximumKey])
+        return str(@"Number by key(%@) from json has value(%f). But mandatory maximum is (%f))",key,[self.value floatValue],[self.limit floatValue]);
+
+    return str(@"The value by key(%@) does not satisfy the rule (%@)",key,rule);
+}
+
+@end
+
+
+/*--------------------------------------------------------------------------------------------------------------
+ 'ValidationIssueMessages' - the array of the messages of the issues (userInfo[@"userInfoArray"]).
+ A message is formatted only when it is read.
+ --------------------------------------------------------------------------------------------------------------*/
+@interface ValidationIssueMessages : NSArray
+@property (nonatomic, strong) NSArray<ValidationIssue*>* issues;
+@end
+
+@implementation ValidationIssueMessages
+
+- (NSUInteger) count
+{
+    return self.issues.count;
+}
+
+- (id) objectAtIndex:(NSUInteger)index
+{
+    return self.issues[index].message;
+}
+
+@end
+
+
+static NSUInteger _validationIssueCounters[ValidationIssueKindCount] = {0};
+
+
+
+#pragma mark - Validation Policies
+
+#define defaultValidationSampleRate       20
+#define defaultValidationEscalationLength 50
+
+static inline NSUInteger ValidationMix(NSUInteger value)
+{
+    value = (value ^ (value >> 31)) * 0x7fb5d329728ea185ULL;
+    return value ^ (value >> 27);
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ Structural fingerprint of the value: keys and type tags of all nested dictionaries in one pass.
+ The values themselves are not taken into account, so the responses with the same structure have the same fingerprint.
+ --------------------------------------------------------------------------------------------------------------*/
+static NSUInteger ValidationShapeFingerprint(id _Nullable value)
+{
+    ValidationValueType type = ValidationTypeOf(value);
+    NSUInteger fingerprint   = ValidationMix(type + 1);
+
+    if (type == ValidationValueType_Dictionary){
+        // The order of the keys in 'NSDictionary' is not defined, so the mixed pairs are summed
+        for (NSString* key in (NSDictionary*)value){
+            fingerprint += ValidationMix(key.hash ^ (ValidationShapeFingerprint(value[key]) * 31));
+        }
+    } else if ((type == ValidationValueType_Array) && ([value count] > 0)){
+        // All elements are validated, so each of them is taken into account. Every distinct shape is counted once:
+        // arrays of different length with the same elements have the same fingerprint
+        NSUInteger firstShape = ValidationShapeFingerprint([value firstObject]);
+        NSMutableSet<NSNumber*>* otherShapes = nil;
+        for (id element in (NSArray*)value){
+            NSUInteger shape = ValidationShapeFingerprint(element);
+            if (shape == firstShape) continue;
+            if (!otherShapes) otherShapes = [NSMutableSet new];
+            [otherShapes addObject:@(shape)];
+        }
+        fingerprint = ValidationMix(fingerprint ^ firstShape);
+        for (NSNumber* shape in otherShapes){
+            fingerprint += ValidationMix(shape.unsignedIntegerValue);
+        }
+    }
+    return fingerprint;
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ Structural fingerprint of the response over the keys described by the plan: their type tags, nested dictionaries
+ and distinct shapes of array elements. Keys which the template does not describe are not validated,
+ so they do not change the fingerprint.
+ --------------------------------------------------------------------------------------------------------------*/
+static NSUInteger ValidationPlanShapeFingerprint(ValidationPlan* plan, id _Nullable value)
+{
+    ValidationValueType type = ValidationTypeOf(value);
+    NSUInteger fingerprint   = ValidationMix(type + 1);
+    if (type != ValidationValueType_Dictionary) return fingerprint;
+
+    for (ValidationPlanEntry* entry in plan.entries)
+    {
+        id         valueOfKey = ((NSDictionary*)value)[entry.key];
+        NSUInteger shape      = ValidationMix(ValidationTypeOf(valueOfKey) + 1);
+
+        if ((entry.subPlan) && ([valueOfKey isKindOfClass:[NSDictionary class]])){
+            shape = ValidationPlanShapeFingerprint(entry.subPlan, valueOfKey);
+        }
+        // Elements are checked only against the first element of the template array
+        else if ((entry.elementType != ValidationValueType_None) && ([valueOfKey isKindOfClass:[NSArray class]]) && ([valueOfKey count] > 0))
+        {
+            // Every distinct shape of the elements is counted once, as in 'ValidationShapeFingerprint'
+            NSUInteger firstShape = (entry.elementPlan) ? ValidationPlanShapeFingerprint(entry.elementPlan, [valueOfKey firstObject]) :
+                                                          ValidationMix(ValidationTypeOf([valueOfKey firstObject]) + 1);
+            NSMutableSet<NSNumber*>* otherShapes = nil;
+            for (id element in (NSArray*)valueOfKey){
+                NSUInteger elementShape = (entry.elementPlan) ? ValidationPlanShapeFingerprint(entry.elementPlan, element) :
+                                                                ValidationMix(ValidationTypeOf(element) + 1);
+                if (elementShape == firstShape) continue;
+                if (!otherShapes) otherShapes = [NSMutableSet new];
+                [otherShapes addObject:@(elementShape)];
+            }
+            shape = ValidationMix(shape ^ firstShape);
+            for (NSNumber* otherShape in otherShapes){
+                shape += ValidationMix(otherShape.unsignedIntegerValue);
+            }
+        }
+        fingerprint += ValidationMix(entry.key.hash ^ (shape * 31));
+    }
+    return fingerprint;
+}
+
+// The fingerprint computed by the validation policy, handed down to '+automaticValidateResponse:...' of the same thread
+typedef struct {
+    const void* response;
+    const void* plan;
+    NSUInteger  shape;
+} ValidationKnownShape;
+
+static __thread ValidationKnownShape _knownShape;
+
+
+/*--------------------------------------------------------------------------------------------------------------
+ 'ValidationPolicyState' - the validation policy of one API method and the counters it needs.
+ --------------------------------------------------------------------------------------------------------------*/
+@interface ValidationPolicyState : NSObject
+@property (nonatomic, assign) ValidationPolicy policy;
+// Number of responses received under 'ValidationPolicy_Sampled'
+@property (nonatomic, assign) NSUInteger responseCounter;
+// Number of responses left to validate fully after the failure
+@property (nonatomic, assign) NSUInteger escalatedResponses;
+// Fingerprint of the last response which passed the validation
+@property (nonatomic, assign) NSUInteger validShape;
+@property (nonatomic, assign) BOOL       hasValidShape;
+// Responses are validated on 'backgroundValidationQueue', the caller does not wait for the result
+@property (nonatomic, assign) BOOL       isAsynchronous;
+@property (nonatomic, assign) NSUInteger backgroundValidations;
+@property (nonatomic, assign) NSUInteger driftedResponses;
+@end
+
+@implementation ValidationPolicyState
+@end
+
+
+static NSUInteger _validationSampleRate       = defaultValidationSampleRate;
+static NSUInteger _validationEscalationLength = defaultValidationEscalationLength;
+static NSMutableDictionary<NSNumber*,ValidationPolicyState*>* _validationPolicies = nil;
+
+// Responses waiting for the background validation. New ones are dropped above the limit
+#define maxPendingBackgroundValidations 32
+
+static dispatch_queue_t       _backgroundValidationQueue    = nil;
+static NSUInteger             _pendingBackgroundValidations = 0;
+static ValidationDriftHandler _validationDriftHandler       = nil;
+
+
+
 @implementation Validator
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -94,16 +672,38 @@ NSString * const maximumKey  = @"maximum";
  --------------------------------------------------------------------------------------------------------------*/
 + (NSError* _Nullable) validateResponse:(NSDictionary*)recievedJSON fromAPIMethod:(APIMethod)method
 {
-    NSError* error  = nil;
-    switch (method) {
-        case APIMethod_UserGet: error = [Validator validateResponseFrom_usersGet:recievedJSON]; break;
-        case APIMethod_WallGet: error = [Validator validateResponseFrom_wallGet:recievedJSON];  break;
-      
-        case APIMethod_PhotosGetAll: error = [Validator validateResponseFrom_photosGetAll:recievedJSON];  break;
-        case APIMethod_FriendsGet:   error = [Validator validateResponseFrom_friendsGet:recievedJSON];    break;
-            
-        default: APILog(@"+validateResponse:fromAPIMethod: | Switch not found mathes!"); break;
+    SEL validator = APIMethodResponseValidator(method);
+    if (!validator){
+        APILog(@"+validateResponse:fromAPIMethod: | Validation method is not registered for '%@'",[APIManager convertAPIMethodToString:method]);
+        return nil;
+    }
+
+    // Mapping and delivery do not wait: the failure is reported to 'validationDriftHandler'
+    if ([Validator isAsynchronousValidationForAPIMethod:method]){
+        [Validator validateInBackgroundResponse:recievedJSON fromAPIMethod:method validator:validator];
+        return nil;
+    }
+    return [Validator validateResponse:recievedJSON fromAPIMethod:method validator:validator];
+}
+
+
+/*--------------------------------------------------------------------------------------------------------------
+ [Internal method]
+ Calls the validation method of the API method according to its validation policy.
+ --------------------------------------------------------------------------------------------------------------*/
++ (NSError* _Nullable) validateResponse:(NSDictionary*)recievedJSON fromAPIMethod:(APIMethod)method validator:(SEL)validator
+{
+    NSUInteger shape = 0;
+    NSError*   error = nil;
+    if ([Validator shouldValidateResponse:recievedJSON fromAPIMethod:method shape:&shape])
+    {
+        NSError* (*validate)(id, SEL, NSDictionary*) = (void*)[Validator methodForSelector:validator];
+        error = validate([Validator class], validator, recievedJSON);
+
+        [Validator recordValidationError:error fromAPIMethod:method shape:shape];
     }
+    // The fingerprint belongs only to this response
+    _knownShape = (ValidationKnownShape){ 0 };
     return error;
 }
 
@@ -129,6 +729,18 @@ NSString * const maximumKey  = @"maximum";
 
 #pragma mark - Specific Validation Methods (for specific API methods)
 
+/*--------------------------------------------------------------------------------------------------------------
+ [Internal method]
+ Returns the validation mask of the API method: 'AllChecks' and 'CheckArrayElements' if the registry asks for it.
+ --------------------------------------------------------------------------------------------------------------*/
++ (ResponseValidationMask) validationMaskForAPIMethod:(APIMethod)method
+{
+    ResponseValidationMask mask = AllChecks;
+    if (APIMethodInfoFor(method)->checksArrayElements) mask |= CheckArrayElements;
+    return mask;
+}
+
+
 /*--------------------------------------------------------------------------------------------------------------
  The method validates the server response to the "users.get" method request.
  ------------------------------------------------------------
@@ -143,7 +755,7 @@ NSString * const maximumKey  = @"maximum";
     
     NSError* error = [Validator automaticValidateResponse:recievedJSON
                                                  template:template
-                                           validationMask:AllChecks
+                                           validationMask:[Validator validationMaskForAPIMethod:APIMethod_UserGet]
                                             fromAPIMethod:APIMethod_UserGet];
     return error;
 }
@@ -151,6 +763,7 @@ NSString * const maximumKey  = @"maximum";
 
 /*--------------------------------------------------------------------------------------------------------------
 The method validates the server response to the request for the "wall.get" method.
+ Each post in 'items' is checked against the first post of the template.
  --------------------------------------------------------------------------------------------------------------*/
 + (NSError* _Nullable) validateResponseFrom_wallGet:(NSDictionary*)recievedJSON
 {
@@ -159,7 +772,7 @@ The method validates the server response to the request for the "wall.get" metho
     
     NSError* error = [Validator automaticValidateResponse:recievedJSON
                                                  template:template
-                                           validationMask:AllChecks
+                                           validationMask:[Validator validationMaskForAPIMethod:APIMethod_WallGet]
                                             fromAPIMethod:APIMethod_WallGet];
     return error;
 }
@@ -178,12 +791,18 @@ The method validates the server response to the request for the "wall.get" metho
 
 /*--------------------------------------------------------------------------------------------------------------
  The method validates the server response to the "friends.get" method request.
+ Each friend in 'items' is checked against the first friend of the template.
  --------------------------------------------------------------------------------------------------------------*/
 + (NSError* _Nullable) validateResponseFrom_friendsGet:(NSDictionary*)recievedJSON
 {
     NSDictionary* template = [Templater templateForAPIMethod:APIMethod_FriendsGet];
     if (!template) return nil;
-    return nil;
+    
+    NSError* error = [Validator automaticValidateResponse:recievedJSON
+                                                 template:template
+                                           validationMask:[Validator validationMaskForAPIMethod:APIMethod_FriendsGet]
+                                            fromAPIMethod:APIMethod_FriendsGet];
+    return error;
 }
 
 
@@ -228,108 +847,278 @@ ____    ____  ___       __       __   _______       ___   .___________. __    __
                                   validationMask:(ResponseValidationMask)mask
                                    fromAPIMethod:(APIMethod)method
 {
-    NSError* error      = nil;
-    BOOL isOccuredError = NO;
+    NSError* error = nil;
     NSString* domain;
-    NSMutableArray* userInfoArray = [NSMutableArray new];
     
-    if ((recievedJSON.allKeys.count < 1) || (templateJSON.allKeys.count < 1)){
+    if ((recievedJSON.count < 1) || (templateJSON.count < 1)){
         domain = [NSString stringWithFormat:@"'recievedJSON' or 'templateJSON' is nil."];
         domain = [NSString stringWithFormat:@"%@\nIn +[Validator automaticValidateResponse:template:validationMask:]",domain];
         return [NSError errorWithDomain:domain code:0 userInfo:nil];
     }
     
+    NSMutableArray<ValidationIssue*>* issues = [NSMutableArray new];
+    ValidationPlan* plan = [Validator planForTemplate:templateJSON];
+    
+    // The fingerprint may already be computed by the validation policy of the API method
+    BOOL isKnownShape = (_knownShape.response == (__bridge const void*)recievedJSON) && (_knownShape.plan == (__bridge const void*)plan);
+    NSUInteger responseShape = (isKnownShape) ? _knownShape.shape : ValidationPlanShapeFingerprint(plan, recievedJSON);
+    NSNumber*  shape = @(ValidationMix(responseShape ^ mask));
+    
+    BOOL isPassedShape = NO;
+    @synchronized (plan){
+        NSUInteger index = [plan.passedShapes indexOfObject:shape];
+        isPassedShape = (index != NSNotFound);
+        // The fingerprint becomes the most recent one
+        if ((isPassedShape) && (index + 1 < plan.passedShapes.count)){
+            [plan.passedShapes removeObjectAtIndex:index];
+            [plan.passedShapes addObject:shape];
+        }
+    }
+    
+    // The same structure has already passed: only the values are checked
+    if (isPassedShape){
+        if ((mask & CheckOnExtendedRules) && (plan.hasRules) &&
+            ([Validator runRulesOfPlan:plan onJSON:recievedJSON validationMask:mask issues:issues]))
+        {
+            error = [Validator errorWithIssues:issues fromAPIMethod:method];
+        }
+        return error;
+    }
+    
+    // We initialize an error if it occurs
+    if ([Validator runPlan:plan onJSON:recievedJSON validationMask:mask issues:issues])
+    {
+        error = [Validator errorWithIssues:issues fromAPIMethod:method];
+    } else {
+        @synchronized (plan){
+            // The least recently passed fingerprint is forgotten
+            if (plan.passedShapes.count >= maxPassedShapes) [plan.passedShapes removeObjectAtIndex:0];
+            [plan.passedShapes addObject:shape];
+        }
+    }
+    return error;
+}
+
+
+/*--------------------------------------------------------------------------------------------------------------
+ Builds the error of the automatic validation and adds the issues to the counters.
+ The messages of 'userInfoArray' are formatted only when they are read.
+ --------------------------------------------------------------------------------------------------------------*/
++ (NSError*) errorWithIssues:(NSArray<ValidationIssue*>*)issues fromAPIMethod:(APIMethod)method
+{
+    @synchronized ([NSNotificationCenter defaultCenter]){
+        for (ValidationIssue* issue in issues) _validationIssueCounters[issue.kind] += 1;
+    }
+    ValidationIssueMessages* messages = [ValidationIssueMessages new];
+    messages.issues = issues;
+
+    NSString* APIMethod = [API convertAPIMethodToString:method];
+    NSString* domain    = [NSString stringWithFormat:@"json recieved from API method (%@) has incorrect stucture",APIMethod];
+    return [NSError errorWithDomain:domain code:0 userInfo:@{ @"userInfoArray" : messages, @"validationIssues" : issues }];
+}
+
+
+/*--------------------------------------------------------------------------------------------------------------
+ Returns the compiled plan of the template. The template is compiled only on the first call.
+ --------------------------------------------------------------------------------------------------------------*/
++ (ValidationPlan*) planForTemplate:(NSDictionary*)templateJSON
+{
+    @synchronized ([ValidationPlan class])
+    {
+        if (!_plans){
+             _plans = [NSMapTable mapTableWithKeyOptions:NSPointerFunctionsWeakMemory | NSPointerFunctionsObjectPointerPersonality
+                                            valueOptions:NSPointerFunctionsStrongMemory];
+        }
+        ValidationPlan* plan = [_plans objectForKey:templateJSON];
+        if (!plan){
+            plan = ValidationPlanCompile(templateJSON);
+            [_plans setObject:plan forKey:templateJSON];
+        }
+        return plan;
+    }
+}
+
+
+/*--------------------------------------------------------------------------------------------------------------
+ Checks 'recievedJSON' against the plan. The issues found are added to 'issues'.
+ Returns 'YES' if errors were found.
+ --------------------------------------------------------------------------------------------------------------*/
++ (BOOL) runPlan:(ValidationPlan*)plan
+          onJSON:(NSDictionary*)recievedJSON
+  validationMask:(ResponseValidationMask)mask
+          issues:(NSMutableArray<ValidationIssue*>*)issues
+{
+    BOOL isOccuredError = NO;
+    
+    for (ValidationPlanEntry* entry in plan.entries)
+    {
+        id valueFromJSON = recievedJSON[entry.key];
+        ValidationValueType type = ValidationTypeOf(valueFromJSON);
+        
+        // Checking for keys
+        if ((!valueFromJSON) && (entry.isOptional)){
+            continue;
+        } else if ((!valueFromJSON) && (mask & CheckOnKeys)){
+            isOccuredError = YES;
+            [issues addObject:ValidationIssueMake(ValidationIssueKind_MissingKey, entry.key, nil, nil, nil)];
+            continue;
+        }
+        
+        // Errors of the main algorithm (another class, nested structures) cancel the check of rules for the key
+        NSUInteger errorsBeforeKey = issues.count;
+        
+        // Type checking
+        if ((mask & CheckOnTypesOfValues) && (type != entry.type)){
+            isOccuredError = YES;
+            [issues addObject:ValidationTypeIssueMake(entry.key, type, entry.type)];
+        }
+        
+        // Checking nesting
+        if ((mask & CheckSubEntityOnKeys) && (entry.subPlan) &&
+            (type == ValidationValueType_Dictionary) && ([valueFromJSON count] > 0))
+        {
+            if ([Validator runPlan:entry.subPlan onJSON:valueFromJSON validationMask:mask issues:issues]){
+                isOccuredError = YES;
+            }
+        }
+        
+        // Checking elements of arrays
+        if ((mask & CheckArrayElements) && (entry.elementType != ValidationValueType_None) &&
+            (type == ValidationValueType_Array) && ([valueFromJSON count] > 0))
+        {
+            if ([Validator runElementsOfEntry:entry onArray:valueFromJSON validationMask:mask rulesOnly:NO issues:issues]){
+                isOccuredError = YES;
+            }
+        }
+        
+        // We run a check for a dictionary with rules if we have passed all the previous checks
+        if ((mask & CheckOnExtendedRules) && (entry.rules) && (issues.count == errorsBeforeKey))
+        {
+            [Validator validateJSONValue:valueFromJSON templateValue:entry.templateValue key:entry.key onRules:entry.rules issues:issues];
+            if (issues.count > errorsBeforeKey) isOccuredError = YES;
+        }
+    }
+    return isOccuredError;
+}
+
+
+/*--------------------------------------------------------------------------------------------------------------
+ Checks only the rules of the plan. Used for the responses whose structure has already passed the plan:
+ keys and types are not checked again, the nested dictionaries without rules are not visited.
+ --------------------------------------------------------------------------------------------------------------*/
++ (BOOL) runRulesOfPlan:(ValidationPlan*)plan
+                 onJSON:(NSDictionary*)recievedJSON
+         validationMask:(ResponseValidationMask)mask
+                 issues:(NSMutableArray<ValidationIssue*>*)issues
+{
+    BOOL isOccuredError = NO;
+    
+    for (ValidationPlanEntry* entry in plan.entries)
+    {
+        if (!entry.hasRules) continue;
+        
+        id valueFromJSON = recievedJSON[entry.key];
+        if (!valueFromJSON) continue;
+        
+        if ((entry.subPlan.hasRules) && ([valueFromJSON isKindOfClass:[NSDictionary class]]) &&
+            ([Validator runRulesOfPlan:entry.subPlan onJSON:valueFromJSON validationMask:mask issues:issues]))
+        {
+            isOccuredError = YES;
+            continue;
+        }
+        
+        if ((mask & CheckArrayElements) && (entry.elementPlan.hasRules) && ([valueFromJSON isKindOfClass:[NSArray class]]) &&
+            ([Validator runElementsOfEntry:entry onArray:valueFromJSON validationMask:mask rulesOnly:YES issues:issues]))
+        {
+            isOccuredError = YES;
+            continue;
+        }
+        
+        if (entry.rules)
+        {
+            NSUInteger issuesBeforeKey = issues.count;
+            [Validator validateJSONValue:valueFromJSON templateValue:entry.templateValue key:entry.key onRules:entry.rules issues:issues];
+            if (issues.count > issuesBeforeKey) isOccuredError = YES;
+        }
+    }
+    return isOccuredError;
+}
 
-    NSArray<NSString*>* allKeysFromRecievedJSON = [recievedJSON allKeys];
-    NSArray<NSString*>* allKeysFromTemplateJSON = [templateJSON allKeys];
 
-    for (NSString* key in allKeysFromTemplateJSON)
+/*--------------------------------------------------------------------------------------------------------------
+ Checks each element of 'array' against the first element of the template array of 'entry'.
+ Long arrays are split into chunks which are checked in parallel. The check stops when 'arrayValidationErrorLimit'
+ invalid elements are found. With 'rulesOnly' only the rules of the elements are checked.
+ --------------------------------------------------------------------------------------------------------------*/
++ (BOOL) runElementsOfEntry:(ValidationPlanEntry*)entry
+                    onArray:(NSArray*)array
+             validationMask:(ResponseValidationMask)mask
+                  rulesOnly:(BOOL)rulesOnly
+                     issues:(NSMutableArray<ValidationIssue*>*)issues
+{
+    NSUInteger count      = array.count;
+    NSUInteger errorLimit = MAX(1, Validator.arrayValidationErrorLimit);
+    NSUInteger chunkCount = 1;
+    if (count >= parallelElementsThreshold){
+        chunkCount = MIN(NSProcessInfo.processInfo.activeProcessorCount * 2, count / minElementsPerChunk);
+    }
+    NSUInteger chunkLength = (count + chunkCount - 1) / chunkCount;
+    
+    // Each chunk writes only to its own array, so the chunks do not need a lock
+    NSMutableArray<NSMutableArray<ValidationIssue*>*>* chunkIssues = [NSMutableArray arrayWithCapacity:chunkCount];
+    for (NSUInteger chunk = 0; chunk < chunkCount; chunk++){
+        [chunkIssues addObject:[NSMutableArray new]];
+    }
+    atomic_uint  invalidElements    = 0;
+    atomic_uint* invalidElementsRef = &invalidElements;
+    
+    void(^validateChunk)(size_t) = ^(size_t chunk)
     {
-        if ([key hasSuffix:@"-Rules"]){
-            continue;
-        }
-        // The array is needed in order to decide at the end of the for loop whether to check for rules.
-        // If errors were found in the main algorithm, that is (lack of a key, another class, etc.),
-        // then there is simply no point in checking for rules for a specific key-value pair
-        NSMutableArray* localUserInfoArray = [NSMutableArray new];
-
-        id valueFromJSON     = recievedJSON[key];
-        id valueFromTemplate = templateJSON[key];
-        
-        NSDictionary* rules = [Validator rulesByKey:key inJSON:templateJSON];
-        BOOL     isOptional = [rules[isOptionalKey] boolValue];
-
-        // Checking for keys
-        if ((mask & CheckOnKeys) && (![allKeysFromRecievedJSON containsObject:key]) && (!isOptional)){
-            isOccuredError = YES;
-            domain = [NSString stringWithFormat:@"json hasn't '%@' key",key];
-            [userInfoArray addObject:domain];
-            continue;
-        } else if ((![allKeysFromRecievedJSON containsObject:key]) && (isOptional)) {
-            continue;
-        }
+        NSMutableArray<ValidationIssue*>* issuesOfChunk   = chunkIssues[chunk];
+        NSMutableArray<ValidationIssue*>* issuesOfElement = [NSMutableArray new];
+        NSUInteger end = MIN(count, (chunk + 1) * chunkLength);
         
-        // Type checking
-        if (mask & CheckOnTypesOfValues)
+        for (NSUInteger index = chunk * chunkLength; index < end; index++)
         {
-            NSString* superClassValueFromJSON     = [Validator typeSuperClassName:[valueFromJSON superclass]];
-            NSString* superClassValueFromTemplate = [Validator typeSuperClassName:[valueFromTemplate superclass]];
+            // Enough invalid elements have already been found by this or other chunks
+            if (atomic_load_explicit(invalidElementsRef, memory_order_relaxed) >= errorLimit) return;
             
-            // We handle the case if the values for the keys have different types, classes.
-            if (![superClassValueFromJSON isEqualToString:superClassValueFromTemplate]){
-                isOccuredError = YES;
-                domain = [NSString stringWithFormat:@"Value for key '%@' in recievedJSON has class (%@)\n"
-                          "Value for key '%@' in templateJSON has class (%@).",
-                          key,superClassValueFromJSON,
-                          key,superClassValueFromTemplate];
-                [localUserInfoArray addObject:domain];
-            }
-        }
-        
-        // Checking nesting
-        if ((mask & CheckSubEntityOnKeys) && (recievedJSON[key])){
+            id element = array[index];
+            ValidationValueType type = ValidationTypeOf(element);
             
-            //NSLog(@"valueFromJSON.class %@",NSStringFromClass([valueFromJSON superclass]));
-            //NSLog(@"valueFromTemplate.class %@",NSStringFromClass([valueFromTemplate superclass]));
-
-           if (([valueFromJSON isKindOfClass:[NSDictionary class]]) &&
-               ([valueFromTemplate isKindOfClass:[NSDictionary class]])) {
-               
-                // Recursively invoke the check of nested subdictionaries
-                NSError* subError = [Validator automaticValidateResponse:valueFromJSON
-                                                                template:valueFromTemplate
-                                                          validationMask:mask
-                                                           fromAPIMethod:method];
-               
-                if ((subError) && (subError.userInfo[@"userInfoArray"]))
-                {
-                    isOccuredError = YES;
-                    [localUserInfoArray addObjectsFromArray:subError.userInfo[@"userInfoArray"]];
-                }
+            if (type != entry.elementType){
+                if ((rulesOnly) || (!(mask & CheckOnTypesOfValues))) continue;
+                [issuesOfElement addObject:ValidationTypeIssueMake(nil, type, entry.elementType)];
+            } else if ((entry.elementPlan) && ([element count] > 0)){
+                if (rulesOnly) [Validator runRulesOfPlan:entry.elementPlan onJSON:element validationMask:mask issues:issuesOfElement];
+                else           [Validator runPlan:entry.elementPlan onJSON:element validationMask:mask issues:issuesOfElement];
             }
-        }
-        
-        // We run a check for a dictionary with rules if we have passed all the previous checks
-        if ((mask & CheckOnExtendedRules) && (rules.allKeys.count > 0) && (localUserInfoArray.count < 1)) {
-            NSError* subError = [Validator validateJSONValue:valueFromJSON templateValue:valueFromTemplate key:key onRules:rules];
-          
-            if ((subError) && (subError.userInfo[@"userInfoArray"])) {
-                isOccuredError = YES;
-                [userInfoArray addObjectsFromArray:subError.userInfo[@"userInfoArray"]];
+            if (issuesOfElement.count < 1) continue;
+            
+            atomic_fetch_add_explicit(invalidElementsRef, 1, memory_order_relaxed);
+            for (ValidationIssue* issue in issuesOfElement){
+                ValidationElementPath* step = [ValidationElementPath new];
+                step.key   = entry.key;
+                step.index = index;
+                step.next  = issue.elementPath;
+                issue.elementPath = step;
             }
-        } else {
-            [userInfoArray addObjectsFromArray:localUserInfoArray];
+            [issuesOfChunk addObjectsFromArray:issuesOfElement];
+            [issuesOfElement removeAllObjects];
         }
-    }
+    };
     
-    // We initialize an error if it occurs
-    if (isOccuredError)
-    {
-        NSString* APIMethod = [API convertAPIMethodToString:method];
-        domain = [NSString stringWithFormat:@"json recieved from API method (%@) has incorrect stucture",APIMethod];
-        error  = [NSError errorWithDomain:domain code:0 userInfo:@{ @"userInfoArray" : userInfoArray }];
+    if (chunkCount > 1) dispatch_apply(chunkCount, DISPATCH_APPLY_AUTO, validateChunk);
+    else                validateChunk(0);
+    
+    for (NSMutableArray<ValidationIssue*>* issuesOfChunk in chunkIssues){
+        [issues addObjectsFromArray:issuesOfChunk];
     }
-    return error;
+    NSUInteger invalidCount = atomic_load(&invalidElements);
+    if (invalidCount >= errorLimit){
+        [issues addObject:ValidationIssueMake(ValidationIssueKind_ArrayCheckStopped, entry.key, nil, @(invalidCount), @(count))];
+    }
+    return (invalidCount > 0);
 }
 
 
@@ -352,233 +1141,165 @@ ____    ____  ___       __       __   _______       ___   .___________. __    __
  Takes a value from a json file, and depending on their type (String / Array / Dictionary / Number), call the required
  the validation method for the given type.
  --------------------------------------------------------------------------------------------------------------*/
-+ (NSError* _Nullable) validateJSONValue:(id)jsonValue templateValue:(id)templateValue key:(NSString*)key onRules:(NSDictionary*)rules
++ (void) validateJSONValue:(id)jsonValue
+             templateValue:(id)templateValue
+                       key:(NSString*)key
+                   onRules:(ValidationRules*)rules
+                    issues:(NSMutableArray<ValidationIssue*>*)issues
 {
-    NSError*  error   = nil;
-    NSString* message = nil;
-    
     // Check on nil
     if ((!jsonValue) || (!templateValue) || (!rules)){
-        message = @"One of params is nil. In +validateJSONValue:templateValue:key:onRules:";
-        return [NSError errorWithDomain:message code:0 userInfo:@{ @"userInfoArray" : @[message] }];
+        [issues addObject:ValidationIssueMake(ValidationIssueKind_InvalidParams, key, nil, nil, nil)];
+        return;
     }
     
     // Check on other class
-    NSString* superClassValueFromJSON     = [Validator typeSuperClassName:[jsonValue superclass]];
-    NSString* superClassValueFromTemplate = [Validator typeSuperClassName:[templateValue superclass]];
+    ValidationValueType type = ValidationTypeOf(jsonValue);
     
     // We handle the case if the values for the keys have different types, classes.
-    if (![superClassValueFromJSON isEqualToString:superClassValueFromTemplate]){
-        message = @"jsonValue & templateValue are members of other classes. In +validateJSONValue:templateValue:key:onRules:";
-        return [NSError errorWithDomain:message code:0 userInfo:@{ @"userInfoArray" : @[message] }];
-    }
-    
-    // String case:
-    if ([superClassValueFromJSON isEqualToString:@"NSString"]){
-        return [Validator validateString:jsonValue templateString:templateValue key:key onRules:rules];
+    if (type != ValidationTypeOf(templateValue)){
+        [issues addObject:ValidationTypeIssueMake(key, type, ValidationTypeOf(templateValue))];
+        return;
     }
     
-    // Array case:
-    if ([superClassValueFromJSON isEqualToString:@"NSArray"]){
-        return [Validator validateArray:jsonValue templateArray:templateValue key:key onRules:rules];
+    switch (type) {
+        case ValidationValueType_String:     [Validator validateString:jsonValue templateString:templateValue key:key onRules:rules issues:issues];             break;
+        case ValidationValueType_Array:      [Validator validateArray:jsonValue templateArray:templateValue key:key onRules:rules issues:issues];               break;
+        case ValidationValueType_Dictionary: [Validator validateDictionary:jsonValue templateDictionary:templateValue key:key onRules:rules issues:issues]; break;
+        case ValidationValueType_Number:     [Validator validateNumber:jsonValue templateNumber:templateValue key:key onRules:rules issues:issues];             break;
+        default: break;
     }
-
-    // Dictionary case:
-    if ([superClassValueFromJSON isEqualToString:@"NSDictionary"]){
-        return [Validator validateDictionary:jsonValue templateDictionary:templateValue key:key onRules:rules];
-    }
-    
-    // Number case:
-    if ([superClassValueFromJSON isEqualToString:@"NSNumber"]){
-        return  [Validator validateNumber:jsonValue templateNumber:templateValue key:key onRules:rules];
-    }
-    
-    return error;
 }
 
 /*--------------------------------------------------------------------------------------------------------------
 The method is engaged in the validation of variables of type NSString
  --------------------------------------------------------------------------------------------------------------*/
-+ (NSError* _Nullable) validateString:(nullable NSString*)jsonString
-                       templateString:(NSString*)templateString
-                                  key:(NSString*)key
-                              onRules:(NSDictionary*)rules
++ (void) validateString:(nullable NSString*)jsonString
+         templateString:(NSString*)templateString
+                    key:(NSString*)key
+                onRules:(ValidationRules*)rules
+                 issues:(NSMutableArray<ValidationIssue*>*)issues
 {
-    NSError*  error  = nil;
-    NSString* domain = nil;
-    NSMutableArray* userInfoArray = [NSMutableArray new];
-    
     // Check on nil
-    if ((!templateString) || (rules.allKeys.count < 1)){
-        domain = str(@"One of params (in +validateString:...) is nil. By key (%@)",key);
-        return [NSError errorWithDomain:domain code:0 userInfo: @{ @"userInfoArray" : @[domain] }];
+    if ((!templateString) || (!rules)){
+        [issues addObject:ValidationIssueMake(ValidationIssueKind_InvalidParams, key, nil, nil, nil)];
+        return;
     }
     
-    BOOL isOptional             =  [rules[isOptionalKey]        boolValue];
-    BOOL  mustMatch             =  [rules[mustMatchKey]         boolValue];
-    BOOL equalInLength          =  [rules[equalInLengthKey]     boolValue];
-    NSInteger lengthMustBeEqualOrGreaterThan =  [rules[lengthMustBeEqualOrGreaterThanKey] integerValue];
-    NSInteger lengthMustBeEqualOrLessThan    =  [rules[lengthMustBeEqualOrLessThanKey]    integerValue];
-    NSString* hasSuffix         =  rules[hasSuffixKey];
-    NSArray*  matchWithOneOf    =  rules[matchWithOneOfKey];
-    
+    NSUInteger length = jsonString.length;
     
     // If the value from json == nil, and the conditions say that it is not necessary to property
-    if ((isOptional) && (!jsonString)){
-        return nil;
+    if ((rules.isOptional) && (!jsonString)){
+        return;
     }
     
     //hasSuffix
-    if ((hasSuffix) && (![jsonString hasPrefix:hasSuffix])) {
-        domain = str(@"The value(%@) by key(%@) hasn't requiered suffix(%@)",jsonString,key,hasSuffix);
-        [userInfoArray addObject:domain];
+    if ((rules.hasSuffix) && (![jsonString hasSuffix:rules.hasSuffix])) {
+        [issues addObject:ValidationIssueMake(ValidationIssueKind_RuleViolation, key, hasSuffixKey, jsonString, rules.hasSuffix)];
     }
     
     // matchWithOneOf
-    if (matchWithOneOf.count > 0) {
-       NSArray*  lowercaseArray  =  [Validator lowercaseArray:matchWithOneOf];
-       NSString* lowercaseString =  [jsonString lowercaseString];
-      
-        if (![lowercaseArray containsObject:lowercaseString]){
-            domain = str(@"The value(%@) by key(%@) not found in the allowed array(%@))",jsonString,key,matchWithOneOf);
-            [userInfoArray addObject:domain];
-        }
+    // The lowercase copy of the value is made only if the value is not found as it is
+    if ((rules.matchWithOneOfSet) &&
+        (![rules.matchWithOneOfSet containsObject:jsonString]) &&
+        (![rules.matchWithOneOfSet containsObject:[jsonString lowercaseString]])){
+        [issues addObject:ValidationIssueMake(ValidationIssueKind_RuleViolation, key, matchWithOneOfKey, jsonString, rules.matchWithOneOf)];
     }
     
-    if ((mustMatch) && (![jsonString isEqualToString:templateString])) {
-        domain = str(@"The value by key(%@) not match with required=%@)",key,templateString);
-        [userInfoArray addObject:domain];
+    // matchesPattern. The whole value must match the pattern
+    if ((rules.pattern) && (!rules.patternExpression)){
+        [issues addObject:ValidationIssueMake(ValidationIssueKind_InvalidRules, key, matchesPatternKey, jsonString, rules.pattern)];
+    } else if (rules.patternExpression){
+        NSRange match = [rules.patternExpression rangeOfFirstMatchInString:jsonString options:NSMatchingAnchored range:NSMakeRange(0, length)];
+        if ((match.location != 0) || (match.length != length)){
+            [issues addObject:ValidationIssueMake(ValidationIssueKind_RuleViolation, key, matchesPatternKey, jsonString, rules.pattern)];
+        }
     }
     
-    if ((equalInLength) && (jsonString.length != templateString.length)) {
-        domain = str(@"The length of values for key(%@) does not match",key);
-        [userInfoArray addObject:domain];
+    if ((rules.mustMatch) && (![jsonString isEqualToString:templateString])) {
+        [issues addObject:ValidationIssueMake(ValidationIssueKind_RuleViolation, key, mustMatchKey, jsonString, templateString)];
     }
     
-    if ((rules[@"lengthMustBeEqualOrGreaterThan"]) && (rules[@"lengthMustBeEqualOrLessThan"])){
-        if (lengthMustBeEqualOrGreaterThan > lengthMustBeEqualOrLessThan){
-            domain = str(@"Invalid rules (lengthMustBeEqualOrGreaterThan (cannot be greater than)> lengthMustBeEqualOrLessThan) in key(%@) value(%@)",key,jsonString);
-            [userInfoArray addObject:domain];
-            return [NSError errorWithDomain:domain code:0 userInfo:@{ @"userInfoArray" : userInfoArray }];
-        }
+    if ((rules.equalInLength) && (length != templateString.length)) {
+        [issues addObject:ValidationIssueMake(ValidationIssueKind_RuleViolation, key, equalInLengthKey, jsonString, templateString)];
     }
     
-    //lengthGreaterThan
-    if ((rules[@"lengthMustBeEqualOrGreaterThan"]) && (jsonString.length <= lengthMustBeEqualOrGreaterThan)) {
-        domain = str(@"The length of the key(%@) value is less than the required length. Must be greater than %d",key,lengthMustBeEqualOrGreaterThan);
-        [userInfoArray addObject:domain];
+    if (rules.hasInvalidLength){
+        [issues addObject:ValidationIssueMake(ValidationIssueKind_InvalidRules, key, lengthMustBeEqualOrGreaterThanKey, jsonString, nil)];
+        return;
     }
     
     //lengthGreaterThan
-    if ((rules[@"lengthMustBeEqualOrLessThan"]) && (jsonString.length >= lengthMustBeEqualOrLessThan)) {
-        domain = str(@"The length of the key(%@) value is greater than the required length. Must be less than %d",key,lengthMustBeEqualOrLessThan);
-        [userInfoArray addObject:domain];
+    if ((rules.lengthMin) && ((NSInteger)length <= [rules.lengthMin integerValue])) {
+        [issues addObject:ValidationIssueMake(ValidationIssueKind_RuleViolation, key, lengthMustBeEqualOrGreaterThanKey, jsonString, rules.lengthMin)];
     }
     
-    
-    if (userInfoArray.count > 0){
-        domain = [NSString stringWithFormat:@"Value for key(%@) has uncorrect data or structure",key];
-        error  = [NSError errorWithDomain:domain code:0 userInfo:@{ @"userInfoArray" : userInfoArray }];
+    //lengthGreaterThan
+    if ((rules.lengthMax) && ((NSInteger)length >= [rules.lengthMax integerValue])) {
+        [issues addObject:ValidationIssueMake(ValidationIssueKind_RuleViolation, key, lengthMustBeEqualOrLessThanKey, jsonString, rules.lengthMax)];
     }
     
-    return error;
 }
 
 
 /*--------------------------------------------------------------------------------------------------------------
  The method is engaged in validating objects of type NSArray
  --------------------------------------------------------------------------------------------------------------*/
-+ (NSError* _Nullable) validateArray:(nullable NSArray*)jsonArray
-                       templateArray:(NSArray*)templateArray
-                                 key:(NSString*)key
-                             onRules:(NSDictionary*)rules
++ (void) validateArray:(nullable NSArray*)jsonArray
+         templateArray:(NSArray*)templateArray
+                   key:(NSString*)key
+               onRules:(ValidationRules*)rules
+                issues:(NSMutableArray<ValidationIssue*>*)issues
 {
-    NSError*  error  = nil;
-    NSString* domain = nil;
-    NSMutableArray* userInfoArray = [NSMutableArray new];
-    
     // Check on nil
-    if ((!templateArray) || (rules.allKeys.count < 1)){
-        domain = str(@"One of params (in +validateArray:...) is nil. By key (%@)",key);
-        return [NSError errorWithDomain:domain code:0 userInfo:@{ @"userInfoArray" : @[domain] }];
+    if ((!templateArray) || (!rules)){
+        [issues addObject:ValidationIssueMake(ValidationIssueKind_InvalidParams, key, nil, nil, nil)];
+        return;
     }
     
-    BOOL isOptional = [rules[isOptionalKey] boolValue];
-    BOOL  mustMatch = [rules[mustMatchKey]  boolValue];
-
-    NSInteger elementsMustBeEqualOrMoreThan = [rules[elementsMustBeEqualOrMoreThanKey] integerValue];
-    NSInteger elementsMustBeEqualOrLessThan = [rules[elementsMustBeEqualOrLessThanKey] integerValue];
-    
     // If the value from json == nil, and the conditions say that it is not necessary to property
-    if ((isOptional) && (!jsonArray)){
-        return nil;
-    }
-    
-    if (mustMatch){
-        
-        NSArray* arrayWithoutRules  = [Validator removeAllRulesFromArrayAndNastedStructure:templateArray];
-        NSArray* lowercaseTemplate  = [Validator lowercaseArray:arrayWithoutRules];
-        NSArray* lowercaseJSON      = [Validator lowercaseArray:jsonArray];
-        
-        if (![lowercaseTemplate isEqualToArray:lowercaseJSON]){
-            domain = str(@"The value by key(%@) not match with required=%@)",key,templateArray);
-            [userInfoArray addObject:domain];
-        }
+    if ((rules.isOptional) && (!jsonArray)){
+        return;
     }
     
-    if ((rules[@"elementsMustBeEqualOrMoreThan"]) && (jsonArray.count < elementsMustBeEqualOrMoreThan)){
-        domain = str(@"Array by key(%@) from json has less elements than required(%d)",key,elementsMustBeEqualOrMoreThan);
-        [userInfoArray addObject:domain];
+    if ((rules.mustMatch) && (!ValidationStringsMatchIgnoringCase(jsonArray, rules.mustMatchValue))){
+        [issues addObject:ValidationIssueMake(ValidationIssueKind_RuleViolation, key, mustMatchKey, jsonArray, templateArray)];
     }
     
-    if ((rules[@"elementsMustBeEqualOrLessThan"]) && (jsonArray.count > elementsMustBeEqualOrLessThan)){
-        domain = str(@"Array by key(%@) from json has greater elements than required(%d)",key,elementsMustBeEqualOrLessThan);
-        [userInfoArray addObject:domain];
+    if ((rules.elementsMin) && ((NSInteger)jsonArray.count < [rules.elementsMin integerValue])){
+        [issues addObject:ValidationIssueMake(ValidationIssueKind_RuleViolation, key, elementsMustBeEqualOrMoreThanKey, jsonArray, rules.elementsMin)];
     }
     
-    
-    if (userInfoArray.count > 0){
-        domain = [NSString stringWithFormat:@"Value for key(%@) has uncorrect data or structure",key];
-        error  = [NSError errorWithDomain:domain code:0 userInfo:@{ @"userInfoArray" : userInfoArray }];
+    if ((rules.elementsMax) && ((NSInteger)jsonArray.count > [rules.elementsMax integerValue])){
+        [issues addObject:ValidationIssueMake(ValidationIssueKind_RuleViolation, key, elementsMustBeEqualOrLessThanKey, jsonArray, rules.elementsMax)];
     }
     
-    return error;
 }
 
 
 /*--------------------------------------------------------------------------------------------------------------
  The method is engaged in validating objects of type NSDictionary
  --------------------------------------------------------------------------------------------------------------*/
-+ (NSError* _Nullable) validateDictionary:(nullable NSDictionary*)jsonDictionary
-                       templateDictionary:(NSDictionary*)templateDictionary
-                                      key:(NSString*)key
-                                  onRules:(NSDictionary*)rules
++ (void) validateDictionary:(nullable NSDictionary*)jsonDictionary
+         templateDictionary:(NSDictionary*)templateDictionary
+                        key:(NSString*)key
+                    onRules:(ValidationRules*)rules
+                     issues:(NSMutableArray<ValidationIssue*>*)issues
 {
-    NSError*  error  = nil;
-    NSString* domain = nil;
-    
     // Check on nil
-    if ((!templateDictionary) || (rules.allKeys.count < 1)){
-        domain = str(@"One of params (in +validateDictionary:...) is nil. By key (%@)",key);
-        return [NSError errorWithDomain:domain code:0 userInfo:@{ @"userInfoArray" : @[domain] }];
+    if ((!templateDictionary) || (!rules)){
+        [issues addObject:ValidationIssueMake(ValidationIssueKind_InvalidParams, key, nil, nil, nil)];
+        return;
     }
     
-    BOOL isOptional = [rules[isOptionalKey] boolValue];
-    BOOL  mustMatch = [rules[mustMatchKey]  boolValue];
-    
     // If the value from json == nil, and the conditions say that it is not necessary to property
-    if ((isOptional) && (!jsonDictionary)){
-        return nil;
+    if ((rules.isOptional) && (!jsonDictionary)){
+        return;
     }
     
-    if (mustMatch){
-        NSDictionary* templateWithoutRules = [Validator removeAllRulesFromDictionaryAndNastedStructure:templateDictionary];
-        if (![jsonDictionary isEqualToDictionary:templateWithoutRules]){
-            domain = str(@"The value by key(%@) not match with required=(%@)",key,templateDictionary);
-            return [NSError errorWithDomain:domain code:0 userInfo:@{ @"userInfoArray" : @[domain] }];
-        }
+    if ((rules.mustMatch) && (![jsonDictionary isEqualToDictionary:rules.mustMatchValue])){
+        [issues addObject:ValidationIssueMake(ValidationIssueKind_RuleViolation, key, mustMatchKey, jsonDictionary, templateDictionary)];
     }
-    return error;
 }
 
 
@@ -586,70 +1307,49 @@ The method is engaged in the validation of variables of type NSString
 /*--------------------------------------------------------------------------------------------------------------
  The method validates objects of type NSNumber. Only handles numeric values (int / float / .. ect)
  --------------------------------------------------------------------------------------------------------------*/
-+ (NSError* _Nullable) validateNumber:(nullable NSNumber*)jsonNumber
-                       templateNumber:(NSNumber*)templateNumber
-                                  key:(NSString*)key
-                              onRules:(NSDictionary*)rules
++ (void) validateNumber:(nullable NSNumber*)jsonNumber
+         templateNumber:(NSNumber*)templateNumber
+                    key:(NSString*)key
+                onRules:(ValidationRules*)rules
+                 issues:(NSMutableArray<ValidationIssue*>*)issues
 {
-    NSError*  error  = nil;
-    NSString* domain = nil;
-    NSMutableArray* userInfoArray = [NSMutableArray new];
-    
     // Check on nil
-    if ((!templateNumber) || (rules.allKeys.count < 1)){
-        domain = str(@"One of params (in +validateNumber:...) is nil. By key (%@)",key);
-        return [NSError errorWithDomain:domain code:0 userInfo:@{ @"userInfoArray" : @[domain] }];
+    if ((!templateNumber) || (!rules)){
+        [issues addObject:ValidationIssueMake(ValidationIssueKind_InvalidParams, key, nil, nil, nil)];
+        return;
     }
+    NSUInteger issuesBeforeNumber = issues.count;
     float jsonFloat = [jsonNumber  floatValue];
-
-    BOOL isOptional = [rules[isOptionalKey] boolValue];
-    BOOL  mustMatch = [rules[mustMatchKey]  boolValue];
-    
-    float  minimum = [rules[minimumKey]  floatValue];
-    float  maximum = [rules[maximumKey]  floatValue];
-
     
     // If the value from json == nil, and the conditions say that it is not necessary to property
-    if ((isOptional) && (!jsonNumber)){
-        return nil;
+    if ((rules.isOptional) && (!jsonNumber)){
+        return;
     }
     
-    if ((mustMatch) && (![jsonNumber isEqualToNumber:templateNumber])){
-        domain = str(@"Number by key(%@) from json not matches with templete value(%@))",key,templateNumber);
-        [userInfoArray addObject:domain];
+    if ((rules.mustMatch) && (![jsonNumber isEqualToNumber:templateNumber])){
+        [issues addObject:ValidationIssueMake(ValidationIssueKind_RuleViolation, key, mustMatchKey, jsonNumber, templateNumber)];
     }
     
     // BOOL is not validated further
-    if ([NSStringFromClass([jsonNumber class]) isEqualToString:@"__NSCFBoolean"]){
-          if (userInfoArray.count > 0) return [NSError errorWithDomain:domain code:0 userInfo:@{ @"userInfoArray" : userInfoArray }];
+    if (CFGetTypeID((__bridge CFTypeRef)jsonNumber) == CFBooleanGetTypeID()){
+          if (issues.count > issuesBeforeNumber) return;
     }
     
     
-    if ((rules[minimumKey]) && (rules[maximumKey])){
-        if (minimum > maximum){
-            domain = str(@"Invalid rules (minimum (cannot be greater than)> maximum) in key(%@))",key);
-            [userInfoArray addObject:domain];
-            return [NSError errorWithDomain:domain code:0 userInfo:@{ @"userInfoArray" : userInfoArray }];
-        }
+    if (rules.hasInvalidRange){
+        [issues addObject:ValidationIssueMake(ValidationIssueKind_InvalidRules, key, minimumKey, jsonNumber, nil)];
+        return;
     }
     
     
-    if ((rules[minimumKey]) && (jsonFloat < minimum)){
-        domain = str(@"Number by key(%@) from json has value(%f). But mandatory minimum is (%f))",key,jsonFloat,minimum);
-        [userInfoArray addObject:domain];
+    if ((rules.minimum) && (jsonFloat < [rules.minimum floatValue])){
+        [issues addObject:ValidationIssueMake(ValidationIssueKind_RuleViolation, key, minimumKey, jsonNumber, rules.minimum)];
     }
     
     
-    if ((rules[maximumKey]) && (jsonFloat > maximum)){
-        domain = str(@"Number by key(%@) from json has value(%f). But mandatory maximum is (%f))",key,jsonFloat,maximum);
-        [userInfoArray addObject:domain];
-    }
-    
-    if (userInfoArray.count > 0){
-        domain = [NSString stringWithFormat:@"Value for key(%@) has uncorrect data or structure",key];
-        error  = [NSError errorWithDomain:domain code:0 userInfo:@{ @"userInfoArray" : userInfoArray }];
+    if ((rules.maximum) && (jsonFloat > [rules.maximum floatValue])){
+        [issues addObject:ValidationIssueMake(ValidationIssueKind_RuleViolation, key, maximumKey, jsonNumber, rules.maximum)];
     }
-    return error;
 }
 
 
@@ -805,4 +1505,410 @@ The method is engaged in the validation of variables of type NSString
     return [tempArray copy];
 }
 
+
+#pragma mark - Validation Issues
+
+/*--------------------------------------------------------------------------------------------------------------
+ Returns the number of issues of the kind found by the automatic validation since the start or the last reset.
+ --------------------------------------------------------------------------------------------------------------*/
++ (NSUInteger) validationIssueCountOfKind:(ValidationIssueKind)kind
+{
+    if ((kind < 0) || (kind >= ValidationIssueKindCount)) return 0;
+    @synchronized ([NSNotificationCenter defaultCenter]){
+        return _validationIssueCounters[kind];
+    }
+}
+
++ (void) resetValidationIssueCounters
+{
+    @synchronized ([NSNotificationCenter defaultCenter]){
+        memset(_validationIssueCounters, 0, sizeof(_validationIssueCounters));
+    }
+}
+
+
+
+#pragma mark - Array Validation
+
+/*--------------------------------------------------------------------------------------------------------------
+ @property (class, nonatomic, assign) NSUInteger arrayValidationErrorLimit;
+ --------------------------------------------------------------------------------------------------------------*/
++ (void)setArrayValidationErrorLimit:(NSUInteger)arrayValidationErrorLimit
+{
+    @synchronized ([NSNotificationCenter defaultCenter]){
+        _arrayValidationErrorLimit = MAX(1, arrayValidationErrorLimit);
+    }
+}
+
++ (NSUInteger)arrayValidationErrorLimit
+{
+    @synchronized ([NSNotificationCenter defaultCenter]){
+        return _arrayValidationErrorLimit;
+    }
+}
+
+
+
+#pragma mark - Validation Policy
+
+/*--------------------------------------------------------------------------------------------------------------
+ Sets the validation policy of the API method. The counters of the previous policy are reset.
+ --------------------------------------------------------------------------------------------------------------*/
++ (void) setValidationPolicy:(ValidationPolicy)policy forAPIMethod:(APIMethod)method
+{
+    @synchronized ([NSNotificationCenter defaultCenter])
+    {
+        ValidationPolicyState* state = [Validator policyStateForAPIMethod:method];
+        state.policy             = policy;
+        state.responseCounter    = 0;
+        state.escalatedResponses = 0;
+        state.hasValidShape      = NO;
+    }
+}
+
++ (ValidationPolicy) validationPolicyForAPIMethod:(APIMethod)method
+{
+    @synchronized ([NSNotificationCenter defaultCenter]){
+        ValidationPolicyState* state = _validationPolicies[@(method)];
+        return (state) ? state.policy : ValidationPolicy_Full;
+    }
+}
+
++ (BOOL) isValidationEscalatedForAPIMethod:(APIMethod)method
+{
+    @synchronized ([NSNotificationCenter defaultCenter]){
+        return (_validationPolicies[@(method)].escalatedResponses > 0);
+    }
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ [Internal method]
+ Returns the state of the API method, creating it if needed. Must be called inside '@synchronized'.
+ --------------------------------------------------------------------------------------------------------------*/
++ (ValidationPolicyState*) policyStateForAPIMethod:(APIMethod)method
+{
+    if (!_validationPolicies){
+         _validationPolicies = [NSMutableDictionary new];
+    }
+    ValidationPolicyState* state = _validationPolicies[@(method)];
+    if (!state){
+        state = [ValidationPolicyState new];
+        _validationPolicies[@(method)] = state;
+    }
+    return state;
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ [Internal method]
+ Decides by the policy of the API method whether the response must be validated.
+ Under 'ValidationPolicy_ShapeChanged' returns the fingerprint of the response in 'shape'.
+ If the API method has a template, the fingerprint covers only its keys and is reused by the automatic validation.
+ --------------------------------------------------------------------------------------------------------------*/
++ (BOOL) shouldValidateResponse:(NSDictionary*)recievedJSON fromAPIMethod:(APIMethod)method shape:(NSUInteger*)shape
+{
+    ValidationPolicy policy = [Validator validationPolicyForAPIMethod:method];
+    if (policy == ValidationPolicy_Full) return YES;
+
+    // The fingerprint is calculated outside of the lock: it walks the whole response
+    if (policy == ValidationPolicy_ShapeChanged){
+        *shape = [Validator shapeOfResponse:recievedJSON fromAPIMethod:method];
+    }
+
+    @synchronized ([NSNotificationCenter defaultCenter])
+    {
+        ValidationPolicyState* state = _validationPolicies[@(method)];
+        if ((!state) || (state.policy != policy)) return YES;
+        if (state.escalatedResponses > 0)         return YES;
+
+        switch (policy) {
+            case ValidationPolicy_Sampled: {
+                NSUInteger counter = state.responseCounter;
+                state.responseCounter = counter + 1;
+                return (counter % MAX(1, _validationSampleRate) == 0);
+            }
+            case ValidationPolicy_ShapeChanged:
+                return (!state.hasValidShape) || (state.validShape != *shape);
+            case ValidationPolicy_Off:
+                return NO;
+            default:
+                return YES;
+        }
+    }
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ [Internal method]
+ Structural fingerprint of the response to the API method. If the API method has a template, only the keys of its
+ plan are taken into account, and the fingerprint is handed down to '+automaticValidateResponse:...' on this thread.
+ --------------------------------------------------------------------------------------------------------------*/
++ (NSUInteger) shapeOfResponse:(NSDictionary*)recievedJSON fromAPIMethod:(APIMethod)method
+{
+    NSDictionary* template = [Templater templateForAPIMethod:method];
+    if (!template) return ValidationShapeFingerprint(recievedJSON);
+
+    ValidationPlan* plan  = [Validator planForTemplate:template];
+    NSUInteger      shape = ValidationPlanShapeFingerprint(plan, recievedJSON);
+    _knownShape = (ValidationKnownShape){ (__bridge const void*)recievedJSON, (__bridge const void*)plan, shape };
+    return shape;
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ [Internal method]
+ Saves the result of the validation. After the failure the API method is validated fully for the next
+ 'validationEscalationLength' responses. Each new failure starts the escalation again.
+ --------------------------------------------------------------------------------------------------------------*/
++ (void) recordValidationError:(nullable NSError*)error fromAPIMethod:(APIMethod)method shape:(NSUInteger)shape
+{
+    @synchronized ([NSNotificationCenter defaultCenter])
+    {
+        ValidationPolicyState* state = _validationPolicies[@(method)];
+        if ((!state) || (state.policy == ValidationPolicy_Full)) return;
+
+        if (error){
+            if (state.escalatedResponses == 0){
+                APILog(@"+recordValidationError: | '%@' is validated fully after the failure",[APIManager convertAPIMethodToString:method]);
+            }
+            state.escalatedResponses = _validationEscalationLength;
+            state.hasValidShape = NO;
+            return;
+        }
+
+        if (state.escalatedResponses > 0){
+            state.escalatedResponses -= 1;
+        }
+        if (state.policy == ValidationPolicy_ShapeChanged){
+            state.validShape    = shape;
+            state.hasValidShape = YES;
+        }
+    }
+}
+
+
+/*--------------------------------------------------------------------------------------------------------------
+ @property (class, nonatomic, assign) NSUInteger validationSampleRate;
+ --------------------------------------------------------------------------------------------------------------*/
++ (void)setValidationSampleRate:(NSUInteger)validationSampleRate
+{
+    @synchronized ([NSNotificationCenter defaultCenter]){
+        _validationSampleRate = MAX(1, validationSampleRate);
+    }
+}
+
++ (NSUInteger)validationSampleRate
+{
+    @synchronized ([NSNotificationCenter defaultCenter]){
+        return _validationSampleRate;
+    }
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ @property (class, nonatomic, assign) NSUInteger validationEscalationLength;
+ --------------------------------------------------------------------------------------------------------------*/
++ (void)setValidationEscalationLength:(NSUInteger)validationEscalationLength
+{
+    @synchronized ([NSNotificationCenter defaultCenter]){
+        _validationEscalationLength = validationEscalationLength;
+    }
+}
+
++ (NSUInteger)validationEscalationLength
+{
+    @synchronized ([NSNotificationCenter defaultCenter]){
+        return _validationEscalationLength;
+    }
+}
+
+
+
+#pragma mark - Background Validation
+
+/*--------------------------------------------------------------------------------------------------------------
+ Turns on the background validation of the responses of the API method.
+ --------------------------------------------------------------------------------------------------------------*/
++ (void) setAsynchronousValidation:(BOOL)isAsynchronous forAPIMethod:(APIMethod)method
+{
+    @synchronized ([NSNotificationCenter defaultCenter]){
+        [Validator policyStateForAPIMethod:method].isAsynchronous = isAsynchronous;
+    }
+}
+
++ (BOOL) isAsynchronousValidationForAPIMethod:(APIMethod)method
+{
+    @synchronized ([NSNotificationCenter defaultCenter]){
+        return _validationPolicies[@(method)].isAsynchronous;
+    }
+}
+
++ (NSUInteger) backgroundValidationCountForAPIMethod:(APIMethod)method
+{
+    @synchronized ([NSNotificationCenter defaultCenter]){
+        return _validationPolicies[@(method)].backgroundValidations;
+    }
+}
+
++ (NSUInteger) driftCountForAPIMethod:(APIMethod)method
+{
+    @synchronized ([NSNotificationCenter defaultCenter]){
+        return _validationPolicies[@(method)].driftedResponses;
+    }
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ [Internal method]
+ Validates the response on 'backgroundValidationQueue'. The failure is counted and passed to 'validationDriftHandler'.
+ If the queue is overloaded the response is not validated at all.
+ --------------------------------------------------------------------------------------------------------------*/
++ (void) validateInBackgroundResponse:(NSDictionary*)recievedJSON fromAPIMethod:(APIMethod)method validator:(SEL)validator
+{
+    @synchronized ([NSNotificationCenter defaultCenter])
+    {
+        if (_pendingBackgroundValidations >= maxPendingBackgroundValidations){
+            APILog(@"+validateInBackgroundResponse: | Queue is overloaded, response of '%@' is skipped",[APIManager convertAPIMethodToString:method]);
+            return;
+        }
+        _pendingBackgroundValidations += 1;
+    }
+
+    dispatch_async(Validator.backgroundValidationQueue, ^{
+        NSError* error = [Validator validateResponse:recievedJSON fromAPIMethod:method validator:validator];
+        ValidationDriftHandler driftHandler = nil;
+
+        @synchronized ([NSNotificationCenter defaultCenter])
+        {
+            _pendingBackgroundValidations -= 1;
+            ValidationPolicyState* state = [Validator policyStateForAPIMethod:method];
+            state.backgroundValidations += 1;
+            if (error){
+                state.driftedResponses += 1;
+                driftHandler = _validationDriftHandler;
+            }
+        }
+        if (error){
+            APILog(@"+validateInBackgroundResponse: | Response of '%@' differs from the template",[APIManager convertAPIMethodToString:method]);
+            if (driftHandler) driftHandler(method, error);
+        }
+    });
+}
+
+
+/*--------------------------------------------------------------------------------------------------------------
+ @property (class, nonatomic, copy, nullable) ValidationDriftHandler validationDriftHandler;
+ --------------------------------------------------------------------------------------------------------------*/
++ (void)setValidationDriftHandler:(ValidationDriftHandler)validationDriftHandler
+{
+    @synchronized ([NSNotificationCenter defaultCenter]){
+        _validationDriftHandler = [validationDriftHandler copy];
+    }
+}
+
++ (ValidationDriftHandler)validationDriftHandler
+{
+    @synchronized ([NSNotificationCenter defaultCenter]){
+        return _validationDriftHandler;
+    }
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ @property (class, nonatomic, readonly, strong) dispatch_queue_t backgroundValidationQueue;
+ --------------------------------------------------------------------------------------------------------------*/
++ (dispatch_queue_t)backgroundValidationQueue
+{
+    @synchronized ([NSNotificationCenter defaultCenter])
+    {
+        if (!_backgroundValidationQueue){
+            dispatch_queue_attr_t attributes = dispatch_queue_attr_make_with_qos_class(DISPATCH_QUEUE_SERIAL, QOS_CLASS_UTILITY, 0);
+            _backgroundValidationQueue = dispatch_queue_create("Validator.serial.backgroundValidationQueue", attributes);
+        }
+        return _backgroundValidationQueue;
+    }
+}
+
+
+
+#pragma mark - Benchmark
+
+#if DEBUG
+/*--------------------------------------------------------------------------------------------------------------
+ Returns a post in the format of 'wall.get'. Used as the payload and (with rules) as the template.
+ --------------------------------------------------------------------------------------------------------------*/
+static NSMutableDictionary* ValidatorBenchmarkPost(NSInteger index)
+{
+    return [@{ @"id"          : @(index),
+               @"from_id"     : @(155510513),
+               @"owner_id"    : @(155510513),
+               @"date"        : @(1600000000 + index),
+               @"post_type"   : @"post",
+               @"text"        : str(@"Post number %ld",(long)index),
+               @"comments"    : @{ @"count" : @(index % 7),  @"can_post"   : @(1) },
+               @"likes"       : @{ @"count" : @(index * 3),  @"user_likes" : @(0), @"can_like" : @(1), @"can_publish" : @(1) },
+               @"reposts"     : @{ @"count" : @(index % 5),  @"user_reposted" : @(0) },
+               @"views"       : @{ @"count" : @(index * 10) },
+               @"post_source" : @{ @"type"  : @"vk" },
+               @"attachments" : @[] } mutableCopy];
+}
+
+static void ValidatorMeasure(NSString* name, NSUInteger iterations, void(^validate)(void))
+{
+    validate(); // The plan is compiled before the measurement
+
+    CFAbsoluteTime elapsed = 0;
+    @autoreleasepool {
+        CFAbsoluteTime start = CFAbsoluteTimeGetCurrent();
+        for (NSUInteger i = 0; i < iterations; i++) validate();
+        elapsed = CFAbsoluteTimeGetCurrent() - start;
+    }
+    APILog(@"%@: %.2f µs per response", name, elapsed * 1e6 / iterations);
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ Validates a 'wall.get' payload with 100 posts: each post against the template of the post.
+ Compares walking the template on each response, the cached compiled plan and the plan with the fingerprints
+ of the passed structures (only the rules are checked again). Then validates 'items' with 5000 posts.
+ --------------------------------------------------------------------------------------------------------------*/
++ (void) benchmarkValidation:(NSUInteger)iterations
+{
+    iterations = MAX(1, iterations);
+
+    NSMutableArray* posts = [NSMutableArray new];
+    for (NSInteger i = 0; i < 100; i++) [posts addObject:ValidatorBenchmarkPost(i)];
+
+    NSMutableDictionary* template = ValidatorBenchmarkPost(0);
+    template[@"post_type-Rules"] = @{ matchWithOneOfKey : @[@"post",@"copy",@"reply",@"postpone",@"suggest"] };
+    template[@"text-Rules"]      = @{ isOptionalKey : @(YES) };
+    template[@"date-Rules"]      = @{ minimumKey : @(0) };
+
+    ValidatorMeasure(@"wall.get x100 (template walked per response)", iterations, ^{
+        for (NSDictionary* post in posts){
+            NSMutableArray* issues = [NSMutableArray new];
+            [Validator runPlan:ValidationPlanCompile(template) onJSON:post validationMask:AllChecks issues:issues];
+        }
+    });
+    ValidatorMeasure(@"wall.get x100 (compiled plan)                ", iterations, ^{
+        ValidationPlan* plan = [Validator planForTemplate:template];
+        for (NSDictionary* post in posts){
+            NSMutableArray* issues = [NSMutableArray new];
+            [Validator runPlan:plan onJSON:post validationMask:AllChecks issues:issues];
+        }
+    });
+    ValidatorMeasure(@"wall.get x100 (compiled plan + fingerprints) ", iterations, ^{
+        for (NSDictionary* post in posts){
+            [Validator automaticValidateResponse:post template:template validationMask:AllChecks fromAPIMethod:APIMethod_WallGet];
+        }
+    });
+    
+    // The whole response: the elements of 'items' are checked against the first post of the template
+    NSMutableArray* items = [NSMutableArray new];
+    for (NSInteger i = 0; i < 5000; i++) [items addObject:posts[i % posts.count]];
+    
+    NSDictionary* response         = @{ @"response" : @{ @"count" : @(items.count), @"items" : items } };
+    NSDictionary* responseTemplate = @{ @"response" : @{ @"count" : @(1), @"items" : @[template] } };
+    ValidationPlan* responsePlan   = [Validator planForTemplate:responseTemplate];
+    
+    ValidatorMeasure(@"wall.get items x5000 (elements in parallel)  ", iterations, ^{
+        NSMutableArray* issues = [NSMutableArray new];
+        [Validator runPlan:responsePlan onJSON:response validationMask:[Validator validationMaskForAPIMethod:APIMethod_WallGet] issues:issues];
+    });
+}
+#endif
+
 @end
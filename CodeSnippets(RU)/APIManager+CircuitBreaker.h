@@ -0,0 +1,95 @@
+#import "APIManager.h"
+#import "APIMethods.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+/*--------------------------------------------------------------------------------------------------------------
+ Состояния цепи одного хоста.
+ 'Closed'   - запросы отправляются как обычно, их исходы подсчитываются.
+ 'Open'     - запросы не отправляются, а сразу завершаются с ошибкой (или получают ответ из кэша).
+ 'HalfOpen' - интервал открытия прошел. Отправляется только один пробный запрос, его исход закрывает или открывает цепь.
+ --------------------------------------------------------------------------------------------------------------*/
+typedef NS_ENUM(NSInteger, APICircuitState) {
+    APICircuitState_Closed = 0,
+    APICircuitState_Open,
+    APICircuitState_HalfOpen
+};
+
+// Код ошибки, которая возвращается вместо отправки запроса на хост с открытой цепью
+static const NSInteger APICircuitOpenErrorCode = 503;
+
+
+/*--------------------------------------------------------------------------------------------------------------
+ 🌐🔌 'APIManager(CircuitBreaker)' - прекращает отправку запросов на хост, который не отвечает.
+ ---------------
+ Когда 'api.vk.com' или сервер загрузки фотографий деградирует, каждый экран продолжает отправлять запросы, которые
+ ждут таймаута в 5 секунд. Операции копятся в очередях, а сервер получает еще большую нагрузку.
+ Предохранитель подсчитывает исходы последних запросов каждого хоста и, если слишком многие из них неудачны,
+ "размыкает цепь": новые запросы сразу завершаются с ошибкой, не уходя в сеть.
+ ---------------
+ [⚖️] Обязанности:
+ - Хранить скользящее окно последних 'circuitWindowSize' исходов для каждого хоста.
+ - Открывать цепь, когда доля сбоев достигает 'circuitFailureRateThreshold'.
+ - Через 'circuitOpenInterval' секунд пропускать один пробный запрос и закрывать цепь, если он успешен.
+ - Хранить последний успешный ответ идемпотентных запросов и возвращать его, пока цепь открыта.
+ ---------------
+ Дополнительно:
+ (⚠️) Сбоями считаются таймауты, отказы в соединении и ошибки VK 1 и 10. Отмененные запросы и отсутствие
+      Интернета на устройстве не учитываются: они ничего не говорят о состоянии сервера.
+ (⚠️) Отклоненный запрос не отправляется. Методы 'APIManager' все равно возвращают операцию, она уже
+      содержит ошибку с кодом 'APICircuitOpenErrorCode' или ответ из кэша. При запуске операция выполняет
+      локальный запрос, построенный '+requestInPlaceOfRejectedRequest:', и завершается как обычно.
+ --------------------------------------------------------------------------------------------------------------*/
+@interface APIManager (CircuitBreaker)
+
+@property (class, nonatomic, assign) double         circuitFailureRateThreshold; // default 0.5
+@property (class, nonatomic, assign) NSUInteger     circuitWindowSize;           // default 20
+@property (class, nonatomic, assign) NSUInteger     circuitMinimumRequests;      // default 10. Меньшее число исходов никогда не открывает цепь
+@property (class, nonatomic, assign) NSTimeInterval circuitOpenInterval;         // default 30 sec.
+
+
+#pragma mark - Admission
+
+/*--------------------------------------------------------------------------------------------------------------
+ Возвращает 'nil' если запрос можно отправить, иначе ошибку, которая возвращается пользователю вместо ответа.
+ В состоянии 'HalfOpen' первый вызов пропускает пробный запрос, все следующие отклоняются до его исхода.
+ --------------------------------------------------------------------------------------------------------------*/
++ (nullable NSError*) admitRequest:(NSURLRequest*)request;
+
+/*--------------------------------------------------------------------------------------------------------------
+ Возвращает 'YES', если '+admitRequest:' сейчас отклонил бы запрос. В отличие от него ничего не меняет:
+ пробный запрос полуоткрытой цепи не занимается.
+ --------------------------------------------------------------------------------------------------------------*/
++ (BOOL) isCircuitOpenForRequest:(NSURLRequest*)request;
+
+/*--------------------------------------------------------------------------------------------------------------
+ Возвращает запрос, который операция отклоненного запроса выполняет вместо него. 'NSURLSession' сам отвечает
+ на 'data:' URL без сети, поэтому операция запускается и завершается как обычно: '-syncStart' возвращается,
+ очередь освобождает операцию, вызывается 'completion'.
+ --------------------------------------------------------------------------------------------------------------*/
++ (NSURLRequest*) requestInPlaceOfRejectedRequest:(NSURLRequest*)request;
+
+/*--------------------------------------------------------------------------------------------------------------
+ Учитывает исход завершенной операции в окне хоста, на который был отправлен запрос.
+ --------------------------------------------------------------------------------------------------------------*/
++ (void) recordOutcomeOfOperation:(BO*)op forRequest:(NSURLRequest*)request;
+
++ (APICircuitState) circuitStateForHost:(NSString*)host;
+
+
+#pragma mark - Cache
+
+/*--------------------------------------------------------------------------------------------------------------
+ Сохраняет успешный ответ API метода, у которого 'cacheTTL' больше нуля. Остальные ответы игнорируются.
+ --------------------------------------------------------------------------------------------------------------*/
++ (void) cacheResponseOfOperation:(BO*)op forRequest:(NSURLRequest*)request APIMethod:(APIMethod)method;
+
+/*--------------------------------------------------------------------------------------------------------------
+ Возвращает последний успешный ответ на такой же запрос, если он не старше 'cacheTTL', или 'nil'.
+
+ --------------------------------------------------------------------------------------------------------------*/
++ (nullable id) cachedResponseForRequest:(NSURLRequest*)request APIMethod:(APIMethod)method;
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,398 @@
+#import "APIManager+CircuitBreaker.h"
+#import "APIManager+RetryPolicy.h"
+#import "APIMethodRegistry.h"
+#import "NetworkRequestConstructor+RequestBody.h"
+#import "NSError+ShortStyle.h"
+#import <RXNetworkOperation/RXNetworkOperation.h>
+
+
+// Ошибки VK API, которые означают, что проблемы у самого сервера
+#define unknownErrorCode        1   // "Unknown error occurred"
+#define internalServerErrorCode 10  // "Internal server error"
+// Сколько последних успешных ответов хранится на случай открытой цепи
+#define responseCacheCountLimit 64
+
+
+typedef NS_ENUM(NSInteger, APICircuitOutcome) {
+    APICircuitOutcome_Neutral = 0,
+    APICircuitOutcome_Success,
+    APICircuitOutcome_Failure
+};
+
+
+/*--------------------------------------------------------------------------------------------------------------
+ 'APICircuit' - состояние цепи одного хоста.
+ 'outcomes' - кольцевой буфер последних исходов ('YES' - сбой).
+ --------------------------------------------------------------------------------------------------------------*/
+@interface APICircuit : NSObject
+@property (nonatomic, assign) APICircuitState state;
+@property (nonatomic, strong) NSMutableArray<NSNumber*>* outcomes;
+@property (nonatomic, assign) NSUInteger     nextOutcomeIndex;
+@property (nonatomic, assign) CFAbsoluteTime openedAt;
+@property (nonatomic, assign) CFAbsoluteTime probeSentAt; // '0' - пробный запрос не выполняется
+
+- (void) addOutcome:(BOOL)isFailure windowSize:(NSUInteger)windowSize;
+- (double) failureRate;
+- (void) open;
+- (void) close;
+@end
+
+
+@implementation APICircuit
+
+- (instancetype) init
+{
+    self = [super init];
+    if (self) {
+        _outcomes = [NSMutableArray new];
+    }
+    return self;
+}
+
+- (void) addOutcome:(BOOL)isFailure windowSize:(NSUInteger)windowSize
+{
+    if (self.outcomes.count < windowSize){
+        [self.outcomes addObject:@(isFailure)];
+        return;
+    }
+    // Окно уменьшили через сеттер
+    while (self.outcomes.count > windowSize) [self.outcomes removeObjectAtIndex:0];
+
+    NSUInteger index = self.nextOutcomeIndex % windowSize;
+    self.outcomes[index]  = @(isFailure);
+    self.nextOutcomeIndex = (index + 1) % windowSize;
+}
+
+- (double) failureRate
+{
+    if (self.outcomes.count < 1) return 0;
+
+    NSUInteger failures = 0;
+    for (NSNumber* isFailure in self.outcomes){
+        if (isFailure.boolValue) failures += 1;
+    }
+    return (double)failures / self.outcomes.count;
+}
+
+- (void) open
+{
+    self.state       = APICircuitState_Open;
+    self.openedAt    = CFAbsoluteTimeGetCurrent();
+    self.probeSentAt = 0;
+}
+
+- (void) close
+{
+    self.state       = APICircuitState_Closed;
+    self.probeSentAt = 0;
+    self.nextOutcomeIndex = 0;
+    [self.outcomes removeAllObjects];
+}
+
+@end
+
+
+
+static double         _circuitFailureRateThreshold = 0.5;
+static NSUInteger     _circuitWindowSize           = 20;
+static NSUInteger     _circuitMinimumRequests      = 10;
+static NSTimeInterval _circuitOpenInterval         = 30;
+static NSMutableDictionary<NSString*,APICircuit*>* _circuits = nil;
+static NSCache<NSString*,id>* _responseCache = nil;
+
+
+
+@implementation APIManager (CircuitBreaker)
+
+#pragma mark - Admission
+
+/*--------------------------------------------------------------------------------------------------------------
+ Возвращает 'nil' если запрос можно отправить, иначе ошибку, которая возвращается пользователю вместо ответа.
+ --------------------------------------------------------------------------------------------------------------*/
++ (nullable NSError*) admitRequest:(NSURLRequest*)request
+{
+    NSString* host = [APIManager circuitKeyForRequest:request];
+
+    @synchronized ([NSNotificationCenter defaultCenter])
+    {
+        APICircuit* circuit = [APIManager circuitForHost:host];
+        CFAbsoluteTime now  = CFAbsoluteTimeGetCurrent();
+
+        if ((circuit.state == APICircuitState_Open) && (now - circuit.openedAt >= _circuitOpenInterval)){
+            circuit.state = APICircuitState_HalfOpen;
+        }
+
+        switch (circuit.state) {
+            case APICircuitState_Closed:
+                return nil;
+
+            case APICircuitState_HalfOpen:
+                // Пробный запрос, не вернувшийся в течение интервала открытия, считается потерянным
+                if ((circuit.probeSentAt > 0) && (now - circuit.probeSentAt < _circuitOpenInterval)) break;
+                circuit.probeSentAt = now;
+                APILog(@"The circuit of '%@' is half-open. The probe request is sent",host);
+                return nil;
+
+            case APICircuitState_Open:
+                break;
+        }
+    }
+    return [NSError initWithMsg:str(@"'%@' is temporarily unavailable",host) code:APICircuitOpenErrorCode];
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ Возвращает 'YES', если '+admitRequest:' сейчас отклонил бы запрос. В отличие от него ничего не меняет.
+ --------------------------------------------------------------------------------------------------------------*/
++ (BOOL) isCircuitOpenForRequest:(NSURLRequest*)request
+{
+    NSString* host = [APIManager circuitKeyForRequest:request];
+
+    @synchronized ([NSNotificationCenter defaultCenter])
+    {
+        APICircuit* circuit = _circuits[host];
+        CFAbsoluteTime now  = CFAbsoluteTimeGetCurrent();
+
+        switch (circuit.state) {
+            case APICircuitState_Closed:
+                return NO;
+
+            // Интервал открытия прошел: '+admitRequest:' пропустит пробный запрос
+            case APICircuitState_Open:
+                return (now - circuit.openedAt < _circuitOpenInterval);
+
+            // Пробный запрос в пути
+            case APICircuitState_HalfOpen:
+                return ((circuit.probeSentAt > 0) && (now - circuit.probeSentAt < _circuitOpenInterval));
+        }
+    }
+    return NO;
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ Возвращает запрос, который операция отклоненного запроса выполняет вместо него. 'NSURLSession' сам отвечает
+ на 'data:' URL без сети, поэтому операция запускается и завершается как обычно: '-syncStart' возвращается,
+ очередь освобождает операцию, вызывается 'completion'.
+ --------------------------------------------------------------------------------------------------------------*/
++ (NSURLRequest*) requestInPlaceOfRejectedRequest:(NSURLRequest*)request
+{
+    NSMutableURLRequest* localRequest = [NSMutableURLRequest requestWithURL:[NSURL URLWithString:@"data:application/json,%7B%7D"]];
+    localRequest.HTTPMethod = request.HTTPMethod;
+    // Пустое тело: операция загрузки отправляет его как файл
+    localRequest.HTTPBody   = [NSData data];
+    return localRequest;
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ Учитывает исход завершенной операции в окне хоста, на который был отправлен запрос.
+ --------------------------------------------------------------------------------------------------------------*/
++ (void) recordOutcomeOfOperation:(BO*)op forRequest:(NSURLRequest*)request
+{
+    NSString* host = [APIManager circuitKeyForRequest:request];
+    APICircuitOutcome outcome = [APIManager circuitOutcomeOfOperation:op];
+
+    @synchronized ([NSNotificationCenter defaultCenter])
+    {
+        APICircuit* circuit = [APIManager circuitForHost:host];
+        switch (circuit.state)
+        {
+            case APICircuitState_Closed:
+                if (outcome == APICircuitOutcome_Neutral) return;
+                [circuit addOutcome:(outcome == APICircuitOutcome_Failure) windowSize:_circuitWindowSize];
+
+                if ((circuit.outcomes.count >= _circuitMinimumRequests) &&
+                    ([circuit failureRate] >= _circuitFailureRateThreshold)){
+                    APILog(@"The circuit of '%@' is opened. Failure rate: %.2f",host,[circuit failureRate]);
+                    [circuit open];
+                }
+                break;
+
+            case APICircuitState_HalfOpen:
+                // Пробный запрос ничего не сказал о сервере. Следующий запрос станет пробным
+                if (outcome == APICircuitOutcome_Neutral){
+                    circuit.probeSentAt = 0;
+                } else if (outcome == APICircuitOutcome_Success){
+                    APILog(@"The circuit of '%@' is closed",host);
+                    [circuit close];
+                } else {
+                    [circuit open];
+                }
+                break;
+
+            case APICircuitState_Open:
+                // Запоздавшие ответы на запросы, отправленные до открытия цепи
+                break;
+        }
+    }
+}
+
++ (APICircuitState) circuitStateForHost:(NSString*)host
+{
+    @synchronized ([NSNotificationCenter defaultCenter]){
+        return _circuits[host].state;
+    }
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ Сервер ответил - успех, даже если ответ содержит ошибку самого запроса (Например 401).
+ --------------------------------------------------------------------------------------------------------------*/
++ (APICircuitOutcome) circuitOutcomeOfOperation:(BO*)op
+{
+    if (([op.json isKindOfClass:[NSDictionary class]]) && ([op.json[@"error"] isKindOfClass:[NSDictionary class]]))
+    {
+        NSInteger code = [op.json[@"error"][@"error_code"] integerValue];
+        BOOL isServerFailure = (code == unknownErrorCode) || (code == internalServerErrorCode);
+        return (isServerFailure) ? APICircuitOutcome_Failure : APICircuitOutcome_Success;
+    }
+    if (!op.error){
+        return (op.json) ? APICircuitOutcome_Success : APICircuitOutcome_Failure;
+    }
+
+    if (([op.error.domain isEqualToString:NSURLErrorDomain]) &&
+        ((op.error.code == NSURLErrorCancelled) || (op.error.code == NSURLErrorNotConnectedToInternet))){
+        return APICircuitOutcome_Neutral;
+    }
+    return APICircuitOutcome_Failure;
+}
+
+
+#pragma mark - Cache
+
+/*--------------------------------------------------------------------------------------------------------------
+ Сохраняет успешный ответ API метода, у которого 'cacheTTL' больше нуля. Остальные ответы игнорируются.
+ --------------------------------------------------------------------------------------------------------------*/
++ (void) cacheResponseOfOperation:(BO*)op forRequest:(NSURLRequest*)request APIMethod:(APIMethod)method
+{
+    if (APIMethodInfoFor(method)->cacheTTL <= 0) return;
+    if ((op.error) || (![op.json isKindOfClass:[NSDictionary class]]) || (!op.json[@"response"])) return;
+
+    @synchronized ([NSNotificationCenter defaultCenter])
+    {
+        if (!_responseCache){
+             _responseCache = [NSCache new];
+             _responseCache.countLimit = responseCacheCountLimit;
+        }
+    }
+    [_responseCache setObject:@[op.json, @(CFAbsoluteTimeGetCurrent())] forKey:[APIManager cacheKeyForRequest:request APIMethod:method]];
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ Возвращает последний успешный ответ на такой же запрос, если он не старше 'cacheTTL', или 'nil'.
+ --------------------------------------------------------------------------------------------------------------*/
++ (nullable id) cachedResponseForRequest:(NSURLRequest*)request APIMethod:(APIMethod)method
+{
+    NSTimeInterval cacheTTL = APIMethodInfoFor(method)->cacheTTL;
+    if (cacheTTL <= 0) return nil;
+
+    NSCache* cache = nil;
+    @synchronized ([NSNotificationCenter defaultCenter]){
+        cache = _responseCache;
+    }
+    // [json, время сохранения]
+    NSArray* entry = [cache objectForKey:[APIManager cacheKeyForRequest:request APIMethod:method]];
+    if ((!entry) || (CFAbsoluteTimeGetCurrent() - [entry.lastObject doubleValue] > cacheTTL)) return nil;
+    return entry.firstObject;
+}
+
+
+#pragma mark - Helpers
+
++ (NSString*) circuitKeyForRequest:(NSURLRequest*)request
+{
+    NSString* host = request.URL.host;
+    return (host) ? host.lowercaseString : @"";
+}
+
++ (NSString*) cacheKeyForRequest:(NSURLRequest*)request APIMethod:(APIMethod)method
+{
+    return str(@"%ld|%@",(long)method,[NRC canonicalKeyForRequest:request]);
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ [Internal method] Должен вызываться внутри '@synchronized ([NSNotificationCenter defaultCenter])'.
+
+ --------------------------------------------------------------------------------------------------------------*/
++ (APICircuit*) circuitForHost:(NSString*)host
+{
+    if (!_circuits){
+         _circuits = [NSMutableDictionary new];
+    }
+    APICircuit* circuit = _circuits[host];
+    if (!circuit){
+        circuit = [APICircuit new];
+        _circuits[host] = circuit;
+    }
+    return circuit;
+}
+
+
+#pragma mark - Setters & Getters
+
+/*--------------------------------------------------------------------------------------------------------------
+ @property (class, nonatomic, assign) double circuitFailureRateThreshold;
+ --------------------------------------------------------------------------------------------------------------*/
++ (void)setCircuitFailureRateThreshold:(double)circuitFailureRateThreshold
+{
+    @synchronized ([NSNotificationCenter defaultCenter]){
+        _circuitFailureRateThreshold = MIN(1, MAX(0, circuitFailureRateThreshold));
+    }
+}
+
++ (double)circuitFailureRateThreshold
+{
+    @synchronized ([NSNotificationCenter defaultCenter]){
+        return _circuitFailureRateThreshold;
+    }
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ @property (class, nonatomic, assign) NSUInteger circuitWindowSize;
+ --------------------------------------------------------------------------------------------------------------*/
++ (void)setCircuitWindowSize:(NSUInteger)circuitWindowSize
+{
+    @synchronized ([NSNotificationCenter defaultCenter]){
+        _circuitWindowSize = MAX(1, circuitWindowSize);
+    }
+}
+
++ (NSUInteger)circuitWindowSize
+{
+    @synchronized ([NSNotificationCenter defaultCenter]){
+        return _circuitWindowSize;
+    }
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ @property (class, nonatomic, assign) NSUInteger circuitMinimumRequests;
+ --------------------------------------------------------------------------------------------------------------*/
++ (void)setCircuitMinimumRequests:(NSUInteger)circuitMinimumRequests
+{
+    @synchronized ([NSNotificationCenter defaultCenter]){
+        _circuitMinimumRequests = MAX(1, circuitMinimumRequests);
+    }
+}
+
++ (NSUInteger)circuitMinimumRequests
+{
+    @synchronized ([NSNotificationCenter defaultCenter]){
+        return _circuitMinimumRequests;
+    }
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ @property (class, nonatomic, assign) NSTimeInterval circuitOpenInterval;
+ --------------------------------------------------------------------------------------------------------------*/
++ (void)setCircuitOpenInterval:(NSTimeInterval)circuitOpenInterval
+{
+    @synchronized ([NSNotificationCenter defaultCenter]){
+        _circuitOpenInterval = MAX(0, circuitOpenInterval);
+    }
+}
+
++ (NSTimeInterval)circuitOpenInterval
+{
+    @synchronized ([NSNotificationCenter defaultCenter]){
+        return _circuitOpenInterval;
+    }
+}
+
+@end
@@ -0,0 +1,55 @@
+#import "APIManager.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+/*--------------------------------------------------------------------------------------------------------------
+ Отправляется на главном потоке, когда 'APIManager.isReachable' меняет свое значение.
+ --------------------------------------------------------------------------------------------------------------*/
+extern NSNotificationName const APIReachabilityDidChangeNotification;
+
+
+/*--------------------------------------------------------------------------------------------------------------
+ 🌐📶 'APIManager(Connectivity)' - заранее подготавливает соединения и отслеживает доступность сети.
+ ---------------
+ Первый запрос после запуска платит за DNS, TCP и TLS до 'api.vk.com', прежде чем получит первый байт.
+ Категория открывает эти соединения в фоне, пока приложение еще запускается, поэтому первый
+ реальный запрос идет через уже установленное соединение.
+ ---------------
+ [⚖️] Обязанности:
+ - Отправлять легкие 'HEAD' запросы на хост 'baseURL' и на хост загрузки фотографий через
+   'APIManager.defaultSession', чтобы соединения остались в ее пуле.
+ - Определять доступность сети по исходам реальных запросов, без активных пингов.
+ ---------------
+ Дополнительно:
+ (⚠️) Соединение переиспользуется только операциями, выполняемыми через 'APIManager.defaultSession'.
+ (⚠️) 'isReachable' равно 'YES', пока первый запрос не скажет обратное. Значение оптимистичное:
+      оно меняется только когда завершился реальный запрос.
+ --------------------------------------------------------------------------------------------------------------*/
+@interface APIManager (Connectivity)
+
+/*--------------------------------------------------------------------------------------------------------------
+ Хост, на который загружаются фотографии. Конкретный адрес загрузки выдает 'photos.getWallUploadServer',
+ но он всегда находится на этом хосте. По умолчанию 'https://pu.vk.com/'.
+ --------------------------------------------------------------------------------------------------------------*/
+@property (class, nonatomic, strong) NSString* uploadHostURL;
+
+@property (class, nonatomic, readonly, assign) BOOL isReachable;
+
+
+/*--------------------------------------------------------------------------------------------------------------
+ Открывает в фоне соединения с хостом 'baseURL' и с 'uploadHostURL'.
+ Вызывается из 'prepareAPIManagerBeforeUsing:'.
+ --------------------------------------------------------------------------------------------------------------*/
++ (void) prewarmConnections;
+
+/*--------------------------------------------------------------------------------------------------------------
+ Обновляет 'isReachable' по исходу завершенной операции.
+ Любой ответ сервера означает, что сеть доступна. Недоступной ее делают только ошибки, которые точно означают
+ отсутствие сети.
+
+ --------------------------------------------------------------------------------------------------------------*/
++ (void) updateReachabilityWithOperation:(BO*)op;
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,127 @@
+#import "APIManager+Connectivity.h"
+#import "MultiThreads.h"
+#import <RXNetworkOperation/RXNetworkOperation.h>
+
+
+#define defaultUploadHostURL @"https://pu.vk.com/"
+// Прогрев бесполезен, если он не успел завершиться до первых запросов
+#define prewarmTimeout       10
+
+
+NSNotificationName const APIReachabilityDidChangeNotification = @"APIReachabilityDidChangeNotification";
+
+static NSString* _uploadHostURL = nil;
+static BOOL      _isReachable   = YES;
+
+
+
+@implementation APIManager (Connectivity)
+
+/*--------------------------------------------------------------------------------------------------------------
+ Открывает в фоне соединения с хостом 'baseURL' и с 'uploadHostURL'.
+ --------------------------------------------------------------------------------------------------------------*/
++ (void) prewarmConnections
+{
+    NSMutableOrderedSet<NSURL*>* origins = [NSMutableOrderedSet new];
+    for (NSString* address in @[API.baseURL ?: @"", APIManager.uploadHostURL])
+    {
+        NSURLComponents* components = [NSURLComponents componentsWithString:address];
+        if (!components.host) continue;
+
+        // Важен только origin, соединение устанавливается с хостом, а не с путем
+        components.path  = @"/";
+        components.query = nil;
+        if (components.URL) [origins addObject:components.URL];
+    }
+
+    dispatch_async(dispatch_get_global_queue(QOS_CLASS_UTILITY, 0), ^{
+        for (NSURL* origin in origins)
+        {
+            NSMutableURLRequest* request = [NSMutableURLRequest requestWithURL:origin];
+            request.HTTPMethod      = @"HEAD";
+            request.timeoutInterval = prewarmTimeout;
+
+            DTO* netOp =
+            [DTO request:request uploadProgress:nil downloadProgress:nil completion:^(DTO * _Nonnull op, NSError * _Nullable error) {
+                // Сам ответ не важен. Важно соединение, которое остается в пуле сессии
+                [APIManager updateReachabilityWithOperation:op];
+            }];
+            netOp.privateSession = APIManager.defaultSession;
+            [netOp start];
+        }
+    });
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ Обновляет 'isReachable' по исходу завершенной операции.
+ --------------------------------------------------------------------------------------------------------------*/
++ (void) updateReachabilityWithOperation:(BO*)op
+{
+    BOOL isReachable = YES;
+
+    if ((op.error) && (!op.json))
+    {
+        if (![op.error.domain isEqualToString:NSURLErrorDomain]) return;
+
+        switch (op.error.code) {
+            case NSURLErrorNotConnectedToInternet:
+            case NSURLErrorDataNotAllowed:
+            case NSURLErrorInternationalRoamingOff:
+            case NSURLErrorCallIsActive:
+                isReachable = NO;
+                break;
+
+            // Остальные ошибки (таймаут, отмена и т.д.) ничего не говорят о сети устройства
+
+            default:
+                return;
+        }
+    }
+
+    @synchronized ([NSNotificationCenter defaultCenter])
+    {
+        if (_isReachable == isReachable) return;
+        _isReachable = isReachable;
+    }
+
+    APILog(@"Reachability changed: %@",(isReachable) ? @"reachable" : @"not reachable");
+    MainQueue(^{
+        [[NSNotificationCenter defaultCenter] postNotificationName:APIReachabilityDidChangeNotification object:nil];
+    });
+}
+
+
+#pragma mark - Setters & Getters
+
+/*--------------------------------------------------------------------------------------------------------------
+ @property (class, nonatomic, strong) NSString* uploadHostURL;
+ --------------------------------------------------------------------------------------------------------------*/
++ (void)setUploadHostURL:(NSString *)uploadHostURL
+{
+    @synchronized ([NSNotificationCenter defaultCenter]){
+        _uploadHostURL = uploadHostURL;
+    }
+}
+
++ (NSString *)uploadHostURL
+{
+    @synchronized ([NSNotificationCenter defaultCenter])
+    {
+        if (!_uploadHostURL){
+             _uploadHostURL = defaultUploadHostURL;
+        }
+        return _uploadHostURL;
+    }
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ @property (class, nonatomic, readonly, assign) BOOL isReachable;
+ --------------------------------------------------------------------------------------------------------------*/
++ (BOOL)isReachable
+{
+    @synchronized ([NSNotificationCenter defaultCenter]){
+        return _isReachable;
+    }
+}
+
+@end
@@ -0,0 +1,101 @@
+#import "APIManager.h"
+#import "APIMethods.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+/*--------------------------------------------------------------------------------------------------------------
+ 🏁 'APIHedgeRace' - гонка между исходным запросом и его дубликатом ('hedge').
+ ---------------
+ Гонка наблюдает за моментом запуска исходной операции. Если операция не получила ответ в пределах
+ адаптивного порога, гонка отправляет дубликат через 'APIManager.hedgeSession' (отдельный пул соединений).
+ Побеждает первый успешный ответ. Проигравший дубликат отменяется. Проигравший оригинал нет:
+ его держит пользователь, отменяется только его задача сессии.
+ --------------------------------------------------------------------------------------------------------------*/
+@interface APIHedgeRace : NSObject
+
+/*--------------------------------------------------------------------------------------------------------------
+ 'attemptCompletion' вызывается, когда дубликат завершился.
+ (⚠️) Не захватывайте 'op' сильной ссылкой внутри блока, гонка хранится до окончания операции.
+ --------------------------------------------------------------------------------------------------------------*/
++ (instancetype) raceForOperation:(DTO*)op
+                        APIMethod:(APIMethod)method
+                          request:(NSURLRequest*)request
+                attemptCompletion:(void(^)(DTO* finishedOp))attemptCompletion;
+
+/*--------------------------------------------------------------------------------------------------------------
+ Вызывается, когда исходная операция или ее дубликат завершились.
+ Возвращает 'YES' если ответ нужно доставить пользователю. Возвращает 'NO' для проигравшего и для первого
+ неудачного ответа, пока второй запрос еще выполняется.
+ --------------------------------------------------------------------------------------------------------------*/
+- (BOOL) shouldDeliverAttempt:(DTO*)attemptOp;
+
+@end
+
+
+
+/*--------------------------------------------------------------------------------------------------------------
+ 🌐🏁 'APIManager(Hedging)' - сокращает "хвостовые" задержки идемпотентных запросов на чтение.
+ ---------------
+ Большая часть медленных ответов вызвана не сервером, а "зависшим" соединением. Такой запрос ждет таймаута,
+ хотя дубликат отправленный через другое соединение получил бы ответ за обычное время.
+ ---------------
+ [⚖️] Обязанности:
+ - Собирать задержки последних запросов для каждого API метода.
+ - Вычислять порог (перцентиль 'hedgingPercentile' задержки), после которого отправляется дубликат.
+ - Ограничивать количество дубликатов ('hedging budget'), чтобы они добавляли не больше 'hedgingBudgetRatio' нагрузки.
+ ---------------
+ Дополнительно:
+ (⚠️) По умолчанию hedging выключен. Включите его через 'APIManager.isHedgingEnabled = YES'.
+ (⚠️) Дублируются только 'users.get', 'wall.get', 'friends.get' и 'photos.getAll'. Синхронные операции не дублируются.
+ --------------------------------------------------------------------------------------------------------------*/
+@interface APIManager (Hedging)
+
+@property (class, nonatomic, assign) BOOL   isHedgingEnabled;    // default 'NO'
+@property (class, nonatomic, assign) double hedgingPercentile;   // default 0.95
+@property (class, nonatomic, assign) double hedgingBudgetRatio;  // default 0.05 (не больше 5% лишних запросов)
+
+/*--------------------------------------------------------------------------------------------------------------
+ Сессия через которую отправляются дубликаты. У нее та же конфигурация что и у 'APIManager.defaultSession',
+ но собственный пул соединений, поэтому дубликат никогда не ждет "зависшее" соединение оригинала.
+ --------------------------------------------------------------------------------------------------------------*/
+@property (class, nonatomic, readonly, strong) NSURLSession* hedgeSession;
+
+
+/*--------------------------------------------------------------------------------------------------------------
+ Возвращает 'YES' если запросы API метода можно дублировать.
+ --------------------------------------------------------------------------------------------------------------*/
++ (BOOL) isHedgeableAPIMethod:(APIMethod)method;
+
+/*--------------------------------------------------------------------------------------------------------------
+ Возвращает время, после которого отправляется дубликат запроса.
+ Пока собрано меньше 20 ответов, возвращает 1 секунду.
+ --------------------------------------------------------------------------------------------------------------*/
++ (NSTimeInterval) hedgeDelayForAPIMethod:(APIMethod)method;
+
+/*--------------------------------------------------------------------------------------------------------------
+ Сохраняет задержку успешного ответа. Для каждого API метода хранятся последние 128 значений.
+ --------------------------------------------------------------------------------------------------------------*/
++ (void) recordLatency:(NSTimeInterval)latency forAPIMethod:(APIMethod)method;
+
+/*--------------------------------------------------------------------------------------------------------------
+ Вызывается для каждого запроса, который можно дублировать. Пополняет бюджет дубликатов.
+ 'tryWithdrawHedgingBudget' возвращает 'NO' если бюджет исчерпан.
+
+ --------------------------------------------------------------------------------------------------------------*/
++ (void) depositHedgingBudget;
++ (BOOL) tryWithdrawHedgingBudget;
+
+
+#pragma mark - Self-check
+
+#if DEBUG
+/*--------------------------------------------------------------------------------------------------------------
+ Дубликат выигрывает гонку: он доставляется, оригинал не отменяется, а поздний ответ оригинала не доставляется
+ и не перезаписывает доставленный результат. Возвращает 'YES', если проверка пройдена.
+ --------------------------------------------------------------------------------------------------------------*/
++ (BOOL) checkRaceWonByHedge;
+#endif
+
+@end
+
+NS_ASSUME_NONNULL_END
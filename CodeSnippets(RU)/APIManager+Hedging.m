@@ -0,0 +1,401 @@
+#import "APIManager+Hedging.h"
+#import "APIMethodRegistry.h"
+#import "APIManager+RateGovernor.h"
+#import <RXNetworkOperation/RXNetworkOperation.h>
+
+
+// Сколько последних задержек хранится для каждого API метода
+#define latencySamplesCapacity 128
+// Пока не собрано столько ответов, перцентилю не доверяем
+#define latencySamplesMinimum  20
+#define defaultHedgeDelay      1.0
+#define minimumHedgeDelay      0.05
+#define hedgingBudgetCapacity  5.0
+
+
+static BOOL          _isHedgingEnabled   = NO;
+static double        _hedgingPercentile  = 0.95;
+static double        _hedgingBudgetRatio = 0.05;
+static double        _hedgingBudget      = hedgingBudgetCapacity;
+static NSURLSession* _hedgeSession       = nil;
+static NSMutableDictionary<NSNumber*,NSMutableArray<NSNumber*>*>* _latencySamples = nil;
+static NSMutableDictionary<NSNumber*,NSNumber*>* _latencySampleIndexes = nil;
+
+
+
+@interface APIHedgeRace ()
+@property (nonatomic, weak)   DTO*           op;
+@property (nonatomic, assign) APIMethod      method;
+@property (nonatomic, strong) NSURLRequest*  request;
+@property (nonatomic, copy, nullable)   void(^attemptCompletion)(DTO* finishedOp);
+@property (nonatomic, strong, nullable) DTO* hedgeOp;
+@property (nonatomic, weak,   nullable) DTO* loser;
+// Ответ дубликата, доставленный в оригинале. Восстанавливается, если поздний ответ оригинала его перезапишет
+@property (nonatomic, strong, nullable) id       winnerJSON;
+@property (nonatomic, strong, nullable) NSError* winnerError;
+@property (nonatomic, assign) CFAbsoluteTime startedAt;
+@property (nonatomic, assign) BOOL isResolved;
+@property (nonatomic, assign) BOOL isObserving;
+@property (nonatomic, assign) BOOL hasFailedContender;
+@end
+
+
+@implementation APIHedgeRace
+
++ (instancetype) raceForOperation:(DTO*)op
+                        APIMethod:(APIMethod)method
+                          request:(NSURLRequest*)request
+                attemptCompletion:(void(^)(DTO* finishedOp))attemptCompletion
+{
+    APIHedgeRace* race = [APIHedgeRace new];
+    race.op      = op;
+    race.method  = method;
+    race.request = request;
+    race.attemptCompletion = attemptCompletion;
+
+    // Таймер запускается, когда операция действительно стартовала, а не когда ее положили в очередь
+    race.isObserving = YES;
+    [op addObserver:race forKeyPath:@"isExecuting" options:NSKeyValueObservingOptionNew context:nil];
+    return race;
+}
+
+- (void) observeValueForKeyPath:(NSString*)keyPath ofObject:(id)object change:(NSDictionary*)change context:(void*)context
+{
+    if (![change[NSKeyValueChangeNewKey] boolValue]) return;
+
+    @synchronized (self)
+    {
+        if ((self.startedAt > 0) || (self.isResolved)) return;
+        self.startedAt = CFAbsoluteTimeGetCurrent();
+    }
+
+    NSTimeInterval delay = [APIManager hedgeDelayForAPIMethod:self.method];
+    __weak APIHedgeRace* weakSelf = self;
+    dispatch_after(dispatch_time(DISPATCH_TIME_NOW, (int64_t)(delay * NSEC_PER_SEC)),
+                   dispatch_get_global_queue(QOS_CLASS_USER_INITIATED, 0), ^{
+        [weakSelf sendHedge];
+    });
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ Оригинал не ответил в пределах порога. Отправляем дубликат, если это позволяют бюджет и лимит запросов.
+ --------------------------------------------------------------------------------------------------------------*/
+- (void) sendHedge
+{
+    DTO* op = self.op;
+    DTO* hedgeOp = nil;
+
+    @synchronized (self)
+    {
+        if ((!op) || (self.isResolved) || (op.isSync) || (op.isFinished) || (op.isCancelled)) return;
+
+        // Дубликат тоже запрос. Лучше не отправлять его вовсе, чем придерживать в очереди
+        if (![APIManager tryReserveRequestSlotForAPIMethod:self.method]) return;
+        if (![APIManager tryWithdrawHedgingBudget]) return;
+
+        __weak APIHedgeRace* weakSelf = self;
+        hedgeOp =
+        [DTO request:self.request uploadProgress:nil downloadProgress:nil completion:^(DTO * _Nonnull finishedOp, NSError * _Nullable error) {
+            void(^attemptCompletion)(DTO* finishedOp) = weakSelf.attemptCompletion;
+            if (attemptCompletion) attemptCompletion(finishedOp);
+        }];
+        hedgeOp.privateSession = APIManager.hedgeSession;
+        self.hedgeOp = hedgeOp;
+    }
+    [hedgeOp start];
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ Возвращает 'YES' если ответ нужно доставить пользователю.
+ --------------------------------------------------------------------------------------------------------------*/
+- (BOOL) shouldDeliverAttempt:(DTO*)attemptOp
+{
+    DTO* loser = nil;
+
+    @synchronized (self)
+    {
+        // Повторы сделанные после окончания гонки к ней не относятся
+        if ((attemptOp != self.op) && (attemptOp != self.hedgeOp)){
+            return YES;
+        }
+        if (self.isResolved){
+            // Поздний ответ проигравшего оригинала. RX уже записал его в операцию, которую держит пользователь
+            if ((attemptOp == self.loser) && (attemptOp == self.op)){
+                attemptOp.json  = self.winnerJSON;
+                attemptOp.error = self.winnerError;
+            }
+            return (attemptOp != self.loser);
+        }
+
+        // Пока соперник в полете, неудачный ответ не доставляется. Возможно сопернику повезет больше.
+        BOOL isSucceeded     = [APIHedgeRace isSucceededOperation:attemptOp];
+        BOOL isRivalInFlight = (self.hedgeOp) && (!self.hasFailedContender);
+        if ((!isSucceeded) && (isRivalInFlight)){
+            self.hasFailedContender = YES;
+            return NO;
+        }
+
+        self.isResolved = YES;
+        self.attemptCompletion = nil;
+        if ((self.hedgeOp) && (!self.hasFailedContender)){
+            loser = (attemptOp == self.op) ? self.hedgeOp : self.op;
+            self.loser = loser;
+        }
+        if ((loser) && (loser == self.op)){
+            self.winnerJSON  = attemptOp.json;
+            self.winnerError = attemptOp.error;
+        }
+        if ((isSucceeded) && (self.startedAt > 0)){
+            [APIManager recordLatency:CFAbsoluteTimeGetCurrent() - self.startedAt forAPIMethod:self.method];
+        }
+    }
+
+    [self stopObserving];
+
+    // Оригинал - это операция пользователя, она никогда не отменяется. Отменяется только ее задача сессии
+    if ((loser) && (loser == self.op)){
+        [self cancelTaskOfOperation:loser];
+    } else {
+        [loser cancel];
+    }
+    return YES;
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ Оригинал проиграл гонку. Пользователь держит оригинал и уже получил в нем ответ дубликата, поэтому сама
+ операция не отменяется (иначе у успешного результата 'isCancelled' будет 'YES').
+ Отменяется только ее 'NSURLSessionTask', чтобы освободить соединение.
+ --------------------------------------------------------------------------------------------------------------*/
+- (void) cancelTaskOfOperation:(DTO*)op
+{
+    NSURLRequest* request = self.request;
+    NSURLSession* session = (op.privateSession) ? op.privateSession : APIManager.defaultSession;
+
+    [session getAllTasksWithCompletionHandler:^(NSArray<__kindof NSURLSessionTask*>* tasks) {
+        NSURLSessionTask* originalTask = nil;
+        for (NSURLSessionTask* task in tasks)
+        {
+            if ((task.state != NSURLSessionTaskStateRunning) || (![task.originalRequest isEqual:request])) continue;
+
+            // Может выполняться такой же запрос другой операции. Тогда ничего не отменяется
+            if (originalTask) return;
+            originalTask = task;
+        }
+        [originalTask cancel];
+    }];
+}
+
+- (void) stopObserving
+{
+    DTO* op = self.op;
+    @synchronized (self)
+    {
+        if (!self.isObserving) return;
+        self.isObserving = NO;
+    }
+    [op removeObserver:self forKeyPath:@"isExecuting"];
+}
+
++ (BOOL) isSucceededOperation:(DTO*)op
+{
+    if ((op.error) || (!op.json)) return NO;
+    if (([op.json isKindOfClass:[NSDictionary class]]) && (op.json[@"error"])) return NO;
+    return YES;
+}
+
+@end
+
+
+
+@implementation APIManager (Hedging)
+
+/*--------------------------------------------------------------------------------------------------------------
+ Возвращает 'YES' если запросы API метода можно дублировать.
+ --------------------------------------------------------------------------------------------------------------*/
++ (BOOL) isHedgeableAPIMethod:(APIMethod)method
+{
+    return APIMethodInfoFor(method)->isHedgeable;
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ Возвращает время, после которого отправляется дубликат запроса.
+ --------------------------------------------------------------------------------------------------------------*/
++ (NSTimeInterval) hedgeDelayForAPIMethod:(APIMethod)method
+{
+    NSArray<NSNumber*>* samples = nil;
+    double percentile = 0;
+
+    @synchronized ([NSNotificationCenter defaultCenter])
+    {
+        samples    = [_latencySamples[@(method)] copy];
+        percentile = _hedgingPercentile;
+    }
+    if (samples.count < latencySamplesMinimum){
+        return defaultHedgeDelay;
+    }
+
+    NSArray<NSNumber*>* sorted = [samples sortedArrayUsingSelector:@selector(compare:)];
+    NSUInteger index = MIN(sorted.count - 1, (NSUInteger)(percentile * sorted.count));
+    return MAX(minimumHedgeDelay, [sorted[index] doubleValue]);
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ Сохраняет задержку успешного ответа в кольцевой буфер API метода.
+ --------------------------------------------------------------------------------------------------------------*/
++ (void) recordLatency:(NSTimeInterval)latency forAPIMethod:(APIMethod)method
+{
+    @synchronized ([NSNotificationCenter defaultCenter])
+    {
+        if (!_latencySamples){
+             _latencySamples       = [NSMutableDictionary new];
+             _latencySampleIndexes = [NSMutableDictionary new];
+        }
+        NSMutableArray<NSNumber*>* samples = _latencySamples[@(method)];
+        if (!samples){
+            samples = [NSMutableArray arrayWithCapacity:latencySamplesCapacity];
+            _latencySamples[@(method)] = samples;
+        }
+
+        if (samples.count < latencySamplesCapacity){
+            [samples addObject:@(latency)];
+        } else {
+            NSUInteger index = [_latencySampleIndexes[@(method)] unsignedIntegerValue];
+            samples[index] = @(latency);
+            _latencySampleIndexes[@(method)] = @((index + 1) % latencySamplesCapacity);
+        }
+    }
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ Вызывается для каждого запроса, который можно дублировать. Пополняет бюджет дубликатов.
+ --------------------------------------------------------------------------------------------------------------*/
++ (void) depositHedgingBudget
+{
+    @synchronized ([NSNotificationCenter defaultCenter]){
+        _hedgingBudget = MIN(hedgingBudgetCapacity, _hedgingBudget + _hedgingBudgetRatio);
+    }
+}
+
++ (BOOL) tryWithdrawHedgingBudget
+{
+    @synchronized ([NSNotificationCenter defaultCenter])
+    {
+        if (_hedgingBudget < 1) return NO;
+        _hedgingBudget -= 1;
+        return YES;
+    }
+}
+
+
+#pragma mark - Setters & Getters
+
+/*--------------------------------------------------------------------------------------------------------------
+ @property (class, nonatomic, assign) BOOL isHedgingEnabled;
+ --------------------------------------------------------------------------------------------------------------*/
++ (void)setIsHedgingEnabled:(BOOL)isHedgingEnabled
+{
+    @synchronized ([NSNotificationCenter defaultCenter]){
+        _isHedgingEnabled = isHedgingEnabled;
+    }
+}
+
++ (BOOL)isHedgingEnabled
+{
+    @synchronized ([NSNotificationCenter defaultCenter]){
+        return _isHedgingEnabled;
+    }
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ @property (class, nonatomic, assign) double hedgingPercentile;
+ --------------------------------------------------------------------------------------------------------------*/
++ (void)setHedgingPercentile:(double)hedgingPercentile
+{
+    @synchronized ([NSNotificationCenter defaultCenter]){
+        _hedgingPercentile = MIN(1, MAX(0, hedgingPercentile));
+    }
+}
+
++ (double)hedgingPercentile
+{
+    @synchronized ([NSNotificationCenter defaultCenter]){
+        return _hedgingPercentile;
+    }
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ @property (class, nonatomic, assign) double hedgingBudgetRatio;
+ --------------------------------------------------------------------------------------------------------------*/
++ (void)setHedgingBudgetRatio:(double)hedgingBudgetRatio
+{
+    @synchronized ([NSNotificationCenter defaultCenter]){
+        _hedgingBudgetRatio = MAX(0, hedgingBudgetRatio);
+    }
+}
+
++ (double)hedgingBudgetRatio
+{
+    @synchronized ([NSNotificationCenter defaultCenter]){
+        return _hedgingBudgetRatio;
+    }
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ @property (class, nonatomic, readonly, strong) NSURLSession* hedgeSession;
+ --------------------------------------------------------------------------------------------------------------*/
++ (NSURLSession*) hedgeSession
+{
+    @synchronized ([NSNotificationCenter defaultCenter])
+    {
+        if (!_hedgeSession){
+             // Та же конфигурация, но отдельный пул соединений
+
+             NSURLSessionConfiguration* configuration = APIManager.defaultSession.configuration;
+             _hedgeSession = [NSURLSession sessionWithConfiguration:configuration
+                                                           delegate:RXNO_BaseOperation.internal_delegate
+                                                      delegateQueue:nil];
+             _hedgeSession.sessionDescription = @"APIManager.hedgeSession";
+        }
+        return _hedgeSession;
+    }
+}
+
+
+#pragma mark - Self-check
+
+#if DEBUG
+/*--------------------------------------------------------------------------------------------------------------
+ Дубликат выигрывает гонку: он доставляется, оригинал не отменяется, а поздний ответ оригинала не доставляется
+ и не перезаписывает доставленный результат. Возвращает 'YES', если проверка пройдена.
+ --------------------------------------------------------------------------------------------------------------*/
++ (BOOL) checkRaceWonByHedge
+{
+    NSURLRequest* request = [NSURLRequest requestWithURL:[NSURL URLWithString:@"https://api.vk.com/method/users.get"]];
+    DTO* op      = [DTO new];
+    DTO* hedgeOp = [DTO new];
+
+    APIHedgeRace* race =
+    [APIHedgeRace raceForOperation:op APIMethod:APIMethod_UserGet request:request attemptCompletion:^(DTO * _Nonnull finishedOp) {}];
+    race.hedgeOp = hedgeOp;
+
+    // Дубликат отвечает первым
+    hedgeOp.json = @{ @"response" : @[ @{ @"id" : @(1) } ] };
+    BOOL isHedgeDelivered = [race shouldDeliverAttempt:hedgeOp];
+
+    // 'finishAttempt' копирует ответ победителя в операцию пользователя
+    op.json  = hedgeOp.json;
+    op.error = hedgeOp.error;
+
+    // Отмененная задача оригинала: RX записывает ошибку отмены в операцию
+    op.json  = nil;
+    op.error = [NSError errorWithDomain:NSURLErrorDomain code:NSURLErrorCancelled userInfo:nil];
+    BOOL isOriginalDelivered = [race shouldDeliverAttempt:op];
+
+    BOOL isPassed = (isHedgeDelivered) && (!isOriginalDelivered) && (!op.isCancelled) &&
+                    (!op.error) && ([op.json isEqual:hedgeOp.json]);
+    if (!isPassed) APILog(@"+[checkRaceWonByHedge] провалена");
+    return isPassed;
+}
+#endif
+
+@end
@@ -0,0 +1,106 @@
+#import "APIManager.h"
+#import "APIMethods.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+/*--------------------------------------------------------------------------------------------------------------
+ 🌐🚥 'APIManager(RateGovernor)' - удерживает частоту исходящих запросов в пределах лимитов VK API.
+ ---------------
+ VK позволяет пользовательскому токену выполнять около 3 запросов в секунду. Все что выше, отклоняется с
+ ошибкой 6 "Too many requests per second". Вместо того чтобы отправлять такие запросы и получать ошибку,
+ категория придерживает лишние операции в очереди, пока в 'token bucket' не появится свободный слот.
+ ---------------
+ [⚖️] Обязанности:
+ - Хранить по одному ведру на каждый токен доступа и на каждую группу методов.
+ - Вычислять сколько операция должна подождать перед отправкой.
+ - Придерживать операцию при ее запуске до наступления этого момента.
+ - Распознавать ошибку превышения лимита и вычислять задержку перед повторной отправкой запроса.
+ ---------------
+ Дополнительно:
+ (⚠️) Слот резервируется в момент запуска операции, а не ее создания: очередью 'NSOperationQueue',
+      методом '-start' или '-syncStart'. Если слот еще не свободен, '-start' отправит запрос когда он освободится,
+      а '-syncStart' блокирует поток до этого момента.
+ (⚠️) Повторы запроса придерживаются в 'APIManager.aSyncQueue' через зависимость от операции-'разрешения'.
+ --------------------------------------------------------------------------------------------------------------*/
+@interface APIManager (RateGovernor)
+
+/*--------------------------------------------------------------------------------------------------------------
+ Сколько раз запрос отправляется повторно после того, как сервер ответил ошибкой 6 "Too many requests per second".
+ По умолчанию 3. Каждый повтор отправляется только когда в ведре есть свободный слот, поэтому не тратит лишний запрос.
+ --------------------------------------------------------------------------------------------------------------*/
+@property (class, nonatomic, assign) NSUInteger maxRateLimitRetries;
+
+
+#pragma mark - Configuration
+
+/*--------------------------------------------------------------------------------------------------------------
+ Устанавливает лимит для всех запросов выполняемых с указанным токеном доступа.
+ Если передать 'nil' в 'accessToken', лимит станет значением по умолчанию для всех токенов (3 запроса в секунду).
+ Передайте '0' в 'requestsPerSecond', чтобы отключить лимит.
+ --------------------------------------------------------------------------------------------------------------*/
++ (void) setRequestsPerSecond:(double)requestsPerSecond
+                        burst:(NSUInteger)burst
+               forAccessToken:(nullable NSString*)accessToken;
+
+/*--------------------------------------------------------------------------------------------------------------
+ Устанавливает дополнительный лимит для группы методов (Например, 1 'wall.post' в секунду).
+ По умолчанию у групп нет собственного лимита. Передайте '0' в 'requestsPerSecond', чтобы отключить лимит.
+ --------------------------------------------------------------------------------------------------------------*/
++ (void) setRequestsPerSecond:(double)requestsPerSecond
+                        burst:(NSUInteger)burst
+               forMethodGroup:(APIMethodGroup)group;
+
+/*--------------------------------------------------------------------------------------------------------------
+ Возвращает группу к которой относится API метод.
+ --------------------------------------------------------------------------------------------------------------*/
++ (APIMethodGroup) methodGroupForAPIMethod:(APIMethod)method;
+
+
+#pragma mark - Dispatch
+
+/*--------------------------------------------------------------------------------------------------------------
+ Занимает слот для запроса в ведрах текущего токена и группы метода.
+ Возвращает количество секунд, которое запрос должен подождать перед отправкой ('0' - можно отправлять сразу).
+ --------------------------------------------------------------------------------------------------------------*/
++ (NSTimeInterval) reserveRequestSlotForAPIMethod:(APIMethod)method;
+
+/*--------------------------------------------------------------------------------------------------------------
+ Занимает слот, только если прямо сейчас он свободен в обоих ведрах. Иначе возвращает 'NO' и ничего не занимает.
+ Используется для необязательных запросов (Например дубликатов в hedging), которые лучше не отправлять вовсе, чем придерживать.
+ --------------------------------------------------------------------------------------------------------------*/
++ (BOOL) tryReserveRequestSlotForAPIMethod:(APIMethod)method;
+
+/*--------------------------------------------------------------------------------------------------------------
+ Помечает операцию как управляемую. При запуске (очередью, '-start' или '-syncStart') она резервирует слот
+ и отправляется только когда слот свободен. Вызывается 'APIManager'ом для каждой создаваемой операции DTO.
+ --------------------------------------------------------------------------------------------------------------*/
++ (void) governOperation:(NSOperation*)op forAPIMethod:(APIMethod)method;
+
+/*--------------------------------------------------------------------------------------------------------------
+ Возвращает время, когда управляемая операция была отправлена после своего слота, или '0', если она не запускалась.
+ Время ожидания слота не включается.
+ --------------------------------------------------------------------------------------------------------------*/
++ (CFAbsoluteTime) sendTimeOfOperation:(NSOperation*)op;
+
+/*--------------------------------------------------------------------------------------------------------------
+ Не позволяет очереди запустить операцию раньше чем через 'delay' секунд.
+ --------------------------------------------------------------------------------------------------------------*/
++ (void) holdOperation:(NSOperation*)op forTimeInterval:(NSTimeInterval)delay;
+
+
+#pragma mark - Throttling errors
+
+/*--------------------------------------------------------------------------------------------------------------
+ Возвращает 'YES' если сервер отклонил запрос с ошибкой 6 "Too many requests per second".
+ --------------------------------------------------------------------------------------------------------------*/
++ (BOOL) isRateLimitErrorInOperation:(BO*)op;
+
+/*--------------------------------------------------------------------------------------------------------------
+ Сервер насчитал больше запросов чем ведро (Например, тот же токен используется на другом устройстве).
+ Метод опустошает ведро токена и возвращает задержку, после которой запрос можно отправить повторно.
+ --------------------------------------------------------------------------------------------------------------*/
++ (NSTimeInterval) delayAfterRateLimitErrorForAPIMethod:(APIMethod)method;
+
+@end
+
+NS_ASSUME_NONNULL_END
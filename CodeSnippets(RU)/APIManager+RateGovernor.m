@@ -0,0 +1,422 @@
+#import "APIManager+RateGovernor.h"
+#import "APIMethodRegistry.h"
+#import "Token.h"
+#import <RXNetworkOperation/RXNetworkOperation.h>
+#import <objc/runtime.h>
+
+
+// Лимит VK API для пользовательского токена
+#define defaultRequestsPerSecond 3.0
+#define defaultBurst             3
+// Ошибка "Too many requests per second"
+#define rateLimitErrorCode       6
+// Ключ под которым хранится лимит по умолчанию для всех токенов
+#define anyAccessTokenKey        @"*"
+
+
+/*--------------------------------------------------------------------------------------------------------------
+ 'APIRateBucket' - классический 'token bucket'.
+ Каждый запрос забирает один токен. Токены восстанавливаются со скоростью 'rate', но не больше чем 'capacity'.
+ Количество токенов может становиться отрицательным, так ведро хранит очередь уже зарезервированных слотов.
+ --------------------------------------------------------------------------------------------------------------*/
+@interface APIRateBucket : NSObject
+@property (nonatomic, assign) double rate;
+@property (nonatomic, assign) double capacity;
+@property (nonatomic, assign) double tokens;
+@property (nonatomic, assign) CFAbsoluteTime timestamp;
+
++ (instancetype) bucketWithRate:(double)rate capacity:(double)capacity;
+- (NSTimeInterval) reserve;
+- (BOOL) hasFreeToken;
+- (void) drain;
+@end
+
+
+@implementation APIRateBucket
+
++ (instancetype) bucketWithRate:(double)rate capacity:(double)capacity
+{
+    APIRateBucket* bucket = [APIRateBucket new];
+    bucket.rate      = rate;
+    bucket.capacity  = MAX(1, capacity);
+    bucket.tokens    = bucket.capacity;
+    bucket.timestamp = CFAbsoluteTimeGetCurrent();
+    return bucket;
+}
+
+- (void) refill
+{
+    CFAbsoluteTime now = CFAbsoluteTimeGetCurrent();
+    self.tokens    = MIN(self.capacity, self.tokens + (now - self.timestamp) * self.rate);
+    self.timestamp = now;
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ Забирает один токен и возвращает количество секунд, через которое этот токен действительно станет доступен.
+ --------------------------------------------------------------------------------------------------------------*/
+- (NSTimeInterval) reserve
+{
+    if (self.rate <= 0) return 0;
+
+    [self refill];
+    NSTimeInterval wait = (self.tokens >= 1) ? 0 : (1 - self.tokens) / self.rate;
+    self.tokens -= 1;
+    return wait;
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ Забирает все свободные токены. Слоты зарезервированные ранее остаются в очереди.
+ --------------------------------------------------------------------------------------------------------------*/
+- (void) drain
+{
+    [self refill];
+    if (self.tokens > 0) self.tokens = 0;
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ Возвращает 'YES' если один токен доступен прямо сейчас.
+ --------------------------------------------------------------------------------------------------------------*/
+- (BOOL) hasFreeToken
+{
+    if (self.rate <= 0) return YES;
+
+    [self refill];
+    return (self.tokens >= 1);
+}
+
+@end
+
+
+
+static NSUInteger           _maxRateLimitRetries = 3;
+static NSMutableDictionary<NSString*,APIRateBucket*>* _rateBuckets = nil;
+static NSMutableDictionary<NSString*,NSArray<NSNumber*>*>* _tokenLimits = nil;
+static NSMutableDictionary<NSNumber*,NSArray<NSNumber*>*>* _groupLimits = nil;
+// API метод управляемой операции, слот которой еще не зарезервирован
+static char governedAPIMethodKey;
+// Время, когда слот управляемой операции позволяет отправить ее запрос
+static char sendTimeKey;
+
+
+
+@implementation APIManager (RateGovernor)
+
+#pragma mark - Configuration
+
+/*--------------------------------------------------------------------------------------------------------------
+ Устанавливает лимит для всех запросов выполняемых с указанным токеном доступа.
+ --------------------------------------------------------------------------------------------------------------*/
++ (void) setRequestsPerSecond:(double)requestsPerSecond
+                        burst:(NSUInteger)burst
+               forAccessToken:(nullable NSString*)accessToken
+{
+    NSString* key = (accessToken) ? [APIManager keyForAccessToken:accessToken] : anyAccessTokenKey;
+
+    @synchronized ([APIManager rateBuckets]) {
+        [APIManager tokenLimits][key] = @[@(MAX(0, requestsPerSecond)), @(burst)];
+        // Ведра будут пересозданы с новыми значениями при следующем запросе
+        [[APIManager rateBuckets] removeAllObjects];
+    }
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ Устанавливает дополнительный лимит для группы методов.
+ --------------------------------------------------------------------------------------------------------------*/
++ (void) setRequestsPerSecond:(double)requestsPerSecond
+                        burst:(NSUInteger)burst
+               forMethodGroup:(APIMethodGroup)group
+{
+    @synchronized ([APIManager rateBuckets]) {
+        [APIManager groupLimits][@(group)] = @[@(MAX(0, requestsPerSecond)), @(burst)];
+        [[APIManager rateBuckets] removeAllObjects];
+    }
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ Возвращает группу к которой относится API метод.
+ --------------------------------------------------------------------------------------------------------------*/
++ (APIMethodGroup) methodGroupForAPIMethod:(APIMethod)method
+{
+    return APIMethodInfoFor(method)->group;
+}
+
+
+#pragma mark - Dispatch
+
+/*--------------------------------------------------------------------------------------------------------------
+ Занимает слот для запроса в ведрах текущего токена и группы метода.
+ --------------------------------------------------------------------------------------------------------------*/
++ (NSTimeInterval) reserveRequestSlotForAPIMethod:(APIMethod)method
+{
+    APIMethodGroup group = [APIManager methodGroupForAPIMethod:method];
+    NSString* tokenKey   = [APIManager keyForAccessToken:APIManager.token.access_token];
+
+    @synchronized ([APIManager rateBuckets])
+    {
+        NSTimeInterval delay = 0;
+        if (group != APIMethodGroup_Service){
+            delay = [[APIManager bucketForAccessTokenKey:tokenKey] reserve];
+        }
+        APIRateBucket* groupBucket = [APIManager bucketForMethodGroup:group accessTokenKey:tokenKey];
+        if (groupBucket){
+            delay = MAX(delay, [groupBucket reserve]);
+        }
+        return delay;
+    }
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ Занимает слот, только если прямо сейчас он свободен в обоих ведрах. Иначе возвращает 'NO' и ничего не занимает.
+ --------------------------------------------------------------------------------------------------------------*/
++ (BOOL) tryReserveRequestSlotForAPIMethod:(APIMethod)method
+{
+    APIMethodGroup group = [APIManager methodGroupForAPIMethod:method];
+    NSString* tokenKey   = [APIManager keyForAccessToken:APIManager.token.access_token];
+
+    @synchronized ([APIManager rateBuckets])
+    {
+        APIRateBucket* tokenBucket = (group != APIMethodGroup_Service) ? [APIManager bucketForAccessTokenKey:tokenKey] : nil;
+        APIRateBucket* groupBucket = [APIManager bucketForMethodGroup:group accessTokenKey:tokenKey];
+
+        if (((tokenBucket) && (![tokenBucket hasFreeToken])) || ((groupBucket) && (![groupBucket hasFreeToken]))){
+            return NO;
+        }
+        [tokenBucket reserve];
+        [groupBucket reserve];
+        return YES;
+    }
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ Помечает операцию как управляемую. Слот резервируется перехватчиками '-start' и '-syncStart'.
+ --------------------------------------------------------------------------------------------------------------*/
++ (void) governOperation:(NSOperation*)op forAPIMethod:(APIMethod)method
+{
+    [APIManager installStartHooks];
+    objc_setAssociatedObject(op, &governedAPIMethodKey, @(method), OBJC_ASSOCIATION_RETAIN_NONATOMIC);
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ Забирает API метод управляемой операции, поэтому слот резервируется только один раз,
+ даже если '-syncStart' внутри вызывает '-start'. Возвращает задержку перед отправкой запроса.
+ Момент отправки запоминается для '+sendTimeOfOperation:'.
+ --------------------------------------------------------------------------------------------------------------*/
++ (NSTimeInterval) reserveSlotOfGovernedOperation:(NSOperation*)op
+{
+    NSNumber* method = nil;
+    @synchronized (op) {
+        method = objc_getAssociatedObject(op, &governedAPIMethodKey);
+        objc_setAssociatedObject(op, &governedAPIMethodKey, nil, OBJC_ASSOCIATION_RETAIN_NONATOMIC);
+    }
+    if ((!method) || (op.isCancelled)) return 0;
+
+    NSTimeInterval delay = [APIManager reserveRequestSlotForAPIMethod:(APIMethod)method.integerValue];
+    objc_setAssociatedObject(op, &sendTimeKey, @(CFAbsoluteTimeGetCurrent() + MAX(0, delay)), OBJC_ASSOCIATION_RETAIN_NONATOMIC);
+    return delay;
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ Возвращает время, когда управляемая операция была отправлена после своего слота, или '0', если она не запускалась.
+ --------------------------------------------------------------------------------------------------------------*/
++ (CFAbsoluteTime) sendTimeOfOperation:(NSOperation*)op
+{
+    return [objc_getAssociatedObject(op, &sendTimeKey) doubleValue];
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ 'start' и 'syncStart' класса 'DTO' один раз заменяются реализациями, которые сначала резервируют слот
+ управляемой операции. Фреймворк закрыт, поэтому перехватчики вызывают исходные реализации, а не переопределяют
+ их в наследнике. Неуправляемые операции запускаются как раньше.
+ --------------------------------------------------------------------------------------------------------------*/
++ (void) installStartHooks
+{
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        Class operationClass = [DTO class];
+
+        SEL    startSelector = @selector(start);
+        Method startMethod   = class_getInstanceMethod(operationClass, startSelector);
+        void (*originalStart)(id, SEL) = (void (*)(id, SEL))method_getImplementation(startMethod);
+
+        IMP governedStart = imp_implementationWithBlock(^(NSOperation* op){
+            NSTimeInterval delay = [APIManager reserveSlotOfGovernedOperation:op];
+            if (delay <= 0){
+                originalStart(op, startSelector);
+                return;
+            }
+            // Очередь или '-start': поток не блокируется, запрос отправляется когда слот освободится
+            dispatch_after(dispatch_time(DISPATCH_TIME_NOW, (int64_t)(delay * NSEC_PER_SEC)),
+                           dispatch_get_global_queue(QOS_CLASS_UTILITY, 0), ^{
+                originalStart(op, startSelector);
+            });
+        });
+        // 'class_replaceMethod' добавляет метод самому 'DTO', если он унаследован, суперкласс не меняется
+        class_replaceMethod(operationClass, startSelector, governedStart, method_getTypeEncoding(startMethod));
+
+        SEL    syncStartSelector = @selector(syncStart);
+        Method syncStartMethod   = class_getInstanceMethod(operationClass, syncStartSelector);
+        id (*originalSyncStart)(id, SEL) = (id (*)(id, SEL))method_getImplementation(syncStartMethod);
+
+        IMP governedSyncStart = imp_implementationWithBlock(^id(NSOperation* op){
+            // '-syncStart' все равно блокирует поток, поэтому ждет слот здесь
+            NSTimeInterval delay = [APIManager reserveSlotOfGovernedOperation:op];
+            if (delay > 0) [NSThread sleepForTimeInterval:delay];
+
+            return originalSyncStart(op, syncStartSelector);
+        });
+        class_replaceMethod(operationClass, syncStartSelector, governedSyncStart, method_getTypeEncoding(syncStartMethod));
+    });
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ Операция получает зависимость от пустой операции-'разрешения', которая завершается через 'delay' секунд.
+ До этого момента очередь считает операцию не готовой и запускает другие.
+ --------------------------------------------------------------------------------------------------------------*/
++ (void) holdOperation:(NSOperation*)op forTimeInterval:(NSTimeInterval)delay
+{
+    if (delay <= 0) return;
+
+    NSBlockOperation* permit = [NSBlockOperation blockOperationWithBlock:^{}];
+    permit.name = @"APIManager.RateGovernor.permit";
+    [op addDependency:permit];
+
+    dispatch_after(dispatch_time(DISPATCH_TIME_NOW, (int64_t)(delay * NSEC_PER_SEC)),
+                   dispatch_get_global_queue(QOS_CLASS_UTILITY, 0), ^{
+        [permit start];
+    });
+}
+
+
+#pragma mark - Throttling errors
+
+/*--------------------------------------------------------------------------------------------------------------
+ Возвращает 'YES' если сервер отклонил запрос с ошибкой 6 "Too many requests per second".
+ --------------------------------------------------------------------------------------------------------------*/
++ (BOOL) isRateLimitErrorInOperation:(BO*)op
+{
+    if (![op.json isKindOfClass:[NSDictionary class]]) return NO;
+
+    id error = op.json[@"error"];
+    if (![error isKindOfClass:[NSDictionary class]]) return NO;
+
+    return ([error[@"error_code"] integerValue] == rateLimitErrorCode);
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ Опустошает ведро текущего токена и возвращает задержку, после которой запрос можно отправить повторно.
+ --------------------------------------------------------------------------------------------------------------*/
++ (NSTimeInterval) delayAfterRateLimitErrorForAPIMethod:(APIMethod)method
+{
+    NSString* tokenKey = [APIManager keyForAccessToken:APIManager.token.access_token];
+
+    @synchronized ([APIManager rateBuckets]) {
+        [[APIManager bucketForAccessTokenKey:tokenKey] drain];
+    }
+    // Запросы которые уже ждут в очереди сохраняют свои слоты, повтор получает следующий свободный.
+    return [APIManager reserveRequestSlotForAPIMethod:method];
+}
+
+
+#pragma mark - Helpers
+
+/*--------------------------------------------------------------------------------------------------------------
+ Сам токен не хранится в памяти в качестве ключа, только его хеш.
+ --------------------------------------------------------------------------------------------------------------*/
++ (NSString*) keyForAccessToken:(nullable NSString*)accessToken
+{
+    return str(@"%lu",(unsigned long)accessToken.hash);
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ (!) Должен вызываться внутри '@synchronized ([APIManager rateBuckets])'
+ --------------------------------------------------------------------------------------------------------------*/
++ (APIRateBucket*) bucketForAccessTokenKey:(NSString*)tokenKey
+{
+    APIRateBucket* bucket = [APIManager rateBuckets][tokenKey];
+    if (!bucket){
+        NSArray<NSNumber*>* limit = [APIManager tokenLimits][tokenKey];
+        if (!limit) limit = [APIManager tokenLimits][anyAccessTokenKey];
+
+        bucket = [APIRateBucket bucketWithRate:[limit[0] doubleValue] capacity:[limit[1] doubleValue]];
+        [APIManager rateBuckets][tokenKey] = bucket;
+    }
+    return bucket;
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ Возвращает 'nil' если у группы нет собственного лимита.
+ (!) Должен вызываться внутри '@synchronized ([APIManager rateBuckets])'
+ --------------------------------------------------------------------------------------------------------------*/
++ (nullable APIRateBucket*) bucketForMethodGroup:(APIMethodGroup)group accessTokenKey:(NSString*)tokenKey
+{
+    NSArray<NSNumber*>* limit = [APIManager groupLimits][@(group)];
+    if ([limit[0] doubleValue] <= 0) return nil;
+
+    NSString* key = str(@"%@|%ld",tokenKey,(long)group);
+    APIRateBucket* bucket = [APIManager rateBuckets][key];
+    if (!bucket){
+        bucket = [APIRateBucket bucketWithRate:[limit[0] doubleValue] capacity:[limit[1] doubleValue]];
+        [APIManager rateBuckets][key] = bucket;
+    }
+    return bucket;
+}
+
+
+#pragma mark - Setters & Getters
+
+/*--------------------------------------------------------------------------------------------------------------
+ @property (class, nonatomic, assign) NSUInteger maxRateLimitRetries;
+ --------------------------------------------------------------------------------------------------------------*/
++ (void)setMaxRateLimitRetries:(NSUInteger)maxRateLimitRetries
+{
+    @synchronized ([NSNotificationCenter defaultCenter]){
+        _maxRateLimitRetries = maxRateLimitRetries;
+    }
+}
+
++ (NSUInteger)maxRateLimitRetries
+{
+    @synchronized ([NSNotificationCenter defaultCenter]){
+        return _maxRateLimitRetries;
+    }
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ Приватные хранилища
+
+ --------------------------------------------------------------------------------------------------------------*/
++ (NSMutableDictionary<NSString*,APIRateBucket*>*) rateBuckets
+{
+    @synchronized ([NSNotificationCenter defaultCenter])
+    {
+        if (!_rateBuckets){
+             _rateBuckets = [NSMutableDictionary new];
+        }
+        return _rateBuckets;
+    }
+}
+
++ (NSMutableDictionary<NSString*,NSArray<NSNumber*>*>*) tokenLimits
+{
+    @synchronized ([NSNotificationCenter defaultCenter])
+    {
+        if (!_tokenLimits){
+             _tokenLimits = [NSMutableDictionary new];
+             _tokenLimits[anyAccessTokenKey] = @[@(defaultRequestsPerSecond), @(defaultBurst)];
+        }
+        return _tokenLimits;
+    }
+}
+
++ (NSMutableDictionary<NSNumber*,NSArray<NSNumber*>*>*) groupLimits
+{
+    @synchronized ([NSNotificationCenter defaultCenter])
+    {
+        if (!_groupLimits){
+             _groupLimits = [NSMutableDictionary new];
+        }
+        return _groupLimits;
+    }
+}
+
+@end
@@ -0,0 +1,99 @@
+#import "APIManager.h"
+#import "APIMethods.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+/*--------------------------------------------------------------------------------------------------------------
+ 📝 'APIRetryPolicy' - описывает как повторяется неудачный запрос определенного API метода.
+ ---------------
+ Задержка перед повтором растет экспоненциально: 'baseDelay * multiplier^retry', но не больше чем 'maxDelay'.
+ Реальная задержка выбирается случайно от нуля до этого значения ('full jitter'), чтобы множество клиентов,
+ получивших ошибку в один момент, не вернулись на сервер тоже в один момент.
+ --------------------------------------------------------------------------------------------------------------*/
+@interface APIRetryPolicy : NSObject <NSCopying>
+
+@property (nonatomic, assign) NSUInteger     maxRetries; // Количество повторов после первой попытки (по умолчанию 2)
+@property (nonatomic, assign) NSTimeInterval baseDelay;  // по умолчанию 0.25 сек.
+@property (nonatomic, assign) NSTimeInterval maxDelay;   // по умолчанию 4 сек.
+@property (nonatomic, assign) double         multiplier; // по умолчанию 2
+@property (nonatomic, assign) NSTimeInterval deadline;   // Общее время на все попытки, отсчитывается от первой отправки запроса (по умолчанию 15 сек.)
+
++ (instancetype) defaultPolicy;
++ (instancetype) noRetryPolicy;
+
+/*--------------------------------------------------------------------------------------------------------------
+ Возвращает задержку перед повтором с номером 'retry' (считая с нуля).
+ --------------------------------------------------------------------------------------------------------------*/
+- (NSTimeInterval) delayBeforeRetry:(NSUInteger)retry;
+
+@end
+
+
+
+/*--------------------------------------------------------------------------------------------------------------
+ 🌐🔁 'APIManager(RetryPolicy)' - повторяет запросы, которые завершились неудачно из-за временных проблем.
+ ---------------
+ [⚖️] Обязанности:
+ - Знать какие API методы идемпотентны (могут повторяться без побочных эффектов).
+ - Отличать временные сбои (таймаут, потеря соединения, ошибки VK 1 и 10) от окончательных.
+ - Вычислять задержку перед повтором согласно политике API метода.
+ - Ограничивать долю повторов в общем количестве запросов ('retry budget'), чтобы сбоящий сервер
+   не получил от приложения "шторм" повторов.
+ ---------------
+ Дополнительно:
+ (⚠️) Неидемпотентный запрос (Например 'wall.post') повторяется, только если точно известно что он не дошел
+      до сервера (хост не был найден или соединение не было установлено). Иначе повтор мог бы
+      опубликовать пост дважды.
+ --------------------------------------------------------------------------------------------------------------*/
+@interface APIManager (RetryPolicy)
+
+/*--------------------------------------------------------------------------------------------------------------
+ Каждый запрос добавляет в бюджет 'retryBudgetRatio' (по умолчанию 0.1), каждый повтор забирает из него 1.
+ Таким образом на длинной дистанции повторов не больше 10%. Бюджет не растет выше 'retryBudgetCapacity' (по умолчанию 10).
+ --------------------------------------------------------------------------------------------------------------*/
+@property (class, nonatomic, assign) double retryBudgetRatio;
+@property (class, nonatomic, assign) double retryBudgetCapacity;
+
+
+#pragma mark - Policies
+
+/*--------------------------------------------------------------------------------------------------------------
+ Устанавливает политику для API метода. Передайте 'nil', чтобы вернуть политику по умолчанию.
+ --------------------------------------------------------------------------------------------------------------*/
++ (void) setRetryPolicy:(nullable APIRetryPolicy*)policy forAPIMethod:(APIMethod)method;
+
++ (APIRetryPolicy*) retryPolicyForAPIMethod:(APIMethod)method;
+
+/*--------------------------------------------------------------------------------------------------------------
+ Возвращает 'YES' если повторение API метода не меняет состояние на сервере.
+ --------------------------------------------------------------------------------------------------------------*/
++ (BOOL) isIdempotentAPIMethod:(APIMethod)method;
+
+
+#pragma mark - Decision
+
+/*--------------------------------------------------------------------------------------------------------------
+ Вызывается для каждого нового запроса. Пополняет бюджет повторов.
+ --------------------------------------------------------------------------------------------------------------*/
++ (void) depositRetryBudget;
+
+/*--------------------------------------------------------------------------------------------------------------
+ Решает нужно ли повторить неудачную операцию.
+ Возвращает задержку перед повтором, или отрицательное значение если операцию повторять не нужно.
+ 'retries' - сколько повторов уже было сделано, 'elapsed' - сколько секунд прошло с момента первой отправки запроса.
+ --------------------------------------------------------------------------------------------------------------*/
++ (NSTimeInterval) retryDelayForOperation:(BO*)op
+                                APIMethod:(APIMethod)method
+                                  retries:(NSUInteger)retries
+                                  elapsed:(NSTimeInterval)elapsed;
+
+/*--------------------------------------------------------------------------------------------------------------
+ Возвращает 'YES' если ошибка временная и запрос может выполниться успешно при повторе.
+ 'isIdempotent' - при 'NO' учитываются только ошибки, после которых запрос точно не дошел до сервера.
+
+ --------------------------------------------------------------------------------------------------------------*/
++ (BOOL) isTransientErrorInOperation:(BO*)op isIdempotent:(BOOL)isIdempotent;
+
+@end
+
+NS_ASSUME_NONNULL_END
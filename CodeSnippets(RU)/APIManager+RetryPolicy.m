@@ -0,0 +1,219 @@
+#import "APIManager+RetryPolicy.h"
+#import "APIMethodRegistry.h"
+#import <RXNetworkOperation/RXNetworkOperation.h>
+
+
+// Ошибки VK API, после которых повтор имеет смысл
+#define unknownErrorCode        1   // "Unknown error occurred"
+#define internalServerErrorCode 10  // "Internal server error"
+
+
+@implementation APIRetryPolicy
+
++ (instancetype) defaultPolicy
+{
+    APIRetryPolicy* policy = [APIRetryPolicy new];
+    policy.maxRetries = 2;
+    policy.baseDelay  = 0.25;
+    policy.maxDelay   = 4;
+    policy.multiplier = 2;
+    policy.deadline   = 15;
+    return policy;
+}
+
++ (instancetype) noRetryPolicy
+{
+    APIRetryPolicy* policy = [APIRetryPolicy defaultPolicy];
+    policy.maxRetries = 0;
+    return policy;
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ 'Full jitter': случайное значение от нуля до экспоненциально растущего предела.
+ --------------------------------------------------------------------------------------------------------------*/
+- (NSTimeInterval) delayBeforeRetry:(NSUInteger)retry
+{
+    NSTimeInterval limit = MIN(self.maxDelay, self.baseDelay * pow(self.multiplier, retry));
+    return limit * ((double)arc4random() / UINT32_MAX);
+}
+
+- (id) copyWithZone:(NSZone*)zone
+{
+    APIRetryPolicy* copy = [[APIRetryPolicy allocWithZone:zone] init];
+    copy.maxRetries = self.maxRetries;
+    copy.baseDelay  = self.baseDelay;
+    copy.maxDelay   = self.maxDelay;
+    copy.multiplier = self.multiplier;
+    copy.deadline   = self.deadline;
+    return copy;
+}
+
+@end
+
+
+
+static double _retryBudget         = 10;
+static double _retryBudgetRatio    = 0.1;
+static double _retryBudgetCapacity = 10;
+static NSMutableDictionary<NSNumber*,APIRetryPolicy*>* _retryPolicies = nil;
+
+
+
+@implementation APIManager (RetryPolicy)
+
+#pragma mark - Policies
+
+/*--------------------------------------------------------------------------------------------------------------
+ Устанавливает политику для API метода. Передайте 'nil', чтобы вернуть политику по умолчанию.
+ --------------------------------------------------------------------------------------------------------------*/
++ (void) setRetryPolicy:(nullable APIRetryPolicy*)policy forAPIMethod:(APIMethod)method
+{
+    @synchronized ([NSNotificationCenter defaultCenter])
+    {
+        if (!_retryPolicies){
+             _retryPolicies = [NSMutableDictionary new];
+        }
+        _retryPolicies[@(method)] = [policy copy];
+    }
+}
+
++ (APIRetryPolicy*) retryPolicyForAPIMethod:(APIMethod)method
+{
+    @synchronized ([NSNotificationCenter defaultCenter])
+    {
+        APIRetryPolicy* policy = _retryPolicies[@(method)];
+        return (policy) ? policy : [APIRetryPolicy defaultPolicy];
+    }
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ Возвращает 'YES' если повторение API метода не меняет состояние на сервере.
+ --------------------------------------------------------------------------------------------------------------*/
++ (BOOL) isIdempotentAPIMethod:(APIMethod)method
+{
+    return APIMethodInfoFor(method)->isIdempotent;
+}
+
+
+#pragma mark - Decision
+
+/*--------------------------------------------------------------------------------------------------------------
+ Вызывается для каждого нового запроса. Пополняет бюджет повторов.
+ --------------------------------------------------------------------------------------------------------------*/
++ (void) depositRetryBudget
+{
+    @synchronized ([NSNotificationCenter defaultCenter]){
+        _retryBudget = MIN(_retryBudgetCapacity, _retryBudget + _retryBudgetRatio);
+    }
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ Решает нужно ли повторить неудачную операцию.
+ Возвращает задержку перед повтором, или отрицательное значение если операцию повторять не нужно.
+ --------------------------------------------------------------------------------------------------------------*/
++ (NSTimeInterval) retryDelayForOperation:(BO*)op
+                                APIMethod:(APIMethod)method
+                                  retries:(NSUInteger)retries
+                                  elapsed:(NSTimeInterval)elapsed
+{
+    BOOL isIdempotent = [APIManager isIdempotentAPIMethod:method];
+    if (![APIManager isTransientErrorInOperation:op isIdempotent:isIdempotent]){
+        return -1;
+    }
+
+    APIRetryPolicy* policy = [APIManager retryPolicyForAPIMethod:method];
+    if (retries >= policy.maxRetries){
+        return -1;
+    }
+
+    // Нет смысла в повторе, который не успеет завершиться до дедлайна
+    NSTimeInterval delay = [policy delayBeforeRetry:retries];
+    if (elapsed + delay >= policy.deadline){
+        return -1;
+    }
+
+    @synchronized ([NSNotificationCenter defaultCenter])
+    {
+        if (_retryBudget < 1){
+            APILog(@"Retry budget is exhausted. The error is returned without repeat: %@",op.error);
+            return -1;
+        }
+        _retryBudget -= 1;
+    }
+    return delay;
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ Возвращает 'YES' если ошибка временная и запрос может выполниться успешно при повторе.
+ --------------------------------------------------------------------------------------------------------------*/
++ (BOOL) isTransientErrorInOperation:(BO*)op isIdempotent:(BOOL)isIdempotent
+{
+    // Запрос дошел до сервера, но сервер не смог его обработать
+    if (([op.json isKindOfClass:[NSDictionary class]]) && ([op.json[@"error"] isKindOfClass:[NSDictionary class]]))
+    {
+        NSInteger code = [op.json[@"error"][@"error_code"] integerValue];
+        return ((isIdempotent) && ((code == unknownErrorCode) || (code == internalServerErrorCode)));
+    }
+
+    if (![op.error.domain isEqualToString:NSURLErrorDomain]){
+        return NO;
+    }
+
+    switch (op.error.code) {
+        // Запрос точно не дошел до сервера
+        case NSURLErrorCannotFindHost:
+        case NSURLErrorCannotConnectToHost:
+        case NSURLErrorDNSLookupFailed:
+        case NSURLErrorNotConnectedToInternet:
+            return YES;
+
+        // Неизвестно успел ли сервер обработать запрос
+
+        case NSURLErrorTimedOut:
+        case NSURLErrorNetworkConnectionLost:
+            return isIdempotent;
+
+        default:
+            return NO;
+    }
+}
+
+
+#pragma mark - Setters & Getters
+
+/*--------------------------------------------------------------------------------------------------------------
+ @property (class, nonatomic, assign) double retryBudgetRatio;
+ --------------------------------------------------------------------------------------------------------------*/
++ (void)setRetryBudgetRatio:(double)retryBudgetRatio
+{
+    @synchronized ([NSNotificationCenter defaultCenter]){
+        _retryBudgetRatio = MAX(0, retryBudgetRatio);
+    }
+}
+
++ (double)retryBudgetRatio
+{
+    @synchronized ([NSNotificationCenter defaultCenter]){
+        return _retryBudgetRatio;
+    }
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ @property (class, nonatomic, assign) double retryBudgetCapacity;
+ --------------------------------------------------------------------------------------------------------------*/
++ (void)setRetryBudgetCapacity:(double)retryBudgetCapacity
+{
+    @synchronized ([NSNotificationCenter defaultCenter]){
+        _retryBudgetCapacity = MAX(0, retryBudgetCapacity);
+        _retryBudget = MIN(_retryBudget, _retryBudgetCapacity);
+    }
+}
+
++ (double)retryBudgetCapacity
+{
+    @synchronized ([NSNotificationCenter defaultCenter]){
+        return _retryBudgetCapacity;
+    }
+}
+
+@end
@@ -1,6 +1,7 @@
 
 
 #import "APIManager+Utilites.h"
+#import "APIMethodRegistry.h"
 
 /*--------------------------------------------------------------------------------------------------------------
  🌐🍑 'APIManager(Utilites)' - содержит методы косвенно используемые в 'APIManager' и его категориях.
@@ -22,24 +23,7 @@
  --------------------------------------------------------------------------------------------------------------*/
 + (NSString*) convertAPIMethodToString:(APIMethod)enumValue
 {
-    NSString* convert;
-    switch (enumValue) {
-        case APIMethod_Unknow:     convert = @"unknow";       break;
-        case APIMethod_UserGet:    convert = @"users.get";    break;
-        case APIMethod_FriendsGet: convert = @"friends.get";  break;
-      
-        case APIMethod_WallGet:    convert = @"wall.get";     break;
-        case APIMethod_WallPost:   convert = @"wall.post";    break;
-
-        case APIMethod_PhotosGetAll:              convert = @"photos.getAll";              break;
-        case APIMethod_PhotosGetWallUploadServer: convert = @"photos.getWallUploadServer"; break;
-        case APIMethod_PhotosSaveWallPhoto:       convert = @"photos.saveWallPhoto";       break;
-
-        case APIMethod_Logout: convert = @"auth.logout";  break;
-        //...
-        default: APILog(@"+convertAPIMethodToString| Switch not found mathes!"); break;
-    }
-    return convert;
+    return APIMethodInfoFor(enumValue)->name;
 }
 
 
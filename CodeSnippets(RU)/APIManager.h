@@ -88,6 +88,7 @@ NS_ASSUME_NONNULL_BEGIN
  Метод создан для возможности дополнительной настройки 'APIManager'a перед использованием.
  Например вы хотите задать некие дополнительные пользовательские параметры.
  В можете сделать это, вызывав данный метод внутри 'didFinishLaunchingWithOptions:..'.
+ Также метод заранее открывает соединения с хостами API (см. 'APIManager(Connectivity)').
  --------------------------------------------------------------------------------------------------------------*/
 + (void) prepareAPIManagerBeforeUsing:(nullable void(^)(void))completion;
 
@@ -9,9 +9,16 @@
 #import "APIManager.h"
 // Own Categories
 #import "APIManager+Utilites.h"
+#import "APIManager+RateGovernor.h"
+#import "APIManager+RetryPolicy.h"
+#import "APIManager+Hedging.h"
+#import "APIManager+CircuitBreaker.h"
+#import "APIManager+Connectivity.h"
 
 // Other Network layer components
+#import "APIMethodRegistry.h"
 #import "NetworkRequestConstructor.h"
+#import "NetworkRequestConstructor+FieldProjection.h"
 #import "Validator.h"
 #import "Parser.h"
 #import "Mapper.h"
@@ -38,7 +45,6 @@
 #import "KFKeychain.h"
 #import <RXNetworkOperation/RXNetworkOperation.h>
 #import "FEMDeserializer.h"
-#import "RealReachability.h"
 
 // WKWebView
 #import <WebKit/WebKit.h>
@@ -63,6 +69,25 @@ static AuthenticationCompletion  _authenticationCompletion = nil;
 
 
 
+typedef void(^APIDispatchCompletion)(DTO* op, NSError* _Nullable error);
+
+/*--------------------------------------------------------------------------------------------------------------
+ 'APIDispatchContext' - состояние одного запроса 'APIManager'a, общее для всех попыток его выполнить.
+ --------------------------------------------------------------------------------------------------------------*/
+@interface APIDispatchContext : NSObject
+@property (nonatomic, assign) APIMethod      method;
+@property (nonatomic, strong) NSURLRequest*  request;
+@property (nonatomic, copy)   APIDispatchCompletion completion;
+@property (nonatomic, assign) CFAbsoluteTime createdAt;
+@property (nonatomic, assign) NSUInteger     retries;          // Повторы после временных сбоев
+@property (nonatomic, assign) NSUInteger     rateLimitRetries; // Повторы после "Too many requests per second"
+@property (nonatomic, strong, nullable) APIHedgeRace* hedgeRace; // Гонка с дубликатом, если запрос дублируется
+@end
+
+@implementation APIDispatchContext
+@end
+
+
 @interface APIManager ()
 
 @property (class, nonatomic, readwrite, strong) NSURLSession* defaultSession;
@@ -118,8 +143,19 @@ static AuthenticationCompletion  _authenticationCompletion = nil;
 {
     [API setBaseURL:@"https://api.vk.com/method/"];
     
-    GLobalRealReachability.hostForPing  = @"www.google.com";
-    GLobalRealReachability.hostForCheck = @"www.goolge.com";
+    // Соединения с хостами API открываются заранее. Доступность сети определяется по реальным запросам
+    [APIManager prewarmConnections];
+    
+    // Шаблоны парсятся в фоне, поэтому первые ответы не читают их с диска
+    [Templater warmUpTemplates:^(TemplaterWarmUpReport* report) {
+#if DEBUG
+        // Отладочные сборки заново читают шаблоны, измененные на диске, без перезапуска приложения.
+        // Первый снимок папки делается после прогрева и не на главном потоке
+        dispatch_async(dispatch_get_global_queue(QOS_CLASS_UTILITY, 0), ^{
+            Templater.watchesTemplateDirectory = YES;
+        });
+#endif
+    }];
     
     if (completion) completion();
 }
@@ -158,7 +194,7 @@ static AuthenticationCompletion  _authenticationCompletion = nil;
                                                                              nameCase:nil];
     // NetworkOpeation
      DTO* netOp =
-    [DTO request:request uploadProgress:nil downloadProgress:nil completion:^(DTO * _Nonnull op, NSError * _Nullable error) {
+    [APIManager dataTaskForAPIMethod:APIMethod_UserGet request:request completion:^(DTO * _Nonnull op, NSError * _Nullable error) {
        
         // Check on 401 and other server's error
         if ([APIManager checkOnServerAndOtherError:op apiMethodCompletion:completion]){
@@ -170,8 +206,9 @@ static AuthenticationCompletion  _authenticationCompletion = nil;
             return;
         }
         
-        // Mapper
-        NSArray<UserProfile*>* userProfiles = [Mapper usersGetFromJSON:op.json error:&error];
+        // Mapper. В режиме отслеживания поля, которые маппинг не прочитал, выводятся в консоль
+        NSDictionary* json = [NRC trackFieldUsageInJSON:op.json request:request];
+        NSArray<UserProfile*>* userProfiles = [Mapper usersGetFromJSON:json error:&error];
         if ([API callCompletionIfOccuredErrorInOp:op result:userProfiles error:error block:completion]){
             return;
         }
@@ -179,7 +216,7 @@ static AuthenticationCompletion  _authenticationCompletion = nil;
         // Call completion
         if (completion) completion(userProfiles,op);
     }];
-    //netOp.privateSession = self.defaultSession;
+    netOp.privateSession = self.defaultSession;
     return netOp;
 }
 
@@ -197,7 +234,7 @@ static AuthenticationCompletion  _authenticationCompletion = nil;
     
     // NetworkOpeation
      DTO* netOp =
-    [DTO request:request uploadProgress:nil downloadProgress:nil completion:^(DTO * _Nonnull op, NSError * _Nullable error) {
+    [APIManager dataTaskForAPIMethod:APIMethod_PhotosGetAll request:request completion:^(DTO * _Nonnull op, NSError * _Nullable error) {
         
         // Check server error. For example 401 - failed authentication
         if ([APIManager checkOnServerAndOtherError:op apiMethodCompletion:completion]){
@@ -219,7 +256,7 @@ static AuthenticationCompletion  _authenticationCompletion = nil;
         // Call completion
         if (completion) completion(collection,op);
     }];
-    //netOp.privateSession = self.defaultSession;
+    netOp.privateSession = self.defaultSession;
     return netOp;
 }
 
@@ -242,7 +279,7 @@ static AuthenticationCompletion  _authenticationCompletion = nil;
                                                                                  offset:offset];
     // NetworkOpeation
     DTO* netOp =
-    [DTO request:request uploadProgress:nil downloadProgress:nil completion:^(DTO * _Nonnull op, NSError * _Nullable error) {
+    [APIManager dataTaskForAPIMethod:APIMethod_FriendsGet request:request completion:^(DTO * _Nonnull op, NSError * _Nullable error) {
         
         // Check server error. For example 401 - failed authentication
         if ([APIManager checkOnServerAndOtherError:op apiMethodCompletion:completion]){
@@ -255,8 +292,9 @@ static AuthenticationCompletion  _authenticationCompletion = nil;
             return;
         }
         
-        // Mapper
-        NSArray<Friend*>* friends = [Mapper friendsFromJSON:op.json[@"response"] error:&error];
+        // Mapper. В режиме отслеживания поля, которые маппинг не прочитал, выводятся в консоль
+        NSDictionary* json = [NRC trackFieldUsageInJSON:op.json request:request];
+        NSArray<Friend*>* friends = [Mapper friendsFromJSON:json[@"response"] error:&error];
         if ([API callCompletionIfOccuredErrorInOp:op result:friends error:error block:completion]){
             return;
         }
@@ -286,7 +324,7 @@ static AuthenticationCompletion  _authenticationCompletion = nil;
     
     // NetworkOpeation
      DTO* netOp =
-    [DTO request:request uploadProgress:nil downloadProgress:nil completion:^(DTO * _Nonnull op, NSError * _Nullable error) {
+    [APIManager dataTaskForAPIMethod:APIMethod_WallGet request:request completion:^(DTO * _Nonnull op, NSError * _Nullable error) {
         
         // Check server error. For example 401 - failed authentication
         if ([APIManager  checkOnServerAndOtherError:op apiMethodCompletion:completion]){
@@ -403,7 +441,7 @@ static AuthenticationCompletion  _authenticationCompletion = nil;
     
     // NetworkOpeation
      DTO* netOp =
-    [DTO request:request uploadProgress:nil downloadProgress:nil completion:^(DTO * _Nonnull op, NSError * _Nullable error) {
+    [APIManager dataTaskForAPIMethod:APIMethod_WallPost request:request completion:^(DTO * _Nonnull op, NSError * _Nullable error) {
         
         // Check server error. For example 401 - failed authentication
         if ([APIManager  checkOnServerAndOtherError:op apiMethodCompletion:completion]){
@@ -526,7 +564,7 @@ static AuthenticationCompletion  _authenticationCompletion = nil;
     
     // NetworkOpeation
      DTO* netOp =
-    [DTO request:request uploadProgress:nil downloadProgress:nil completion:^(DTO * _Nonnull op, NSError * _Nullable error) {
+    [APIManager dataTaskForAPIMethod:APIMethod_Logout request:request completion:^(DTO * _Nonnull op, NSError * _Nullable error) {
         
         MainQueue(^{
             // Clear cookies
@@ -601,7 +639,7 @@ static AuthenticationCompletion  _authenticationCompletion = nil;
 {
     NSURLRequest* request = [NetworkRequestConstructor buildRequestForMethod_PhotosGetWallUploadServer:userID groupID:groupID];
     DTO* netOp =
-    [DTO request:request uploadProgress:nil downloadProgress:nil completion:^(DTO * _Nonnull op, NSError * _Nullable error) {
+    [APIManager dataTaskForAPIMethod:APIMethod_PhotosGetWallUploadServer request:request completion:^(DTO * _Nonnull op, NSError * _Nullable error) {
         
         // Check server error. For example 401 - failed authentication
         if ([APIManager checkOnServerAndOtherError:op apiMethodCompletion:nil]){
@@ -644,9 +682,28 @@ static AuthenticationCompletion  _authenticationCompletion = nil;
     void(^progressBlock)(UO* op, UOUpProgress p) = nil;
     if (progress) progressBlock =  progress;
 
+    // Цепь сервера загрузки открыта. Запрос не отправляется: операция выполняет локальный запрос
+    // и завершается с ошибкой цепи
+    NSError* circuitError = [APIManager admitRequest:request];
+    if (circuitError){
+        UO* netOp =
+        [UO uploadByRequest:[APIManager requestInPlaceOfRejectedRequest:request] progress:progressBlock completion:^(UO * _Nonnull op, NSError * _Nullable error) {
+            op.json  = nil;
+            op.error = circuitError;
+            if (completion) completion(nil,op);
+        }];
+        // Результат доступен и до запуска
+        netOp.error = circuitError;
+        netOp.privateSession = self.defaultSession;
+        return netOp;
+    }
+
     // Network Operation
     UO* netOp =
     [UO uploadByRequest:request progress:progressBlock completion:^(UO * _Nonnull op, NSError * _Nullable error) {
+        [APIManager recordOutcomeOfOperation:op forRequest:request];
+        [APIManager updateReachabilityWithOperation:op];
+
         // Check server error. For example 401 - failed authentication
         if ([APIManager checkOnServerAndOtherError:op apiMethodCompletion:nil]){
             return;
@@ -682,7 +739,7 @@ static AuthenticationCompletion  _authenticationCompletion = nil;
     
     // Network Operation
      DTO* netOp =
-    [DTO request:saveWallPhotoRequest uploadProgress:nil downloadProgress:nil completion:^(DTO * _Nonnull op, NSError * _Nullable error) {
+    [APIManager dataTaskForAPIMethod:APIMethod_PhotosSaveWallPhoto request:saveWallPhotoRequest completion:^(DTO * _Nonnull op, NSError * _Nullable error) {
         
         // Check server error. For example 401 - failed authentication
         if ([APIManager checkOnServerAndOtherError:op apiMethodCompletion:nil]){
@@ -695,6 +752,165 @@ static AuthenticationCompletion  _authenticationCompletion = nil;
     return netOp;
 }
 
+
+#pragma mark - Dispatch
+
+/*--------------------------------------------------------------------------------------------------------------
+ Все операции 'APIManager'a типа data task создаются через этот метод, чтобы политики отправки запросов
+ применялись в одном месте:
+ - 'APIManager(RateGovernor)' придерживает операцию при запуске, если лимит запросов в секунду исчерпан.
+ - Если сервер все же ответил "Too many requests per second", запрос отправляется повторно когда появится свободный слот.
+ - 'APIManager(RetryPolicy)' повторяет запрос после временных сбоев (таймаут, потеря соединения и т.д.).
+ - 'APIManager(Hedging)' отправляет дубликат медленного запроса на чтение и доставляет первый успешный ответ.
+ - 'APIManager(CircuitBreaker)' не отправляет запрос, если хост не отвечает: возвращенная операция
+   выполняет локальный запрос и получает ошибку (или ответ из кэша).
+ 'completion' блок получает только окончательный ответ.
+ --------------------------------------------------------------------------------------------------------------*/
++ (DTO*) dataTaskForAPIMethod:(APIMethod)method
+                      request:(NSURLRequest*)request
+                   completion:(APIDispatchCompletion)completion
+{
+    // Хост не отвечает. Запрос не отправляется: операция выполняет локальный запрос
+    // и завершается с ответом из кэша или с ошибкой цепи
+    NSError* circuitError = [APIManager admitRequest:request];
+    if (circuitError){
+        id cachedResponse = [APIManager cachedResponseForRequest:request APIMethod:method];
+        DTO* netOp =
+        [DTO request:[APIManager requestInPlaceOfRejectedRequest:request] uploadProgress:nil downloadProgress:nil completion:^(DTO * _Nonnull op, NSError * _Nullable error) {
+            op.json  = cachedResponse;
+            op.error = (cachedResponse) ? nil : circuitError;
+            if (completion) completion(op, op.error);
+        }];
+        // Результат доступен и до запуска
+        netOp.json  = cachedResponse;
+        netOp.error = (cachedResponse) ? nil : circuitError;
+        netOp.queuePriority = APIMethodInfoFor(method)->lane;
+        return netOp;
+    }
+
+    APIDispatchContext* context = [APIDispatchContext new];
+    context.method     = method;
+    context.request    = request;
+    context.completion = completion;
+    context.createdAt  = CFAbsoluteTimeGetCurrent();
+
+    DTO* netOp =
+    [DTO request:request uploadProgress:nil downloadProgress:nil completion:^(DTO * _Nonnull op, NSError * _Nullable error) {
+        [APIManager finishAttempt:op ofOperation:op context:context];
+    }];
+
+    // Полоса приоритета метода: шапка профиля идет раньше списков, страницы фотографий - позже
+    netOp.queuePriority = APIMethodInfoFor(method)->lane;
+
+    [APIManager depositRetryBudget];
+    [APIManager governOperation:netOp forAPIMethod:method];
+
+    if ((APIManager.isHedgingEnabled) && ([APIManager isHedgeableAPIMethod:method]))
+    {
+        __weak DTO* weakOp = netOp;
+        __weak APIDispatchContext* weakContext = context;
+        context.hedgeRace =
+        [APIHedgeRace raceForOperation:netOp APIMethod:method request:request attemptCompletion:^(DTO * _Nonnull finishedOp) {
+            DTO* op = weakOp;
+            APIDispatchContext* strongContext = weakContext;
+            if ((op) && (strongContext)) [APIManager finishAttempt:finishedOp ofOperation:op context:strongContext];
+        }];
+        [APIManager depositHedgingBudget];
+    }
+    return netOp;
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ Вызывается когда завершилась одна попытка выполнить запрос.
+ Повторные попытки выполняются отдельными операциями, их результат копируется в операцию, которая была
+ возвращена пользователю. Поэтому пользователь всегда работает с одним и тем же экземпляром операции.
+ --------------------------------------------------------------------------------------------------------------*/
++ (void) finishAttempt:(DTO*)attemptOp ofOperation:(DTO*)op context:(APIDispatchContext*)context
+{
+    // Проигравший гонку и первый сбой, пока соперник еще в полете, не доставляются
+    if ((context.hedgeRace) && (![context.hedgeRace shouldDeliverAttempt:attemptOp])){
+        return;
+    }
+    [APIManager recordOutcomeOfOperation:attemptOp forRequest:context.request];
+    [APIManager updateReachabilityWithOperation:attemptOp];
+    [APIManager cacheResponseOfOperation:attemptOp forRequest:context.request APIMethod:context.method];
+
+    if (attemptOp != op){
+        op.json  = attemptOp.json;
+        op.error = attemptOp.error;
+    }
+
+    NSTimeInterval delay = [APIManager delayBeforeRepeatingOperation:op context:context];
+    if (delay >= 0)
+    {
+        // ⚠️ Запрещаем разблокировать поток синхронной операции пока не получен окончательный ответ
+        if (op.isSync) { op.isMayUnlockSemaphore = NO; }
+
+        [APIManager resendRequestOfOperation:op context:context afterDelay:delay];
+        return;
+    }
+
+    if (context.completion) context.completion(op, op.error);
+
+    // Поток синхронной операции отпускаем только после того, как 'completion' заполнил операцию результатом
+    if ((attemptOp != op) && (op.isSync)){
+        op.isMayUnlockSemaphore = YES;
+        [op unlockSemaphore];
+    }
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ Возвращает задержку перед повторной отправкой запроса, или отрицательное значение если 'op' содержит окончательный ответ.
+ --------------------------------------------------------------------------------------------------------------*/
++ (NSTimeInterval) delayBeforeRepeatingOperation:(DTO*)op context:(APIDispatchContext*)context
+{
+    // Сервер отклонил запрос из-за лимита запросов в секунду
+    if ([APIManager isRateLimitErrorInOperation:op])
+    {
+        if (context.rateLimitRetries >= APIManager.maxRateLimitRetries){
+            return -1;
+        }
+        context.rateLimitRetries += 1;
+        return [APIManager delayAfterRateLimitErrorForAPIMethod:context.method];
+    }
+
+    // Временные сбои
+    // Повтор не отправляется на хост с открытой цепью. Пробный запрос полуоткрытой цепи не занимается
+    // Цепь проверяется первой, чтобы бюджет повторов тратился только на повтор, который действительно отправляется
+    if ([APIManager isCircuitOpenForRequest:context.request]){
+        return -1;
+    }
+    // Дедлайн отсчитывается от первой отправки: время удержания регулятором частоты его не расходует
+    CFAbsoluteTime sentAt  = [APIManager sendTimeOfOperation:op];
+    NSTimeInterval elapsed = CFAbsoluteTimeGetCurrent() - ((sentAt > 0) ? sentAt : context.createdAt);
+    NSTimeInterval delay   = [APIManager retryDelayForOperation:op APIMethod:context.method retries:context.retries elapsed:elapsed];
+    if (delay < 0){
+        return -1;
+    }
+    context.retries += 1;
+
+    // Повтор тоже является запросом, поэтому он также занимает слот у регулятора частоты
+    return MAX(delay, [APIManager reserveRequestSlotForAPIMethod:context.method]);
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ Выполняет запрос повторно новой операцией на 'APIManager.aSyncQueue' не раньше чем через 'delay' секунд.
+ --------------------------------------------------------------------------------------------------------------*/
++ (void) resendRequestOfOperation:(DTO*)op context:(APIDispatchContext*)context afterDelay:(NSTimeInterval)delay
+{
+    DTO* attemptOp =
+    [DTO request:context.request uploadProgress:nil downloadProgress:nil completion:^(DTO * _Nonnull finishedOp, NSError * _Nullable error) {
+        [APIManager finishAttempt:finishedOp ofOperation:op context:context];
+    }];
+    attemptOp.privateSession = op.privateSession;
+    // Повтор остается в полосе исходной операции
+    attemptOp.queuePriority  = op.queuePriority;
+
+    [APIManager holdOperation:attemptOp forTimeInterval:delay];
+    [APIManager.aSyncQueue addOperation:attemptOp];
+}
+
+
 #pragma mark - Logic
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,74 @@
+//
+//  APIMethodRegistry.h
+//  vk-networkLayer
+//
+//  Created by Admin on 03/08/2020.
+//  Copyright © 2020 iOS-Team. All rights reserved.
+//
+
+#import <Foundation/Foundation.h>
+#import "APIMethods.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+/*--------------------------------------------------------------------------------------------------------------
+ (📄) File 'APIMethodRegistry.h' - единая таблица свойств всех API методов.
+ ---------------
+ Раньше каждая подсистема держала свой 'switch' по 'APIMethod': имя метода, его версия, идемпотентность,
+ группа лимитов, хеджирование. Таблица собирает их все в одном месте, индексированном по 'APIMethod',
+ поэтому любое свойство читается за O(1), а новый API метод описывается одной записью.
+ ---------------
+ [⚖️] Используется:
+ - 'NetworkRequestConstructor' - адрес, версия, фиксированные параметры, поля по умолчанию, конструктор со словарем.
+ - 'Validator'                 - метод валидации ответа, проверка элементов массивов.
+ - категории 'APIManager'      - имя, идемпотентность, группа лимитов, хеджирование, время жизни кэшированного ответа.
+ - 'APIManager'                - полоса приоритета операций метода.
+ ---------------
+ Дополнительно:
+ (⚠️) Новый API метод добавляется в перечисление 'APIMethod' и в таблицу в 'APIMethodRegistry.m' одновременно.
+ (⚠️) Селекторы хранятся строками и разрешаются один раз, при первом вызове.
+ --------------------------------------------------------------------------------------------------------------*/
+typedef struct {
+    // Имя метода в адресе запроса ('users.get')
+    __unsafe_unretained NSString* _Nullable name;
+    // Значение параметра 'v'
+    __unsafe_unretained NSString* _Nullable version;
+    // Параметры, которые никогда не зависят от аргументов, без 'v' ('extended=1')
+    __unsafe_unretained NSString* _Nullable fixedParams;
+    // Поля, запрашиваемые по умолчанию, через запятую. См. 'APIMethodDefaultFields()'
+    __unsafe_unretained NSString* _Nullable defaultFields;
+
+    APIMethodGroup group;
+    // Повтор запроса не меняет состояние на сервере
+    BOOL isIdempotent;
+    // Запрос может дублироваться 'APIManager(Hedging)'
+    BOOL isHedgeable;
+    // Объекты в массивах ответа проверяются по шаблону ('CheckArrayElements')
+    BOOL checksArrayElements;
+    // Как долго последний успешный ответ может возвращаться вместо нового. '0' - никогда
+    NSTimeInterval cacheTTL;
+    // Полоса приоритета: порядок, в котором очередь запускает готовые операции разных методов.
+    // '0' - 'NSOperationQueuePriorityNormal'. 'group' - это ведро лимитов, а не полоса
+    NSOperationQueuePriority lane;
+
+    // Селектор конструктора 'NRC', который принимает словарь параметров
+    const char* _Nullable requestBuilder;
+    // Селектор метода 'Validator', который валидирует ответ
+    const char* _Nullable responseValidator;
+} APIMethodInfo;
+
+
+/*--------------------------------------------------------------------------------------------------------------
+ Возвращает свойства API метода. Для значений вне перечисления возвращает строку 'APIMethod_Unknow'.
+ --------------------------------------------------------------------------------------------------------------*/
+const APIMethodInfo* APIMethodInfoFor(APIMethod method);
+
+/*--------------------------------------------------------------------------------------------------------------
+ Возвращает 'defaultFields' в виде массива. Массив строится один раз для каждого API метода.
+ --------------------------------------------------------------------------------------------------------------*/
+NSArray<NSString*>* _Nullable APIMethodDefaultFields(APIMethod method);
+
+SEL _Nullable APIMethodRequestBuilder(APIMethod method);
+SEL _Nullable APIMethodResponseValidator(APIMethod method);
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,165 @@
+//
+//  APIMethodRegistry.m
+//  vk-networkLayer
+//
+//  Created by Admin on 03/08/2020.
+//  Copyright © 2020 iOS-Team. All rights reserved.
+//
+
+#import "APIMethodRegistry.h"
+#import <objc/runtime.h>
+
+
+#define APIMethodCount (APIMethod_Logout + 1)
+
+
+/*--------------------------------------------------------------------------------------------------------------
+ Сама таблица. Индекс строки - значение 'APIMethod'.
+ --------------------------------------------------------------------------------------------------------------*/
+static const APIMethodInfo _registry[APIMethodCount] = {
+
+    [APIMethod_Unknow] = {
+        .name          = @"unknow",
+        .group         = APIMethodGroup_Read,
+        .isIdempotent  = YES,
+    },
+
+    [APIMethod_UserGet] = {
+        .name          = @"users.get",
+        .version       = @"5.122",
+        .defaultFields = @"photo_50,photo_100,photo_200,photo_max_orig,online,last_seen,counters,city,country,home_town",
+        .group         = APIMethodGroup_Read,
+        .isIdempotent  = YES,
+        .isHedgeable   = YES,
+        .cacheTTL      = 300,
+        .lane          = NSOperationQueuePriorityHigh,
+        .requestBuilder    = "buildRequestForMethod_UsersGet:",
+        .responseValidator = "validateResponseFrom_usersGet:",
+    },
+
+    [APIMethod_FriendsGet] = {
+        .name          = @"friends.get",
+        .version       = @"5.21",
+        .fixedParams   = @"name_case=nom",
+        .defaultFields = @"photo_50,photo_100",
+        .group         = APIMethodGroup_Read,
+        .isIdempotent  = YES,
+        .isHedgeable   = YES,
+        .checksArrayElements = YES,
+        .cacheTTL      = 300,
+        .requestBuilder    = "buildRequestForMethod_FriendsGet:",
+        .responseValidator = "validateResponseFrom_friendsGet:",
+    },
+
+    [APIMethod_WallGet] = {
+        .name          = @"wall.get",
+        .version       = @"5.122",
+        .fixedParams   = @"extended=1",
+        .group         = APIMethodGroup_Read,
+        .isIdempotent  = YES,
+        .isHedgeable   = YES,
+        .checksArrayElements = YES,
+        .cacheTTL      = 60,
+        .requestBuilder    = "buildRequestForMethod_WallGet:",
+        .responseValidator = "validateResponseFrom_wallGet:",
+    },
+
+    [APIMethod_WallPost] = {
+        .name          = @"wall.post",
+        .version       = @"5.21",
+        .group         = APIMethodGroup_Write,
+        .lane          = NSOperationQueuePriorityHigh,
+        .requestBuilder    = "buildRequestForMethod_WallPost:",
+    },
+
+    [APIMethod_PhotosGetAll] = {
+        .name          = @"photos.getAll",
+        .version       = @"5.21",
+        .fixedParams   = @"photo_sizes=0&skip_hidden=1",
+        .group         = APIMethodGroup_Read,
+        .isIdempotent  = YES,
+        .isHedgeable   = YES,
+        .cacheTTL      = 300,
+        .lane          = NSOperationQueuePriorityLow,
+        .requestBuilder    = "buildRequestForMethod_PhotosGetAll:",
+        .responseValidator = "validateResponseFrom_photosGetAll:",
+    },
+
+    // Адрес загрузки выдается на короткое время, поэтому ответ не сохраняется
+    [APIMethod_PhotosGetWallUploadServer] = {
+        .name          = @"photos.getWallUploadServer",
+        .version       = @"5.126",
+        .group         = APIMethodGroup_Read,
+        .isIdempotent  = YES,
+        .requestBuilder    = "buildRequestForMethod_PhotosGetWallUploadServer:",
+    },
+
+    [APIMethod_PhotosSaveWallPhoto] = {
+        .name          = @"photos.saveWallPhoto",
+        .version       = @"5.126",
+        .group         = APIMethodGroup_Write,
+        .requestBuilder    = "buildRequestForMethod_PhotosSaveWallPhoto:",
+    },
+
+    // Отправляется на 'oauth.vk.com', поэтому не имеет шаблона на 'baseURL'
+    [APIMethod_Logout] = {
+        .name          = @"auth.logout",
+        .version       = @"5.52",
+        .group         = APIMethodGroup_Service,
+        .isIdempotent  = YES,
+        .lane          = NSOperationQueuePriorityVeryHigh,
+        .requestBuilder    = "buildRequestForMethod_logout:",
+    },
+};
+
+
+static NSArray<NSString*>* _defaultFields[APIMethodCount];
+static SEL                 _requestBuilders[APIMethodCount];
+static SEL                 _responseValidators[APIMethodCount];
+
+
+/*--------------------------------------------------------------------------------------------------------------
+ Строит значения, которые нельзя записать в статическую таблицу: массивы и селекторы.
+ --------------------------------------------------------------------------------------------------------------*/
+static void APIMethodRegistryPrepare(void)
+{
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        for (NSInteger method = 0; method < APIMethodCount; method++)
+        {
+            const APIMethodInfo* info = &_registry[method];
+            if (info->defaultFields)     _defaultFields[method]      = [info->defaultFields componentsSeparatedByString:@","];
+            if (info->requestBuilder)    _requestBuilders[method]    = sel_registerName(info->requestBuilder);
+            if (info->responseValidator) _responseValidators[method] = sel_registerName(info->responseValidator);
+        }
+    });
+}
+
+static inline NSInteger APIMethodIndex(APIMethod method)
+{
+    return ((method < 0) || (method >= APIMethodCount)) ? APIMethod_Unknow : method;
+}
+
+
+const APIMethodInfo* APIMethodInfoFor(APIMethod method)
+{
+    return &_registry[APIMethodIndex(method)];
+}
+
+NSArray<NSString*>* _Nullable APIMethodDefaultFields(APIMethod method)
+{
+    APIMethodRegistryPrepare();
+    return _defaultFields[APIMethodIndex(method)];
+}
+
+SEL _Nullable APIMethodRequestBuilder(APIMethod method)
+{
+    APIMethodRegistryPrepare();
+    return _requestBuilders[APIMethodIndex(method)];
+}
+
+SEL _Nullable APIMethodResponseValidator(APIMethod method)
+{
+    APIMethodRegistryPrepare();
+    return _responseValidators[APIMethodIndex(method)];
+}
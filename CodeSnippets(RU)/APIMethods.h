@@ -17,6 +17,7 @@
 /*--------------------------------------------------------------------------------------------------------------
  Перечисления API методов которые поддерживает 'APIManager'.
  Используются для удобства в 'NetworkRequestConstructor' в качестве аргументов для функций построения запросов.
+ (⚠️) Каждое значение имеет свою строку в таблице 'APIMethodRegistry.m' со всеми свойствами API метода.
  --------------------------------------------------------------------------------------------------------------*/
 typedef NS_ENUM(NSInteger, APIMethod) {
     
@@ -34,23 +35,16 @@ typedef NS_ENUM(NSInteger, APIMethod) {
     APIMethod_Logout
 };
 
-
-#pragma mark - String Constants API Part
 /*--------------------------------------------------------------------------------------------------------------
-  Строковые константы содержащие название EndPoint название API-методов.
-  Используются конструктором 'NetworkRequestConstructor' при построении NSURLRequest.
+ Группы API методов, которые расходуют общий лимит запросов.
+ 'Read'    - users.get, wall.get, friends.get, photos.getAll, photos.getWallUploadServer
+ 'Write'   - wall.post, photos.saveWallPhoto
+ 'Service' - auth.logout. Не учитывается лимитами VK API, поэтому никогда не придерживается ведром токена.
  --------------------------------------------------------------------------------------------------------------*/
-static NSString *const usersGet = @"users.get"; // Возвращает расширенную информацию о пользователях.
-static NSString *const wallGet  = @"wall.get";  // Возвращает записи со стены пользователей
-static NSString *const wallPost = @"wall.post"; // Позволяет создать запись на стене,
-
-static NSString *const photosGetAll  = @"photos.getAll"; // Возвращает все фотографии пользователя или сообщества в антихронологическом порядке.
-static NSString *const friendsGet    = @"friends.get";   // Возвращает список идентификаторов друзей пользователя или расширенную информацию о друзьях пользователя
-
-
-static NSString *const photosGetWallUploadServer = @"photos.getWallUploadServer"; // Возвращает адрес сервера для загрузки фотографии на стену пользователя или сообщества.
-static NSString *const photosSaveWallPhoto       = @"photos.saveWallPhoto";       // Сохраняет фотографии после успешной загрузки на URI, полученный методом
-
-static NSString *const logout = @"auth.logout";
+typedef NS_ENUM(NSInteger, APIMethodGroup) {
+    APIMethodGroup_Read = 0,
+    APIMethodGroup_Write,
+    APIMethodGroup_Service
+};
 
 #endif /* APIMethods_h */
@@ -0,0 +1,59 @@
+#import "NetworkRequestConstructor.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+/*--------------------------------------------------------------------------------------------------------------
+ 🏗🔎 'NRC(FieldProjection)' - запрашивает у сервера только те поля, которые действительно используются.
+ ---------------
+ 'users.get' и 'friends.get' возвращают столько полей, сколько у них попросили. Каждое лишнее поле увеличивает
+ ответ и замедляет его передачу, парсинг и маппинг.
+ ---------------
+ [⚖️] Обязанности:
+ - Хранить поля, объявленные каждым потребителем (viewModel, маппинг), для каждого API метода.
+ - Возвращать объединение полей всех живых потребителей. NRC запрашивает его вместо списка по умолчанию.
+ - В режиме отслеживания сообщать о полях, которые были скачаны, но так и не прочитаны при маппинге.
+ ---------------
+ Дополнительно:
+ (⚠️) Потребители хранятся слабой ссылкой. Когда потребитель освобождается, его поля больше не запрашиваются.
+ (⚠️) Поля, переданные напрямую в метод конструктора, заменяют проекцию и список по умолчанию (а не
+      объединяются с ними).
+ (⚠️) Порядок приоритета: поля вызова -> объединение потребителей -> поля API метода по умолчанию.
+ --------------------------------------------------------------------------------------------------------------*/
+@interface NetworkRequestConstructor (FieldProjection)
+
+/*--------------------------------------------------------------------------------------------------------------
+ Включает отслеживание прочитанных полей. Предназначено для отладки, так как каждый ответ оборачивается в прокси.
+ По умолчанию 'NO'.
+ --------------------------------------------------------------------------------------------------------------*/
+@property (class, nonatomic, assign) BOOL isFieldUsageTrackingEnabled;
+
+
+#pragma mark - Projection
+
+/*--------------------------------------------------------------------------------------------------------------
+ Объявляет поля API метода, которые читает 'consumer'. Новый вызов заменяет предыдущее объявление.
+ Например, в инициализаторе viewModel:
+ [NRC declareFields:@[@"photo_200",@"online",@"city"] forConsumer:self APIMethod:APIMethod_UserGet];
+ --------------------------------------------------------------------------------------------------------------*/
++ (void) declareFields:(NSArray<NSString*>*)fields forConsumer:(id)consumer APIMethod:(APIMethod)method;
+
++ (void) removeFieldsForConsumer:(id)consumer APIMethod:(APIMethod)method;
+
+/*--------------------------------------------------------------------------------------------------------------
+ Возвращает отсортированное объединение полей всех живых потребителей, или 'nil', если никто ничего не объявил.
+ --------------------------------------------------------------------------------------------------------------*/
++ (nullable NSArray<NSString*>*) projectedFieldsForAPIMethod:(APIMethod)method;
+
+
+#pragma mark - Tracking
+
+/*--------------------------------------------------------------------------------------------------------------
+ Если режим отслеживания включен, возвращает копию 'json', которая запоминает, какие ключи были прочитаны.
+ Когда копия освобождается, поля, запрошенные в 'request', но так и не прочитанные, выводятся в консоль.
+ Если режим выключен, возвращает 'json' как есть.
+ --------------------------------------------------------------------------------------------------------------*/
++ (nullable id) trackFieldUsageInJSON:(nullable id)json request:(NSURLRequest*)request;
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,61 @@
+#import "NetworkRequestConstructor.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+/*--------------------------------------------------------------------------------------------------------------
+ 🏗📦 'NRC(RequestBody)' - переносит параметры длинных запросов из адреса в тело.
+ ---------------
+ Все API методы отправляются как 'GET' и передают параметры в строке запроса. Длинные тексты 'message',
+ списки вложений и большие пачки 'user_ids' превышают ограничения на длину адреса, а весь адрес повторяется
+ в заголовках запроса и в логах прокси.
+ ---------------
+ [⚖️] Обязанности:
+ - Превращать 'GET' запрос, адрес которого длиннее 'bodyThreshold', в 'POST' запрос с параметрами
+   в теле 'application/x-www-form-urlencoded'.
+ - Сжимать тело с помощью gzip, если установлен 'isBodyCompressionEnabled'.
+ - Сохранять канонический ключ запроса, который не зависит от того, где передаются параметры.
+ ---------------
+ Дополнительно:
+ (⚠️) Все методы конструктора API методов сами вызывают 'moveParametersToBodyIfNeeded:'.
+ (⚠️) Кэши и дедупликация должны использовать 'canonicalKeyForRequest:' вместо 'request.URL', иначе все 'POST'
+      запросы одного API метода получат одинаковый ключ.
+ (⚠️) Сжатое тело отправляется, только если оно действительно меньше исходного.
+ --------------------------------------------------------------------------------------------------------------*/
+@interface NetworkRequestConstructor (RequestBody)
+
+/*--------------------------------------------------------------------------------------------------------------
+ Длина адреса (в символах), выше которой параметры переносятся в тело. По умолчанию 2048.
+ --------------------------------------------------------------------------------------------------------------*/
+@property (class, nonatomic, assign) NSUInteger bodyThreshold;
+
+/*--------------------------------------------------------------------------------------------------------------
+ Сжимает перенесенное тело с помощью gzip и устанавливает 'Content-Encoding: gzip'. По умолчанию 'NO'.
+ --------------------------------------------------------------------------------------------------------------*/
+@property (class, nonatomic, assign) BOOL isBodyCompressionEnabled;
+
+
+/*--------------------------------------------------------------------------------------------------------------
+ Если адрес 'GET' запроса длиннее 'bodyThreshold', переносит query в тело и превращает запрос в 'POST'.
+ Возвращает тот же запрос.
+ --------------------------------------------------------------------------------------------------------------*/
++ (nullable NSMutableURLRequest*) moveParametersToBodyIfNeeded:(nullable NSMutableURLRequest*)request;
+
+/*--------------------------------------------------------------------------------------------------------------
+ Возвращает адрес запроса со всеми его параметрами, как если бы они отправлялись в строке запроса.
+ --------------------------------------------------------------------------------------------------------------*/
++ (NSString*) canonicalKeyForRequest:(NSURLRequest*)request;
+
+
+#pragma mark - Self-check
+
+#if DEBUG
+/*--------------------------------------------------------------------------------------------------------------
+ Переносит в тело запрос 'wall.post' с '+' в длинном сообщении, построенный по шаблону и по словарю.
+ '+' должен попасть в тело как '%2B', иначе сервер прочитает его как пробел. Возвращает 'YES', если проверка пройдена.
+ --------------------------------------------------------------------------------------------------------------*/
++ (BOOL) checkPlusInMovedBody;
+#endif
+
+@end
+
+NS_ASSUME_NONNULL_END
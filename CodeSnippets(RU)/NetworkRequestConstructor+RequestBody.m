@@ -0,0 +1,157 @@
+#import "NetworkRequestConstructor+RequestBody.h"
+
+// System
+#import <zlib.h>
+
+
+#define defaultBodyThreshold 2048
+
+static NSString* const NRCCanonicalKeyProperty = @"NRCCanonicalKey";
+
+static NSUInteger _bodyThreshold            = defaultBodyThreshold;
+static BOOL       _isBodyCompressionEnabled = NO;
+
+
+/*--------------------------------------------------------------------------------------------------------------
+ Сжимает 'data' в формат gzip. Возвращает 'nil', если zlib не справился.
+ --------------------------------------------------------------------------------------------------------------*/
+static NSData* _Nullable NRCGzip(NSData* data)
+{
+    z_stream stream = {0};
+    // 15 + 16: максимальное окно и заголовок gzip вместо заголовка zlib
+    if (deflateInit2(&stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK) return nil;
+
+    NSMutableData* compressed = [NSMutableData dataWithLength:deflateBound(&stream, (uLong)data.length)];
+    stream.next_in   = (Bytef*)data.bytes;
+    stream.avail_in  = (uInt)data.length;
+    stream.next_out  = (Bytef*)compressed.mutableBytes;
+    stream.avail_out = (uInt)compressed.length;
+
+    int status = deflate(&stream, Z_FINISH);
+    deflateEnd(&stream);
+    if (status != Z_STREAM_END) return nil;
+
+    compressed.length = stream.total_out;
+    return compressed;
+}
+
+
+
+@implementation NetworkRequestConstructor (RequestBody)
+
+/*--------------------------------------------------------------------------------------------------------------
+ Если адрес 'GET' запроса длиннее 'bodyThreshold', переносит query в тело и превращает запрос в 'POST'.
+ Возвращает тот же запрос.
+ --------------------------------------------------------------------------------------------------------------*/
++ (nullable NSMutableURLRequest*) moveParametersToBodyIfNeeded:(nullable NSMutableURLRequest*)request
+{
+    if ((!request) || (request.HTTPBody) || (![request.HTTPMethod isEqualToString:@"GET"])) return request;
+
+    NSString* address = request.URL.absoluteString;
+    if (address.length <= NRC.bodyThreshold) return request;
+
+    NSRange separator = [address rangeOfString:@"?"];
+    if (separator.location == NSNotFound) return request;
+
+    // Query уже закодирован процентами. Корректным телом 'x-www-form-urlencoded' он становится, когда
+    // экранирован буквальный '+': в теле '+' декодируется как пробел. Кодировщик NRC экранирует его сам, кодировщик RX может нет
+    NSString* query = [[address substringFromIndex:NSMaxRange(separator)] stringByReplacingOccurrencesOfString:@"+" withString:@"%2B"];
+    NSURL*    url   = [NSURL URLWithString:[address substringToIndex:separator.location]];
+    NSData*   body  = [query dataUsingEncoding:NSUTF8StringEncoding];
+    if ((!url) || (!body)) return request;
+
+    [NSURLProtocol setProperty:address forKey:NRCCanonicalKeyProperty inRequest:request];
+    request.URL        = url;
+    request.HTTPMethod = @"POST";
+    [request setValue:@"application/x-www-form-urlencoded" forHTTPHeaderField:@"Content-Type"];
+
+    if (NRC.isBodyCompressionEnabled)
+    {
+        NSData* compressed = NRCGzip(body);
+        if ((compressed) && (compressed.length < body.length)){
+            body = compressed;
+            [request setValue:@"gzip" forHTTPHeaderField:@"Content-Encoding"];
+        }
+    }
+    request.HTTPBody = body;
+    return request;
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ Возвращает адрес запроса со всеми его параметрами, как если бы они отправлялись в строке запроса.
+ --------------------------------------------------------------------------------------------------------------*/
++ (NSString*) canonicalKeyForRequest:(NSURLRequest*)request
+{
+    NSString* canonicalKey = [NSURLProtocol propertyForKey:NRCCanonicalKeyProperty inRequest:request];
+    return canonicalKey ?: (request.URL.absoluteString ?: @"");
+}
+
+
+#pragma mark - Setters & Getters
+
+/*--------------------------------------------------------------------------------------------------------------
+ @property (class, nonatomic, assign) NSUInteger bodyThreshold;
+ --------------------------------------------------------------------------------------------------------------*/
++ (void)setBodyThreshold:(NSUInteger)bodyThreshold
+{
+    @synchronized ([NSNotificationCenter defaultCenter]){
+        _bodyThreshold = bodyThreshold;
+    }
+}
+
++ (NSUInteger)bodyThreshold
+{
+    @synchronized ([NSNotificationCenter defaultCenter]){
+        return _bodyThreshold;
+    }
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ @property (class, nonatomic, assign) BOOL isBodyCompressionEnabled;
+ --------------------------------------------------------------------------------------------------------------*/
++ (void)setIsBodyCompressionEnabled:(BOOL)isBodyCompressionEnabled
+{
+    @synchronized ([NSNotificationCenter defaultCenter]){
+        _isBodyCompressionEnabled = isBodyCompressionEnabled;
+    }
+}
+
++ (BOOL)isBodyCompressionEnabled
+{
+    @synchronized ([NSNotificationCenter defaultCenter]){
+        return _isBodyCompressionEnabled;
+    }
+}
+
+
+#pragma mark - Self-check
+
+#if DEBUG
+/*--------------------------------------------------------------------------------------------------------------
+ Переносит в тело запрос 'wall.post' с '+' в длинном сообщении, построенный по шаблону и по словарю.
+ '+' должен попасть в тело как '%2B', иначе сервер прочитает его как пробел. Возвращает 'YES', если проверка пройдена.
+ --------------------------------------------------------------------------------------------------------------*/
++ (BOOL) checkPlusInMovedBody
+{
+    NSString* message = [@"1+1=2 " stringByPaddingToLength:NRC.bodyThreshold + 1 withString:@"1+1=2 " startingAtIndex:0];
+
+    // Тело проверяется как есть, без gzip
+    BOOL isBodyCompressionEnabled = NRC.isBodyCompressionEnabled;
+    NRC.isBodyCompressionEnabled  = NO;
+    NSArray<NSURLRequest*>* requests = @[ [NRC buildRequestForMethod_WallPost:@"1" message:message attachments:nil] ?: [NSURLRequest new],
+                                          [NRC buildRequestForMethod_WallPost:@{ @"message" : message }] ?: [NSURLRequest new] ];
+    NRC.isBodyCompressionEnabled  = isBodyCompressionEnabled;
+
+    BOOL isPassed = YES;
+    for (NSURLRequest* request in requests)
+    {
+        NSString* body = [[NSString alloc] initWithData:request.HTTPBody encoding:NSUTF8StringEncoding];
+        isPassed = (isPassed) && ([request.HTTPMethod isEqualToString:@"POST"]) &&
+                   ([body containsString:@"1%2B1"]) && (![body containsString:@"+"]);
+    }
+    if (!isPassed) APILog(@"+[checkPlusInMovedBody] failed");
+    return isPassed;
+}
+#endif
+
+@end
@@ -30,6 +30,9 @@ NS_ASSUME_NONNULL_BEGIN
       Первый вид принимает несколько сырых аргументов (int/nsstring/float/итд) и сам формирует запрос.
       Второй вид принимает готовый словарь с параметрами, и в случае надобности самостоятельно добавляет необходимые
       значения.
+ (⚠️) Методы первого вида собирают адрес из скомпилированного шаблона API метода: статическая часть
+      кодируется один раз, а каждый вызов кодирует только аргументы.
+ (⚠️) Запросы с длинным адресом отправляются как 'POST' с параметрами в теле. См. 'NRC(RequestBody)'.
  --------------------------------------------------------------------------------------------------------------*/
 
 @interface NetworkRequestConstructor : NSObject
@@ -255,6 +258,18 @@ NS_ASSUME_NONNULL_BEGIN
 + (NSMutableURLRequest*) buildRequestForMethod_logout;
 
 
+#pragma mark - Benchmark
+
+#if DEBUG
+/*--------------------------------------------------------------------------------------------------------------
+ Собирает одни и те же запросы 'iterations' раз старым способом (через словари параметров) и через
+ скомпилированные шаблоны. Выводит в консоль время и удерживаемую память на один запрос.
+
+ --------------------------------------------------------------------------------------------------------------*/
++ (void) benchmarkRequestBuilding:(NSUInteger)iterations;
+#endif
+
+
 @end
 
 NS_ASSUME_NONNULL_END
\ No newline at end of file
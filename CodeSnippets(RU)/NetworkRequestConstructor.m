@@ -11,6 +11,13 @@
 // APIManager's Categories
 #import "APIManager+Utilites.h"
 
+// Свойства API методов
+#import "APIMethodRegistry.h"
+
+// NRC's Categories
+#import "NetworkRequestConstructor+FieldProjection.h"
+#import "NetworkRequestConstructor+RequestBody.h"
+
 // Models
 #import "Token.h"
 
@@ -20,6 +27,12 @@
 // Third-party frameworks
 #import <RXNetworkOperation/RXNetworkOperation.h>
 
+// System
+#import <pthread.h>
+#if DEBUG
+#import <malloc/malloc.h>
+#endif
+
 
 /*--------------------------------------------------------------------------------------------------------------
  🏗 'NetworkRequestConstructor' (aka NRC) - класс созданный для конструирования запросов к API
@@ -39,9 +52,232 @@
  Первый вид принимает несколько сырых аргументов (int/nsstring/float/итд) и сам формирует запрос.
  Второй вид принимает готовый словарь с параметрами, и в случае надобности самостоятельно добавляет необходимые
  значения.
+ (⚠️) Методы первого вида собирают адрес из скомпилированного шаблона API метода: статическая часть
+      кодируется один раз, а каждый вызов кодирует только аргументы.
+ (⚠️) Запросы с длинным адресом отправляются как 'POST' с параметрами в теле. См. 'NRC(RequestBody)'.
  --------------------------------------------------------------------------------------------------------------*/
 
 
+#pragma mark - Request templates
+
+/*--------------------------------------------------------------------------------------------------------------
+ 'NRCBuffer' - буфер, в котором собирается адрес запроса.
+ У каждого потока свой буфер. Он создается один раз и только растет, поэтому сборка адреса не выделяет
+ память под промежуточные строки, словари и числа.
+ --------------------------------------------------------------------------------------------------------------*/
+typedef struct {
+    char*  bytes;
+    size_t length;
+    size_t capacity;
+} NRCBuffer;
+
+#define initialBufferCapacity 512
+
+static pthread_key_t _bufferKey;
+static bool          _unreservedChars[256];
+static const char    _hexDigits[] = "0123456789ABCDEF";
+
+
+static void NRCBufferDestroy(void* value)
+{
+    NRCBuffer* buffer = value;
+    free(buffer->bytes);
+    free(buffer);
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ Возвращает пустой буфер текущего потока.
+ --------------------------------------------------------------------------------------------------------------*/
+static NRCBuffer* NRCThreadBuffer(void)
+{
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        pthread_key_create(&_bufferKey, NRCBufferDestroy);
+
+        // 'unreserved' символы из RFC 3986. Все остальные кодируются через '%'
+        for (int c = 0; c < 256; c++){
+            _unreservedChars[c] = ((c >= 'A') && (c <= 'Z')) || ((c >= 'a') && (c <= 'z')) || ((c >= '0') && (c <= '9')) ||
+                                   (c == '-') || (c == '.') || (c == '_') || (c == '~');
+        }
+    });
+
+    NRCBuffer* buffer = pthread_getspecific(_bufferKey);
+    if (!buffer){
+        buffer = calloc(1, sizeof(NRCBuffer));
+        buffer->capacity = initialBufferCapacity;
+        buffer->bytes    = malloc(buffer->capacity);
+        pthread_setspecific(_bufferKey, buffer);
+    }
+    buffer->length = 0;
+    return buffer;
+}
+
+static inline void NRCBufferReserve(NRCBuffer* buffer, size_t extra)
+{
+    if (buffer->length + extra <= buffer->capacity) return;
+    while (buffer->length + extra > buffer->capacity) buffer->capacity *= 2;
+    buffer->bytes = realloc(buffer->bytes, buffer->capacity);
+}
+
+static inline void NRCBufferAppendBytes(NRCBuffer* buffer, const void* bytes, size_t length)
+{
+    NRCBufferReserve(buffer, length);
+    memcpy(buffer->bytes + buffer->length, bytes, length);
+    buffer->length += length;
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ Percent-encoding за один проход. Место для худшего случая ('%XX' на каждый байт) резервируется заранее.
+ --------------------------------------------------------------------------------------------------------------*/
+static void NRCBufferAppendEncodedBytes(NRCBuffer* buffer, const unsigned char* bytes, size_t length)
+{
+    NRCBufferReserve(buffer, length * 3);
+
+    char* out = buffer->bytes + buffer->length;
+    for (size_t i = 0; i < length; i++)
+    {
+        unsigned char c = bytes[i];
+        if (_unreservedChars[c]){
+            *out++ = c;
+        } else {
+            *out++ = '%';
+            *out++ = _hexDigits[c >> 4];
+            *out++ = _hexDigits[c & 0x0F];
+        }
+    }
+    buffer->length = out - buffer->bytes;
+}
+
+static void NRCBufferAppendEncoded(NRCBuffer* buffer, NSString* string)
+{
+    // Большинство строк (id, токены, имена полей) уже хранят UTF-8 внутри
+    const char* utf8 = CFStringGetCStringPtr((__bridge CFStringRef)string, kCFStringEncodingUTF8);
+    if (utf8){
+        NRCBufferAppendEncodedBytes(buffer, (const unsigned char*)utf8, strlen(utf8));
+        return;
+    }
+
+    // Иначе строка конвертируется по частям через буфер на стеке
+    unsigned char chunk[256];
+    NSRange range = NSMakeRange(0, string.length);
+    while (range.length > 0)
+    {
+        NSUInteger used = 0;
+        [string getBytes:chunk maxLength:sizeof(chunk) usedLength:&used encoding:NSUTF8StringEncoding options:0 range:range remainingRange:&range];
+        if (used == 0) break;
+        NRCBufferAppendEncodedBytes(buffer, chunk, used);
+    }
+}
+
+static inline void NRCBufferAppendKey(NRCBuffer* buffer, const char* key)
+{
+    NRCBufferAppendBytes(buffer, "&", 1);
+    NRCBufferAppendBytes(buffer, key, strlen(key));
+    NRCBufferAppendBytes(buffer, "=", 1);
+}
+
+static void NRCAppendString(NRCBuffer* buffer, const char* key, NSString* _Nullable value)
+{
+    if (!value) return;
+    NRCBufferAppendKey(buffer, key);
+    NRCBufferAppendEncoded(buffer, value);
+}
+
+static void NRCAppendInteger(NRCBuffer* buffer, const char* key, NSInteger value)
+{
+    char digits[24];
+    size_t index = sizeof(digits);
+    unsigned long long magnitude = (value < 0) ? -(unsigned long long)value : (unsigned long long)value;
+    do {
+        digits[--index] = '0' + (magnitude % 10);
+        magnitude /= 10;
+    } while (magnitude > 0);
+    if (value < 0) digits[--index] = '-';
+
+    NRCBufferAppendKey(buffer, key);
+    NRCBufferAppendBytes(buffer, digits + index, sizeof(digits) - index);
+}
+
+static BOOL NRCAppendListValues(NRCBuffer* buffer, NSArray* _Nullable values, NSArray* _Nullable skippedValues, BOOL isFirst)
+{
+    for (id value in values)
+    {
+        if ([skippedValues containsObject:value]) continue;
+
+        if (!isFirst) NRCBufferAppendBytes(buffer, ",", 1);
+        NRCBufferAppendEncoded(buffer, ([value isKindOfClass:[NSString class]]) ? value : [value description]);
+        isFirst = NO;
+    }
+    return isFirst;
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ Добавляет список значений через запятую: сначала 'values', затем 'extraValues', которых нет в 'values'.
+ --------------------------------------------------------------------------------------------------------------*/
+static void NRCAppendList(NRCBuffer* buffer, const char* key, NSArray* _Nullable values, NSArray* _Nullable extraValues)
+{
+    if ((values.count < 1) && (extraValues.count < 1)) return;
+
+    NRCBufferAppendKey(buffer, key);
+    BOOL isFirst = NRCAppendListValues(buffer, values, nil, YES);
+    NRCAppendListValues(buffer, extraValues, values, isFirst);
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ Выбирает поля для запроса: поля вызова заменяют все остальное; без них запрашивается объединение потребителей,
+ объявленных в 'NRC(FieldProjection)'; и только если их нет - 'defaultFields'.
+ --------------------------------------------------------------------------------------------------------------*/
+static NSArray<NSString*>* _Nullable NRCFieldsForMethod(APIMethod method, NSArray<NSString*>* _Nullable fields, NSArray<NSString*>* _Nullable defaultFields)
+{
+    if (fields.count > 0) return fields;
+    return [NRC projectedFieldsForAPIMethod:method] ?: defaultFields;
+}
+
+
+
+/*--------------------------------------------------------------------------------------------------------------
+ 'NRCRequestTemplate' - статическая часть запроса одного API метода, скомпилированная один раз.
+ 'prefix' содержит уже закодированный '<baseURL><method>?<фиксированные параметры>'. Каждый запрос копирует его
+ в буфер и дописывает только параметры, которые меняются от вызова к вызову.
+ --------------------------------------------------------------------------------------------------------------*/
+@interface NRCRequestTemplate : NSObject
+@property (nonatomic, strong) NSString* baseURL;
+@property (nonatomic, strong) NSData*   prefix;
+@property (nonatomic, strong, nullable) NSArray<NSString*>* defaultFields;
+@end
+
+@implementation NRCRequestTemplate
+@end
+
+
+/*--------------------------------------------------------------------------------------------------------------
+ Возвращает буфер текущего потока, который уже содержит статическую часть запроса.
+ --------------------------------------------------------------------------------------------------------------*/
+static NRCBuffer* _Nullable NRCBufferWithTemplate(NRCRequestTemplate* _Nullable requestTemplate)
+{
+    if (!requestTemplate) return NULL;
+
+    NRCBuffer* buffer = NRCThreadBuffer();
+    NRCBufferAppendBytes(buffer, requestTemplate.prefix.bytes, requestTemplate.prefix.length);
+    return buffer;
+}
+
+static NSMutableURLRequest* _Nullable NRCRequestFromBuffer(NRCBuffer* _Nullable buffer)
+{
+    if (!buffer) return nil;
+
+    CFURLRef url = CFURLCreateWithBytes(kCFAllocatorDefault, (const UInt8*)buffer->bytes, buffer->length, kCFStringEncodingUTF8, NULL);
+    if (!url) return nil;
+
+    NSMutableURLRequest* request = [NSMutableURLRequest requestWithURL:(__bridge_transfer NSURL*)url];
+    return (buffer->length > NRC.bodyThreshold) ? [NRC moveParametersToBodyIfNeeded:request] : request;
+}
+
+
+static NSMutableDictionary<NSNumber*,NRCRequestTemplate*>* _templates = nil;
+
+
+
 @implementation NetworkRequestConstructor
 
 #pragma mark - Shared method
@@ -64,30 +300,65 @@
 + (NSMutableURLRequest* _Nullable) buildRequestForMethod:(APIMethod)method
                                               properties:(nullable NSDictionary<NSString*,id>*)properties
 {
-    NSMutableURLRequest* request;
-    switch (method) {
-        case APIMethod_Unknow:     request = nil;                                                break;
-        case APIMethod_UserGet:    request = [NRC buildRequestForMethod_UsersGet:properties];    break;
-        case APIMethod_FriendsGet: request = [NRC buildRequestForMethod_FriendsGet:properties];  break;
-
-            
-        case APIMethod_WallGet:  request = [NRC buildRequestForMethod_WallGet:properties];  break;
-        case APIMethod_WallPost: request = [NRC buildRequestForMethod_WallPost:properties]; break;
-
-        case APIMethod_PhotosGetAll:              request = [NRC buildRequestForMethod_PhotosGetAll:properties];                break;
-        case APIMethod_PhotosGetWallUploadServer: request = [NRC buildRequestForMethod_PhotosGetWallUploadServer:properties];   break;
-      
-        case APIMethod_Logout: request = [NRC buildRequestForMethod_logout]; break;
-        
-        default: APILog(@"+buildRequestForMethod:properties:| Switch not found mathes!"); break;
+    SEL builder = APIMethodRequestBuilder(method);
+    if (!builder){
+        APILog(@"+buildRequestForMethod:properties:| Constructor is not registered for '%@'",[APIManager convertAPIMethodToString:method]);
+        return nil;
     }
-    return request;
+    NSMutableURLRequest* (*build)(id, SEL, NSDictionary*) = (void*)[NRC methodForSelector:builder];
+    return build([NRC class], builder, properties);
 }
 
 
 
 
 
+#pragma mark - Templates
+
+/*--------------------------------------------------------------------------------------------------------------
+ Возвращает скомпилированный шаблон API метода. Шаблон компилируется при первом вызове и повторно,
+ только если изменился 'APIManager.baseURL'.
+ --------------------------------------------------------------------------------------------------------------*/
++ (nullable NRCRequestTemplate*) templateForMethod:(APIMethod)method
+{
+    NSString* baseURL = API.baseURL;
+
+    @synchronized ([NRCRequestTemplate class])
+    {
+        NRCRequestTemplate* requestTemplate = _templates[@(method)];
+        if ((requestTemplate) && ((requestTemplate.baseURL == baseURL) || ([requestTemplate.baseURL isEqualToString:baseURL]))){
+            return requestTemplate;
+        }
+
+        requestTemplate = [NRC compileTemplateForMethod:method baseURL:baseURL];
+        if (!_templates){
+             _templates = [NSMutableDictionary new];
+        }
+        _templates[@(method)] = requestTemplate;
+        return requestTemplate;
+    }
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ Фиксированные параметры - те, что никогда не зависят от аргументов методов-конструкторов.
+ --------------------------------------------------------------------------------------------------------------*/
++ (nullable NRCRequestTemplate*) compileTemplateForMethod:(APIMethod)method baseURL:(NSString*)baseURL
+{
+    const APIMethodInfo* info = APIMethodInfoFor(method);
+    // 'auth.logout' отправляется на другой хост и строится без шаблона
+    if ((!info->version) || (method == APIMethod_Logout)) return nil;
+
+    NSString* fixedParams = (info->fixedParams) ? str(@"%@&v=%@",info->fixedParams,info->version) : str(@"v=%@",info->version);
+
+    NRCRequestTemplate* requestTemplate = [NRCRequestTemplate new];
+    requestTemplate.baseURL       = baseURL;
+    requestTemplate.prefix        = [str(@"%@%@?%@",baseURL,info->name,fixedParams) dataUsingEncoding:NSUTF8StringEncoding];
+    requestTemplate.defaultFields = APIMethodDefaultFields(method);
+    return requestTemplate;
+}
+
+
+
 #pragma mark - Individual methods
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -119,13 +390,18 @@
                                                            fields:(nullable NSArray<NSString*>*)fields
                                                          nameCase:(nullable NSString*)nameCase
 {
-    NSMutableDictionary* properties = [NSMutableDictionary new];
+    NRCRequestTemplate* requestTemplate = [NRC templateForMethod:APIMethod_UserGet];
+    NRCBuffer* buffer = NRCBufferWithTemplate(requestTemplate);
+    if (!buffer) return nil;
     
-    properties[@"user_ids"]  = (userIds.count   > 0) ? userIds  : @[APIManager.token.userID];
-    properties[@"fields"]    = (fields.count    > 0) ? fields   : @[@"photo_50",@"photo_100",@"photo_200",@"online",@"last_seen",@"counters",@"city",@"country",@"home_town"];
-    properties[@"name_case"] = (nameCase.length > 0) ? nameCase : @"Nom";
-
-    return [NRC buildRequestForMethod_UsersGet:properties];
+    if (userIds.count > 0) NRCAppendList(buffer, "user_ids", userIds, nil);
+    else NRCAppendString(buffer, "user_ids", APIManager.token.userID);
+    
+    NRCAppendList  (buffer, "fields",       NRCFieldsForMethod(APIMethod_UserGet, fields, requestTemplate.defaultFields), nil);
+    NRCAppendString(buffer, "name_case",    (nameCase.length > 0) ? nameCase : @"Nom");
+    NRCAppendString(buffer, "access_token", APIManager.token.access_token);
+    
+    return NRCRequestFromBuffer(buffer);
 }
 
 
@@ -134,21 +410,21 @@
     // Создаем шаблонную изначальную структуру параметров
     NSMutableDictionary* params = [NSMutableDictionary new];
     params[@"user_ids"]     =  @[];
-    params[@"fields"]       =  @[@"photo_50",@"photo_100",@"photo_200",@"photo_max_orig",@"online",@"last_seen",@"counters"];
+    params[@"fields"]       =  NRCFieldsForMethod(APIMethod_UserGet, nil, APIMethodDefaultFields(APIMethod_UserGet));
     params[@"name_case"]    =  @"Nom";
-    params[@"v"]            =  @"5.122";
+    params[@"v"]            =  APIMethodInfoFor(APIMethod_UserGet)->version;
     params[@"access_token"] =  APIManager.token.access_token;
 
     // Объединяем словари если в 'properties' из аргументов вообще что-то есть.
     if ((properties.allKeys.count > 0) || (properties != nil)){
-         params = (NSMutableDictionary*)[params mergeWithHighPriority:properties isConcatenateArrays:YES];
+         params = (NSMutableDictionary*)[params mergeWithHighPriority:properties isConcatenateArrays:NO];
     }
     
     // Формируем request
     NSMutableURLRequest* request =
-    [BO createRequestWithURL:[API baseURLappend:usersGet] HTTPMethod:GET params:params headers:nil];
+    [BO createRequestWithURL:[API baseURLappend:APIMethodInfoFor(APIMethod_UserGet)->name] HTTPMethod:GET params:params headers:nil];
     
-    return request;
+    return [NRC moveParametersToBodyIfNeeded:request];
 }
 
 
@@ -171,14 +447,16 @@
                                                            count:(NSInteger)count
                                                           filter:(nullable NSString*)filter
 {
-    NSMutableDictionary* properties = [NSMutableDictionary new];
+    NRCBuffer* buffer = NRCBufferWithTemplate([NRC templateForMethod:APIMethod_WallGet]);
+    if (!buffer) return nil;
     
-    properties[@"owner_id"] = (ownerID.length  > 0) ? ownerID  : APIManager.token.userID;
-    properties[@"offset"]   = [NSString stringWithFormat:@"%d",(int)offset];
-    properties[@"count"]    = (count > 0) ? [NSString stringWithFormat:@"%d",(int)count] : @"1";
-    properties[@"filter"]   = (filter.length > 0) ? filter : @"all";
+    NRCAppendString (buffer, "owner_id",     (ownerID.length > 0) ? ownerID : APIManager.token.userID);
+    NRCAppendInteger(buffer, "offset",       offset);
+    NRCAppendInteger(buffer, "count",        (count > 0) ? count : 1);
+    NRCAppendString (buffer, "filter",       (filter.length > 0) ? filter : @"all");
+    NRCAppendString (buffer, "access_token", APIManager.token.access_token);
     
-    return [NRC buildRequestForMethod_WallGet:properties];
+    return NRCRequestFromBuffer(buffer);
 }
 
 
@@ -191,18 +469,18 @@
     params[@"count"]    = @"1";
     params[@"filter"]   = @"all";
     params[@"extended"]     = @(YES);
-    params[@"v"]            =  @"5.122";
+    params[@"v"]            =  APIMethodInfoFor(APIMethod_WallGet)->version;
     params[@"access_token"] =  APIManager.token.access_token;
     
     // Объединяем словари если в 'properties' из аргументов вообще что-то есть.
     if ((properties.allKeys.count > 0) || (properties != nil)){
-        params = (NSMutableDictionary*)[params mergeWithHighPriority:properties isConcatenateArrays:YES];
+        params = (NSMutableDictionary*)[params mergeWithHighPriority:properties isConcatenateArrays:NO];
     }
     
     // Формируем request
     NSMutableURLRequest* request =
-    [BO createRequestWithURL:[API baseURLappend:wallGet] HTTPMethod:GET params:params headers:nil];
-    return request;
+    [BO createRequestWithURL:[API baseURLappend:APIMethodInfoFor(APIMethod_WallGet)->name] HTTPMethod:GET params:params headers:nil];
+    return [NRC moveParametersToBodyIfNeeded:request];
 }
 
 
@@ -238,13 +516,15 @@
                                                           message:(nullable NSString*)message
                                                       attachments:(nullable NSString*)attachments // а может массив принимать ?
 {
-    NSMutableDictionary* properties = [NSMutableDictionary new];
+    NRCBuffer* buffer = NRCBufferWithTemplate([NRC templateForMethod:APIMethod_WallPost]);
+    if (!buffer) return nil;
     
-    properties[@"owner_id"]    = (ownerID.length  > 0) ? ownerID : APIManager.token.userID;
-    properties[@"message"]     = (message.length > 0)  ? message : @"";
-    properties[@"attachments"] = (attachments.length > 0) ? attachments : @"";
+    NRCAppendString(buffer, "owner_id",     (ownerID.length > 0) ? ownerID : APIManager.token.userID);
+    NRCAppendString(buffer, "message",      (message.length > 0) ? message : @"");
+    NRCAppendString(buffer, "attachments",  (attachments.length > 0) ? attachments : @"");
+    NRCAppendString(buffer, "access_token", APIManager.token.access_token);
     
-    return [NRC buildRequestForMethod_WallPost:properties];
+    return NRCRequestFromBuffer(buffer);
 }
 
 
@@ -258,19 +538,19 @@
     // Создаем шаблонную изначальную структуру параметров
     NSMutableDictionary* params = [NSMutableDictionary new];
     params[@"owner_id"]     = APIManager.token.userID;
-    params[@"v"]            =  @"5.21";
+    params[@"v"]            =  APIMethodInfoFor(APIMethod_WallPost)->version;
     params[@"access_token"] =  APIManager.token.access_token;
     
     
     // Объединяем словари если в 'properties' из аргументов вообще что-то есть.
     if ((properties.allKeys.count > 0) || (properties != nil)){
-        params = (NSMutableDictionary*)[params mergeWithHighPriority:properties isConcatenateArrays:YES];
+        params = (NSMutableDictionary*)[params mergeWithHighPriority:properties isConcatenateArrays:NO];
     }
     
     // Формируем request
     NSMutableURLRequest* request =
-    [BO createRequestWithURL:[API baseURLappend:wallPost] HTTPMethod:GET params:params headers:nil];
-    return request;
+    [BO createRequestWithURL:[API baseURLappend:APIMethodInfoFor(APIMethod_WallPost)->name] HTTPMethod:GET params:params headers:nil];
+    return [NRC moveParametersToBodyIfNeeded:request];
 }
 
 #pragma mark - APIMethod -  photos.getWallUploadServer
@@ -290,10 +570,14 @@
 + (NSMutableURLRequest* _Nullable) buildRequestForMethod_PhotosGetWallUploadServer:(nullable NSString*)userID
                                                                            groupID:(nullable NSString*)groupID
 {
-    NSMutableDictionary* properties = [NSMutableDictionary new];
-    if (userID.length  > 0)  properties[@"user_id"] = userID;
-    if (groupID.length > 0) properties[@"groupID"] = userID;
-    return [NRC buildRequestForMethod_PhotosGetWallUploadServer:properties];
+    NRCBuffer* buffer = NRCBufferWithTemplate([NRC templateForMethod:APIMethod_PhotosGetWallUploadServer]);
+    if (!buffer) return nil;
+    
+    NRCAppendString(buffer, "user_id", (userID.length > 0) ? userID : APIManager.token.userID);
+    if (groupID.length > 0) NRCAppendString(buffer, "group_id", groupID);
+    NRCAppendString(buffer, "access_token", APIManager.token.access_token);
+    
+    return NRCRequestFromBuffer(buffer);
 }
 
 
@@ -302,18 +586,18 @@
     // Создаем шаблонную изначальную структуру параметров
     NSMutableDictionary* params = [NSMutableDictionary new];
     params[@"user_id"]      = APIManager.token.userID;
-    params[@"v"]            =  @"5.126";
+    params[@"v"]            =  APIMethodInfoFor(APIMethod_PhotosGetWallUploadServer)->version;
     params[@"access_token"] =  APIManager.token.access_token;
     
     // Объединяем словари если в 'properties' из аргументов вообще что-то есть.
     if ((properties.allKeys.count > 0) || (properties != nil)){
-        params = (NSMutableDictionary*)[params mergeWithHighPriority:properties isConcatenateArrays:YES];
+        params = (NSMutableDictionary*)[params mergeWithHighPriority:properties isConcatenateArrays:NO];
     }
     
     // Формируем request
     NSMutableURLRequest* request =
-    [BO createRequestWithURL:[API baseURLappend:photosGetWallUploadServer] HTTPMethod:GET params:params headers:nil];
-    return request;
+    [BO createRequestWithURL:[API baseURLappend:APIMethodInfoFor(APIMethod_PhotosGetWallUploadServer)->name] HTTPMethod:GET params:params headers:nil];
+    return [NRC moveParametersToBodyIfNeeded:request];
 }
 
 
@@ -338,13 +622,15 @@
                                                                offset:(NSInteger)offset
                                                                 count:(NSInteger)count
 {
-    NSMutableDictionary* properties = [NSMutableDictionary new];
+    NRCBuffer* buffer = NRCBufferWithTemplate([NRC templateForMethod:APIMethod_PhotosGetAll]);
+    if (!buffer) return nil;
     
-    properties[@"owner_id"] = (ownerID.length  > 0) ? ownerID  : APIManager.token.userID;
-    properties[@"offset"]   = [NSString stringWithFormat:@"%d",(int)offset];
-    properties[@"count"]    = (count > 0) ? [NSString stringWithFormat:@"%d",(int)count] : @"1";
+    NRCAppendString (buffer, "owner_id",     (ownerID.length > 0) ? ownerID : APIManager.token.userID);
+    NRCAppendInteger(buffer, "offset",       offset);
+    NRCAppendInteger(buffer, "count",        (count > 0) ? count : 1);
+    NRCAppendString (buffer, "access_token", APIManager.token.access_token);
    
-    return [NRC buildRequestForMethod_PhotosGetAll:properties];
+    return NRCRequestFromBuffer(buffer);
 }
 
 
@@ -359,18 +645,18 @@
     params[@"photo_sizes"]  = @(NO);
     params[@"skip_hidden"]  = @(YES);
     
-    params[@"v"]            =  @"5.21";
+    params[@"v"]            =  APIMethodInfoFor(APIMethod_PhotosGetAll)->version;
     params[@"access_token"] =  APIManager.token.access_token;
     
     // Объединяем словари если в 'properties' из аргументов вообще что-то есть.
     if ((properties.allKeys.count > 0) || (properties != nil)){
-        params = (NSMutableDictionary*)[params mergeWithHighPriority:properties isConcatenateArrays:YES];
+        params = (NSMutableDictionary*)[params mergeWithHighPriority:properties isConcatenateArrays:NO];
     }
     
     // Формируем request
     NSMutableURLRequest* request =
-    [BO createRequestWithURL:[API baseURLappend:photosGetAll] HTTPMethod:GET params:params headers:nil];
-    return request;
+    [BO createRequestWithURL:[API baseURLappend:APIMethodInfoFor(APIMethod_PhotosGetAll)->name] HTTPMethod:GET params:params headers:nil];
+    return [NRC moveParametersToBodyIfNeeded:request];
 }
 
 
@@ -399,16 +685,19 @@
                                                                       server:(NSInteger)server
                                                                         hash:(NSString*)hash
 {
-    NSMutableDictionary* properties = [NSMutableDictionary new];
+    NRCBuffer* buffer = NRCBufferWithTemplate([NRC templateForMethod:APIMethod_PhotosSaveWallPhoto]);
+    if (!buffer) return nil;
     
-    if (userID.length  > 0) properties[@"user_id"]  = userID;
-    if (groupID.length > 0) properties[@"group_id"] = groupID;
-
-    if (photo.length > 0) properties[@"photo"] = photo;
-    if (hash.length  > 0) properties[@"hash"]  = hash;
-    if (server) properties[@"server"] = @(server);
+    if (userID.length  > 0) NRCAppendString(buffer, "user_id",  userID);
+    if (groupID.length > 0) NRCAppendString(buffer, "group_id", groupID);
+    if ((userID.length < 1) && (groupID.length < 1)) NRCAppendString(buffer, "user_id", APIManager.token.userID);
+
+    if (photo.length > 0) NRCAppendString (buffer, "photo",  photo);
+    if (hash.length  > 0) NRCAppendString (buffer, "hash",   hash);
+    if (server)           NRCAppendInteger(buffer, "server", server);
+    NRCAppendString(buffer, "access_token", APIManager.token.access_token);
     
-    return [NRC buildRequestForMethod_PhotosSaveWallPhoto:properties];
+    return NRCRequestFromBuffer(buffer);
 }
 
 
@@ -420,18 +709,18 @@
     if (!properties[@"user_id"] && !properties[@"group_id"]){
          params[@"user_id"] = APIManager.token.userID;
     }
-    params[@"v"]            =  @"5.126";
+    params[@"v"]            =  APIMethodInfoFor(APIMethod_PhotosSaveWallPhoto)->version;
     params[@"access_token"] =  APIManager.token.access_token;
     
     // Объединяем словари если в 'properties' из аргументов вообще что-то есть.
     if ((properties.allKeys.count > 0) || (properties != nil)){
-        params = (NSMutableDictionary*)[params mergeWithHighPriority:properties isConcatenateArrays:YES];
+        params = (NSMutableDictionary*)[params mergeWithHighPriority:properties isConcatenateArrays:NO];
     }
     
     // Формируем request
     NSMutableURLRequest* request =
-    [BO createRequestWithURL:[API baseURLappend:photosSaveWallPhoto] HTTPMethod:GET params:params headers:nil];
-    return request;
+    [BO createRequestWithURL:[API baseURLappend:APIMethodInfoFor(APIMethod_PhotosSaveWallPhoto)->name] HTTPMethod:GET params:params headers:nil];
+    return [NRC moveParametersToBodyIfNeeded:request];
 }
 
 
@@ -462,12 +751,17 @@
                                                               count:(NSInteger)count
                                                              offset:(NSInteger)offset
 {
-    NSMutableDictionary* properties = [NSMutableDictionary new];
+    NRCRequestTemplate* requestTemplate = [NRC templateForMethod:APIMethod_FriendsGet];
+    NRCBuffer* buffer = NRCBufferWithTemplate(requestTemplate);
+    if (!buffer) return nil;
     
-    properties[@"user_id"] = (ownerID.length  > 0) ? ownerID  : APIManager.token.userID;
-    properties[@"offset"]  = [NSString stringWithFormat:@"%d",(int)offset];
-    properties[@"count"]   = (count > 0) ? [NSString stringWithFormat:@"%d",(int)count] : @"1";
-    return [NRC buildRequestForMethod_FriendsGet:properties];
+    NRCAppendString (buffer, "user_id",      (ownerID.length > 0) ? ownerID : APIManager.token.userID);
+    NRCAppendInteger(buffer, "offset",       offset);
+    NRCAppendInteger(buffer, "count",        (count > 0) ? count : 1);
+    NRCAppendString (buffer, "order",        (order.length > 0) ? order : @"hints");
+    NRCAppendList   (buffer, "fields",       NRCFieldsForMethod(APIMethod_FriendsGet, fields, requestTemplate.defaultFields), nil);
+    NRCAppendString (buffer, "access_token", APIManager.token.access_token);
+    return NRCRequestFromBuffer(buffer);
 }
 
 
@@ -480,21 +774,21 @@
     params[@"count"]   = @"1";
     
     params[@"order"]   = @"hints";
-    params[@"fields"]  = @[@"photo_50",@"photo_100"];
+    params[@"fields"]  = NRCFieldsForMethod(APIMethod_FriendsGet, nil, APIMethodDefaultFields(APIMethod_FriendsGet));
     
     params[@"name_case"]    =  @"nom";
-    params[@"v"]            =  @"5.21";
+    params[@"v"]            =  APIMethodInfoFor(APIMethod_FriendsGet)->version;
     params[@"access_token"] =  APIManager.token.access_token;
     
     // Объединяем словари если в 'properties' из аргументов вообще что-то есть.
     if ((properties.allKeys.count > 0) || (properties != nil)){
-        params = (NSMutableDictionary*)[params mergeWithHighPriority:properties isConcatenateArrays:YES];
+        params = (NSMutableDictionary*)[params mergeWithHighPriority:properties isConcatenateArrays:NO];
     }
     
     // Формируем request
     NSMutableURLRequest* request =
-    [BO createRequestWithURL:[API baseURLappend:friendsGet] HTTPMethod:GET params:params headers:nil];
-    return request;
+    [BO createRequestWithURL:[API baseURLappend:APIMethodInfoFor(APIMethod_FriendsGet)->name] HTTPMethod:GET params:params headers:nil];
+    return [NRC moveParametersToBodyIfNeeded:request];
 }
 
 #pragma mark - Another methods
@@ -521,10 +815,79 @@
     urlComponents.queryItems = @[[NSURLQueryItem queryItemWithName:@"access_token" value:APIManager.token.access_token],
                                  [NSURLQueryItem queryItemWithName:@"client_id" value:@"7531597"],
                                  [NSURLQueryItem queryItemWithName:@"revoke"    value:@"1"],
-                                 [NSURLQueryItem queryItemWithName:@"v"         value:@"5.52"]];
+                                 [NSURLQueryItem queryItemWithName:@"v"         value:APIMethodInfoFor(APIMethod_Logout)->version]];
     
     return [NSURLRequest requestWithURL:urlComponents.URL].mutableCopy;
 }
 
+/*--------------------------------------------------------------------------------------------------------------
+ [Internal method] Форма со словарем для 'buildRequestForMethod:properties:'. 'properties' игнорируются.
+ --------------------------------------------------------------------------------------------------------------*/
++ (NSMutableURLRequest*) buildRequestForMethod_logout:(nullable NSDictionary<NSString*,id>*)properties
+{
+    return [NRC buildRequestForMethod_logout];
+}
+
+
+#pragma mark - Benchmark
+
+#if DEBUG
+/*--------------------------------------------------------------------------------------------------------------
+ Измеряет один способ сборки запроса. 'blocks' - сколько блоков памяти на один запрос остаются живыми до
+ очистки autorelease pool (временные объекты, освобожденные раньше, не учитываются, поэтому это нижняя оценка).
+ --------------------------------------------------------------------------------------------------------------*/
+static void NRCMeasure(NSString* name, NSUInteger iterations, void(^build)(void))
+{
+    build(); // Шаблон и буфер создаются до измерения
+
+    malloc_statistics_t before, after;
+    CFAbsoluteTime elapsed = 0;
+    @autoreleasepool {
+        malloc_zone_statistics(NULL, &before);
+        CFAbsoluteTime start = CFAbsoluteTimeGetCurrent();
+        for (NSUInteger i = 0; i < iterations; i++) build();
+        elapsed = CFAbsoluteTimeGetCurrent() - start;
+        malloc_zone_statistics(NULL, &after);
+    }
+
+    double blocks = ((double)after.blocks_in_use - (double)before.blocks_in_use) / iterations;
+    double bytes  = ((double)after.size_in_use   - (double)before.size_in_use)   / iterations;
+    APILog(@"%@: %.2f µs per request | %.1f blocks (%.0f bytes) per request", name, elapsed * 1e6 / iterations, blocks, bytes);
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ Сравнивает сборку через словари параметров со сборкой через скомпилированные шаблоны.
+
+ --------------------------------------------------------------------------------------------------------------*/
++ (void) benchmarkRequestBuilding:(NSUInteger)iterations
+{
+    iterations = MAX(1, iterations);
+    NSArray<NSString*>* userIDs = @[@"155510513"];
+
+    NRCMeasure(@"users.get (dictionary)", iterations, ^{
+        NSMutableDictionary* properties = [NSMutableDictionary new];
+        properties[@"user_ids"]  = userIDs;
+        properties[@"fields"]    = @[@"photo_50",@"photo_100",@"photo_200",@"online",@"last_seen",@"counters",@"city",@"country",@"home_town"];
+        properties[@"name_case"] = @"Nom";
+        [NRC buildRequestForMethod_UsersGet:properties];
+    });
+    NRCMeasure(@"users.get (template)  ", iterations, ^{
+        [NRC buildRequestForMethod_UsersGet:userIDs fields:nil nameCase:nil];
+    });
+
+    NRCMeasure(@"wall.get  (dictionary)", iterations, ^{
+        NSMutableDictionary* properties = [NSMutableDictionary new];
+        properties[@"owner_id"] = userIDs.firstObject;
+        properties[@"offset"]   = [NSString stringWithFormat:@"%d",20];
+        properties[@"count"]    = [NSString stringWithFormat:@"%d",10];
+        properties[@"filter"]   = @"all";
+        [NRC buildRequestForMethod_WallGet:properties];
+    });
+    NRCMeasure(@"wall.get  (template)  ", iterations, ^{
+        [NRC buildRequestForMethod_WallGet:userIDs.firstObject offset:20 count:10 filter:nil];
+    });
+}
+#endif
+
 
 @end
@@ -9,6 +9,8 @@
 #import <Foundation/Foundation.h>
 #import "APIMethods.h"
 
+@class TemplaterWarmUpReport;
+
 
 NS_ASSUME_NONNULL_BEGIN
 
@@ -43,9 +45,28 @@ NS_ASSUME_NONNULL_BEGIN
  который разархивиет папку в нужную директорию (по умолчанию в 'pathToTemplateDirectory').
  
  В последующим использовании приложения вы получать json файлы с диска, а также модифицировать их.
+ 
+ (⚠️) Шаблоны читаются параллельно. Запись, удаление и перемещение папки выполняются с барьерами:
+      они дожидаются текущих читателей.
+ (⚠️) Без прогрева первый ответ каждого API метода читает и парсит свой шаблон с диска.
+      +warmUpTemplates: делает это для всех API методов в фоне сразу после запуска.
+ (⚠️) Если bundle приложения содержит 'APIManagerResponseDefaultTemplates.templates' (см. 'TemplaterBundle'),
+      шаблоны, которых нет на диске, декодируются из него, и архив не разархивируется.
+ (⚠️) Сам архив тоже не распаковывается: шаблоны, которых нет на диске, читаются из его записей
+      (см. 'TemplaterArchive'). На диске хранятся только шаблоны, измененные приложением.
+ (⚠️) Пока 'watchesTemplateDirectory' равно 'YES', json файлы, добавленные, замененные или удаленные в папке кем угодно,
+      замечаются: заново читаются только их шаблоны, и 'Validator' компилирует для них новые планы.
  --------------------------------------------------------------------------------------------------------------*/
 
 
+/*--------------------------------------------------------------------------------------------------------------
+ Отправляется на главном потоке, когда +warmUpTemplates: завершился.
+ 'userInfo[TemplaterWarmUpReportKey]' содержит 'TemplaterWarmUpReport'.
+ --------------------------------------------------------------------------------------------------------------*/
+extern NSNotificationName const TemplaterDidWarmUpTemplatesNotification;
+extern NSString* const TemplaterWarmUpReportKey;
+
+
 @interface Templater : NSObject
 
 /*--------------------------------------------------------------------------------------------------------------
@@ -60,6 +81,30 @@ NS_ASSUME_NONNULL_BEGIN
  --------------------------------------------------------------------------------------------------------------*/
 @property (nonatomic, assign, class) BOOL loadTemplateFromBundle;
 
+/*--------------------------------------------------------------------------------------------------------------
+ 'YES' после завершения первого прохода +warmUpTemplates:. С этого момента первые ответы не ждут
+ чтения шаблонов с диска.
+ --------------------------------------------------------------------------------------------------------------*/
+@property (atomic, readonly, assign, class) BOOL areTemplatesWarmedUp;
+
+/*--------------------------------------------------------------------------------------------------------------
+ SHA-256 скомпилированных стандартных шаблонов в bundle приложения. Меняется вместе с любым шаблоном,
+ поэтому является версией стандартных шаблонов. nil, если bundle не содержит скомпилированный файл.
+ Когда он меняется, +unarchiveFolderWithDefaultTemplates: удаляет копии на диске, распакованные из предыдущей версии.
+ --------------------------------------------------------------------------------------------------------------*/
+@property (nonatomic, readonly, copy, class, nullable) NSString* defaultTemplatesHash;
+
+/*--------------------------------------------------------------------------------------------------------------
+ 'YES' - за папкой с шаблонами следит dispatch source. Когда json файлы папки добавляются,
+ заменяются или удаляются (файловым менеджером, отладочным инструментом, другим процессом), из RAM удаляются
+ только их шаблоны, а те, что были в RAM, читаются заново. Остальные шаблоны и их планы валидации сохраняются.
+ По умолчанию 'NO'. Отладочные сборки включают его в 'prepareAPIManagerBeforeUsing:' после окончания прогрева.
+ (⚠️) Включение делает снимок файлов папки: делайте это не на главном потоке.
+ (⚠️) Source сообщает об изменениях папки. Файл, измененный на месте, без его замены,
+      замечается при следующем изменении папки.
+ --------------------------------------------------------------------------------------------------------------*/
+@property (nonatomic, assign, class) BOOL watchesTemplateDirectory;
+
 #pragma mark - Methods
 
 /*--------------------------------------------------------------------------------------------------------------
@@ -87,16 +132,61 @@ NS_ASSUME_NONNULL_BEGIN
  --------------------------------------------------------------------------------------------------------------*/
 + (nullable NSError*) removeAllTemplates;
 
+/*--------------------------------------------------------------------------------------------------------------
+ Загружает в RAM шаблоны всех API методов, ответы которых валидируются. Шаблоны читаются и парсятся
+ параллельно на фоновых потоках. Шаблоны, которые уже находятся в RAM, повторно не читаются.
+ Вызывается из 'prepareAPIManagerBeforeUsing:' и после разархивирования архива со стандартными шаблонами.
+ Когда проход завершен, 'areTemplatesWarmedUp' становится 'YES', 'completion' вызывается на главном потоке
+ и отправляется 'TemplaterDidWarmUpTemplatesNotification'.
+ --------------------------------------------------------------------------------------------------------------*/
++ (void) warmUpTemplates:(nullable void(^)(TemplaterWarmUpReport* report))completion;
+
 
 /*--------------------------------------------------------------------------------------------------------------
- Метод распаковывает архив с папкой стандартных json файлов (ответов от сервера).
- Если укажите nil в аргумент 'atPath', тогда алгоритм автоматический разархиврует папку по пути 'Templater.pathToTemplateDirectory'.
- Данный метод вы можете вызывать каждый раз при запуске приложения внутри метода +APIManager.prepareBeforeUsing:,
- внутри встроена защита от повторных разархиврований.
+ Подготавливает стандартные шаблоны из bundle приложения: скомпилированный
+ 'APIManagerResponseDefaultTemplates.templates' или, если его нет, 'APIManagerResponseDefaultTemplates.zip'.
+ Ни один из них не распаковывается: шаблоны читаются из них по требованию. Когда стандартные шаблоны изменились
+ при обновлении приложения ('contentHash' скомпилированного файла или CRC-32 записей архива), копия на диске
+ измененного шаблона удаляется, если копия не менялась с момента распаковки.
+ Если укажите путь в аргумент 'atPath', папка с шаблонами будет перемещена туда.
+ Данный метод вы можете вызывать каждый раз при запуске приложения внутри метода +APIManager.prepareBeforeUsing:.
  --------------------------------------------------------------------------------------------------------------*/
 + (void) unarchiveFolderWithDefaultTemplates:(nullable NSString*)atPath
                                   completion:(nullable void(^)(NSError* error))completion;
 
+
+#pragma mark - Benchmark
+
+#if DEBUG
+/*--------------------------------------------------------------------------------------------------------------
+ Запрашивает шаблоны из RAM 'iterations' раз на 1, 2, 4 и 8 потоках через последовательную очередь и через
+ конкурентную очередь 'Templater'. Выводит в консоль количество запросов в секунду.
+ --------------------------------------------------------------------------------------------------------------*/
++ (void) benchmarkTemplateLookup:(NSUInteger)iterations;
+#endif
+
+@end
+
+
+
+/*--------------------------------------------------------------------------------------------------------------
+ Отчет об одном проходе +warmUpTemplates:.
+ --------------------------------------------------------------------------------------------------------------*/
+@interface TemplaterWarmUpReport : NSObject
+
+// Время всего прохода: от вызова до последнего распарсенного шаблона
+@property (nonatomic, readonly, assign) NSTimeInterval duration;
+
+// API методы, шаблоны которых находятся в RAM после прохода
+@property (nonatomic, readonly, copy) NSArray<NSNumber*>* loadedMethods;
+
+// API методы без шаблона или с невалидным json файлом
+@property (nonatomic, readonly, copy) NSArray<NSNumber*>* missingMethods;
+
+// Время чтения и парсинга каждого шаблона по имени API метода.
+// Для шаблонов, которые уже были в RAM, оно близко к нулю
+@property (nonatomic, readonly, copy) NSDictionary<NSString*,NSNumber*>* durationByMethod;
+
 @end
 
 NS_ASSUME_NONNULL_END
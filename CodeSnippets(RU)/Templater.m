@@ -10,15 +10,30 @@
 // APIManager's Categories
 #import "APIManager+Utilites.h"
 
+// Other Network layer components
+#import "APIMethodRegistry.h"
+
 // Own Categories
 #import "TemplaterFileManager.h"
+#import "TemplaterBundle.h"
+#import "TemplaterArchive.h"
 
-// Thrid-party frameworks
-#import <RXZipArchive/RXZipArchive.h>
+// System
+#import <zlib.h>
 
 // Ключи для NSUserDefualt
 static NSString *const templateDirectoryUserDefaultKey   = @"templateDirectoryUserDefaultKey";
+static NSString *const defaultTemplateHashesUserDefaultKey = @"defaultTemplateHashesUserDefaultKey";
+// Версия скомпилированных стандартных шаблонов, копии которой проверялись последними
+static NSString *const defaultTemplatesContentHashUserDefaultKey = @"defaultTemplatesContentHashUserDefaultKey";
+// Устанавливался версиями, которые один раз распаковывали весь архив. Читается только для удаления их копий
 static NSString *const wasArchiveExtractedUserDefaultKey = @"wasArchiveExtractedUserDefaultKey";
+// Копия на диске считается распакованной теми версиями, если она менялась не позже этого срока после создания
+// папки с шаблонами
+static const NSTimeInterval legacyExtractionInterval = 60;
+
+NSNotificationName const TemplaterDidWarmUpTemplatesNotification = @"TemplaterDidWarmUpTemplatesNotification";
+NSString* const TemplaterWarmUpReportKey = @"TemplaterWarmUpReportKey";
 
 
 /*--------------------------------------------------------------------------------------------------------------
@@ -71,24 +86,66 @@ static NSString *const wasArchiveExtractedUserDefaultKey = @"wasArchiveExtracted
 @property (atomic, strong, class) NSMutableDictionary<NSString*,NSDictionary*>* templates;
 
 /*--------------------------------------------------------------------------------------------------------------
- Последовательная очередь, которая непозволяет совершить изменения значения в проперти 'pathToTemplateDirectory'
- и последующего переноса папки с шаблонами в другую директорию.
- Методы перечисленные ниже выполняют свой код внутри блок который вставляется в данную очередь.
+ Конкурентная очередь шаблонов. Чтение выполняется параллельно, поэтому ответы, валидируемые одновременно,
+ не ждут друг друга. Методы, изменяющие шаблоны или их папку, выполняются с барьерами: они дожидаются
+ текущих читателей, и ни один читатель не начнется, пока они не закончат.
  
- +templateForAPIMethod:
- +writeTemplate:forAPIMethod:
- +removeTemplateForAPIMethod:
- +removeAllTemplates:
+ +templateForAPIMethod:           - dispatch_sync
+ +writeTemplate:forAPIMethod:     - dispatch_barrier_sync
+ +removeTemplateForAPIMethod:     - dispatch_barrier_sync
+ +removeAllTemplates              - dispatch_barrier_sync
+ +setNewPathToTemplateDirectory:  - dispatch_barrier_sync
+ +setWatchesTemplateDirectory:    - dispatch_barrier_sync
+ События папки                    - dispatch_barrier_sync
+ --------------------------------------------------------------------------------------------------------------*/
+@property (nonatomic, readonly, strong, class) dispatch_queue_t templatesQueue;
+
+/*--------------------------------------------------------------------------------------------------------------
+ Скомпилированные стандартные шаблоны из 'APIManagerResponseDefaultTemplates.templates' в bundle приложения.
+ Отображаются в память один раз, при первом запросе. Используются для шаблонов, которых нет на диске.
+ --------------------------------------------------------------------------------------------------------------*/
+@property (nonatomic, readonly, strong, class, nullable) TemplaterBundle* defaultTemplates;
+
+/*--------------------------------------------------------------------------------------------------------------
+ 'APIManagerResponseDefaultTemplates.zip' из bundle приложения. Открывается один раз, при первом запросе.
+ Используется для шаблонов, которых нет ни на диске, ни в скомпилированных стандартных шаблонах.
  --------------------------------------------------------------------------------------------------------------*/
-@property (nonatomic, strong, class) dispatch_queue_t serialDispatchQueue;
+@property (nonatomic, readonly, strong, class, nullable) TemplaterArchive* defaultArchive;
 
 @end
 
 
+@interface TemplaterWarmUpReport ()
+@property (nonatomic, readwrite, assign) NSTimeInterval duration;
+@property (nonatomic, readwrite, copy) NSArray<NSNumber*>* loadedMethods;
+@property (nonatomic, readwrite, copy) NSArray<NSNumber*>* missingMethods;
+@property (nonatomic, readwrite, copy) NSDictionary<NSString*,NSNumber*>* durationByMethod;
+@end
+
+
 static NSMutableDictionary *_templates               = nil;
 static NSString            *_pathToTemplateDirectory = nil;
-static dispatch_queue_t     _serialDispatchQueue     = nil;
+static dispatch_queue_t     _templatesQueue          = nil;
 static BOOL                 _loadTemplateFromBundle  = NO;
+static BOOL                 _areTemplatesWarmedUp    = NO;
+
+// Меняется под барьером при каждой записи, удалении и перемещении. Шаблон, прочитанный с диска до изменения,
+// не заносится в RAM после него
+static NSUInteger           _templatesGeneration     = 0;
+
+// Наблюдение за папкой. Меняется только под барьерами 'templatesQueue'
+static dispatch_source_t    _directorySource         = nil;
+// Дата изменения и размер каждого json файла папки при последней проверке, по имени API метода
+static NSMutableDictionary<NSString*,NSString*>* _templateFileStamps = nil;
+
+/*--------------------------------------------------------------------------------------------------------------
+ Дата изменения и размер файла. Меняются, когда файл заменяется или перезаписывается.
+ --------------------------------------------------------------------------------------------------------------*/
+static NSString* TemplaterFileStamp(NSURL* url)
+{
+    NSDictionary<NSURLResourceKey,id>* values = [url resourceValuesForKeys:@[NSURLContentModificationDateKey, NSURLFileSizeKey] error:nil];
+    return [NSString stringWithFormat:@"%f-%@",[values[NSURLContentModificationDateKey] timeIntervalSinceReferenceDate],values[NSURLFileSizeKey]];
+}
 
 @implementation Templater
 
@@ -108,50 +165,82 @@ static BOOL                 _loadTemplateFromBundle  = NO;
 
 /*--------------------------------------------------------------------------------------------------------------
 Восстанавливает ранее записанный json файл с диска или возвращает его из RAM памяти.
+ Шаблоны из RAM возвращаются параллельными читателями. Шаблон, прочитанный с диска, заносится в RAM под барьером.
  --------------------------------------------------------------------------------------------------------------*/
 + (nullable NSDictionary*) templateForAPIMethod:(APIMethod)method
 {
-    __block NSDictionary* template = nil;
+    if (method == APIMethod_Unknow){
+        return nil;
+    }
+    NSString* apiMethod = [APIManager convertAPIMethodToString:method];
     
-    dispatch_sync(self.serialDispatchQueue, ^{
-
-        if (method == APIMethod_Unknow){
-            return;
-        }
-        NSString* apiMethod = [APIManager convertAPIMethodToString:method];
-
-        // Если шаблон ранее инициализировался с диска, то пытаемся достать его из RAM
-           template = self.templates[apiMethod];
-        if (template) return;
+    __block NSDictionary* template   = nil;
+    __block NSUInteger    generation = 0;
+    __block BOOL          isCached   = NO;
+    
+    dispatch_sync(self.templatesQueue, ^{
         
-        NSData* data =  nil;
-       
-        if (self.loadTemplateFromBundle){
-            // Загрузка с Bundle
-            NSString *localPathBundle = [[NSBundle mainBundle] pathForResource:apiMethod ofType:@"json"];
-            data = [NSData dataWithContentsOfFile:localPathBundle];
-        } else {
-           //  Загрузка с диска
-            NSString* localPath = [NSString stringWithFormat:@"%@/%@.json",self.pathToTemplateDirectory,apiMethod];
-           data = [NSData dataWithContentsOfFile:localPath];
-        }
+        // Если шаблон ранее инициализировался с диска, то пытаемся достать его из RAM
+        template = self.templates[apiMethod];
+        isCached = (template != nil);
+        if (isCached) return;
         
-        if (!data) return;
+        generation = _templatesGeneration;
+        template   = [self loadTemplateForAPIMethod:apiMethod];
+    });
+    if ((isCached) || (!template)) return template;
+    
+    // Заносим в RAM память.
+    // Если другой читатель уже занес шаблон, возвращается его экземпляр, чтобы все вызывающие делили один экземпляр
+    dispatch_barrier_sync(self.templatesQueue, ^{
         
-        NSError* error;
-        template = [NSJSONSerialization JSONObjectWithData:data options:kNilOptions error:&error];
-        if (error){
-            NSLog(@"+templateForAPIMethod recovered invalid error from disk. By APIMethod(%@)| error: %@",apiMethod,error);
-        }
-        // Заносим в RAM память
-        if ((template) && (!error)){
-            [self.templates setObject:template forKey:apiMethod];
+        NSDictionary* cachedTemplate = self.templates[apiMethod];
+        if (cachedTemplate){
+            template = cachedTemplate;
+        } else if (generation == _templatesGeneration){
+            self.templates[apiMethod] = template;
         }
     });
     return template;
 }
 
 
+/*--------------------------------------------------------------------------------------------------------------
+ Читает json файл шаблона из bundle или с диска. Если файла нет, шаблон декодируется
+ из скомпилированных стандартных шаблонов или читается из записи стандартного архива.
+ Вызывается внутри 'templatesQueue', поэтому папка с шаблонами не перемещается, пока файл читается.
+ --------------------------------------------------------------------------------------------------------------*/
++ (nullable NSDictionary*) loadTemplateForAPIMethod:(NSString*)apiMethod
+{
+    NSData* data = nil;
+    
+    if (self.loadTemplateFromBundle){
+        // Загрузка с Bundle
+        NSString *localPathBundle = [[NSBundle mainBundle] pathForResource:apiMethod ofType:@"json"];
+        data = [NSData dataWithContentsOfFile:localPathBundle];
+    } else {
+        //  Загрузка с диска
+        NSString* localPath = [NSString stringWithFormat:@"%@/%@.json",self.pathToTemplateDirectory,apiMethod];
+        data = [NSData dataWithContentsOfFile:localPath];
+    }
+    
+    // Шаблоны, записанные на диск, важнее скомпилированных, поэтому их по-прежнему можно менять динамически
+    if ((!data) && (self.defaultTemplates)) return [self.defaultTemplates templateForAPIMethod:apiMethod];
+    
+    // Стандартные шаблоны читаются прямо из архива bundle, без его распаковки
+    if (!data) data = [self.defaultArchive dataForAPIMethod:apiMethod];
+    if (!data) return nil;
+    
+    NSError* error;
+    NSDictionary* template = [NSJSONSerialization JSONObjectWithData:data options:kNilOptions error:&error];
+    if (error){
+        NSLog(@"+templateForAPIMethod recovered invalid error from disk. By APIMethod(%@)| error: %@",apiMethod,error);
+        return nil;
+    }
+    return template;
+}
+
+
 /*--------------------------------------------------------------------------------------------------------------
  Записывает образец файла с именем API метода
  --------------------------------------------------------------------------------------------------------------*/
@@ -159,7 +248,7 @@ static BOOL                 _loadTemplateFromBundle  = NO;
 {
     __block NSError* error = nil;
 
-    dispatch_sync(self.serialDispatchQueue, ^{
+    dispatch_barrier_sync(self.templatesQueue, ^{
 
         if ((method == APIMethod_Unknow) || (template.allKeys.count < 1)){
             error = [NSError errorWithDomain:@"template or apiMethod in +writeTemplate:forAPIMethod: is incorrect" code:0 userInfo:nil];
@@ -176,13 +265,14 @@ static BOOL                 _loadTemplateFromBundle  = NO;
         NSString* localPath = [NSString stringWithFormat:@"%@/%@.json",self.pathToTemplateDirectory,apiMethod];
 
         [jsonData writeToFile:localPath atomically:YES];
+        _templatesGeneration++;
         
+        // Собственная запись не считается внешним изменением папки
+        _templateFileStamps[apiMethod] = TemplaterFileStamp([NSURL fileURLWithPath:localPath]);
  
-        // Если по ключу 'apiMethod' в словаре 'templates' уже хранился образец,
-        // то его нужно обновить
-        if (self.templates[apiMethod]){
-            self.templates[apiMethod] = template;
-        }
+        // В RAM попадает ровно то, что было записано, новым экземпляром: вызывающий может позже изменить свой словарь,
+        // а 'Validator' компилирует новый план для нового экземпляра
+        self.templates[apiMethod] = [NSJSONSerialization JSONObjectWithData:jsonData options:kNilOptions error:nil];
     });
     return error;
 }
@@ -195,7 +285,7 @@ static BOOL                 _loadTemplateFromBundle  = NO;
 {
     __block NSError* error = nil;
 
-    dispatch_sync(self.serialDispatchQueue, ^{
+    dispatch_barrier_sync(self.templatesQueue, ^{
         
         if (method == APIMethod_Unknow){
             error = [NSError errorWithDomain:@"apiMethod in +removeTemplateForAPIMethod: is incorrect" code:0 userInfo:nil];
@@ -206,9 +296,11 @@ static BOOL                 _loadTemplateFromBundle  = NO;
         // Удаляем с диска
         NSString* localPath = [NSString stringWithFormat:@"%@/%@.json",self.pathToTemplateDirectory,apiMethod];
         [TemplaterFileManager removeItemAtPath:localPath error:&error];
+        _templatesGeneration++;
 
         // Удаляем из RAM
         [self.templates removeObjectForKey:apiMethod];
+        [_templateFileStamps removeObjectForKey:apiMethod];
     });
     return error;
 }
@@ -220,13 +312,197 @@ static BOOL                 _loadTemplateFromBundle  = NO;
 + (nullable NSError*) removeAllTemplates
 {
     __block NSError* error = nil;
-    dispatch_sync(self.serialDispatchQueue, ^{
+    dispatch_barrier_sync(self.templatesQueue, ^{
         [TemplaterFileManager removeItemAtPath:self.pathToTemplateDirectory error:&error];
+        _templatesGeneration++;
     });
     return error;
 }
 
 
+#pragma mark - Warm-up
+
+/*--------------------------------------------------------------------------------------------------------------
+ Загружает в RAM шаблоны всех API методов, ответы которых валидируются, параллельно на фоновых потоках.
+ Каждый шаблон проходит через +templateForAPIMethod:, поэтому читатели делят 'templatesQueue', а распарсенные
+ шаблоны заносятся в RAM под барьерами.
+ --------------------------------------------------------------------------------------------------------------*/
++ (void) warmUpTemplates:(nullable void(^)(TemplaterWarmUpReport* report))completion
+{
+    // Шаблоны нужны только API методам, у которых есть метод валидации
+    NSMutableArray<NSNumber*>* methods = [NSMutableArray new];
+    for (APIMethod method = APIMethod_UserGet; method <= APIMethod_Logout; method++){
+        if (APIMethodResponseValidator(method)) [methods addObject:@(method)];
+    }
+    
+    dispatch_queue_t workers = dispatch_get_global_queue(QOS_CLASS_UTILITY, 0);
+    dispatch_async(workers, ^{
+        NSUInteger      count     = methods.count;
+        BOOL*           loaded    = calloc(count, sizeof(BOOL));
+        CFAbsoluteTime* durations = calloc(count, sizeof(CFAbsoluteTime));
+        CFAbsoluteTime  start     = CFAbsoluteTimeGetCurrent();
+        
+        // Каждый шаблон читается и парсится своим воркером. Результаты записываются в свои ячейки
+        dispatch_apply(count, workers, ^(size_t i){
+            @autoreleasepool {
+                CFAbsoluteTime methodStart = CFAbsoluteTimeGetCurrent();
+                loaded[i]    = ([self templateForAPIMethod:methods[i].integerValue] != nil);
+                durations[i] = CFAbsoluteTimeGetCurrent() - methodStart;
+            }
+        });
+        
+        TemplaterWarmUpReport* report = [TemplaterWarmUpReport new];
+        report.duration = CFAbsoluteTimeGetCurrent() - start;
+        
+        NSMutableArray<NSNumber*>*               loadedMethods    = [NSMutableArray new];
+        NSMutableArray<NSNumber*>*               missingMethods   = [NSMutableArray new];
+        NSMutableDictionary<NSString*,NSNumber*>* durationByMethod = [NSMutableDictionary new];
+        for (NSUInteger i = 0; i < count; i++){
+            [(loaded[i] ? loadedMethods : missingMethods) addObject:methods[i]];
+            durationByMethod[[APIManager convertAPIMethodToString:methods[i].integerValue]] = @(durations[i]);
+        }
+        free(loaded);
+        free(durations);
+        
+        report.loadedMethods    = loadedMethods;
+        report.missingMethods   = missingMethods;
+        report.durationByMethod = durationByMethod;
+        
+        @synchronized (self) {
+            _areTemplatesWarmedUp = YES;
+        }
+        APILog(@"%@", report);
+        
+        dispatch_async(dispatch_get_main_queue(), ^{
+            if (completion) completion(report);
+            [[NSNotificationCenter defaultCenter] postNotificationName:TemplaterDidWarmUpTemplatesNotification
+                                                                object:nil
+                                                              userInfo:@{TemplaterWarmUpReportKey : report}];
+        });
+    });
+}
+
+
+#pragma mark - Watching
+
+/*--------------------------------------------------------------------------------------------------------------
+ Возвращает отметки всех json файлов папки. Атрибуты запрашиваются вместе со списком файлов.
+ --------------------------------------------------------------------------------------------------------------*/
++ (NSMutableDictionary<NSString*,NSString*>*) templateFileStamps
+{
+    NSArray<NSURLResourceKey>* keys = @[NSURLContentModificationDateKey, NSURLFileSizeKey];
+    NSArray<NSURL*>* files = [[NSFileManager defaultManager] contentsOfDirectoryAtURL:[NSURL fileURLWithPath:self.pathToTemplateDirectory]
+                                                           includingPropertiesForKeys:keys
+                                                                              options:NSDirectoryEnumerationSkipsHiddenFiles
+                                                                                error:nil];
+    NSMutableDictionary<NSString*,NSString*>* stamps = [NSMutableDictionary dictionaryWithCapacity:files.count];
+    for (NSURL* file in files)
+    {
+        if (![file.pathExtension isEqualToString:@"json"]) continue;
+        stamps[file.lastPathComponent.stringByDeletingPathExtension] = TemplaterFileStamp(file);
+    }
+    return stamps;
+}
+
+
+/*--------------------------------------------------------------------------------------------------------------
+ @property (nonatomic, assign, class) BOOL watchesTemplateDirectory;
+ Включение делает первый снимок файлов папки. Выключение отменяет source.
+ --------------------------------------------------------------------------------------------------------------*/
++ (BOOL)watchesTemplateDirectory
+{
+    __block BOOL watches = NO;
+    dispatch_sync(self.templatesQueue, ^{
+        watches = (_directorySource != nil);
+    });
+    return watches;
+}
+
++ (void)setWatchesTemplateDirectory:(BOOL)watchesTemplateDirectory
+{
+    dispatch_barrier_sync(self.templatesQueue, ^{
+        if (watchesTemplateDirectory == (_directorySource != nil)) return;
+        
+        if (watchesTemplateDirectory){
+            _templateFileStamps = [self templateFileStamps];
+            [self startWatchingTemplateDirectory];
+        } else {
+            dispatch_source_cancel(_directorySource);
+            _directorySource    = nil;
+            _templateFileStamps = nil;
+        }
+    });
+}
+
+
+/*--------------------------------------------------------------------------------------------------------------
+ Открывает папку для событий и создает для нее dispatch source. Предыдущий source отменяется.
+ Вызывается внутри барьера 'templatesQueue'.
+ --------------------------------------------------------------------------------------------------------------*/
++ (void) startWatchingTemplateDirectory
+{
+    if (_directorySource) dispatch_source_cancel(_directorySource);
+    _directorySource = nil;
+    
+    NSString* path = self.pathToTemplateDirectory;
+    int descriptor = open(path.fileSystemRepresentation, O_EVTONLY);
+    if (descriptor < 0){
+        NSLog(@"+startWatchingTemplateDirectory can't open the folder: %@",path);
+        return;
+    }
+    
+    unsigned long events = DISPATCH_VNODE_WRITE | DISPATCH_VNODE_DELETE | DISPATCH_VNODE_RENAME;
+    dispatch_source_t source = dispatch_source_create(DISPATCH_SOURCE_TYPE_VNODE, descriptor, events,
+                                                      dispatch_get_global_queue(QOS_CLASS_UTILITY, 0));
+    dispatch_source_set_event_handler(source, ^{
+        [self reloadChangedTemplates:dispatch_source_get_data(source)];
+    });
+    dispatch_source_set_cancel_handler(source, ^{
+        close(descriptor);
+    });
+    _directorySource = source;
+    dispatch_resume(source);
+}
+
+
+/*--------------------------------------------------------------------------------------------------------------
+ Сравнивает файлы папки с предыдущей проверкой. Шаблоны добавленных, замененных и удаленных
+ файлов удаляются из RAM, а те, что были в RAM, читаются заново. Планы валидации старых экземпляров
+ освобождаются вместе с ними (кэш 'Validator' держит шаблоны слабо).
+ --------------------------------------------------------------------------------------------------------------*/
++ (void) reloadChangedTemplates:(unsigned long)events
+{
+    dispatch_barrier_sync(self.templatesQueue, ^{
+        if (!_directorySource) return;
+        
+        // Сама папка была удалена или перемещена: за папкой по пути 'pathToTemplateDirectory' наблюдаем заново
+        if (events & (DISPATCH_VNODE_DELETE | DISPATCH_VNODE_RENAME)){
+            [self startWatchingTemplateDirectory];
+        }
+        
+        NSMutableDictionary<NSString*,NSString*>* stamps = [self templateFileStamps];
+        NSMutableSet<NSString*>* changed = [NSMutableSet new];
+        for (NSString* apiMethod in stamps){
+            if (![stamps[apiMethod] isEqualToString:_templateFileStamps[apiMethod]]) [changed addObject:apiMethod];
+        }
+        for (NSString* apiMethod in _templateFileStamps){
+            if (!stamps[apiMethod]) [changed addObject:apiMethod];
+        }
+        _templateFileStamps = stamps;
+        if (changed.count < 1) return;
+        
+        _templatesGeneration++;
+        for (NSString* apiMethod in changed)
+        {
+            BOOL wasInRAM = (self.templates[apiMethod] != nil);
+            [self.templates removeObjectForKey:apiMethod];
+            if (wasInRAM) self.templates[apiMethod] = [self loadTemplateForAPIMethod:apiMethod];
+        }
+        APILog(@"Templates changed on disk: %@",changed.allObjects);
+    });
+}
+
+
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 /*
@@ -307,19 +583,73 @@ static BOOL                 _loadTemplateFromBundle  = NO;
 
 
 /*--------------------------------------------------------------------------------------------------------------
- @property (nonatomic, strong, class) dispatch_queue_t serialDispatchQueue;
+ @property (atomic, readonly, assign, class) BOOL areTemplatesWarmedUp;
  --------------------------------------------------------------------------------------------------------------*/
-+ (dispatch_queue_t)serialDispatchQueue
++ (BOOL)areTemplatesWarmedUp
 {
-    if (!_serialDispatchQueue){
-         _serialDispatchQueue = dispatch_queue_create("Templater.serial.aSyncQueue", NULL);
+    @synchronized (self) {
+        return _areTemplatesWarmedUp;
     }
-    return _serialDispatchQueue;
 }
 
-+ (void)setSerialDispatchQueue:(dispatch_queue_t)serialDispatchQueue
+
+/*--------------------------------------------------------------------------------------------------------------
+ @property (nonatomic, readonly, copy, class, nullable) NSString* defaultTemplatesHash;
+ --------------------------------------------------------------------------------------------------------------*/
++ (nullable NSString*)defaultTemplatesHash
+{
+    return self.defaultTemplates.contentHash;
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ @property (nonatomic, readonly, strong, class, nullable) TemplaterBundle* defaultTemplates;
+ --------------------------------------------------------------------------------------------------------------*/
++ (nullable TemplaterBundle*)defaultTemplates
+{
+    static TemplaterBundle* defaultTemplates = nil;
+    static dispatch_once_t  onceToken;
+    dispatch_once(&onceToken, ^{
+        NSString* path = [[NSBundle mainBundle] pathForResource:@"APIManagerResponseDefaultTemplates" ofType:@"templates"];
+        if (!path) return;
+        
+        NSError* error = nil;
+        defaultTemplates = [TemplaterBundle bundleAtPath:path error:&error];
+        if (error) NSLog(@"+defaultTemplates error: %@",error);
+    });
+    return defaultTemplates;
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ @property (nonatomic, readonly, strong, class, nullable) TemplaterArchive* defaultArchive;
+ --------------------------------------------------------------------------------------------------------------*/
++ (nullable TemplaterArchive*)defaultArchive
 {
-    _serialDispatchQueue = serialDispatchQueue;
+    static TemplaterArchive* defaultArchive = nil;
+    static dispatch_once_t   onceToken;
+    dispatch_once(&onceToken, ^{
+        NSString* path = [[NSBundle mainBundle] pathForResource:@"APIManagerResponseDefaultTemplates" ofType:@"zip"];
+        if (!path) return;
+        
+        NSError* error = nil;
+        defaultArchive = [TemplaterArchive archiveAtPath:path error:&error];
+        if (error) NSLog(@"+defaultArchive error: %@",error);
+    });
+    return defaultArchive;
+}
+
+
+/*--------------------------------------------------------------------------------------------------------------
+ @property (nonatomic, readonly, strong, class) dispatch_queue_t templatesQueue;
+ Очередь и словарь шаблонов создаются один раз, до того как их сможет использовать первый читатель.
+ --------------------------------------------------------------------------------------------------------------*/
++ (dispatch_queue_t)templatesQueue
+{
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        _templatesQueue = dispatch_queue_create("Templater.templates.concurrentQueue", DISPATCH_QUEUE_CONCURRENT);
+        if (!_templates) _templates = [NSMutableDictionary new];
+    });
+    return _templatesQueue;
 }
 
 /*--------------------------------------------------------------------------------------------------------------
@@ -340,13 +670,17 @@ static BOOL                 _loadTemplateFromBundle  = NO;
 
 /*--------------------------------------------------------------------------------------------------------------
   Метод позволяет изменить расположение папки с шаблонами.
-  Блок 'dispatch_barrier_sync' позволяет сначала дождаться выполениния всех остальных операций, а потом выполнить
-  переименования.
+  Барьер дожидается завершения читателей 'templatesQueue', а затем перемещает папку. Пока папка перемещается,
+  ни один шаблон из нее не читается.
  --------------------------------------------------------------------------------------------------------------*/
 + (void) setNewPathToTemplateDirectory:(NSString*)path
 {
-    dispatch_barrier_sync(self.serialDispatchQueue, ^{
+    dispatch_barrier_sync(self.templatesQueue, ^{
         [self setPathToTemplateDirectory:path];
+        _templatesGeneration++;
+        
+        // За папкой наблюдаем в ее новом расположении
+        if (_directorySource) [self startWatchingTemplateDirectory];
     });
 }
 
@@ -356,26 +690,29 @@ static BOOL                 _loadTemplateFromBundle  = NO;
 
 + (NSString *)pathToTemplateDirectory
 {
-    // Восстанавливаем из UserDefault
-    if ((!_pathToTemplateDirectory) && ([Templater shortPathFromUserDefault].length > 0)) {
-          _pathToTemplateDirectory = [Templater fullPathFromUserDefault];
-    }
+    // Читатели 'templatesQueue' могут получать путь одновременно
+    @synchronized (self) {
+        // Восстанавливаем из UserDefault
+        if ((!_pathToTemplateDirectory) && ([Templater shortPathFromUserDefault].length > 0)) {
+              _pathToTemplateDirectory = [Templater fullPathFromUserDefault];
+        }
     
-    // Если в UserDefault ничего не было, то устанавливаем значение по-умолчанию и записываем
-    if (!_pathToTemplateDirectory){
+        // Если в UserDefault ничего не было, то устанавливаем значение по-умолчанию и записываем
+        if (!_pathToTemplateDirectory){
         
-        NSString* pathToLibraryCaches = [NSSearchPathForDirectoriesInDomains(NSLibraryDirectory, NSUserDomainMask,YES) firstObject];
-        NSString* pathToFolder = [pathToLibraryCaches stringByAppendingPathComponent:@"/APIManagerResponseTemplates"];
+            NSString* pathToLibraryCaches = [NSSearchPathForDirectoriesInDomains(NSLibraryDirectory, NSUserDomainMask,YES) firstObject];
+            NSString* pathToFolder = [pathToLibraryCaches stringByAppendingPathComponent:@"/APIManagerResponseTemplates"];
 
-        [Templater saveAnyPathToUserDefault:pathToFolder];
-        _pathToTemplateDirectory = pathToFolder;
-    }
+            [Templater saveAnyPathToUserDefault:pathToFolder];
+            _pathToTemplateDirectory = pathToFolder;
+        }
     
-    if ((_pathToTemplateDirectory) && (![TemplaterFileManager existsItemAtPath:_pathToTemplateDirectory])){
-        [self createFolderIfItDoesntExitByPath:_pathToTemplateDirectory];
-    }
+        if ((_pathToTemplateDirectory) && (![TemplaterFileManager existsItemAtPath:_pathToTemplateDirectory])){
+            [self createFolderIfItDoesntExitByPath:_pathToTemplateDirectory];
+        }
     
-    return _pathToTemplateDirectory;
+        return _pathToTemplateDirectory;
+    }
 }
 
 
@@ -465,56 +802,157 @@ static BOOL                 _loadTemplateFromBundle  = NO;
 #pragma mark - Strings / Logics / UserDefault
 
 /*--------------------------------------------------------------------------------------------------------------
- Метод распаковывает архив с папкой стандартных json файлов (ответов от сервера).
- Если укажите nil в аргумент 'atPath', тогда алгоритм автоматический разархиврует папку по пути 'Templater.pathToTemplateDirectory'.
- Данный метод вы можете вызывать каждый раз при запуске приложения внутри метода +APIManager.prepareBeforeUsing:,
- внутри встроена защита от повторных разархиврований.
+ Подготавливает стандартные шаблоны из bundle приложения: скомпилированный
+ 'APIManagerResponseDefaultTemplates.templates' или, если его нет, 'APIManagerResponseDefaultTemplates.zip'.
+ Ни один из них не распаковывается: шаблоны читаются из них по требованию. Когда стандартные шаблоны изменились
+ при обновлении приложения ('contentHash' скомпилированного файла или CRC-32 записей архива), копия на диске
+ измененного шаблона удаляется, если копия не менялась с момента распаковки.
+ Если укажите путь в аргумент 'atPath', папка с шаблонами будет перемещена туда.
+ Данный метод вы можете вызывать каждый раз при запуске приложения внутри метода +APIManager.prepareBeforeUsing:.
  --------------------------------------------------------------------------------------------------------------*/
-
 + (void) unarchiveFolderWithDefaultTemplates:(nullable NSString*)atPath
                                   completion:(nullable void(^)(NSError* error))completion
 {
-    // Проверяем был ли ранее архив разрахивирован
-    BOOL wasZipExtractedEarly = [[NSUserDefaults standardUserDefaults] boolForKey:wasArchiveExtractedUserDefaultKey];
-    if (wasZipExtractedEarly){
-        return;
-    }
-    
-    // Устанавливаем путь куда будет произведена разархивация
-    if (atPath.length < 1){
-        atPath = Templater.pathToTemplateDirectory;
-    } else {
+    // Устанавливаем путь, по которому хранятся измененные шаблоны
+    if (atPath.length > 0){
         [Templater setNewPathToTemplateDirectory:atPath];
     }
     
-    // Удаляем на конце строки названия папки
-    atPath = [Templater removeDefaultFolderNameToPathIfItNeeded:atPath];
+    // Скомпилированные стандартные шаблоны читаются прямо из bundle, поэтому разархивировать нечего.
+    // Копии, распакованные из предыдущих стандартных шаблонов, все еще перекрывают их и удаляются
+    if (self.defaultTemplates){
+        [Templater removeOutdatedCopiesOfDefaultTemplates:self.defaultTemplates];
+        if (completion) completion(nil);
+        return;
+    }
     
-    // Ищем путь к архиву в bundle приложения
-    NSString *localPathAtZip = [[NSBundle mainBundle] pathForResource:@"APIManagerResponseDefaultTemplates" ofType:@"zip"];
-    if (localPathAtZip.length < 1){
+    // Ищем архив в bundle приложения
+    TemplaterArchive* archive = self.defaultArchive;
+    if (!archive){
         if (completion)
             completion([NSError errorWithDomain:@"APIManagerResponseDefaultTemplates.zip wasn't find in bundle" code:0 userInfo:nil]);
         return;
     }
     
-    // Разархивируем архив
-    [SSZipArchive unzipFileAtPath:localPathAtZip
-                    toDestination:atPath
-                  progressHandler:^(NSString * _Nonnull entry, unz_file_info zipInfo, long entryNumber, long total) {
-                      
-                  } completionHandler:^(NSString * _Nonnull path, BOOL succeeded, NSError * _Nullable errorUnpackZip) {
-                      
-                      if (errorUnpackZip){
-                          if (completion) { completion(errorUnpackZip); };
-                      }else if (succeeded){
-                          if (completion) completion(nil);
-                          
-                          // Записываем флаг говорящий о том, что разархивация была проведена
-                          [[NSUserDefaults standardUserDefaults] setBool:YES forKey:wasArchiveExtractedUserDefaultKey];
-                          [[NSUserDefaults standardUserDefaults] synchronize];
-                      }
-    }];
+    [Templater removeOutdatedCopiesOfArchive:archive];
+    if (completion) completion(nil);
+    
+    // Стандартные шаблоны заносятся в RAM до первых ответов
+    [Templater warmUpTemplates:nil];
+}
+
+
+/*--------------------------------------------------------------------------------------------------------------
+ Сравнивает хеши стандартных шаблонов с сохраненными при предыдущем запуске.
+ Для каждого измененного шаблона копия на диске удаляется, если она равна предыдущему или новому стандартному
+ шаблону: такая копия была ранее распакована и не менялась приложением.
+ Копии, записанные приложением, сохраняются.
+ При первом запуске после версий, которые один раз распаковывали весь архив, сохраненных CRC-32 нет,
+ а архив тех версий неизвестен. Копия, равная новой записи, удаляется. Другая копия удаляется, только если
+ она менялась не позже 'legacyExtractionInterval' после создания папки с шаблонами, то есть после того, как те
+ версии распаковали архив (распакованные файлы могут сохранять и даты архива, которые раньше). Компромисс:
+ шаблон, который приложение перезаписало в течение этой минуты, тоже удаляется, а распакованная копия,
+ измененная позже, сохраняется и перекрывает новый стандартный шаблон, пока ее не удалят вручную.
+ --------------------------------------------------------------------------------------------------------------*/
++ (void) removeCopiesOutdatedByDefaultHashes:(NSDictionary<NSString*,NSNumber*>*)entryHashes
+{
+    NSDictionary<NSString*,NSNumber*>* savedHashes  = [[NSUserDefaults standardUserDefaults] dictionaryForKey:defaultTemplateHashesUserDefaultKey];
+    
+    // Стандартные шаблоны не менялись с предыдущего запуска
+    if ([savedHashes isEqualToDictionary:entryHashes]){
+        return;
+    }
+    // Копии распакованы предыдущей версией, хеши ее архива не сохранялись
+    BOOL isLegacyExtraction = (!savedHashes) &&
+                              ([[NSUserDefaults standardUserDefaults] boolForKey:wasArchiveExtractedUserDefaultKey]);
+    // Она создала папку с шаблонами, когда распаковывала архив
+    NSDate* legacyExtractionDate = (isLegacyExtraction) ? [TemplaterFileManager creationDateOfItemAtPath:self.pathToTemplateDirectory] : nil;
+    
+    dispatch_barrier_sync(self.templatesQueue, ^{
+        for (NSString* apiMethod in entryHashes)
+        {
+            NSNumber* entryHash = entryHashes[apiMethod];
+            NSNumber* savedHash = savedHashes[apiMethod];
+            if ([savedHash isEqualToNumber:entryHash]) continue;
+            
+            NSString* localPath = [NSString stringWithFormat:@"%@/%@.json",self.pathToTemplateDirectory,apiMethod];
+            NSData*   data      = [NSData dataWithContentsOfFile:localPath];
+            if (!data) continue;
+            
+            // Хеши архива - это CRC-32 файлов, хеши скомпилированных шаблонов - CRC-32 канонического json.
+            // Копия сравнивается в обеих формах
+            id    localTemplate  = [NSJSONSerialization JSONObjectWithData:data options:kNilOptions error:nil];
+            uLong localHash      = crc32(0L, data.bytes, (uInt)data.length);
+            uLong canonicalHash  = (localTemplate) ? [Templater canonicalHashOfTemplate:localTemplate] : 0;
+            BOOL  isUnpackedCopy = (localHash == entryHash.unsignedLongValue) || (canonicalHash == entryHash.unsignedLongValue) ||
+                                   ((savedHash) && ((localHash == savedHash.unsignedLongValue) || (canonicalHash == savedHash.unsignedLongValue)));
+            if ((!isUnpackedCopy) && (legacyExtractionDate)){
+                // CRC-32 старого архива неизвестны. Копия, не менявшаяся после распаковки, была распакована,
+                // более поздняя записана приложением
+                NSDate* modificationDate = [TemplaterFileManager modificationDateOfItemAtPath:localPath];
+                isUnpackedCopy = (modificationDate) && ([modificationDate timeIntervalSinceDate:legacyExtractionDate] < legacyExtractionInterval);
+            }
+            if (!isUnpackedCopy) continue;
+            
+            [TemplaterFileManager removeItemAtPath:localPath error:nil];
+            [self.templates removeObjectForKey:apiMethod];
+            _templatesGeneration++;
+        }
+    });
+    
+    [[NSUserDefaults standardUserDefaults] setObject:entryHashes forKey:defaultTemplateHashesUserDefaultKey];
+    [[NSUserDefaults standardUserDefaults] removeObjectForKey:wasArchiveExtractedUserDefaultKey];
+    [[NSUserDefaults standardUserDefaults] synchronize];
+}
+
+
+/*--------------------------------------------------------------------------------------------------------------
+ Удаляет копии на диске, которые стандартные шаблоны из архива делают устаревшими.
+ Правило то же, что у +removeCopiesOutdatedByDefaultHashes:.
+ --------------------------------------------------------------------------------------------------------------*/
++ (void) removeOutdatedCopiesOfArchive:(TemplaterArchive*)archive
+{
+    [Templater removeCopiesOutdatedByDefaultHashes:archive.entryHashes];
+
+    // Следующий архив сравнивает свои копии с этими хешами, следующий скомпилированный файл проверяется заново
+    [[NSUserDefaults standardUserDefaults] removeObjectForKey:defaultTemplatesContentHashUserDefaultKey];
+}
+
+
+/*--------------------------------------------------------------------------------------------------------------
+ Удаляет копии на диске, которые скомпилированные стандартные шаблоны делают устаревшими.
+ Выполняется только когда 'contentHash' отличается от сохраненного. Хеши шаблонов - это CRC-32 их
+ канонического json (см. +canonicalHashOfTemplate:), так как скомпилированный файл не хранит json файлы.
+ Правило то же, что у +removeCopiesOutdatedByDefaultHashes:.
+ --------------------------------------------------------------------------------------------------------------*/
++ (void) removeOutdatedCopiesOfDefaultTemplates:(TemplaterBundle*)bundle
+{
+    NSString* savedContentHash = [[NSUserDefaults standardUserDefaults] stringForKey:defaultTemplatesContentHashUserDefaultKey];
+    if ([savedContentHash isEqualToString:bundle.contentHash]){
+        return;
+    }
+
+    NSMutableDictionary<NSString*,NSNumber*>* entryHashes = [NSMutableDictionary new];
+    for (NSString* apiMethod in bundle.apiMethods)
+    {
+        NSDictionary* template = [bundle templateForAPIMethod:apiMethod];
+        if (template) entryHashes[apiMethod] = @([Templater canonicalHashOfTemplate:template]);
+    }
+    [Templater removeCopiesOutdatedByDefaultHashes:entryHashes];
+
+    [[NSUserDefaults standardUserDefaults] setObject:bundle.contentHash forKey:defaultTemplatesContentHashUserDefaultKey];
+    [[NSUserDefaults standardUserDefaults] synchronize];
+}
+
+
+/*--------------------------------------------------------------------------------------------------------------
+ CRC-32 шаблона, сериализованного с отсортированными ключами и без форматирования. Не зависит от форматирования
+ и порядка ключей json файла, поэтому копия, записанная +writeTemplate:, равна своему стандартному шаблону.
+ --------------------------------------------------------------------------------------------------------------*/
++ (uLong) canonicalHashOfTemplate:(id)template
+{
+    NSData* data = [NSJSONSerialization dataWithJSONObject:template options:NSJSONWritingSortedKeys error:nil];
+    return (data) ? crc32(0L, data.bytes, (uInt)data.length) : 0;
 }
 
 
@@ -622,4 +1060,83 @@ static BOOL                 _loadTemplateFromBundle  = NO;
 }
 
 
+#pragma mark - Benchmark
+
+#if DEBUG
+static const APIMethod TemplaterBenchmarkMethods[] = { APIMethod_UserGet, APIMethod_FriendsGet, APIMethod_WallGet, APIMethod_PhotosGetAll };
+#define TemplaterBenchmarkMethodsCount (sizeof(TemplaterBenchmarkMethods) / sizeof(TemplaterBenchmarkMethods[0]))
+
+/*--------------------------------------------------------------------------------------------------------------
+ Выполняет 'lookup' 'iterations' раз на каждом из 'threads' параллельных воркеров. Возвращает время всех воркеров.
+ --------------------------------------------------------------------------------------------------------------*/
+static CFAbsoluteTime TemplaterMeasure(NSUInteger threads, NSUInteger iterations, void(^lookup)(NSUInteger index))
+{
+    dispatch_queue_t workers = dispatch_get_global_queue(QOS_CLASS_USER_INITIATED, 0);
+    CFAbsoluteTime start = CFAbsoluteTimeGetCurrent();
+    dispatch_apply(threads, workers, ^(size_t thread){
+        @autoreleasepool {
+            for (NSUInteger i = 0; i < iterations; i++) lookup(thread + i);
+        }
+    });
+    return CFAbsoluteTimeGetCurrent() - start;
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ Запрашивает шаблоны четырех API методов из 1, 2, 4 и 8 потоков: через последовательную очередь (как это делалось
+ раньше) и через 'templatesQueue'. Измеряется только путь через RAM: шаблоны, которых нет в RAM,
+ на время бенчмарка заменяются заглушками.
+ --------------------------------------------------------------------------------------------------------------*/
++ (void) benchmarkTemplateLookup:(NSUInteger)iterations
+{
+    iterations = MAX(1, iterations);
+    
+    NSMutableArray<NSString*>* stubs = [NSMutableArray new];
+    dispatch_barrier_sync(self.templatesQueue, ^{
+        for (NSUInteger i = 0; i < TemplaterBenchmarkMethodsCount; i++){
+            NSString* apiMethod = [APIManager convertAPIMethodToString:TemplaterBenchmarkMethods[i]];
+            if (self.templates[apiMethod]) continue;
+            
+            self.templates[apiMethod] = @{ @"response" : @{ @"count" : @(1), @"items" : @[] } };
+            [stubs addObject:apiMethod];
+        }
+    });
+    
+    dispatch_queue_t serialQueue = dispatch_queue_create("Templater.benchmark.serialQueue", NULL);
+    
+    for (NSUInteger threads = 1; threads <= 8; threads *= 2)
+    {
+        CFAbsoluteTime serial = TemplaterMeasure(threads, iterations, ^(NSUInteger index){
+            APIMethod method = TemplaterBenchmarkMethods[index % TemplaterBenchmarkMethodsCount];
+            dispatch_sync(serialQueue, ^{
+                (void)self.templates[[APIManager convertAPIMethodToString:method]];
+            });
+        });
+        CFAbsoluteTime concurrent = TemplaterMeasure(threads, iterations, ^(NSUInteger index){
+            [Templater templateForAPIMethod:TemplaterBenchmarkMethods[index % TemplaterBenchmarkMethodsCount]];
+        });
+        
+        double lookups = (double)threads * iterations;
+        APILog(@"%lu threads: serial queue %.0f, concurrent queue %.0f lookups per second",
+               (unsigned long)threads, lookups / serial, lookups / concurrent);
+    }
+    
+    dispatch_barrier_sync(self.templatesQueue, ^{
+        [self.templates removeObjectsForKeys:stubs];
+    });
+}
+#endif
+
+@end
+
+
+
+@implementation TemplaterWarmUpReport
+
+- (NSString*) description
+{
+    return [NSString stringWithFormat:@"<%@: %lu loaded, %lu missing %@, %.1f ms>", NSStringFromClass([self class]),
+            (unsigned long)self.loadedMethods.count, (unsigned long)self.missingMethods.count, self.missingMethods,
+            self.duration * 1000];
+}
+
 @end
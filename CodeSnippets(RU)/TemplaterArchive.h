@@ -0,0 +1,47 @@
+//
+//  TemplaterArchive.h
+//  vk-networkLayer
+//
+//  Created by Admin on 06/08/2020.
+//  Copyright © 2020 iOS-Team. All rights reserved.
+//
+
+#import <Foundation/Foundation.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+/*--------------------------------------------------------------------------------------------------------------
+ 🗜 'TemplaterArchive' - читает отдельные шаблоны прямо из 'APIManagerResponseDefaultTemplates.zip'.
+ ---------------
+ При открытии архива читается только его центральный каталог: имена записей, их позиции
+ и CRC-32. Запись находится по имени API метода и распаковывается при первом запросе своего шаблона,
+ поэтому архив не нужно распаковывать в песочницу.
+ ---------------
+ Дополнительно:
+ (⚠️) 'entryHashes' - это CRC-32 записей, взятые из центрального каталога без распаковки.
+      'Templater' сравнивает их с предыдущим запуском, чтобы найти шаблоны, измененные обновлением приложения.
+ --------------------------------------------------------------------------------------------------------------*/
+@interface TemplaterArchive : NSObject
+
+// Путь к архиву
+@property (nonatomic, readonly, copy) NSString* path;
+
+// CRC-32 записей по имени API метода ('users.get')
+@property (nonatomic, readonly, copy) NSDictionary<NSString*,NSNumber*>* entryHashes;
+
+
+/*--------------------------------------------------------------------------------------------------------------
+ Открывает архив и читает его центральный каталог. Записи с json файлами индексируются по их именам
+ без папки и расширения. Возвращает nil, если архив не существует или не может быть прочитан.
+ --------------------------------------------------------------------------------------------------------------*/
++ (nullable instancetype) archiveAtPath:(NSString*)path error:(NSError**)error;
+
+/*--------------------------------------------------------------------------------------------------------------
+ Распаковывает запись API метода. Возвращает nil, если такой записи нет или она повреждена.
+ Безопасно вызывать с любого потока: чтения архива выполняются последовательно.
+ --------------------------------------------------------------------------------------------------------------*/
+- (nullable NSData*) dataForAPIMethod:(NSString*)apiMethod;
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,100 @@
+//
+//  TemplaterArchive.m
+//  vk-networkLayer
+//
+//  Created by Admin on 06/08/2020.
+//  Copyright © 2020 iOS-Team. All rights reserved.
+//
+
+#import "TemplaterArchive.h"
+
+// Thrid-party frameworks
+#import <RXZipArchive/RXZipArchive.h>
+
+
+@interface TemplaterArchive ()
+@property (nonatomic, readwrite, copy) NSString* path;
+@property (nonatomic, readwrite, copy) NSDictionary<NSString*,NSNumber*>* entryHashes;
+
+// Позиции записей в архиве по имени API метода. 'unz_file_pos' в 'NSValue'
+@property (nonatomic, strong) NSDictionary<NSString*,NSValue*>* entryPositions;
+@end
+
+
+
+@implementation TemplaterArchive
+{
+    // 'unzFile' хранит внутри текущую запись, поэтому все чтения идут под '@synchronized (self)'
+    unzFile _file;
+}
+
++ (nullable instancetype) archiveAtPath:(NSString*)path error:(NSError**)error
+{
+    unzFile file = unzOpen(path.fileSystemRepresentation);
+    if (!file){
+        if (error) *error = [NSError errorWithDomain:[NSString stringWithFormat:@"%@ can't be opened as a zip archive",path.lastPathComponent] code:0 userInfo:nil];
+        return nil;
+    }
+
+    NSMutableDictionary<NSString*,NSNumber*>* entryHashes    = [NSMutableDictionary new];
+    NSMutableDictionary<NSString*,NSValue*>*  entryPositions = [NSMutableDictionary new];
+
+    // Читается только центральный каталог, сами записи не распаковываются
+    for (int status = unzGoToFirstFile(file); status == UNZ_OK; status = unzGoToNextFile(file))
+    {
+        unz_file_info info;
+        char name[PATH_MAX];
+        if (unzGetCurrentFileInfo(file, &info, name, sizeof(name), NULL, 0, NULL, 0) != UNZ_OK) continue;
+
+        NSString* entryName = [NSString stringWithUTF8String:name];
+        if ((![entryName.pathExtension isEqualToString:@"json"]) || ([entryName hasPrefix:@"__MACOSX"])) continue;
+
+        unz_file_pos position;
+        if (unzGetFilePos(file, &position) != UNZ_OK) continue;
+
+        NSString* apiMethod = entryName.lastPathComponent.stringByDeletingPathExtension;
+        entryHashes[apiMethod]    = @(info.crc);
+        entryPositions[apiMethod] = [NSValue valueWithBytes:&position objCType:@encode(unz_file_pos)];
+    }
+
+    TemplaterArchive* archive = [TemplaterArchive new];
+    archive->_file          = file;
+    archive.path            = path;
+    archive.entryHashes     = entryHashes;
+    archive.entryPositions  = entryPositions;
+    return archive;
+}
+
+- (void) dealloc
+{
+    if (_file) unzClose(_file);
+}
+
+
+- (nullable NSData*) dataForAPIMethod:(NSString*)apiMethod
+{
+    NSValue* positionValue = self.entryPositions[apiMethod];
+    if (!positionValue) return nil;
+
+    unz_file_pos position;
+    [positionValue getValue:&position];
+
+    @synchronized (self) {
+        unz_file_info info;
+        if (unzGoToFilePos(_file, &position) != UNZ_OK)                                        return nil;
+        if (unzGetCurrentFileInfo(_file, &info, NULL, 0, NULL, 0, NULL, 0) != UNZ_OK)          return nil;
+        if (unzOpenCurrentFile(_file) != UNZ_OK)                                               return nil;
+
+        NSMutableData* data = [NSMutableData dataWithLength:info.uncompressed_size];
+        int read = unzReadCurrentFile(_file, data.mutableBytes, (unsigned)data.length);
+
+        // 'unzCloseCurrentFile' проверяет CRC-32 всей распакованной записи
+        if ((unzCloseCurrentFile(_file) != UNZ_OK) || (read != (int)data.length)){
+            NSLog(@"TemplaterArchive: entry of %@ is damaged in %@",apiMethod,self.path.lastPathComponent);
+            return nil;
+        }
+        return data;
+    }
+}
+
+@end
@@ -0,0 +1,69 @@
+//
+//  TemplaterBundle.h
+//  vk-networkLayer
+//
+//  Created by Admin on 06/08/2020.
+//  Copyright © 2020 iOS-Team. All rights reserved.
+//
+
+#import <Foundation/Foundation.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+/*--------------------------------------------------------------------------------------------------------------
+ 📦 'TemplaterBundle' - один заранее скомпилированный файл с шаблонами всех API методов.
+ ---------------
+ Шаблон, хранящийся как '<method>.json', парсится 'NSJSONSerialization' при первом ответе своего API метода,
+ а стандартный набор нужно разархивировать в песочницу при первом запуске.
+ Скомпилированный файл добавляется в bundle приложения вместо 'APIManagerResponseDefaultTemplates.zip'.
+ Он отображается в память, и каждый шаблон декодируется из своего бинарного вида при первом запросе,
+ без чтения и парсинга json файлов.
+ ---------------
+ Формат файла (little-endian):
+ - Заголовок: magic 'APTB', версия формата, количество шаблонов, SHA-256 индекса и данных.
+ - Индекс:  по строке на шаблон, отсортированные по имени API метода: смещение и длина имени
+            и смещение и длина шаблона. Поиск выполняется бинарным поиском.
+ - Данные:  имена API методов в UTF-8 и шаблоны в бинарном виде: каждое значение - это однобайтовый тег
+            и следующие за ним байты, поэтому декодирование - один проход без поиска разделителей.
+ ---------------
+ Дополнительно:
+ (⚠️) Файл собирается методом +compileTemplatesAtDirectory:toPath: из папки json файлов, например
+      в Run Script фазе сборки command line таргета. Правила шаблонов компилируются вместе с ними.
+ (⚠️) 'contentHash' меняется вместе с любым шаблоном, поэтому его можно использовать как версию стандартных шаблонов.
+ --------------------------------------------------------------------------------------------------------------*/
+@interface TemplaterBundle : NSObject
+
+// Путь к отображенному файлу
+@property (nonatomic, readonly, copy) NSString* path;
+
+// SHA-256 шаблонов, записанный при компиляции, в hex
+@property (nonatomic, readonly, copy) NSString* contentHash;
+
+// Имена API методов всех шаблонов, отсортированные
+@property (nonatomic, readonly, copy) NSArray<NSString*>* apiMethods;
+
+
+/*--------------------------------------------------------------------------------------------------------------
+ Отображает файл в память и проверяет его заголовок. Шаблоны не читаются, пока их не запросят.
+ Возвращает nil, если файл не существует или имеет другой формат.
+ --------------------------------------------------------------------------------------------------------------*/
++ (nullable instancetype) bundleAtPath:(NSString*)path error:(NSError**)error;
+
+/*--------------------------------------------------------------------------------------------------------------
+ Декодирует шаблон API метода ('users.get') из отображенного файла. Возвращает nil, если такого шаблона нет.
+ Безопасно вызывать с любого потока.
+ --------------------------------------------------------------------------------------------------------------*/
+- (nullable NSDictionary*) templateForAPIMethod:(NSString*)apiMethod;
+
+
+#pragma mark - Build tool
+
+/*--------------------------------------------------------------------------------------------------------------
+ Компилирует все файлы '<method>.json' папки в один файл по пути 'path'.
+ Возвращает ошибку, если любой json файл невалиден, чтобы сломанный шаблон не попал в приложение.
+ --------------------------------------------------------------------------------------------------------------*/
++ (nullable NSError*) compileTemplatesAtDirectory:(NSString*)directory toPath:(NSString*)path;
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -11,10 +11,24 @@
 /*--------------------------------------------------------------------------------------------------------------
   🗃 'TemplaterFileManager' - a class that works with the sandbox. Original name 'FCFileManager'.
      The name was changed to prevent name conflicts with other libraries.
+ (⚠️) 'list...InDirectoryAtPath:' methods walk the folder once with 'readdir': the type of an item is taken
+      from its directory entry, and the extension, prefix and suffix are checked in the same pass.
+ (⚠️) The size of a directory is counted by walking its subdirectories in parallel, both the logical size
+      and the size of the allocated blocks. After 'indexSizeOfDirectoryAtPath:error:' the sizes of the directory
+      are kept up to date by the changes made through this class and are returned without walking it.
+      Changes made past this class are not noticed: index the directory again after them.
+ (⚠️) Paths are resolved by a prefix tree of the base directories, and the last resolved paths are cached,
+      so the methods called for many paths in a row do not compare each path with every base directory.
+ (⚠️) Items are copied by cloning them ('clonefile'), so on APFS a file or a whole directory is copied
+      without copying its data. Where cloning is not possible, the files of a directory are copied in parallel.
+      Items are moved by renaming them, and to another volume by copying and removing them.
  --------------------------------------------------------------------------------------------------------------*/
 
 @interface TemplaterFileManager : NSObject
 
++(NSNumber *)allocatedSizeOfDirectoryAtPath:(NSString *)path;
++(NSNumber *)allocatedSizeOfDirectoryAtPath:(NSString *)path error:(NSError **)error;
+
 +(id)attributeOfItemAtPath:(NSString *)path forKey:(NSString *)key;
 +(id)attributeOfItemAtPath:(NSString *)path forKey:(NSString *)key error:(NSError **)error;
 
@@ -56,6 +70,9 @@
 
 +(BOOL)existsItemAtPath:(NSString *)path;
 
++(BOOL)indexSizeOfDirectoryAtPath:(NSString *)path error:(NSError **)error;
++(void)removeSizeIndexOfDirectoryAtPath:(NSString *)path;
+
 +(BOOL)isDirectoryItemAtPath:(NSString *)path;
 +(BOOL)isDirectoryItemAtPath:(NSString *)path error:(NSError **)error;
 
@@ -193,6 +210,18 @@
 +(BOOL)xattrOfItemAtPath:(NSString *)path removeValueForKey:(NSString *)key;
 +(BOOL)xattrOfItemAtPath:(NSString *)path setValue:(NSString *)value forKey:(NSString *)key;
 
+
+#pragma mark - Benchmark
+
+#if DEBUG
+/*--------------------------------------------------------------------------------------------------------------
+ Creates 'count' files in 100 folders of the temporary directory, half of them json, and lists the json files
+ deeply: by filtering the listed items with 'attributesOfItemAtPath:' (as it was done before) and in one pass.
+ Prints both times to the console and removes the files.
+ --------------------------------------------------------------------------------------------------------------*/
++(void)benchmarkListingOfFilesCount:(NSUInteger)count;
+#endif
+
 @end
 
 
@@ -3,6 +3,9 @@
 #import "APIManager.h"
 #import "Token.h"
 
+// Other Network layer components
+#import "NetworkRequestConstructor+FieldProjection.h"
+
 // Other ViewModels
 #import "UserProfileCellVM.h"
 #import "UserProfileGalleryCellVM.h"
@@ -47,6 +50,11 @@
         __weak UserProfileVM* weak = self;      
         NSArray<NSString*>* userIDs = (self.userID) ? @[self.userID] : @[];
         
+        // Поля, которые читает шапка профиля: одна аватарка, статус онлайн, 'last_seen', подписчики из 'counters', город.
+        // 'first_name', 'last_name' и 'id' возвращаются всегда. Пока viewModel жива, NRC запрашивает только их
+        [NRC declareFields:@[@"photo_200",@"online",@"last_seen",@"counters",@"city"]
+               forConsumer:self APIMethod:APIMethod_UserGet];
+        
         // Network operation initialization
         self.userInfoNetOp =
         [APIManager usersGet:userIDs
@@ -21,11 +21,88 @@ typedef NS_OPTIONS(NSUInteger, ResponseValidationMask) {
     CheckSubEntityOnKeys  = 1 << 1, // Проверяет наличие ключей из шаблона во вложенных структурах
     CheckOnTypesOfValues  = 1 << 2, // Проверяет соотвествие типов данных по ключам
     CheckOnExtendedRules  = 1 << 3, // Осуществляет проверку на правила (если они были перечисленны в шаблоне)
+    CheckArrayElements    = 1 << 4, // Проверяет каждый элемент массивов по первому элементу массива в шаблоне
     
     AllChecks = CheckOnKeys | CheckSubEntityOnKeys | CheckOnTypesOfValues | CheckOnExtendedRules
 };
 
 
+/*--------------------------------------------------------------------------------------------------------------
+  Политика, по которой валидируются ответы API метода. См. '+setValidationPolicy:forAPIMethod:'.
+ --------------------------------------------------------------------------------------------------------------*/
+typedef NS_ENUM(NSInteger, ValidationPolicy) {
+    
+    ValidationPolicy_Full = 0,      // Проверяется каждый ответ (по умолчанию)
+    ValidationPolicy_Sampled,       // Проверяется один из 'validationSampleRate' ответов
+    ValidationPolicy_ShapeChanged,  // Проверяются только ответы, структура которых отличается от последнего валидного
+    ValidationPolicy_Off            // Ответы не проверяются
+};
+
+/*--------------------------------------------------------------------------------------------------------------
+  Вызывается на 'backgroundValidationQueue', когда фоновая валидация нашла ошибку.
+ --------------------------------------------------------------------------------------------------------------*/
+typedef void(^ValidationDriftHandler)(APIMethod method, NSError* error);
+
+
+/*--------------------------------------------------------------------------------------------------------------
+  Тип значения json с точки зрения валидатора.
+ --------------------------------------------------------------------------------------------------------------*/
+typedef NS_ENUM(uint8_t, ValidationValueType) {
+    ValidationValueType_None = 0,   // По ключу нет значения
+    ValidationValueType_String,
+    ValidationValueType_Number,
+    ValidationValueType_Array,
+    ValidationValueType_Dictionary,
+    ValidationValueType_Null,
+    ValidationValueType_Other
+};
+
+/*--------------------------------------------------------------------------------------------------------------
+  Вид проблемы, найденной автоматической валидацией. См. 'ValidationIssue'.
+ --------------------------------------------------------------------------------------------------------------*/
+typedef NS_ENUM(NSInteger, ValidationIssueKind) {
+    
+    ValidationIssueKind_MissingKey = 0,     // Ключа шаблона нет в json
+    ValidationIssueKind_TypeMismatch,       // Значение другого типа, чем в шаблоне
+    ValidationIssueKind_RuleViolation,      // Значение не удовлетворяет правилу шаблона
+    ValidationIssueKind_InvalidRules,       // Правила шаблона противоречат друг другу
+    ValidationIssueKind_InvalidParams,      // Метод правил вызван без шаблона или правил
+    ValidationIssueKind_ArrayCheckStopped,  // Проверка массива остановлена после 'arrayValidationErrorLimit'
+    
+    ValidationIssueKindCount
+};
+
+
+/*--------------------------------------------------------------------------------------------------------------
+ 📋 'ValidationIssue' - одна проблема, найденная автоматической валидацией.
+ ---------------
+ Проблема хранит только вид, ключ, правило и значения: во время валидации ответа ничего не форматируется.
+ 'message' и 'keyPath' строятся при чтении, поэтому неудачная валидация, ошибка которой только считается
+ или отбрасывается, не тратит время на форматирование строк.
+ ---------------
+ Проблемы доступны в 'error.userInfo[@"validationIssues"]'.
+ 'error.userInfo[@"userInfoArray"]' содержит их сообщения, как и раньше.
+ --------------------------------------------------------------------------------------------------------------*/
+@interface ValidationIssue : NSObject
+
+@property (nonatomic, assign, readonly) ValidationIssueKind kind;
+// Ключ шаблона. 'nil' для элемента массива, тип которого отличается от шаблона
+@property (nonatomic, strong, readonly, nullable) NSString* key;
+// Ключ правила шаблона ('mustMatch', 'minimum', ...). 'nil', если проблема не в правиле
+@property (nonatomic, strong, readonly, nullable) NSString* rule;
+@property (nonatomic, assign, readonly) ValidationValueType expectedType;
+@property (nonatomic, assign, readonly) ValidationValueType actualType;
+// Значение из json и значение, требуемое правилом
+@property (nonatomic, strong, readonly, nullable) id value;
+@property (nonatomic, strong, readonly, nullable) id limit;
+
+// Путь к элементу массива ('items[12]'). 'nil' вне массивов
+@property (nonatomic, readonly, nullable) NSString* keyPath;
+@property (nonatomic, readonly) NSString* message;
+
+@end
+
+
 /*--------------------------------------------------------------------------------------------------------------
  🚦⚖️  'Validator' - валидирует ответы полученные от сервера
  ---------------
@@ -44,9 +121,23 @@ typedef NS_OPTIONS(NSUInteger, ResponseValidationMask) {
    автоматического тестирования.
  ---------------
  Additionally:
- (⚠️) При использовании автоматической валидации объекты расположенные в массивах проверки не подлежат.
-      Если ваш ответ от сервера возвращает вам массив объектов, то для осуществляения валидации на диск в качестве
-      шаблона и в метод проверки всегда передавайте непосредственно объект.
+ (⚠️) Объекты, расположенные в массивах, проверяются только с 'CheckArrayElements' (он не входит в 'AllChecks').
+      Методы валидации API методов добавляют его, если в 'APIMethodRegistry' задан 'checksArrayElements':
+      каждый элемент сравнивается с первым элементом массива в шаблоне. Длинные массивы проверяются
+      параллельными частями, проверка останавливается после 'arrayValidationErrorLimit' невалидных элементов.
+ (⚠️) Автоматическая валидация один раз компилирует каждый шаблон в план валидации (упорядоченные ключи,
+      теги типов, правила и планы вложенных словарей). Ответы проверяются по плану за один проход.
+ (⚠️) Словари '<key>-Rules' компилируются вместе с планом: регулярные выражения 'matchesPattern' компилируются
+      один раз, 'matchWithOneOf' хранится как множество строк в нижнем регистре.
+ (⚠️) План запоминает структурные отпечатки прошедших его ответов: ключи шаблона и их типы,
+      последние 16 штук. Ключи, которых нет в шаблоне, не учитываются.
+      Для ответа с известным отпечатком повторно проверяются только правила ('mustMatch', длины, диапазоны).
+ (⚠️) '+validateResponse:fromAPIMethod:' проверяет ответы по политике API метода: каждый, один из N,
+      только при изменившейся структуре или никакие. Конкретные методы валидации политику не учитывают.
+ (⚠️) В фоновом режиме валидация API метода не блокирует маппер и completion.
+      Расхождение со схемой сообщается через 'validationDriftHandler' и счетчики вместо ошибки.
+ (⚠️) Ошибки автоматической валидации записываются как объекты 'ValidationIssue'. Сообщения 'userInfoArray'
+      форматируются только при чтении. Проблемы считаются по видам, см. '+validationIssueCountOfKind:'.
  --------------------------------------------------------------------------------------------------------------*/
 
 
@@ -60,6 +151,45 @@ typedef NS_OPTIONS(NSUInteger, ResponseValidationMask) {
 
 
 
+#pragma mark - Validation Policy
+/*--------------------------------------------------------------------------------------------------------------
+ Устанавливает политику валидации API метода для '+validateResponse:fromAPIMethod:'. По умолчанию 'ValidationPolicy_Full'.
+ После ошибки выборочной валидации API метод полностью проверяется следующие 'validationEscalationLength'
+ ответов, независимо от политики.
+ --------------------------------------------------------------------------------------------------------------*/
++ (void) setValidationPolicy:(ValidationPolicy)policy forAPIMethod:(APIMethod)method;
++ (ValidationPolicy) validationPolicyForAPIMethod:(APIMethod)method;
+
+/*--------------------------------------------------------------------------------------------------------------
+ Возвращает 'YES', пока API метод полностью проверяется после ошибки.
+ --------------------------------------------------------------------------------------------------------------*/
++ (BOOL) isValidationEscalatedForAPIMethod:(APIMethod)method;
+
+@property (class, nonatomic, assign) NSUInteger validationSampleRate;        // по умолчанию 20 (один из 20 ответов)
+@property (class, nonatomic, assign) NSUInteger validationEscalationLength;  // по умолчанию 50 ответов
+
+
+
+#pragma mark - Background Validation
+/*--------------------------------------------------------------------------------------------------------------
+ Проверяет ответы API метода на 'backgroundValidationQueue' (QOS_CLASS_UTILITY).
+ '+validateResponse:fromAPIMethod:' сразу возвращает 'nil', маппинг и доставка не ждут валидации.
+ Ошибки не проваливают запрос: они учитываются в счетчиках и передаются в 'validationDriftHandler'. По умолчанию 'NO'.
+ --------------------------------------------------------------------------------------------------------------*/
++ (void) setAsynchronousValidation:(BOOL)isAsynchronous forAPIMethod:(APIMethod)method;
++ (BOOL) isAsynchronousValidationForAPIMethod:(APIMethod)method;
+
+/*--------------------------------------------------------------------------------------------------------------
+ Счетчики фоновой валидации: обработанные ответы и ответы, не прошедшие валидацию.
+ --------------------------------------------------------------------------------------------------------------*/
++ (NSUInteger) backgroundValidationCountForAPIMethod:(APIMethod)method;
++ (NSUInteger) driftCountForAPIMethod:(APIMethod)method;
+
+@property (class, nonatomic, copy, nullable) ValidationDriftHandler validationDriftHandler;
+@property (class, nonatomic, readonly, strong) dispatch_queue_t backgroundValidationQueue;
+
+
+
 #pragma mark - Automatic Validation (for pair json + template)
 /*--------------------------------------------------------------------------------------------------------------
  Метод автоматической валидации сверяет пришедший json и образец с диска.
@@ -79,6 +209,17 @@ typedef NS_OPTIONS(NSUInteger, ResponseValidationMask) {
                                   validationMask:(ResponseValidationMask)mask
                                    fromAPIMethod:(APIMethod)method;
 
+/*--------------------------------------------------------------------------------------------------------------
+ Количество невалидных элементов, после которого проверка массива останавливается ('CheckArrayElements'). По умолчанию 10.
+ --------------------------------------------------------------------------------------------------------------*/
+@property (class, nonatomic, assign) NSUInteger arrayValidationErrorLimit;
+
+/*--------------------------------------------------------------------------------------------------------------
+ Количество проблем данного вида, найденных автоматической валидацией с запуска или последнего сброса.
+ --------------------------------------------------------------------------------------------------------------*/
++ (NSUInteger) validationIssueCountOfKind:(ValidationIssueKind)kind;
++ (void) resetValidationIssueCounters;
+
 
 
 
@@ -104,6 +245,19 @@ typedef NS_OPTIONS(NSUInteger, ResponseValidationMask) {
  --------------------------------------------------------------------------------------------------------------*/
 + (NSError* _Nullable) validateResponseFrom_friendsGet:(NSDictionary*)recievedJSON;
 
+
+
+#pragma mark - Benchmark
+
+#if DEBUG
+/*--------------------------------------------------------------------------------------------------------------
+ Валидирует синтетический ответ 'wall.get' со 100 постами 'iterations' раз: без скомпилированного плана,
+ с планом и с планом и отпечатками прошедших структур.
+ Выводит в консоль время на один ответ.
+ --------------------------------------------------------------------------------------------------------------*/
++ (void) benchmarkValidation:(NSUInteger)iterations;
+#endif
+
 @end
 
 
@@ -165,6 +319,7 @@ typedef NS_OPTIONS(NSUInteger, ResponseValidationMask) {
   👉🏻 "lengthMustBeEqualOrLessThan"    - Длина значения в json должна быть меньше или равна этой цифре.
   👉🏻 "hasSuffix"                      - Значение в json должно содержать данный суффикс.
   👉🏻 "matchWithOneOf"                 - Значение в json должно быть индентичным одному из объектов в массиве.
+  👉🏻 "matchesPattern"                 - Значение в json целиком должно совпадать с этим регулярным выражением.
  
  
   Пример:
@@ -9,8 +9,12 @@
 #import "Validator.h"
 // APIManager's Categories
 #import "APIManager+Utilites.h"
+// Свойства API методов
+#import "APIMethodRegistry.h"
 // Восстанавливает с диска json файлы по ключам APIMethod
 #import "Templater.h"
+// System
+#import <stdatomic.h>
 
 
 /*--------------------------------------------------------------------------------------------------------------
@@ -27,6 +31,7 @@ NSString * const lengthMustBeEqualOrGreaterThanKey = @"lengthMustBeEqualOrGreate
 NSString * const lengthMustBeEqualOrLessThanKey    = @"lengthMustBeEqualOrLessThan";
 NSString * const hasSuffixKey                      = @"hasSuffix";
 NSString * const matchWithOneOfKey                 = @"matchWithOneOf";
+NSString * const matchesPatternKey                 = @"matchesPattern";
 
 // For Arrays
 NSString * const elementsMustBeEqualOrMoreThanKey  = @"elementsMustBeEqualOrMoreThan";
@@ -43,7 +48,8 @@ NSString * const maximumKey  = @"maximum";
  ---------------------------------------------------------------------------------------------------------------
  
  1. Добавьте новый ключ как константу в шапке файла.
- 2. Добавьте обработку новых ключей в методы валидации разных типов:
+ 2. Прочитайте ключ в 'ValidationRules' в 'ValidationRulesCompile()'. Она вызывается один раз на шаблон.
+ 3. Добавьте обработку новых ключей в методы валидации разных типов:
      +validateString:
      +validateArray:
      +validateDictionary:
@@ -63,10 +69,582 @@ NSString * const maximumKey  = @"maximum";
  
  3. Предварительно добавив значение для нового API метода в перечисление APIMethod.
  
- 4. В методе +validateResponse:fromAPIMethod: добавьте свой метод валидации в конструкцию switch.
+ 4. Добавьте имя своего метода валидации в строку API метода в 'APIMethodRegistry.m'.
  --------------------------------------------------------------------------------------------------------------*/
 
 
+#pragma mark - Validation Plans
+
+/*--------------------------------------------------------------------------------------------------------------
+ Теги типов значений. Заменяют сравнение имен суперклассов: один 'isKindOfClass:' вместо
+ 'NSStringFromClass' и сравнения строк для каждого значения.
+ --------------------------------------------------------------------------------------------------------------*/
+static inline ValidationValueType ValidationTypeOf(id _Nullable value)
+{
+    if (!value) return ValidationValueType_None;
+    if ([value isKindOfClass:[NSString class]])     return ValidationValueType_String;
+    if ([value isKindOfClass:[NSNumber class]])     return ValidationValueType_Number;
+    if ([value isKindOfClass:[NSDictionary class]]) return ValidationValueType_Dictionary;
+    if ([value isKindOfClass:[NSArray class]])      return ValidationValueType_Array;
+    if ([value isKindOfClass:[NSNull class]])       return ValidationValueType_Null;
+    return ValidationValueType_Other;
+}
+
+static NSString* ValidationTypeName(ValidationValueType type)
+{
+    switch (type) {
+        case ValidationValueType_None:       return @"(null)";
+        case ValidationValueType_String:     return @"NSString";
+        case ValidationValueType_Number:     return @"NSNumber";
+        case ValidationValueType_Array:      return @"NSArray";
+        case ValidationValueType_Dictionary: return @"NSDictionary";
+        case ValidationValueType_Null:       return @"NSNull";
+        default:                             return @"NSObject";
+    }
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ 'mustMatch' массивов: строки 'jsonArray' сравниваются со строками шаблона в нижнем регистре
+ без учета регистра. Остальные элементы пропускаются. Ничего не аллоцируется.
+ --------------------------------------------------------------------------------------------------------------*/
+static BOOL ValidationStringsMatchIgnoringCase(NSArray* jsonArray, NSArray<NSString*>* lowercaseTemplate)
+{
+    NSUInteger index = 0;
+    for (id value in jsonArray){
+        if (![value isKindOfClass:[NSString class]]) continue;
+        if ((index >= lowercaseTemplate.count) ||
+            ([value caseInsensitiveCompare:lowercaseTemplate[index]] != NSOrderedSame)) return NO;
+        index++;
+    }
+    return (index == lowercaseTemplate.count);
+}
+
+
+/*--------------------------------------------------------------------------------------------------------------
+ 'ValidationRules' - словарь '<key>-Rules', скомпилированный в типизированные поля.
+ Словарь читается один раз, при компиляции плана: значения для 'mustMatch' очищаются от правил и приводятся
+ к нижнему регистру, 'matchWithOneOf' становится множеством строк в нижнем регистре, 'matchesPattern' -
+ скомпилированным регулярным выражением. Проверка значения по правилам ничего не аллоцирует, пока правило не нарушено.
+ --------------------------------------------------------------------------------------------------------------*/
+@interface ValidationRules : NSObject
+@property (nonatomic, assign) BOOL isOptional;
+@property (nonatomic, assign) BOOL mustMatch;
+@property (nonatomic, assign) BOOL equalInLength;
+// Значение шаблона, подготовленное для 'mustMatch': строки массива в нижнем регистре, словарь без правил
+@property (nonatomic, strong, nullable) id mustMatchValue;
+// Границы в том виде, в каком они записаны в шаблоне. Они же 'limit' проблем
+@property (nonatomic, strong, nullable) NSNumber* lengthMin;
+@property (nonatomic, strong, nullable) NSNumber* lengthMax;
+@property (nonatomic, strong, nullable) NSNumber* elementsMin;
+@property (nonatomic, strong, nullable) NSNumber* elementsMax;
+@property (nonatomic, strong, nullable) NSNumber* minimum;
+@property (nonatomic, strong, nullable) NSNumber* maximum;
+// 'lengthMin > lengthMax' или 'minimum > maximum'. По таким границам значение не проверяется
+@property (nonatomic, assign) BOOL hasInvalidLength;
+@property (nonatomic, assign) BOOL hasInvalidRange;
+@property (nonatomic, strong, nullable) NSString* hasSuffix;
+@property (nonatomic, strong, nullable) NSArray*  matchWithOneOf;
+@property (nonatomic, strong, nullable) NSSet<NSString*>* matchWithOneOfSet;
+// 'patternExpression' равен nil, если 'pattern' - невалидное регулярное выражение
+@property (nonatomic, strong, nullable) NSString* pattern;
+@property (nonatomic, strong, nullable) NSRegularExpression* patternExpression;
+@end
+
+@implementation ValidationRules
+@end
+
+
+@interface Validator ()
+// Хелперы. Вызываются один раз, при компиляции правил
++ (NSArray*) lowercaseArray:(NSArray*)array;
++ (NSDictionary* _Nullable) removeAllRulesFromDictionaryAndNastedStructure:(NSDictionary*)dictionary;
+@end
+
+
+// Скомпилированные регулярные выражения по их шаблонам. 'NSNull' - шаблон невалиден
+static NSMutableDictionary<NSString*,id>* _patternExpressions = nil;
+
+static NSRegularExpression* _Nullable ValidationPatternExpression(NSString* pattern)
+{
+    @synchronized ([NSNotificationCenter defaultCenter]){
+        if (!_patternExpressions) _patternExpressions = [NSMutableDictionary new];
+
+        id expression = _patternExpressions[pattern];
+        if (!expression){
+            expression = [NSRegularExpression regularExpressionWithPattern:pattern options:0 error:nil] ?: [NSNull null];
+            _patternExpressions[pattern] = expression;
+        }
+        return (expression == [NSNull null]) ? nil : expression;
+    }
+}
+
+static NSNumber* _Nullable ValidationRuleNumber(NSDictionary* rules, NSString* key)
+{
+    id value = rules[key];
+    if ([value isKindOfClass:[NSNumber class]]) return value;
+    if ([value isKindOfClass:[NSString class]]) return @([value doubleValue]);
+    return nil;
+}
+
+static ValidationRules* ValidationRulesCompile(NSDictionary* rules, id templateValue)
+{
+    ValidationRules* compiled = [ValidationRules new];
+    compiled.isOptional    = [rules[isOptionalKey]    boolValue];
+    compiled.mustMatch     = [rules[mustMatchKey]     boolValue];
+    compiled.equalInLength = [rules[equalInLengthKey] boolValue];
+
+    compiled.lengthMin   = ValidationRuleNumber(rules, lengthMustBeEqualOrGreaterThanKey);
+    compiled.lengthMax   = ValidationRuleNumber(rules, lengthMustBeEqualOrLessThanKey);
+    compiled.elementsMin = ValidationRuleNumber(rules, elementsMustBeEqualOrMoreThanKey);
+    compiled.elementsMax = ValidationRuleNumber(rules, elementsMustBeEqualOrLessThanKey);
+    compiled.minimum     = ValidationRuleNumber(rules, minimumKey);
+    compiled.maximum     = ValidationRuleNumber(rules, maximumKey);
+
+    compiled.hasInvalidLength = (compiled.lengthMin) && (compiled.lengthMax) &&
+                                ([compiled.lengthMin integerValue] > [compiled.lengthMax integerValue]);
+    compiled.hasInvalidRange  = (compiled.minimum) && (compiled.maximum) &&
+                                ([compiled.minimum floatValue] > [compiled.maximum floatValue]);
+
+    NSString* hasSuffix = rules[hasSuffixKey];
+    if ([hasSuffix isKindOfClass:[NSString class]]) compiled.hasSuffix = hasSuffix;
+
+    NSArray* matchWithOneOf = rules[matchWithOneOfKey];
+    if (([matchWithOneOf isKindOfClass:[NSArray class]]) && (matchWithOneOf.count > 0)){
+        compiled.matchWithOneOf    = matchWithOneOf;
+        compiled.matchWithOneOfSet = [NSSet setWithArray:[Validator lowercaseArray:matchWithOneOf]];
+    }
+
+    NSString* pattern = rules[matchesPatternKey];
+    if ([pattern isKindOfClass:[NSString class]]){
+        compiled.pattern           = pattern;
+        compiled.patternExpression = ValidationPatternExpression(pattern);
+    }
+
+    if (compiled.mustMatch){
+        switch (ValidationTypeOf(templateValue)) {
+            case ValidationValueType_Array:
+                compiled.mustMatchValue = [Validator lowercaseArray:templateValue];
+                break;
+            case ValidationValueType_Dictionary:
+                compiled.mustMatchValue = [Validator removeAllRulesFromDictionaryAndNastedStructure:templateValue];
+                break;
+            default:
+                compiled.mustMatchValue = templateValue;
+                break;
+        }
+    }
+    return compiled;
+}
+
+
+/*--------------------------------------------------------------------------------------------------------------
+ 'ValidationPlanEntry' - один ключ шаблона со всем, что нужно для его проверки.
+ --------------------------------------------------------------------------------------------------------------*/
+@class ValidationPlan;
+
+@interface ValidationPlanEntry : NSObject
+@property (nonatomic, strong) NSString* key;
+@property (nonatomic, strong) id        templateValue;
+@property (nonatomic, assign) ValidationValueType type;
+// Словарь '<key>-Rules' из шаблона, если он есть
+@property (nonatomic, strong, nullable) ValidationRules* rules;
+@property (nonatomic, assign)           BOOL            isOptional;
+// План вложенного словаря, если значение шаблона - непустой словарь
+@property (nonatomic, strong, nullable) ValidationPlan* subPlan;
+// У ключа или его вложенных словарей есть правила
+@property (nonatomic, assign)           BOOL            hasRules;
+// Тип и план первого элемента массива шаблона. По ним проверяются все элементы полученного массива
+@property (nonatomic, assign)           ValidationValueType elementType;
+@property (nonatomic, strong, nullable) ValidationPlan*     elementPlan;
+@end
+
+@implementation ValidationPlanEntry
+@end
+
+
+/*--------------------------------------------------------------------------------------------------------------
+ 'ValidationPlan' - шаблон, скомпилированный в плоский упорядоченный список ключей.
+ Шаблон обходится один раз, при компиляции плана. Затем каждый ответ проверяется по списку за один проход:
+ каждый ключ ищется в ответе по хэшу, без перебора массива его ключей.
+ --------------------------------------------------------------------------------------------------------------*/
+@interface ValidationPlan : NSObject
+@property (nonatomic, strong) NSArray<ValidationPlanEntry*>* entries;
+@property (nonatomic, assign) BOOL hasRules;
+// Отпечатки ответов (смешанные с маской), прошедших все структурные проверки плана.
+// Первым идет тот, что прошел проверку раньше всех
+@property (nonatomic, strong) NSMutableOrderedSet<NSNumber*>* passedShapes;
+@end
+
+@implementation ValidationPlan
+@end
+
+
+static ValidationPlan* ValidationPlanCompile(NSDictionary* templateJSON)
+{
+    NSMutableArray<ValidationPlanEntry*>* entries = [NSMutableArray arrayWithCapacity:templateJSON.count];
+    BOOL hasRules = NO;
+
+    for (NSString* key in templateJSON)
+    {
+        if ([key hasSuffix:@"-Rules"]) continue;
+
+        ValidationPlanEntry* entry = [ValidationPlanEntry new];
+        entry.key           = key;
+        entry.templateValue = templateJSON[key];
+        entry.type          = ValidationTypeOf(entry.templateValue);
+
+        NSDictionary* rules = templateJSON[str(@"%@-Rules",key)];
+        if (([rules isKindOfClass:[NSDictionary class]]) && (rules.count > 0)){
+            entry.rules      = ValidationRulesCompile(rules, entry.templateValue);
+            entry.isOptional = entry.rules.isOptional;
+        }
+        if ((entry.type == ValidationValueType_Dictionary) && ([entry.templateValue count] > 0)){
+            entry.subPlan = ValidationPlanCompile(entry.templateValue);
+        }
+        if ((entry.type == ValidationValueType_Array) && ([entry.templateValue count] > 0)){
+            id element = [entry.templateValue firstObject];
+            entry.elementType = ValidationTypeOf(element);
+            if ((entry.elementType == ValidationValueType_Dictionary) && ([element count] > 0)){
+                entry.elementPlan = ValidationPlanCompile(element);
+            }
+        }
+        entry.hasRules = (entry.rules) || (entry.subPlan.hasRules) || (entry.elementPlan.hasRules);
+        hasRules = hasRules || entry.hasRules;
+        [entries addObject:entry];
+    }
+
+    ValidationPlan* plan = [ValidationPlan new];
+    plan.entries      = entries;
+    plan.hasRules     = hasRules;
+    plan.passedShapes = [NSMutableOrderedSet new];
+    return plan;
+}
+
+// Массивы короче этого проверяются на вызывающем потоке
+#define parallelElementsThreshold 512
+// Наименьшая часть массива, проверяемая одним потоком
+#define minElementsPerChunk       128
+#define defaultArrayValidationErrorLimit 10
+
+static NSUInteger _arrayValidationErrorLimit = defaultArrayValidationErrorLimit;
+
+// Отпечатки, которые запоминает один план. Первым забывается тот, что дольше всех не встречался
+#define maxPassedShapes 16
+
+// Скомпилированные планы. Ключи - сами шаблоны (по адресу), хранятся слабо
+static NSMapTable<NSDictionary*,ValidationPlan*>* _plans = nil;
+
+
+#pragma mark - Validation Issues
+
+/*--------------------------------------------------------------------------------------------------------------
+ 'ValidationElementPath' - один шаг пути к невалидному элементу массива ('items[12]').
+ Создается только для элементов, у которых есть проблемы.
+ --------------------------------------------------------------------------------------------------------------*/
+@interface ValidationElementPath : NSObject
+@property (nonatomic, strong) NSString*   key;
+@property (nonatomic, assign) NSUInteger  index;
+// Путь внутри элемента, если проблема во вложенном массиве
+@property (nonatomic, strong, nullable) ValidationElementPath* next;
+@end
+
+@implementation ValidationElementPath
+@end
+
+
+@interface ValidationIssue ()
+@property (nonatomic, assign, readwrite) ValidationIssueKind kind;
+@property (nonatomic, strong, readwrite, nullable) NSString* key;
+@property (nonatomic, strong, readwrite, nullable) NSString* rule;
+@property (nonatomic, assign, readwrite) ValidationValueType expectedType;
+@property (nonatomic, assign, readwrite) ValidationValueType actualType;
+@property (nonatomic, strong, readwrite, nullable) id value;
+@property (nonatomic, strong, readwrite, nullable) id limit;
+@property (nonatomic, strong, nullable) ValidationElementPath* elementPath;
+@end
+
+
+/*--------------------------------------------------------------------------------------------------------------
+ Записывает проблему, ничего не форматируя. 'key' и 'rule' - строки шаблона и констант,
+ поэтому проблема хранит только указатели на существующие объекты.
+ --------------------------------------------------------------------------------------------------------------*/
+static ValidationIssue* ValidationIssueMake(ValidationIssueKind kind, NSString* _Nullable key, NSString* _Nullable rule,
+                                            id _Nullable value, id _Nullable limit)
+{
+    ValidationIssue* issue = [ValidationIssue new];
+    issue.kind       = kind;
+    issue.key        = key;
+    issue.rule       = rule;
+    issue.value      = value;
+    issue.limit      = limit;
+    issue.actualType = ValidationTypeOf(value);
+    return issue;
+}
+
+static ValidationIssue* ValidationTypeIssueMake(NSString* _Nullable key, ValidationValueType actualType, ValidationValueType expectedType)
+{
+    ValidationIssue* issue = [ValidationIssue new];
+    issue.kind         = ValidationIssueKind_TypeMismatch;
+    issue.key          = key;
+    issue.actualType   = actualType;
+    issue.expectedType = expectedType;
+    return issue;
+}
+
+
+@implementation ValidationIssue
+
+- (nullable NSString*) keyPath
+{
+    if (!self.elementPath) return nil;
+
+    NSMutableString* keyPath = [NSMutableString new];
+    for (ValidationElementPath* step = self.elementPath; step; step = step.next){
+        if (keyPath.length > 0) [keyPath appendString:@"."];
+        [keyPath appendFormat:@"%@[%lu]",step.key,(unsigned long)step.index];
+    }
+    return keyPath;
+}
+
+- (NSString*) message
+{
+    NSString* message = nil;
+    NSString* key     = self.key;
+
+    switch (self.kind) {
+        case ValidationIssueKind_MissingKey:
+            message = str(@"json hasn't '%@' key",key);
+            break;
+        case ValidationIssueKind_TypeMismatch:
+            message = (key) ? str(@"Value for key '%@' in recievedJSON has class (%@)\n"
+                                  "Value for key '%@' in templateJSON has class (%@).",
+                                  key,ValidationTypeName(self.actualType),key,ValidationTypeName(self.expectedType))
+                            : str(@"Element has class (%@), element of templateJSON has class (%@).",
+                                  ValidationTypeName(self.actualType),ValidationTypeName(self.expectedType));
+            break;
+        case ValidationIssueKind_RuleViolation:
+            message = [self ruleViolationMessage];
+            break;
+        case ValidationIssueKind_InvalidRules:
+            if ([self.rule isEqualToString:minimumKey])
+                message = str(@"Invalid rules (minimum (cannot be greater than)> maximum) in key(%@))",key);
+            else if ([self.rule isEqualToString:matchesPatternKey])
+                message = str(@"Invalid rules (matchesPattern (%@) is not a regular expression) in key(%@)",self.limit,key);
+            else
+                message = str(@"Invalid rules (lengthMustBeEqualOrGreaterThan (cannot be greater than)> lengthMustBeEqualOrLessThan) in key(%@) value(%@)",key,self.value);
+            break;
+        case ValidationIssueKind_InvalidParams:
+            message = str(@"One of params (in +validateJSONValue:...) is nil. By key (%@)",key);
+            break;
+        case ValidationIssueKind_ArrayCheckStopped:
+            message = str(@"Check of '%@' was stopped after %@ invalid elements of %@",key,self.value,self.limit);
+            break;
+        default:
+            message = str(@"Unknown issue by key(%@)",key);
+            break;
+    }
+
+    NSString* keyPath = self.keyPath;
+    return (keyPath) ? str(@"%@: %@",keyPath,message) : message;
+}
+
+- (NSString*) ruleViolationMessage
+{
+    NSString* key  = self.key;
+    NSString* rule = self.rule;
+
+    if ([rule isEqualToString:hasSuffixKey])
+        return str(@"The value(%@) by key(%@) hasn't requiered suffix(%@)",self.value,key,self.limit);
+    if ([rule isEqualToString:matchWithOneOfKey])
+        return str(@"The value(%@) by key(%@) not found in the allowed array(%@))",self.value,key,self.limit);
+    if ([rule isEqualToString:matchesPatternKey])
+        return str(@"The value(%@) by key(%@) does not match the pattern(%@)",self.value,key,self.limit);
+    if (([rule isEqualToString:mustMatchKey]) && (self.actualType == ValidationValueType_Number))
+        return str(@"Number by key(%@) from json not matches with templete value(%@))",key,self.limit);
+    if (([rule isEqualToString:mustMatchKey]) && (self.actualType == ValidationValueType_Dictionary))
+        return str(@"The value by key(%@) not match with required=(%@)",key,self.limit);
+    if ([rule isEqualToString:mustMatchKey])
+        return str(@"The value by key(%@) not match with required=%@)",key,self.limit);
+    if ([rule isEqualToString:equalInLengthKey])
+        return str(@"The length of values for key(%@) does not match",key);
+    if ([rule isEqualToString:lengthMustBeEqualOrGreaterThanKey])
+        return str(@"The length of the key(%@) value is less than the required length. Must be greater than %@",key,self.limit);
+    if ([rule isEqualToString:lengthMustBeEqualOrLessThanKey])
+        return str(@"The length of the key(%@) value is greater than the required length. Must be less than %@",key,self.limit);
+    if ([rule isEqualToString:elementsMustBeEqualOrMoreThanKey])
+        return str(@"Array by key(%@) from json has less elements than required(%@)",key,self.limit);
+    if ([rule isEqualToString:elementsMustBeEqualOrLessThanKey])
+        return str(@"Array by key(%@) from json has greater elements than required(%@)",key,self.limit);
+    if ([rule isEqualToString:minimumKey])
+        return str(@"Number by key(%@) from json has value(%f). But mandatory minimum is (%f))",key,[self.value floatValue],[self.limit floatValue]);
+    if ([rule isEqualToString:maximumKey])
+        return str(@"Number by key(%@) from json has value(%f). But mandatory maximum is (%f))",key,[self.value floatValue],[self.limit floatValue]);
+
+    return str(@"The value by key(%@) does not satisfy the rule (%@)",key,rule);
+}
+
+@end
+
+
+/*--------------------------------------------------------------------------------------------------------------
+ 'ValidationIssueMessages' - массив сообщений проблем (userInfo[@"userInfoArray"]).
+ Сообщение форматируется только при чтении.
+ --------------------------------------------------------------------------------------------------------------*/
+@interface ValidationIssueMessages : NSArray
+@property (nonatomic, strong) NSArray<ValidationIssue*>* issues;
+@end
+
+@implementation ValidationIssueMessages
+
+- (NSUInteger) count
+{
+    return self.issues.count;
+}
+
+- (id) objectAtIndex:(NSUInteger)index
+{
+    return self.issues[index].message;
+}
+
+@end
+
+
+static NSUInteger _validationIssueCounters[ValidationIssueKindCount] = {0};
+
+
+
+#pragma mark - Validation Policies
+
+#define defaultValidationSampleRate       20
+#define defaultValidationEscalationLength 50
+
+static inline NSUInteger ValidationMix(NSUInteger value)
+{
+    value = (value ^ (value >> 31)) * 0x7fb5d329728ea185ULL;
+    return value ^ (value >> 27);
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ Структурный отпечаток значения: ключи и теги типов всех вложенных словарей за один проход.
+ Сами значения не учитываются, поэтому у ответов с одинаковой структурой одинаковый отпечаток.
+ --------------------------------------------------------------------------------------------------------------*/
+static NSUInteger ValidationShapeFingerprint(id _Nullable value)
+{
+    ValidationValueType type = ValidationTypeOf(value);
+    NSUInteger fingerprint   = ValidationMix(type + 1);
+
+    if (type == ValidationValueType_Dictionary){
+        // Порядок ключей в 'NSDictionary' не определен, поэтому перемешанные пары суммируются
+        for (NSString* key in (NSDictionary*)value){
+            fingerprint += ValidationMix(key.hash ^ (ValidationShapeFingerprint(value[key]) * 31));
+        }
+    } else if ((type == ValidationValueType_Array) && ([value count] > 0)){
+        // Проверяются все элементы, поэтому учитывается каждый из них. Каждая отличающаяся структура учитывается один раз:
+        // у массивов разной длины с одинаковыми элементами одинаковый отпечаток
+        NSUInteger firstShape = ValidationShapeFingerprint([value firstObject]);
+        NSMutableSet<NSNumber*>* otherShapes = nil;
+        for (id element in (NSArray*)value){
+            NSUInteger shape = ValidationShapeFingerprint(element);
+            if (shape == firstShape) continue;
+            if (!otherShapes) otherShapes = [NSMutableSet new];
+            [otherShapes addObject:@(shape)];
+        }
+        fingerprint = ValidationMix(fingerprint ^ firstShape);
+        for (NSNumber* shape in otherShapes){
+            fingerprint += ValidationMix(shape.unsignedIntegerValue);
+        }
+    }
+    return fingerprint;
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ Структурный отпечаток ответа по ключам, описанным в плане: их теги типов, вложенные словари
+ и различные формы элементов массивов. Ключи, которых нет в шаблоне, не проверяются,
+ поэтому они не меняют отпечаток.
+ --------------------------------------------------------------------------------------------------------------*/
+static NSUInteger ValidationPlanShapeFingerprint(ValidationPlan* plan, id _Nullable value)
+{
+    ValidationValueType type = ValidationTypeOf(value);
+    NSUInteger fingerprint   = ValidationMix(type + 1);
+    if (type != ValidationValueType_Dictionary) return fingerprint;
+
+    for (ValidationPlanEntry* entry in plan.entries)
+    {
+        id         valueOfKey = ((NSDictionary*)value)[entry.key];
+        NSUInteger shape      = ValidationMix(ValidationTypeOf(valueOfKey) + 1);
+
+        if ((entry.subPlan) && ([valueOfKey isKindOfClass:[NSDictionary class]])){
+            shape = ValidationPlanShapeFingerprint(entry.subPlan, valueOfKey);
+        }
+        // Элементы проверяются только по первому элементу массива шаблона
+        else if ((entry.elementType != ValidationValueType_None) && ([valueOfKey isKindOfClass:[NSArray class]]) && ([valueOfKey count] > 0))
+        {
+            // Каждая различная форма элементов учитывается один раз, как в 'ValidationShapeFingerprint'
+            NSUInteger firstShape = (entry.elementPlan) ? ValidationPlanShapeFingerprint(entry.elementPlan, [valueOfKey firstObject]) :
+                                                          ValidationMix(ValidationTypeOf([valueOfKey firstObject]) + 1);
+            NSMutableSet<NSNumber*>* otherShapes = nil;
+            for (id element in (NSArray*)valueOfKey){
+                NSUInteger elementShape = (entry.elementPlan) ? ValidationPlanShapeFingerprint(entry.elementPlan, element) :
+                                                                ValidationMix(ValidationTypeOf(element) + 1);
+                if (elementShape == firstShape) continue;
+                if (!otherShapes) otherShapes = [NSMutableSet new];
+                [otherShapes addObject:@(elementShape)];
+            }
+            shape = ValidationMix(shape ^ firstShape);
+            for (NSNumber* otherShape in otherShapes){
+                shape += ValidationMix(otherShape.unsignedIntegerValue);
+            }
+        }
+        fingerprint += ValidationMix(entry.key.hash ^ (shape * 31));
+    }
+    return fingerprint;
+}
+
+// Отпечаток, посчитанный политикой валидации и переданный в '+automaticValidateResponse:...' того же потока
+typedef struct {
+    const void* response;
+    const void* plan;
+    NSUInteger  shape;
+} ValidationKnownShape;
+
+static __thread ValidationKnownShape _knownShape;
+
+
+/*--------------------------------------------------------------------------------------------------------------
+ 'ValidationPolicyState' - политика валидации одного API метода и нужные ей счетчики.
+ --------------------------------------------------------------------------------------------------------------*/
+@interface ValidationPolicyState : NSObject
+@property (nonatomic, assign) ValidationPolicy policy;
+// Количество ответов, полученных при 'ValidationPolicy_Sampled'
+@property (nonatomic, assign) NSUInteger responseCounter;
+// Сколько ответов осталось полностью проверить после ошибки
+@property (nonatomic, assign) NSUInteger escalatedResponses;
+// Отпечаток последнего ответа, прошедшего валидацию
+@property (nonatomic, assign) NSUInteger validShape;
+@property (nonatomic, assign) BOOL       hasValidShape;
+// Ответы проверяются на 'backgroundValidationQueue', вызывающий не ждет результата
+@property (nonatomic, assign) BOOL       isAsynchronous;
+@property (nonatomic, assign) NSUInteger backgroundValidations;
+@property (nonatomic, assign) NSUInteger driftedResponses;
+@end
+
+@implementation ValidationPolicyState
+@end
+
+
+static NSUInteger _validationSampleRate       = defaultValidationSampleRate;
+static NSUInteger _validationEscalationLength = defaultValidationEscalationLength;
+static NSMutableDictionary<NSNumber*,ValidationPolicyState*>* _validationPolicies = nil;
+
+// Ответы, ожидающие фоновой валидации. Сверх лимита новые отбрасываются
+#define maxPendingBackgroundValidations 32
+
+static dispatch_queue_t       _backgroundValidationQueue    = nil;
+static NSUInteger             _pendingBackgroundValidations = 0;
+static ValidationDriftHandler _validationDriftHandler       = nil;
+
+
+
 @implementation Validator
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -94,16 +672,38 @@ NSString * const maximumKey  = @"maximum";
  --------------------------------------------------------------------------------------------------------------*/
 + (NSError* _Nullable) validateResponse:(NSDictionary*)recievedJSON fromAPIMethod:(APIMethod)method
 {
-    NSError* error  = nil;
-    switch (method) {
-        case APIMethod_UserGet: error = [Validator validateResponseFrom_usersGet:recievedJSON]; break;
-        case APIMethod_WallGet: error = [Validator validateResponseFrom_wallGet:recievedJSON];  break;
-      
-        case APIMethod_PhotosGetAll: error = [Validator validateResponseFrom_photosGetAll:recievedJSON];  break;
-        case APIMethod_FriendsGet:   error = [Validator validateResponseFrom_friendsGet:recievedJSON];    break;
-            
-        default: APILog(@"+validateResponse:fromAPIMethod: | Switch not found mathes!"); break;
+    SEL validator = APIMethodResponseValidator(method);
+    if (!validator){
+        APILog(@"+validateResponse:fromAPIMethod: | Validation method is not registered for '%@'",[APIManager convertAPIMethodToString:method]);
+        return nil;
+    }
+
+    // Маппинг и доставка не ждут: ошибка передается в 'validationDriftHandler'
+    if ([Validator isAsynchronousValidationForAPIMethod:method]){
+        [Validator validateInBackgroundResponse:recievedJSON fromAPIMethod:method validator:validator];
+        return nil;
+    }
+    return [Validator validateResponse:recievedJSON fromAPIMethod:method validator:validator];
+}
+
+
+/*--------------------------------------------------------------------------------------------------------------
+ [Internal method]
+ Вызывает метод валидации API метода согласно его политике валидации.
+ --------------------------------------------------------------------------------------------------------------*/
++ (NSError* _Nullable) validateResponse:(NSDictionary*)recievedJSON fromAPIMethod:(APIMethod)method validator:(SEL)validator
+{
+    NSUInteger shape = 0;
+    NSError*   error = nil;
+    if ([Validator shouldValidateResponse:recievedJSON fromAPIMethod:method shape:&shape])
+    {
+        NSError* (*validate)(id, SEL, NSDictionary*) = (void*)[Validator methodForSelector:validator];
+        error = validate([Validator class], validator, recievedJSON);
+
+        [Validator recordValidationError:error fromAPIMethod:method shape:shape];
     }
+    // Отпечаток относится только к этому ответу
+    _knownShape = (ValidationKnownShape){ 0 };
     return error;
 }
 
@@ -129,6 +729,18 @@ NSString * const maximumKey  = @"maximum";
 
 #pragma mark - Specific Validation Methods (for specific API methods)
 
+/*--------------------------------------------------------------------------------------------------------------
+ [Internal method]
+ Возвращает маску валидации API метода: 'AllChecks' и 'CheckArrayElements', если этого требует реестр.
+ --------------------------------------------------------------------------------------------------------------*/
++ (ResponseValidationMask) validationMaskForAPIMethod:(APIMethod)method
+{
+    ResponseValidationMask mask = AllChecks;
+    if (APIMethodInfoFor(method)->checksArrayElements) mask |= CheckArrayElements;
+    return mask;
+}
+
+
 /*--------------------------------------------------------------------------------------------------------------
  Метод валидирует ответ сервера на запрос метода "users.get".
  ------------------------------------------------------------
@@ -143,7 +755,7 @@ NSString * const maximumKey  = @"maximum";
     
     NSError* error = [Validator automaticValidateResponse:recievedJSON
                                                  template:template
-                                           validationMask:AllChecks
+                                           validationMask:[Validator validationMaskForAPIMethod:APIMethod_UserGet]
                                             fromAPIMethod:APIMethod_UserGet];
     return error;
 }
@@ -151,6 +763,7 @@ NSString * const maximumKey  = @"maximum";
 
 /*--------------------------------------------------------------------------------------------------------------
  Метод валидирует ответ сервера на запрос метода "wall.get".
+ Каждый пост в 'items' проверяется по первому посту шаблона.
  --------------------------------------------------------------------------------------------------------------*/
 + (NSError* _Nullable) validateResponseFrom_wallGet:(NSDictionary*)recievedJSON
 {
@@ -159,7 +772,7 @@ NSString * const maximumKey  = @"maximum";
     
     NSError* error = [Validator automaticValidateResponse:recievedJSON
                                                  template:template
-                                           validationMask:AllChecks
+                                           validationMask:[Validator validationMaskForAPIMethod:APIMethod_WallGet]
                                             fromAPIMethod:APIMethod_WallGet];
     return error;
 }
@@ -178,12 +791,18 @@ NSString * const maximumKey  = @"maximum";
 
 /*--------------------------------------------------------------------------------------------------------------
  Метод валидирует ответ сервера на запрос метода "friends.get".
+ Каждый друг в 'items' проверяется по первому другу шаблона.
  --------------------------------------------------------------------------------------------------------------*/
 + (NSError* _Nullable) validateResponseFrom_friendsGet:(NSDictionary*)recievedJSON
 {
     NSDictionary* template = [Templater templateForAPIMethod:APIMethod_FriendsGet];
     if (!template) return nil;
-    return nil;
+    
+    NSError* error = [Validator automaticValidateResponse:recievedJSON
+                                                 template:template
+                                           validationMask:[Validator validationMaskForAPIMethod:APIMethod_FriendsGet]
+                                            fromAPIMethod:APIMethod_FriendsGet];
+    return error;
 }
 
 
@@ -228,108 +847,278 @@ ____    ____  ___       __       __   _______       ___   .___________. __    __
                                   validationMask:(ResponseValidationMask)mask
                                    fromAPIMethod:(APIMethod)method
 {
-    NSError* error      = nil;
-    BOOL isOccuredError = NO;
+    NSError* error = nil;
     NSString* domain;
-    NSMutableArray* userInfoArray = [NSMutableArray new];
     
-    if ((recievedJSON.allKeys.count < 1) || (templateJSON.allKeys.count < 1)){
+    if ((recievedJSON.count < 1) || (templateJSON.count < 1)){
         domain = [NSString stringWithFormat:@"'recievedJSON' or 'templateJSON' is nil."];
         domain = [NSString stringWithFormat:@"%@\nIn +[Validator automaticValidateResponse:template:validationMask:]",domain];
         return [NSError errorWithDomain:domain code:0 userInfo:nil];
     }
     
+    NSMutableArray<ValidationIssue*>* issues = [NSMutableArray new];
+    ValidationPlan* plan = [Validator planForTemplate:templateJSON];
+    
+    // Отпечаток мог уже быть посчитан политикой валидации API метода
+    BOOL isKnownShape = (_knownShape.response == (__bridge const void*)recievedJSON) && (_knownShape.plan == (__bridge const void*)plan);
+    NSUInteger responseShape = (isKnownShape) ? _knownShape.shape : ValidationPlanShapeFingerprint(plan, recievedJSON);
+    NSNumber*  shape = @(ValidationMix(responseShape ^ mask));
+    
+    BOOL isPassedShape = NO;
+    @synchronized (plan){
+        NSUInteger index = [plan.passedShapes indexOfObject:shape];
+        isPassedShape = (index != NSNotFound);
+        // Отпечаток становится самым свежим
+        if ((isPassedShape) && (index + 1 < plan.passedShapes.count)){
+            [plan.passedShapes removeObjectAtIndex:index];
+            [plan.passedShapes addObject:shape];
+        }
+    }
+    
+    // Такая же структура уже прошла проверку: проверяются только значения
+    if (isPassedShape){
+        if ((mask & CheckOnExtendedRules) && (plan.hasRules) &&
+            ([Validator runRulesOfPlan:plan onJSON:recievedJSON validationMask:mask issues:issues]))
+        {
+            error = [Validator errorWithIssues:issues fromAPIMethod:method];
+        }
+        return error;
+    }
+    
+    // Инициализируем ошибку если она возникла
+    if ([Validator runPlan:plan onJSON:recievedJSON validationMask:mask issues:issues])
+    {
+        error = [Validator errorWithIssues:issues fromAPIMethod:method];
+    } else {
+        @synchronized (plan){
+            // Забывается отпечаток, который дольше всех не встречался
+            if (plan.passedShapes.count >= maxPassedShapes) [plan.passedShapes removeObjectAtIndex:0];
+            [plan.passedShapes addObject:shape];
+        }
+    }
+    return error;
+}
+
+
+/*--------------------------------------------------------------------------------------------------------------
+ Создает ошибку автоматической валидации и добавляет проблемы в счетчики.
+ Сообщения 'userInfoArray' форматируются только при чтении.
+ --------------------------------------------------------------------------------------------------------------*/
++ (NSError*) errorWithIssues:(NSArray<ValidationIssue*>*)issues fromAPIMethod:(APIMethod)method
+{
+    @synchronized ([NSNotificationCenter defaultCenter]){
+        for (ValidationIssue* issue in issues) _validationIssueCounters[issue.kind] += 1;
+    }
+    ValidationIssueMessages* messages = [ValidationIssueMessages new];
+    messages.issues = issues;
+
+    NSString* APIMethod = [API convertAPIMethodToString:method];
+    NSString* domain    = [NSString stringWithFormat:@"json recieved from API method (%@) has incorrect stucture",APIMethod];
+    return [NSError errorWithDomain:domain code:0 userInfo:@{ @"userInfoArray" : messages, @"validationIssues" : issues }];
+}
+
+
+/*--------------------------------------------------------------------------------------------------------------
+ Возвращает скомпилированный план шаблона. Шаблон компилируется только при первом вызове.
+ --------------------------------------------------------------------------------------------------------------*/
++ (ValidationPlan*) planForTemplate:(NSDictionary*)templateJSON
+{
+    @synchronized ([ValidationPlan class])
+    {
+        if (!_plans){
+             _plans = [NSMapTable mapTableWithKeyOptions:NSPointerFunctionsWeakMemory | NSPointerFunctionsObjectPointerPersonality
+                                            valueOptions:NSPointerFunctionsStrongMemory];
+        }
+        ValidationPlan* plan = [_plans objectForKey:templateJSON];
+        if (!plan){
+            plan = ValidationPlanCompile(templateJSON);
+            [_plans setObject:plan forKey:templateJSON];
+        }
+        return plan;
+    }
+}
+
+
+/*--------------------------------------------------------------------------------------------------------------
+ Проверяет 'recievedJSON' по плану. Найденные проблемы добавляются в 'issues'.
+ Возвращает 'YES', если были найдены ошибки.
+ --------------------------------------------------------------------------------------------------------------*/
++ (BOOL) runPlan:(ValidationPlan*)plan
+          onJSON:(NSDictionary*)recievedJSON
+  validationMask:(ResponseValidationMask)mask
+          issues:(NSMutableArray<ValidationIssue*>*)issues
+{
+    BOOL isOccuredError = NO;
+    
+    for (ValidationPlanEntry* entry in plan.entries)
+    {
+        id valueFromJSON = recievedJSON[entry.key];
+        ValidationValueType type = ValidationTypeOf(valueFromJSON);
+        
+        // Проверяем на наличие ключей
+        if ((!valueFromJSON) && (entry.isOptional)){
+            continue;
+        } else if ((!valueFromJSON) && (mask & CheckOnKeys)){
+            isOccuredError = YES;
+            [issues addObject:ValidationIssueMake(ValidationIssueKind_MissingKey, entry.key, nil, nil, nil)];
+            continue;
+        }
+        
+        // Ошибки основного алгоритма (другой класс, вложенные структуры) отменяют проверку правил для ключа
+        NSUInteger errorsBeforeKey = issues.count;
+        
+        // Проверка на типы
+        if ((mask & CheckOnTypesOfValues) && (type != entry.type)){
+            isOccuredError = YES;
+            [issues addObject:ValidationTypeIssueMake(entry.key, type, entry.type)];
+        }
+        
+        // Проверяем вложенности
+        if ((mask & CheckSubEntityOnKeys) && (entry.subPlan) &&
+            (type == ValidationValueType_Dictionary) && ([valueFromJSON count] > 0))
+        {
+            if ([Validator runPlan:entry.subPlan onJSON:valueFromJSON validationMask:mask issues:issues]){
+                isOccuredError = YES;
+            }
+        }
+        
+        // Проверяем элементы массивов
+        if ((mask & CheckArrayElements) && (entry.elementType != ValidationValueType_None) &&
+            (type == ValidationValueType_Array) && ([valueFromJSON count] > 0))
+        {
+            if ([Validator runElementsOfEntry:entry onArray:valueFromJSON validationMask:mask rulesOnly:NO issues:issues]){
+                isOccuredError = YES;
+            }
+        }
+        
+        // Запускаем проверку на словарь с правилами, если мы прошли все предыдущие проверки
+        if ((mask & CheckOnExtendedRules) && (entry.rules) && (issues.count == errorsBeforeKey))
+        {
+            [Validator validateJSONValue:valueFromJSON templateValue:entry.templateValue key:entry.key onRules:entry.rules issues:issues];
+            if (issues.count > errorsBeforeKey) isOccuredError = YES;
+        }
+    }
+    return isOccuredError;
+}
+
+
+/*--------------------------------------------------------------------------------------------------------------
+ Проверяет только правила плана. Используется для ответов, структура которых уже прошла план:
+ ключи и типы повторно не проверяются, вложенные словари без правил не посещаются.
+ --------------------------------------------------------------------------------------------------------------*/
++ (BOOL) runRulesOfPlan:(ValidationPlan*)plan
+                 onJSON:(NSDictionary*)recievedJSON
+         validationMask:(ResponseValidationMask)mask
+                 issues:(NSMutableArray<ValidationIssue*>*)issues
+{
+    BOOL isOccuredError = NO;
+    
+    for (ValidationPlanEntry* entry in plan.entries)
+    {
+        if (!entry.hasRules) continue;
+        
+        id valueFromJSON = recievedJSON[entry.key];
+        if (!valueFromJSON) continue;
+        
+        if ((entry.subPlan.hasRules) && ([valueFromJSON isKindOfClass:[NSDictionary class]]) &&
+            ([Validator runRulesOfPlan:entry.subPlan onJSON:valueFromJSON validationMask:mask issues:issues]))
+        {
+            isOccuredError = YES;
+            continue;
+        }
+        
+        if ((mask & CheckArrayElements) && (entry.elementPlan.hasRules) && ([valueFromJSON isKindOfClass:[NSArray class]]) &&
+            ([Validator runElementsOfEntry:entry onArray:valueFromJSON validationMask:mask rulesOnly:YES issues:issues]))
+        {
+            isOccuredError = YES;
+            continue;
+        }
+        
+        if (entry.rules)
+        {
+            NSUInteger issuesBeforeKey = issues.count;
+            [Validator validateJSONValue:valueFromJSON templateValue:entry.templateValue key:entry.key onRules:entry.rules issues:issues];
+            if (issues.count > issuesBeforeKey) isOccuredError = YES;
+        }
+    }
+    return isOccuredError;
+}
 
-    NSArray<NSString*>* allKeysFromRecievedJSON = [recievedJSON allKeys];
-    NSArray<NSString*>* allKeysFromTemplateJSON = [templateJSON allKeys];
 
-    for (NSString* key in allKeysFromTemplateJSON)
+/*--------------------------------------------------------------------------------------------------------------
+ Проверяет каждый элемент 'array' по первому элементу массива шаблона из 'entry'.
+ Длинные массивы делятся на части, которые проверяются параллельно. Проверка останавливается, когда найдено
+ 'arrayValidationErrorLimit' невалидных элементов. При 'rulesOnly' проверяются только правила элементов.
+ --------------------------------------------------------------------------------------------------------------*/
++ (BOOL) runElementsOfEntry:(ValidationPlanEntry*)entry
+                    onArray:(NSArray*)array
+             validationMask:(ResponseValidationMask)mask
+                  rulesOnly:(BOOL)rulesOnly
+                     issues:(NSMutableArray<ValidationIssue*>*)issues
+{
+    NSUInteger count      = array.count;
+    NSUInteger errorLimit = MAX(1, Validator.arrayValidationErrorLimit);
+    NSUInteger chunkCount = 1;
+    if (count >= parallelElementsThreshold){
+        chunkCount = MIN(NSProcessInfo.processInfo.activeProcessorCount * 2, count / minElementsPerChunk);
+    }
+    NSUInteger chunkLength = (count + chunkCount - 1) / chunkCount;
+    
+    // Каждая часть пишет только в свой массив, поэтому частям не нужна блокировка
+    NSMutableArray<NSMutableArray<ValidationIssue*>*>* chunkIssues = [NSMutableArray arrayWithCapacity:chunkCount];
+    for (NSUInteger chunk = 0; chunk < chunkCount; chunk++){
+        [chunkIssues addObject:[NSMutableArray new]];
+    }
+    atomic_uint  invalidElements    = 0;
+    atomic_uint* invalidElementsRef = &invalidElements;
+    
+    void(^validateChunk)(size_t) = ^(size_t chunk)
     {
-        if ([key hasSuffix:@"-Rules"]){
-            continue;
-        }
-        // Массив нужен для того, чтобы в конце цикла for решить, нужно ли осуществлять проверку на правила.
-        // Если ошибки были обнаружены в основным алгоритмом то есть (отсутьствие ключа,другой класс итд),
-        // тогда просто нету смысла осуществлять проверку на правила для конкретнной пары ключ-значение
-        NSMutableArray* localUserInfoArray = [NSMutableArray new];
-
-        id valueFromJSON     = recievedJSON[key];
-        id valueFromTemplate = templateJSON[key];
-        
-        NSDictionary* rules = [Validator rulesByKey:key inJSON:templateJSON];
-        BOOL     isOptional = [rules[isOptionalKey] boolValue];
-
-        // Проверяем на наличие ключей
-        if ((mask & CheckOnKeys) && (![allKeysFromRecievedJSON containsObject:key]) && (!isOptional)){
-            isOccuredError = YES;
-            domain = [NSString stringWithFormat:@"json hasn't '%@' key",key];
-            [userInfoArray addObject:domain];
-            continue;
-        } else if ((![allKeysFromRecievedJSON containsObject:key]) && (isOptional)) {
-            continue;
-        }
+        NSMutableArray<ValidationIssue*>* issuesOfChunk   = chunkIssues[chunk];
+        NSMutableArray<ValidationIssue*>* issuesOfElement = [NSMutableArray new];
+        NSUInteger end = MIN(count, (chunk + 1) * chunkLength);
         
-        // Проверка на типы
-        if (mask & CheckOnTypesOfValues)
+        for (NSUInteger index = chunk * chunkLength; index < end; index++)
         {
-            NSString* superClassValueFromJSON     = [Validator typeSuperClassName:[valueFromJSON superclass]];
-            NSString* superClassValueFromTemplate = [Validator typeSuperClassName:[valueFromTemplate superclass]];
+            // Этой или другими частями уже найдено достаточно невалидных элементов
+            if (atomic_load_explicit(invalidElementsRef, memory_order_relaxed) >= errorLimit) return;
             
-            // Обрабатываем случай если значения по ключам имеет разные типы,классы.
-            if (![superClassValueFromJSON isEqualToString:superClassValueFromTemplate]){
-                isOccuredError = YES;
-                domain = [NSString stringWithFormat:@"Value for key '%@' in recievedJSON has class (%@)\n"
-                          "Value for key '%@' in templateJSON has class (%@).",
-                          key,superClassValueFromJSON,
-                          key,superClassValueFromTemplate];
-                [localUserInfoArray addObject:domain];
-            }
-        }
-        
-        // Проверяем вложенности
-        if ((mask & CheckSubEntityOnKeys) && (recievedJSON[key])){
+            id element = array[index];
+            ValidationValueType type = ValidationTypeOf(element);
             
-            //NSLog(@"valueFromJSON.class %@",NSStringFromClass([valueFromJSON superclass]));
-            //NSLog(@"valueFromTemplate.class %@",NSStringFromClass([valueFromTemplate superclass]));
-
-           if (([valueFromJSON isKindOfClass:[NSDictionary class]]) &&
-               ([valueFromTemplate isKindOfClass:[NSDictionary class]])) {
-               
-                // Рекурсивно вызываем проверку вложенных подсловарей
-                NSError* subError = [Validator automaticValidateResponse:valueFromJSON
-                                                                template:valueFromTemplate
-                                                          validationMask:mask
-                                                           fromAPIMethod:method];
-               
-                if ((subError) && (subError.userInfo[@"userInfoArray"]))
-                {
-                    isOccuredError = YES;
-                    [localUserInfoArray addObjectsFromArray:subError.userInfo[@"userInfoArray"]];
-                }
+            if (type != entry.elementType){
+                if ((rulesOnly) || (!(mask & CheckOnTypesOfValues))) continue;
+                [issuesOfElement addObject:ValidationTypeIssueMake(nil, type, entry.elementType)];
+            } else if ((entry.elementPlan) && ([element count] > 0)){
+                if (rulesOnly) [Validator runRulesOfPlan:entry.elementPlan onJSON:element validationMask:mask issues:issuesOfElement];
+                else           [Validator runPlan:entry.elementPlan onJSON:element validationMask:mask issues:issuesOfElement];
             }
-        }
-        
-        // Запускаем проверку на словарь с правилами, если мы прошли все предыдущие проверки
-        if ((mask & CheckOnExtendedRules) && (rules.allKeys.count > 0) && (localUserInfoArray.count < 1)) {
-            NSError* subError = [Validator validateJSONValue:valueFromJSON templateValue:valueFromTemplate key:key onRules:rules];
-          
-            if ((subError) && (subError.userInfo[@"userInfoArray"])) {
-                isOccuredError = YES;
-                [userInfoArray addObjectsFromArray:subError.userInfo[@"userInfoArray"]];
+            if (issuesOfElement.count < 1) continue;
+            
+            atomic_fetch_add_explicit(invalidElementsRef, 1, memory_order_relaxed);
+            for (ValidationIssue* issue in issuesOfElement){
+                ValidationElementPath* step = [ValidationElementPath new];
+                step.key   = entry.key;
+                step.index = index;
+                step.next  = issue.elementPath;
+                issue.elementPath = step;
             }
-        } else {
-            [userInfoArray addObjectsFromArray:localUserInfoArray];
+            [issuesOfChunk addObjectsFromArray:issuesOfElement];
+            [issuesOfElement removeAllObjects];
         }
-    }
+    };
     
-    // Инициализируем ошибку если она возникла
-    if (isOccuredError)
-    {
-        NSString* APIMethod = [API convertAPIMethodToString:method];
-        domain = [NSString stringWithFormat:@"json recieved from API method (%@) has incorrect stucture",APIMethod];
-        error  = [NSError errorWithDomain:domain code:0 userInfo:@{ @"userInfoArray" : userInfoArray }];
+    if (chunkCount > 1) dispatch_apply(chunkCount, DISPATCH_APPLY_AUTO, validateChunk);
+    else                validateChunk(0);
+    
+    for (NSMutableArray<ValidationIssue*>* issuesOfChunk in chunkIssues){
+        [issues addObjectsFromArray:issuesOfChunk];
     }
-    return error;
+    NSUInteger invalidCount = atomic_load(&invalidElements);
+    if (invalidCount >= errorLimit){
+        [issues addObject:ValidationIssueMake(ValidationIssueKind_ArrayCheckStopped, entry.key, nil, @(invalidCount), @(count))];
+    }
+    return (invalidCount > 0);
 }
 
 
@@ -352,233 +1141,165 @@ ____    ____  ___       __       __   _______       ___   .___________. __    __
  Принимает значение из json файла, и в зависимости от их типа (String/Array/Dictionary/Number) вызывать нужный
  метод валидации для данного типа.
  --------------------------------------------------------------------------------------------------------------*/
-+ (NSError* _Nullable) validateJSONValue:(id)jsonValue templateValue:(id)templateValue key:(NSString*)key onRules:(NSDictionary*)rules
++ (void) validateJSONValue:(id)jsonValue
+             templateValue:(id)templateValue
+                       key:(NSString*)key
+                   onRules:(ValidationRules*)rules
+                    issues:(NSMutableArray<ValidationIssue*>*)issues
 {
-    NSError*  error   = nil;
-    NSString* message = nil;
-    
     // Check on nil
     if ((!jsonValue) || (!templateValue) || (!rules)){
-        message = @"One of params is nil. In +validateJSONValue:templateValue:key:onRules:";
-        return [NSError errorWithDomain:message code:0 userInfo:@{ @"userInfoArray" : @[message] }];
+        [issues addObject:ValidationIssueMake(ValidationIssueKind_InvalidParams, key, nil, nil, nil)];
+        return;
     }
     
-    // Check on other class
-    NSString* superClassValueFromJSON     = [Validator typeSuperClassName:[jsonValue superclass]];
-    NSString* superClassValueFromTemplate = [Validator typeSuperClassName:[templateValue superclass]];
+    // Проверка на другой класс
+    ValidationValueType type = ValidationTypeOf(jsonValue);
     
     // Обрабатываем случай если значения по ключам имеет разные типы,классы.
-    if (![superClassValueFromJSON isEqualToString:superClassValueFromTemplate]){
-        message = @"jsonValue & templateValue are members of other classes. In +validateJSONValue:templateValue:key:onRules:";
-        return [NSError errorWithDomain:message code:0 userInfo:@{ @"userInfoArray" : @[message] }];
-    }
-    
-    // String case:
-    if ([superClassValueFromJSON isEqualToString:@"NSString"]){
-        return [Validator validateString:jsonValue templateString:templateValue key:key onRules:rules];
-    }
-    
-    // Array case:
-    if ([superClassValueFromJSON isEqualToString:@"NSArray"]){
-        return [Validator validateArray:jsonValue templateArray:templateValue key:key onRules:rules];
-    }
-
-    // Dictionary case:
-    if ([superClassValueFromJSON isEqualToString:@"NSDictionary"]){
-        return [Validator validateDictionary:jsonValue templateDictionary:templateValue key:key onRules:rules];
+    if (type != ValidationTypeOf(templateValue)){
+        [issues addObject:ValidationTypeIssueMake(key, type, ValidationTypeOf(templateValue))];
+        return;
     }
     
-    // Number case:
-    if ([superClassValueFromJSON isEqualToString:@"NSNumber"]){
-        return  [Validator validateNumber:jsonValue templateNumber:templateValue key:key onRules:rules];
+    switch (type) {
+        case ValidationValueType_String:     [Validator validateString:jsonValue templateString:templateValue key:key onRules:rules issues:issues];             break;
+        case ValidationValueType_Array:      [Validator validateArray:jsonValue templateArray:templateValue key:key onRules:rules issues:issues];               break;
+        case ValidationValueType_Dictionary: [Validator validateDictionary:jsonValue templateDictionary:templateValue key:key onRules:rules issues:issues]; break;
+        case ValidationValueType_Number:     [Validator validateNumber:jsonValue templateNumber:templateValue key:key onRules:rules issues:issues];             break;
+        default: break;
     }
-    
-    return error;
 }
 
 /*--------------------------------------------------------------------------------------------------------------
  Метод занимается валидированием переменных типа NSString
  --------------------------------------------------------------------------------------------------------------*/
-+ (NSError* _Nullable) validateString:(nullable NSString*)jsonString
-                       templateString:(NSString*)templateString
-                                  key:(NSString*)key
-                              onRules:(NSDictionary*)rules
++ (void) validateString:(nullable NSString*)jsonString
+         templateString:(NSString*)templateString
+                    key:(NSString*)key
+                onRules:(ValidationRules*)rules
+                 issues:(NSMutableArray<ValidationIssue*>*)issues
 {
-    NSError*  error  = nil;
-    NSString* domain = nil;
-    NSMutableArray* userInfoArray = [NSMutableArray new];
-    
     // Check on nil
-    if ((!templateString) || (rules.allKeys.count < 1)){
-        domain = str(@"One of params (in +validateString:...) is nil. By key (%@)",key);
-        return [NSError errorWithDomain:domain code:0 userInfo: @{ @"userInfoArray" : @[domain] }];
+    if ((!templateString) || (!rules)){
+        [issues addObject:ValidationIssueMake(ValidationIssueKind_InvalidParams, key, nil, nil, nil)];
+        return;
     }
     
-    BOOL isOptional             =  [rules[isOptionalKey]        boolValue];
-    BOOL  mustMatch             =  [rules[mustMatchKey]         boolValue];
-    BOOL equalInLength          =  [rules[equalInLengthKey]     boolValue];
-    NSInteger lengthMustBeEqualOrGreaterThan =  [rules[lengthMustBeEqualOrGreaterThanKey] integerValue];
-    NSInteger lengthMustBeEqualOrLessThan    =  [rules[lengthMustBeEqualOrLessThanKey]    integerValue];
-    NSString* hasSuffix         =  rules[hasSuffixKey];
-    NSArray*  matchWithOneOf    =  rules[matchWithOneOfKey];
-    
+    NSUInteger length = jsonString.length;
     
     // Если значение из json==nil, а условия говорят, что проперти необязательно
-    if ((isOptional) && (!jsonString)){
-        return nil;
+    if ((rules.isOptional) && (!jsonString)){
+        return;
     }
     
     //hasSuffix
-    if ((hasSuffix) && (![jsonString hasPrefix:hasSuffix])) {
-        domain = str(@"The value(%@) by key(%@) hasn't requiered suffix(%@)",jsonString,key,hasSuffix);
-        [userInfoArray addObject:domain];
+    if ((rules.hasSuffix) && (![jsonString hasSuffix:rules.hasSuffix])) {
+        [issues addObject:ValidationIssueMake(ValidationIssueKind_RuleViolation, key, hasSuffixKey, jsonString, rules.hasSuffix)];
     }
     
     // matchWithOneOf
-    if (matchWithOneOf.count > 0) {
-       NSArray*  lowercaseArray  =  [Validator lowercaseArray:matchWithOneOf];
-       NSString* lowercaseString =  [jsonString lowercaseString];
-      
-        if (![lowercaseArray containsObject:lowercaseString]){
-            domain = str(@"The value(%@) by key(%@) not found in the allowed array(%@))",jsonString,key,matchWithOneOf);
-            [userInfoArray addObject:domain];
-        }
+    // Копия значения в нижнем регистре создается, только если значение не найдено как есть
+    if ((rules.matchWithOneOfSet) &&
+        (![rules.matchWithOneOfSet containsObject:jsonString]) &&
+        (![rules.matchWithOneOfSet containsObject:[jsonString lowercaseString]])){
+        [issues addObject:ValidationIssueMake(ValidationIssueKind_RuleViolation, key, matchWithOneOfKey, jsonString, rules.matchWithOneOf)];
     }
     
-    if ((mustMatch) && (![jsonString isEqualToString:templateString])) {
-        domain = str(@"The value by key(%@) not match with required=%@)",key,templateString);
-        [userInfoArray addObject:domain];
+    // matchesPattern. Шаблону должно соответствовать все значение
+    if ((rules.pattern) && (!rules.patternExpression)){
+        [issues addObject:ValidationIssueMake(ValidationIssueKind_InvalidRules, key, matchesPatternKey, jsonString, rules.pattern)];
+    } else if (rules.patternExpression){
+        NSRange match = [rules.patternExpression rangeOfFirstMatchInString:jsonString options:NSMatchingAnchored range:NSMakeRange(0, length)];
+        if ((match.location != 0) || (match.length != length)){
+            [issues addObject:ValidationIssueMake(ValidationIssueKind_RuleViolation, key, matchesPatternKey, jsonString, rules.pattern)];
+        }
     }
     
-    if ((equalInLength) && (jsonString.length != templateString.length)) {
-        domain = str(@"The length of values for key(%@) does not match",key);
-        [userInfoArray addObject:domain];
+    if ((rules.mustMatch) && (![jsonString isEqualToString:templateString])) {
+        [issues addObject:ValidationIssueMake(ValidationIssueKind_RuleViolation, key, mustMatchKey, jsonString, templateString)];
     }
     
-    if ((rules[@"lengthMustBeEqualOrGreaterThan"]) && (rules[@"lengthMustBeEqualOrLessThan"])){
-        if (lengthMustBeEqualOrGreaterThan > lengthMustBeEqualOrLessThan){
-            domain = str(@"Invalid rules (lengthMustBeEqualOrGreaterThan (cannot be greater than)> lengthMustBeEqualOrLessThan) in key(%@) value(%@)",key,jsonString);
-            [userInfoArray addObject:domain];
-            return [NSError errorWithDomain:domain code:0 userInfo:@{ @"userInfoArray" : userInfoArray }];
-        }
+    if ((rules.equalInLength) && (length != templateString.length)) {
+        [issues addObject:ValidationIssueMake(ValidationIssueKind_RuleViolation, key, equalInLengthKey, jsonString, templateString)];
     }
     
-    //lengthGreaterThan
-    if ((rules[@"lengthMustBeEqualOrGreaterThan"]) && (jsonString.length <= lengthMustBeEqualOrGreaterThan)) {
-        domain = str(@"The length of the key(%@) value is less than the required length. Must be greater than %d",key,lengthMustBeEqualOrGreaterThan);
-        [userInfoArray addObject:domain];
+    if (rules.hasInvalidLength){
+        [issues addObject:ValidationIssueMake(ValidationIssueKind_InvalidRules, key, lengthMustBeEqualOrGreaterThanKey, jsonString, nil)];
+        return;
     }
     
     //lengthGreaterThan
-    if ((rules[@"lengthMustBeEqualOrLessThan"]) && (jsonString.length >= lengthMustBeEqualOrLessThan)) {
-        domain = str(@"The length of the key(%@) value is greater than the required length. Must be less than %d",key,lengthMustBeEqualOrLessThan);
-        [userInfoArray addObject:domain];
+    if ((rules.lengthMin) && ((NSInteger)length <= [rules.lengthMin integerValue])) {
+        [issues addObject:ValidationIssueMake(ValidationIssueKind_RuleViolation, key, lengthMustBeEqualOrGreaterThanKey, jsonString, rules.lengthMin)];
     }
     
-    
-    if (userInfoArray.count > 0){
-        domain = [NSString stringWithFormat:@"Value for key(%@) has uncorrect data or structure",key];
-        error  = [NSError errorWithDomain:domain code:0 userInfo:@{ @"userInfoArray" : userInfoArray }];
+    //lengthGreaterThan
+    if ((rules.lengthMax) && ((NSInteger)length >= [rules.lengthMax integerValue])) {
+        [issues addObject:ValidationIssueMake(ValidationIssueKind_RuleViolation, key, lengthMustBeEqualOrLessThanKey, jsonString, rules.lengthMax)];
     }
     
-    return error;
 }
 
 
 /*--------------------------------------------------------------------------------------------------------------
  Метод занимается валидированием объектов типа NSArray
  --------------------------------------------------------------------------------------------------------------*/
-+ (NSError* _Nullable) validateArray:(nullable NSArray*)jsonArray
-                       templateArray:(NSArray*)templateArray
-                                 key:(NSString*)key
-                             onRules:(NSDictionary*)rules
++ (void) validateArray:(nullable NSArray*)jsonArray
+         templateArray:(NSArray*)templateArray
+                   key:(NSString*)key
+               onRules:(ValidationRules*)rules
+                issues:(NSMutableArray<ValidationIssue*>*)issues
 {
-    NSError*  error  = nil;
-    NSString* domain = nil;
-    NSMutableArray* userInfoArray = [NSMutableArray new];
-    
     // Check on nil
-    if ((!templateArray) || (rules.allKeys.count < 1)){
-        domain = str(@"One of params (in +validateArray:...) is nil. By key (%@)",key);
-        return [NSError errorWithDomain:domain code:0 userInfo:@{ @"userInfoArray" : @[domain] }];
+    if ((!templateArray) || (!rules)){
+        [issues addObject:ValidationIssueMake(ValidationIssueKind_InvalidParams, key, nil, nil, nil)];
+        return;
     }
     
-    BOOL isOptional = [rules[isOptionalKey] boolValue];
-    BOOL  mustMatch = [rules[mustMatchKey]  boolValue];
-
-    NSInteger elementsMustBeEqualOrMoreThan = [rules[elementsMustBeEqualOrMoreThanKey] integerValue];
-    NSInteger elementsMustBeEqualOrLessThan = [rules[elementsMustBeEqualOrLessThanKey] integerValue];
-    
     // Если значение из json==nil, а условия говорят, что проперти необязательно
-    if ((isOptional) && (!jsonArray)){
-        return nil;
-    }
-    
-    if (mustMatch){
-        
-        NSArray* arrayWithoutRules  = [Validator removeAllRulesFromArrayAndNastedStructure:templateArray];
-        NSArray* lowercaseTemplate  = [Validator lowercaseArray:arrayWithoutRules];
-        NSArray* lowercaseJSON      = [Validator lowercaseArray:jsonArray];
-        
-        if (![lowercaseTemplate isEqualToArray:lowercaseJSON]){
-            domain = str(@"The value by key(%@) not match with required=%@)",key,templateArray);
-            [userInfoArray addObject:domain];
-        }
+    if ((rules.isOptional) && (!jsonArray)){
+        return;
     }
     
-    if ((rules[@"elementsMustBeEqualOrMoreThan"]) && (jsonArray.count < elementsMustBeEqualOrMoreThan)){
-        domain = str(@"Array by key(%@) from json has less elements than required(%d)",key,elementsMustBeEqualOrMoreThan);
-        [userInfoArray addObject:domain];
+    if ((rules.mustMatch) && (!ValidationStringsMatchIgnoringCase(jsonArray, rules.mustMatchValue))){
+        [issues addObject:ValidationIssueMake(ValidationIssueKind_RuleViolation, key, mustMatchKey, jsonArray, templateArray)];
     }
     
-    if ((rules[@"elementsMustBeEqualOrLessThan"]) && (jsonArray.count > elementsMustBeEqualOrLessThan)){
-        domain = str(@"Array by key(%@) from json has greater elements than required(%d)",key,elementsMustBeEqualOrLessThan);
-        [userInfoArray addObject:domain];
+    if ((rules.elementsMin) && ((NSInteger)jsonArray.count < [rules.elementsMin integerValue])){
+        [issues addObject:ValidationIssueMake(ValidationIssueKind_RuleViolation, key, elementsMustBeEqualOrMoreThanKey, jsonArray, rules.elementsMin)];
     }
     
-    
-    if (userInfoArray.count > 0){
-        domain = [NSString stringWithFormat:@"Value for key(%@) has uncorrect data or structure",key];
-        error  = [NSError errorWithDomain:domain code:0 userInfo:@{ @"userInfoArray" : userInfoArray }];
+    if ((rules.elementsMax) && ((NSInteger)jsonArray.count > [rules.elementsMax integerValue])){
+        [issues addObject:ValidationIssueMake(ValidationIssueKind_RuleViolation, key, elementsMustBeEqualOrLessThanKey, jsonArray, rules.elementsMax)];
     }
     
-    return error;
 }
 
 
 /*--------------------------------------------------------------------------------------------------------------
  Метод занимается валидированием объектов типа NSDictionary
  --------------------------------------------------------------------------------------------------------------*/
-+ (NSError* _Nullable) validateDictionary:(nullable NSDictionary*)jsonDictionary
-                       templateDictionary:(NSDictionary*)templateDictionary
-                                      key:(NSString*)key
-                                  onRules:(NSDictionary*)rules
++ (void) validateDictionary:(nullable NSDictionary*)jsonDictionary
+         templateDictionary:(NSDictionary*)templateDictionary
+                        key:(NSString*)key
+                    onRules:(ValidationRules*)rules
+                     issues:(NSMutableArray<ValidationIssue*>*)issues
 {
-    NSError*  error  = nil;
-    NSString* domain = nil;
-    
     // Check on nil
-    if ((!templateDictionary) || (rules.allKeys.count < 1)){
-        domain = str(@"One of params (in +validateDictionary:...) is nil. By key (%@)",key);
-        return [NSError errorWithDomain:domain code:0 userInfo:@{ @"userInfoArray" : @[domain] }];
+    if ((!templateDictionary) || (!rules)){
+        [issues addObject:ValidationIssueMake(ValidationIssueKind_InvalidParams, key, nil, nil, nil)];
+        return;
     }
     
-    BOOL isOptional = [rules[isOptionalKey] boolValue];
-    BOOL  mustMatch = [rules[mustMatchKey]  boolValue];
-    
-    // Если значение из json==nil, а условия говорят, что проперти необязательно
-    if ((isOptional) && (!jsonDictionary)){
-        return nil;
+    // If значение из json==nil, а условия говорят, что проперти необязательно
+    if ((rules.isOptional) && (!jsonDictionary)){
+        return;
     }
     
-    if (mustMatch){
-        NSDictionary* templateWithoutRules = [Validator removeAllRulesFromDictionaryAndNastedStructure:templateDictionary];
-        if (![jsonDictionary isEqualToDictionary:templateWithoutRules]){
-            domain = str(@"The value by key(%@) not match with required=(%@)",key,templateDictionary);
-            return [NSError errorWithDomain:domain code:0 userInfo:@{ @"userInfoArray" : @[domain] }];
-        }
+    if ((rules.mustMatch) && (![jsonDictionary isEqualToDictionary:rules.mustMatchValue])){
+        [issues addObject:ValidationIssueMake(ValidationIssueKind_RuleViolation, key, mustMatchKey, jsonDictionary, templateDictionary)];
     }
-    return error;
 }
 
 
@@ -586,70 +1307,49 @@ ____    ____  ___       __       __   _______       ___   .___________. __    __
 /*--------------------------------------------------------------------------------------------------------------
  Метод занимается валидированием объектов типа NSNumber. Обрабатывает только численные значения (int/float/..ect)
  --------------------------------------------------------------------------------------------------------------*/
-+ (NSError* _Nullable) validateNumber:(nullable NSNumber*)jsonNumber
-                       templateNumber:(NSNumber*)templateNumber
-                                  key:(NSString*)key
-                              onRules:(NSDictionary*)rules
++ (void) validateNumber:(nullable NSNumber*)jsonNumber
+         templateNumber:(NSNumber*)templateNumber
+                    key:(NSString*)key
+                onRules:(ValidationRules*)rules
+                 issues:(NSMutableArray<ValidationIssue*>*)issues
 {
-    NSError*  error  = nil;
-    NSString* domain = nil;
-    NSMutableArray* userInfoArray = [NSMutableArray new];
-    
     // Check on nil
-    if ((!templateNumber) || (rules.allKeys.count < 1)){
-        domain = str(@"One of params (in +validateNumber:...) is nil. By key (%@)",key);
-        return [NSError errorWithDomain:domain code:0 userInfo:@{ @"userInfoArray" : @[domain] }];
+    if ((!templateNumber) || (!rules)){
+        [issues addObject:ValidationIssueMake(ValidationIssueKind_InvalidParams, key, nil, nil, nil)];
+        return;
     }
+    NSUInteger issuesBeforeNumber = issues.count;
     float jsonFloat = [jsonNumber  floatValue];
-
-    BOOL isOptional = [rules[isOptionalKey] boolValue];
-    BOOL  mustMatch = [rules[mustMatchKey]  boolValue];
-    
-    float  minimum = [rules[minimumKey]  floatValue];
-    float  maximum = [rules[maximumKey]  floatValue];
-
     
     // Если значение из json==nil, а условия говорят, что проперти необязательно
-    if ((isOptional) && (!jsonNumber)){
-        return nil;
+    if ((rules.isOptional) && (!jsonNumber)){
+        return;
     }
     
-    if ((mustMatch) && (![jsonNumber isEqualToNumber:templateNumber])){
-        domain = str(@"Number by key(%@) from json not matches with templete value(%@))",key,templateNumber);
-        [userInfoArray addObject:domain];
+    if ((rules.mustMatch) && (![jsonNumber isEqualToNumber:templateNumber])){
+        [issues addObject:ValidationIssueMake(ValidationIssueKind_RuleViolation, key, mustMatchKey, jsonNumber, templateNumber)];
     }
     
     // BOOL далее не валидируем
-    if ([NSStringFromClass([jsonNumber class]) isEqualToString:@"__NSCFBoolean"]){
-          if (userInfoArray.count > 0) return [NSError errorWithDomain:domain code:0 userInfo:@{ @"userInfoArray" : userInfoArray }];
+    if (CFGetTypeID((__bridge CFTypeRef)jsonNumber) == CFBooleanGetTypeID()){
+          if (issues.count > issuesBeforeNumber) return;
     }
     
     
-    if ((rules[minimumKey]) && (rules[maximumKey])){
-        if (minimum > maximum){
-            domain = str(@"Invalid rules (minimum (cannot be greater than)> maximum) in key(%@))",key);
-            [userInfoArray addObject:domain];
-            return [NSError errorWithDomain:domain code:0 userInfo:@{ @"userInfoArray" : userInfoArray }];
-        }
+    if (rules.hasInvalidRange){
+        [issues addObject:ValidationIssueMake(ValidationIssueKind_InvalidRules, key, minimumKey, jsonNumber, nil)];
+        return;
     }
     
     
-    if ((rules[minimumKey]) && (jsonFloat < minimum)){
-        domain = str(@"Number by key(%@) from json has value(%f). But mandatory minimum is (%f))",key,jsonFloat,minimum);
-        [userInfoArray addObject:domain];
+    if ((rules.minimum) && (jsonFloat < [rules.minimum floatValue])){
+        [issues addObject:ValidationIssueMake(ValidationIssueKind_RuleViolation, key, minimumKey, jsonNumber, rules.minimum)];
     }
     
     
-    if ((rules[maximumKey]) && (jsonFloat > maximum)){
-        domain = str(@"Number by key(%@) from json has value(%f). But mandatory maximum is (%f))",key,jsonFloat,maximum);
-        [userInfoArray addObject:domain];
-    }
-    
-    if (userInfoArray.count > 0){
-        domain = [NSString stringWithFormat:@"Value for key(%@) has uncorrect data or structure",key];
-        error  = [NSError errorWithDomain:domain code:0 userInfo:@{ @"userInfoArray" : userInfoArray }];
+    if ((rules.maximum) && (jsonFloat > [rules.maximum floatValue])){
+        [issues addObject:ValidationIssueMake(ValidationIssueKind_RuleViolation, key, maximumKey, jsonNumber, rules.maximum)];
     }
-    return error;
 }
 
 
@@ -807,4 +1507,410 @@ ____    ____  ___       __       __   _______       ___   .___________. __    __
     return [tempArray copy];
 }
 
+
+#pragma mark - Validation Issues
+
+/*--------------------------------------------------------------------------------------------------------------
+ Возвращает количество проблем данного вида, найденных автоматической валидацией с запуска или последнего сброса.
+ --------------------------------------------------------------------------------------------------------------*/
++ (NSUInteger) validationIssueCountOfKind:(ValidationIssueKind)kind
+{
+    if ((kind < 0) || (kind >= ValidationIssueKindCount)) return 0;
+    @synchronized ([NSNotificationCenter defaultCenter]){
+        return _validationIssueCounters[kind];
+    }
+}
+
++ (void) resetValidationIssueCounters
+{
+    @synchronized ([NSNotificationCenter defaultCenter]){
+        memset(_validationIssueCounters, 0, sizeof(_validationIssueCounters));
+    }
+}
+
+
+
+#pragma mark - Array Validation
+
+/*--------------------------------------------------------------------------------------------------------------
+ @property (class, nonatomic, assign) NSUInteger arrayValidationErrorLimit;
+ --------------------------------------------------------------------------------------------------------------*/
++ (void)setArrayValidationErrorLimit:(NSUInteger)arrayValidationErrorLimit
+{
+    @synchronized ([NSNotificationCenter defaultCenter]){
+        _arrayValidationErrorLimit = MAX(1, arrayValidationErrorLimit);
+    }
+}
+
++ (NSUInteger)arrayValidationErrorLimit
+{
+    @synchronized ([NSNotificationCenter defaultCenter]){
+        return _arrayValidationErrorLimit;
+    }
+}
+
+
+
+#pragma mark - Validation Policy
+
+/*--------------------------------------------------------------------------------------------------------------
+ Устанавливает политику валидации API метода. Счетчики предыдущей политики сбрасываются.
+ --------------------------------------------------------------------------------------------------------------*/
++ (void) setValidationPolicy:(ValidationPolicy)policy forAPIMethod:(APIMethod)method
+{
+    @synchronized ([NSNotificationCenter defaultCenter])
+    {
+        ValidationPolicyState* state = [Validator policyStateForAPIMethod:method];
+        state.policy             = policy;
+        state.responseCounter    = 0;
+        state.escalatedResponses = 0;
+        state.hasValidShape      = NO;
+    }
+}
+
++ (ValidationPolicy) validationPolicyForAPIMethod:(APIMethod)method
+{
+    @synchronized ([NSNotificationCenter defaultCenter]){
+        ValidationPolicyState* state = _validationPolicies[@(method)];
+        return (state) ? state.policy : ValidationPolicy_Full;
+    }
+}
+
++ (BOOL) isValidationEscalatedForAPIMethod:(APIMethod)method
+{
+    @synchronized ([NSNotificationCenter defaultCenter]){
+        return (_validationPolicies[@(method)].escalatedResponses > 0);
+    }
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ [Internal method]
+ Возвращает состояние API метода, при необходимости создавая его. Вызывать только внутри '@synchronized'.
+ --------------------------------------------------------------------------------------------------------------*/
++ (ValidationPolicyState*) policyStateForAPIMethod:(APIMethod)method
+{
+    if (!_validationPolicies){
+         _validationPolicies = [NSMutableDictionary new];
+    }
+    ValidationPolicyState* state = _validationPolicies[@(method)];
+    if (!state){
+        state = [ValidationPolicyState new];
+        _validationPolicies[@(method)] = state;
+    }
+    return state;
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ [Internal method]
+ Решает по политике API метода, нужно ли проверять ответ.
+ При 'ValidationPolicy_ShapeChanged' возвращает отпечаток ответа в 'shape'.
+ Если у API метода есть шаблон, отпечаток покрывает только его ключи и повторно используется автоматической валидацией.
+ --------------------------------------------------------------------------------------------------------------*/
++ (BOOL) shouldValidateResponse:(NSDictionary*)recievedJSON fromAPIMethod:(APIMethod)method shape:(NSUInteger*)shape
+{
+    ValidationPolicy policy = [Validator validationPolicyForAPIMethod:method];
+    if (policy == ValidationPolicy_Full) return YES;
+
+    // Отпечаток считается вне блокировки: он обходит весь ответ
+    if (policy == ValidationPolicy_ShapeChanged){
+        *shape = [Validator shapeOfResponse:recievedJSON fromAPIMethod:method];
+    }
+
+    @synchronized ([NSNotificationCenter defaultCenter])
+    {
+        ValidationPolicyState* state = _validationPolicies[@(method)];
+        if ((!state) || (state.policy != policy)) return YES;
+        if (state.escalatedResponses > 0)         return YES;
+
+        switch (policy) {
+            case ValidationPolicy_Sampled: {
+                NSUInteger counter = state.responseCounter;
+                state.responseCounter = counter + 1;
+                return (counter % MAX(1, _validationSampleRate) == 0);
+            }
+            case ValidationPolicy_ShapeChanged:
+                return (!state.hasValidShape) || (state.validShape != *shape);
+            case ValidationPolicy_Off:
+                return NO;
+            default:
+                return YES;
+        }
+    }
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ [Internal method]
+ Структурный отпечаток ответа API метода. Если у API метода есть шаблон, учитываются только ключи его плана,
+ а отпечаток передается в '+automaticValidateResponse:...' на этом потоке.
+ --------------------------------------------------------------------------------------------------------------*/
++ (NSUInteger) shapeOfResponse:(NSDictionary*)recievedJSON fromAPIMethod:(APIMethod)method
+{
+    NSDictionary* template = [Templater templateForAPIMethod:method];
+    if (!template) return ValidationShapeFingerprint(recievedJSON);
+
+    ValidationPlan* plan  = [Validator planForTemplate:template];
+    NSUInteger      shape = ValidationPlanShapeFingerprint(plan, recievedJSON);
+    _knownShape = (ValidationKnownShape){ (__bridge const void*)recievedJSON, (__bridge const void*)plan, shape };
+    return shape;
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ [Internal method]
+ Сохраняет результат валидации. После ошибки API метод полностью проверяется следующие
+ 'validationEscalationLength' ответов. Каждая новая ошибка начинает эскалацию заново.
+ --------------------------------------------------------------------------------------------------------------*/
++ (void) recordValidationError:(nullable NSError*)error fromAPIMethod:(APIMethod)method shape:(NSUInteger)shape
+{
+    @synchronized ([NSNotificationCenter defaultCenter])
+    {
+        ValidationPolicyState* state = _validationPolicies[@(method)];
+        if ((!state) || (state.policy == ValidationPolicy_Full)) return;
+
+        if (error){
+            if (state.escalatedResponses == 0){
+                APILog(@"+recordValidationError: | '%@' is validated fully after the failure",[APIManager convertAPIMethodToString:method]);
+            }
+            state.escalatedResponses = _validationEscalationLength;
+            state.hasValidShape = NO;
+            return;
+        }
+
+        if (state.escalatedResponses > 0){
+            state.escalatedResponses -= 1;
+        }
+        if (state.policy == ValidationPolicy_ShapeChanged){
+            state.validShape    = shape;
+            state.hasValidShape = YES;
+        }
+    }
+}
+
+
+/*--------------------------------------------------------------------------------------------------------------
+ @property (class, nonatomic, assign) NSUInteger validationSampleRate;
+ --------------------------------------------------------------------------------------------------------------*/
++ (void)setValidationSampleRate:(NSUInteger)validationSampleRate
+{
+    @synchronized ([NSNotificationCenter defaultCenter]){
+        _validationSampleRate = MAX(1, validationSampleRate);
+    }
+}
+
++ (NSUInteger)validationSampleRate
+{
+    @synchronized ([NSNotificationCenter defaultCenter]){
+        return _validationSampleRate;
+    }
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ @property (class, nonatomic, assign) NSUInteger validationEscalationLength;
+ --------------------------------------------------------------------------------------------------------------*/
++ (void)setValidationEscalationLength:(NSUInteger)validationEscalationLength
+{
+    @synchronized ([NSNotificationCenter defaultCenter]){
+        _validationEscalationLength = validationEscalationLength;
+    }
+}
+
++ (NSUInteger)validationEscalationLength
+{
+    @synchronized ([NSNotificationCenter defaultCenter]){
+        return _validationEscalationLength;
+    }
+}
+
+
+
+#pragma mark - Background Validation
+
+/*--------------------------------------------------------------------------------------------------------------
+ Включает фоновую валидацию ответов API метода.
+ --------------------------------------------------------------------------------------------------------------*/
++ (void) setAsynchronousValidation:(BOOL)isAsynchronous forAPIMethod:(APIMethod)method
+{
+    @synchronized ([NSNotificationCenter defaultCenter]){
+        [Validator policyStateForAPIMethod:method].isAsynchronous = isAsynchronous;
+    }
+}
+
++ (BOOL) isAsynchronousValidationForAPIMethod:(APIMethod)method
+{
+    @synchronized ([NSNotificationCenter defaultCenter]){
+        return _validationPolicies[@(method)].isAsynchronous;
+    }
+}
+
++ (NSUInteger) backgroundValidationCountForAPIMethod:(APIMethod)method
+{
+    @synchronized ([NSNotificationCenter defaultCenter]){
+        return _validationPolicies[@(method)].backgroundValidations;
+    }
+}
+
++ (NSUInteger) driftCountForAPIMethod:(APIMethod)method
+{
+    @synchronized ([NSNotificationCenter defaultCenter]){
+        return _validationPolicies[@(method)].driftedResponses;
+    }
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ [Internal method]
+ Проверяет ответ на 'backgroundValidationQueue'. Ошибка учитывается в счетчике и передается в 'validationDriftHandler'.
+ Если очередь перегружена, ответ не проверяется вовсе.
+ --------------------------------------------------------------------------------------------------------------*/
++ (void) validateInBackgroundResponse:(NSDictionary*)recievedJSON fromAPIMethod:(APIMethod)method validator:(SEL)validator
+{
+    @synchronized ([NSNotificationCenter defaultCenter])
+    {
+        if (_pendingBackgroundValidations >= maxPendingBackgroundValidations){
+            APILog(@"+validateInBackgroundResponse: | Queue is overloaded, response of '%@' is skipped",[APIManager convertAPIMethodToString:method]);
+            return;
+        }
+        _pendingBackgroundValidations += 1;
+    }
+
+    dispatch_async(Validator.backgroundValidationQueue, ^{
+        NSError* error = [Validator validateResponse:recievedJSON fromAPIMethod:method validator:validator];
+        ValidationDriftHandler driftHandler = nil;
+
+        @synchronized ([NSNotificationCenter defaultCenter])
+        {
+            _pendingBackgroundValidations -= 1;
+            ValidationPolicyState* state = [Validator policyStateForAPIMethod:method];
+            state.backgroundValidations += 1;
+            if (error){
+                state.driftedResponses += 1;
+                driftHandler = _validationDriftHandler;
+            }
+        }
+        if (error){
+            APILog(@"+validateInBackgroundResponse: | Response of '%@' differs from the template",[APIManager convertAPIMethodToString:method]);
+            if (driftHandler) driftHandler(method, error);
+        }
+    });
+}
+
+
+/*--------------------------------------------------------------------------------------------------------------
+ @property (class, nonatomic, copy, nullable) ValidationDriftHandler validationDriftHandler;
+ --------------------------------------------------------------------------------------------------------------*/
++ (void)setValidationDriftHandler:(ValidationDriftHandler)validationDriftHandler
+{
+    @synchronized ([NSNotificationCenter defaultCenter]){
+        _validationDriftHandler = [validationDriftHandler copy];
+    }
+}
+
++ (ValidationDriftHandler)validationDriftHandler
+{
+    @synchronized ([NSNotificationCenter defaultCenter]){
+        return _validationDriftHandler;
+    }
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ @property (class, nonatomic, readonly, strong) dispatch_queue_t backgroundValidationQueue;
+ --------------------------------------------------------------------------------------------------------------*/
++ (dispatch_queue_t)backgroundValidationQueue
+{
+    @synchronized ([NSNotificationCenter defaultCenter])
+    {
+        if (!_backgroundValidationQueue){
+            dispatch_queue_attr_t attributes = dispatch_queue_attr_make_with_qos_class(DISPATCH_QUEUE_SERIAL, QOS_CLASS_UTILITY, 0);
+            _backgroundValidationQueue = dispatch_queue_create("Validator.serial.backgroundValidationQueue", attributes);
+        }
+        return _backgroundValidationQueue;
+    }
+}
+
+
+
+#pragma mark - Benchmark
+
+#if DEBUG
+/*--------------------------------------------------------------------------------------------------------------
+ Возвращает пост в формате 'wall.get'. Используется как полезная нагрузка и (с правилами) как шаблон.
+ --------------------------------------------------------------------------------------------------------------*/
+static NSMutableDictionary* ValidatorBenchmarkPost(NSInteger index)
+{
+    return [@{ @"id"          : @(index),
+               @"from_id"     : @(155510513),
+               @"owner_id"    : @(155510513),
+               @"date"        : @(1600000000 + index),
+               @"post_type"   : @"post",
+               @"text"        : str(@"Post number %ld",(long)index),
+               @"comments"    : @{ @"count" : @(index % 7),  @"can_post"   : @(1) },
+               @"likes"       : @{ @"count" : @(index * 3),  @"user_likes" : @(0), @"can_like" : @(1), @"can_publish" : @(1) },
+               @"reposts"     : @{ @"count" : @(index % 5),  @"user_reposted" : @(0) },
+               @"views"       : @{ @"count" : @(index * 10) },
+               @"post_source" : @{ @"type"  : @"vk" },
+               @"attachments" : @[] } mutableCopy];
+}
+
+static void ValidatorMeasure(NSString* name, NSUInteger iterations, void(^validate)(void))
+{
+    validate(); // План компилируется до замера
+
+    CFAbsoluteTime elapsed = 0;
+    @autoreleasepool {
+        CFAbsoluteTime start = CFAbsoluteTimeGetCurrent();
+        for (NSUInteger i = 0; i < iterations; i++) validate();
+        elapsed = CFAbsoluteTimeGetCurrent() - start;
+    }
+    APILog(@"%@: %.2f µs per response", name, elapsed * 1e6 / iterations);
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ Валидирует ответ 'wall.get' со 100 постами: каждый пост по шаблону поста.
+ Сравнивает обход шаблона на каждый ответ, закэшированный скомпилированный план и план с отпечатками
+ прошедших структур (повторно проверяются только правила). Затем валидирует 'items' с 5000 постами.
+ --------------------------------------------------------------------------------------------------------------*/
++ (void) benchmarkValidation:(NSUInteger)iterations
+{
+    iterations = MAX(1, iterations);
+
+    NSMutableArray* posts = [NSMutableArray new];
+    for (NSInteger i = 0; i < 100; i++) [posts addObject:ValidatorBenchmarkPost(i)];
+
+    NSMutableDictionary* template = ValidatorBenchmarkPost(0);
+    template[@"post_type-Rules"] = @{ matchWithOneOfKey : @[@"post",@"copy",@"reply",@"postpone",@"suggest"] };
+    template[@"text-Rules"]      = @{ isOptionalKey : @(YES) };
+    template[@"date-Rules"]      = @{ minimumKey : @(0) };
+
+    ValidatorMeasure(@"wall.get x100 (template walked per response)", iterations, ^{
+        for (NSDictionary* post in posts){
+            NSMutableArray* issues = [NSMutableArray new];
+            [Validator runPlan:ValidationPlanCompile(template) onJSON:post validationMask:AllChecks issues:issues];
+        }
+    });
+    ValidatorMeasure(@"wall.get x100 (compiled plan)                ", iterations, ^{
+        ValidationPlan* plan = [Validator planForTemplate:template];
+        for (NSDictionary* post in posts){
+            NSMutableArray* issues = [NSMutableArray new];
+            [Validator runPlan:plan onJSON:post validationMask:AllChecks issues:issues];
+        }
+    });
+    ValidatorMeasure(@"wall.get x100 (compiled plan + fingerprints) ", iterations, ^{
+        for (NSDictionary* post in posts){
+            [Validator automaticValidateResponse:post template:template validationMask:AllChecks fromAPIMethod:APIMethod_WallGet];
+        }
+    });
+    
+    // Ответ целиком: элементы 'items' проверяются по первому посту шаблона
+    NSMutableArray* items = [NSMutableArray new];
+    for (NSInteger i = 0; i < 5000; i++) [items addObject:posts[i % posts.count]];
+    
+    NSDictionary* response         = @{ @"response" : @{ @"count" : @(items.count), @"items" : items } };
+    NSDictionary* responseTemplate = @{ @"response" : @{ @"count" : @(1), @"items" : @[template] } };
+    ValidationPlan* responsePlan   = [Validator planForTemplate:responseTemplate];
+    
+    ValidatorMeasure(@"wall.get items x5000 (elements in parallel)  ", iterations, ^{
+        NSMutableArray* issues = [NSMutableArray new];
+        [Validator runPlan:responsePlan onJSON:response validationMask:[Validator validationMaskForAPIMethod:APIMethod_WallGet] issues:issues];
+    });
+}
+#endif
+
 @end